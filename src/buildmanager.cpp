@@ -2395,7 +2395,7 @@ bool BuildManager::executeDDE(QString ddePseudoURL)
 #endif
 
 ProcessX::ProcessX(BuildManager *parent, const QString &assignedCommand, const QString &fileToCompile):
-    QProcess(parent), cmd(assignedCommand.trimmed()), file(fileToCompile), isStarted(false), ended(false), stderrEnabled(true), stdoutEnabled(true), stdoutEnabledOverrideOn(false), stdoutBuffer(nullptr),stderrBuffer(nullptr), stdoutCodec(nullptr)
+    QProcess(parent), cmd(assignedCommand.trimmed()), file(fileToCompile), isStarted(false), ended(false), stderrEnabled(true), stdoutEnabled(true), stdoutEnabledOverrideOn(false), stdoutObserved(false), stdoutBuffer(nullptr),stderrBuffer(nullptr), stdoutCodec(nullptr)
 {
 
 	QString stdoutRedirection, stderrRedirection;
@@ -2455,7 +2455,7 @@ void ProcessX::startCommand()
 		return;
 	}
 
-	if (stdoutEnabled || stdoutBuffer)
+	if (stdoutEnabled || stdoutBuffer || stdoutObserved)
 		connect(this, SIGNAL(readyReadStandardOutput()), this, SLOT(readFromStandardOutput()));
 	if (stderrEnabled)
 		connect(this, SIGNAL(readyReadStandardError()), this, SLOT(readFromStandardError()));
@@ -2548,6 +2548,11 @@ void ProcessX::setStderrBuffer(QString *buffer)
     stderrBuffer = buffer;
 }
 
+void ProcessX::setObserveStdout(bool observe)
+{
+	stdoutObserved = observe;
+}
+
 void ProcessX::setStdoutCodec(QTextCodec *codec)
 {
 	stdoutCodec = codec;
@@ -2651,10 +2656,11 @@ void ProcessX::finished()
 
 void ProcessX::readFromStandardOutput()
 {
-	if (!stdoutEnabled && !stdoutBuffer) return;
+	if (!stdoutEnabled && !stdoutBuffer && !stdoutObserved) return;
     QString t = readAllStandardOutputStr();
 	if (stdoutBuffer) stdoutBuffer->append(t);
-	emit standardOutputRead(t);
+	if (stdoutEnabled || stdoutBuffer) emit standardOutputRead(t);
+	if (stdoutObserved) emit standardOutputObserved(t);
 }
 
 void ProcessX::readFromStandardError(bool force)
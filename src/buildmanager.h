@@ -278,6 +278,7 @@ public:
 	void setStdoutBuffer(QString *buffer);
     void setStderrBuffer(QString *buffer);
 	void setStdoutCodec(QTextCodec *codec);
+	void setObserveStdout(bool observe);
 	bool showStderr() const;
 	void setShowStderr(bool show);
 	void setOverrideEnvironment(const QStringList &env);
@@ -295,6 +296,7 @@ signals:
 
 	void processNotification(const QString &message);
 	void standardOutputRead(const QString &data);
+	void standardOutputObserved(const QString &data); // emitted for every chunk of stdout if setObserveStdout(true), regardless of showStdout
 	void standardErrorRead(const QString &data);
     void processFinished();
 private slots:
@@ -310,7 +312,7 @@ private:
 	friend class BuildManager;
 	QString cmd;
 	QString file;
-	bool isStarted, ended, stderrEnabled, stdoutEnabled, stdoutEnabledOverrideOn;
+	bool isStarted, ended, stderrEnabled, stdoutEnabled, stdoutEnabledOverrideOn, stdoutObserved;
     QString *stdoutBuffer,*stderrBuffer;
 	QTextCodec *stdoutCodec;
 	QStringList overriddenEnvironment;
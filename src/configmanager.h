@@ -189,6 +189,7 @@ public:
 	QString logFileEncoding, bibFileEncoding;
 	bool autoLoadChildren;
     bool cacheDocuments;
+    bool indexProjectFiles;
 
     // insert cite command, when no context available
     QString citeCommand;
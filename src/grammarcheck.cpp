@@ -5,6 +5,24 @@
 #include "QThread"
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QCryptographicHash>
+
+namespace {
+const quint32 RESULT_CACHE_MAGIC = 0x54584743; ///< "TXGC"
+const qint32 RESULT_CACHE_VERSION = 1;
+const int RESULT_CACHE_SIZE = 5000; ///< number of cached blocks
+const int MAX_BATCH_LENGTH = 6000; ///< characters per backend request, a single larger block is sent alone
+const QString BATCH_SEPARATOR = "\n\n"; ///< blocks are separate paragraphs for LanguageTool
+
+QByteArray resultCacheKey(const QString &language, const QString &text)
+{
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(language.toUtf8());
+	hash.addData(QByteArray(1, '\0'));
+	hash.addData(text.toUtf8());
+	return hash.result();
+}
+}
 
 
 GrammarError::GrammarError(): offset(0), length(0), error(GET_UNKNOWN) {}
@@ -13,9 +31,10 @@ GrammarError::GrammarError(int offset, int length, const GrammarErrorType &error
 GrammarError::GrammarError(int offset, int length, const GrammarError &other): offset(offset), length(length), error(other.error), message(other.message), corrections(other.corrections) {}
 
 GrammarCheck::GrammarCheck(QObject *parent) :
-    QObject(parent), ltstatus(LTS_Unknown), backend(nullptr), ticket(0), pendingProcessing(false), shuttingDown(false)
+    QObject(parent), ltstatus(LTS_Unknown), backend(nullptr), ticket(0), pendingProcessing(false), shuttingDown(false), batchId(0), resultCacheModified(false)
 {
     latexParser = QSharedPointer<LatexParser>::create();
+    resultCache.setMaxCost(RESULT_CACHE_SIZE);
 }
 /*!
  * \brief GrammarCheck::~GrammarCheck
@@ -40,11 +59,12 @@ void GrammarCheck::init(const LatexParser &lp, const GrammarCheckerConfig &confi
 
         backend = new GrammarCheckLanguageToolJSON(this);
 
-        connect(backend, SIGNAL(checked(uint,int,QList<GrammarError>)), this, SLOT(backendChecked(uint,int,QList<GrammarError>)));
+        connect(backend, SIGNAL(checked(uint,int,QList<GrammarError>,bool)), this, SLOT(backendBatchChecked(uint,int,QList<GrammarError>,bool)));
         connect(backend, SIGNAL(errorMessage(QString)),this,SIGNAL(errorMessage(QString)));
         connect(backend, SIGNAL(languageToolStatusChanged()),this,SLOT(updateLTStatus()));
     }
 	backend->init(config);
+	initResultCache();
 
 	if (floatingEnvs.isEmpty())
 		floatingEnvs << "figure" << "table" << "SCfigure" << "wrapfigure" << "subfigure" << "floatbox";
@@ -150,6 +170,20 @@ struct CheckRequest {
 	QVector<QList<GrammarError> > errors;
 };
 
+/*!
+ * \brief block of a check request, which is sent to the backend together with other blocks
+ */
+struct BatchBlock {
+	uint ticket;
+	int subticket;
+	QString language;
+	QString text;
+	QByteArray key; ///< key in the result cache
+	int offset; ///< position of text in the text sent to the backend
+	BatchBlock(uint ticket, int subticket, const QString &language, const QString &text, const QByteArray &key):
+		ticket(ticket), subticket(subticket), language(language), text(text), key(key), offset(0) {}
+};
+
 void GrammarCheck::check(const QString &language, LatexDocument *doc, const QList<LineInfo> &inlines, int firstLineNr)
 {
 	if (shuttingDown || inlines.isEmpty()) return;
@@ -182,6 +216,7 @@ void GrammarCheck::check(const QString &language, LatexDocument *doc, const QLis
 
 void GrammarCheck::shutdown()
 {
+	saveResultCache();
 	if (backend) backend->shutdown();
 	shuttingDown = true;
 	deleteLater();
@@ -195,6 +230,7 @@ void GrammarCheck::processLoop()
 			requests[i].pending = false;
 			process(i);
 		}
+	sendBatches();
 	pendingProcessing = false;
 }
 
@@ -245,11 +281,162 @@ void GrammarCheck::process(int reqId)
 		if (tb.words.isEmpty() || !backend->isAvailable() ) backendChecked(crTicket, b, QList<GrammarError>(), true);
 		else  {
 			QString joined = tb.toString();
-			backend->check(crTicket, b, crLanguage, joined);
+			QByteArray key = resultCacheKey(crLanguage, joined);
+			const QList<GrammarError> *cached = resultCache.object(key);
+			if (cached) backendChecked(crTicket, b, *cached);
+			else queuedBlocks << BatchBlock(crTicket, b, crLanguage, joined, key);
+		}
+	}
+}
+
+/*!
+ * \brief send the queued blocks to the backend
+ * Blocks of the same language are joined as paragraphs of one text, so that many small blocks (e.g. after opening a document) need few requests.
+ */
+void GrammarCheck::sendBatches()
+{
+	while (!queuedBlocks.isEmpty()) {
+		const QString language = queuedBlocks.first().language;
+		QList<BatchBlock> batch;
+		QString text;
+		for (int i = 0; i < queuedBlocks.size();) {
+			const BatchBlock &bb = queuedBlocks.at(i);
+			if (bb.language != language) {
+				i++;
+				continue;
+			}
+			if (!batch.isEmpty() && text.length() + BATCH_SEPARATOR.length() + bb.text.length() > MAX_BATCH_LENGTH)
+				break;
+			if (!batch.isEmpty()) text += BATCH_SEPARATOR;
+			batch << queuedBlocks.takeAt(i);
+			batch.last().offset = text.length();
+			text += batch.last().text;
+		}
+		batchId++;
+		batches.insert(batchId, batch);
+		backend->check(batchId, 0, language, text);
+	}
+}
+
+/*!
+ * \brief split the backend result of a batch into the results of its blocks
+ * Errors spanning the separator of two blocks are dropped. The block results are cached, unless the backend reported a failed request.
+ * If the backend became unavailable, it drops its outstanding requests, so all pending batches are answered without backend errors.
+ */
+void GrammarCheck::backendBatchChecked(uint batchId, int subticket, const QList<GrammarError> &errors, bool success)
+{
+	Q_UNUSED(subticket)
+	if (shuttingDown) return;
+	if (!success && !backend->isAvailable()) {
+		const QHash<uint, QList<BatchBlock> > pending = batches;
+		batches.clear();
+		foreach (const QList<BatchBlock> &batch, pending)
+			foreach (const BatchBlock &bb, batch)
+				backendChecked(bb.ticket, bb.subticket, QList<GrammarError>());
+		return;
+	}
+	QHash<uint, QList<BatchBlock> >::iterator it = batches.find(batchId);
+	if (it == batches.end()) return;
+	const QList<BatchBlock> batch = it.value();
+	batches.erase(it);
+
+	QVector<QList<GrammarError> > blockErrors(batch.size());
+	foreach (const GrammarError &error, errors) {
+		int b = batch.size() - 1;
+		while (b > 0 && error.offset < batch.at(b).offset) b--;
+		const BatchBlock &bb = batch.at(b);
+		if (error.offset < bb.offset || error.offset + error.length > bb.offset + bb.text.length()) continue;
+		blockErrors[b] << GrammarError(error.offset - bb.offset, error.length, error);
+	}
+	for (int b = 0; b < batch.size(); b++) {
+		if (success) {
+			resultCache.insert(batch.at(b).key, new QList<GrammarError>(blockErrors.at(b)));
+			resultCacheModified = true;
+		}
+		backendChecked(batch.at(b).ticket, batch.at(b).subticket, blockErrors.at(b));
+	}
+}
+
+/*!
+ * \brief use the result cache of the caching folder
+ * The cache is cleared if settings changed which influence the backend results.
+ */
+void GrammarCheck::initResultCache()
+{
+	QString fileName = config.cachingDir.isEmpty() ? QString() : config.cachingDir + "/grammarcheck.cache";
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	foreach (const QString &s, QStringList() << config.languageToolURL << config.languageToolIgnoredRules << config.specialIds1 << config.specialIds2 << config.specialIds3 << config.specialIds4)
+		hash.addData((s + '\n').toUtf8());
+	QByteArray configHash = hash.result();
+	if (fileName == resultCacheFileName && configHash == resultCacheConfigHash)
+		return;
+
+	if (configHash == resultCacheConfigHash) saveResultCache();
+	else resultCache.clear();
+	resultCacheFileName = fileName;
+	resultCacheConfigHash = configHash;
+	resultCacheModified = false;
+	if (resultCache.isEmpty()) loadResultCache();
+}
+
+void GrammarCheck::loadResultCache()
+{
+	if (resultCacheFileName.isEmpty())
+		return;
+	QFile f(resultCacheFileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return;
+	QDataStream in(&f);
+	in.setVersion(QDataStream::Qt_5_12);
+	quint32 magic;
+	qint32 version, count;
+	QByteArray configHash;
+	in >> magic >> version >> configHash >> count;
+	if (magic != RESULT_CACHE_MAGIC || version != RESULT_CACHE_VERSION || configHash != resultCacheConfigHash || count < 0)
+		return;
+	for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		QByteArray key;
+		qint32 errorCount;
+		in >> key >> errorCount;
+		QList<GrammarError> *errors = new QList<GrammarError>();
+		for (int e = 0; e < errorCount && in.status() == QDataStream::Ok; e++) {
+			qint32 offset, length, type;
+			GrammarError error;
+			in >> offset >> length >> type >> error.message >> error.corrections;
+			error.offset = offset;
+			error.length = length;
+			error.error = static_cast<GrammarErrorType>(type);
+			errors->append(error);
+		}
+		if (in.status() != QDataStream::Ok) {
+			delete errors;
+			break;
 		}
+		resultCache.insert(key, errors);
 	}
 }
 
+void GrammarCheck::saveResultCache()
+{
+	if (!resultCacheModified || resultCacheFileName.isEmpty())
+		return;
+	QDir().mkpath(QFileInfo(resultCacheFileName).absolutePath());
+	QFile f(resultCacheFileName);
+	if (!f.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&f);
+	out.setVersion(QDataStream::Qt_5_12);
+	const QList<QByteArray> keys = resultCache.keys();
+	out << RESULT_CACHE_MAGIC << RESULT_CACHE_VERSION << resultCacheConfigHash << qint32(keys.size());
+	foreach (const QByteArray &key, keys) {
+		const QList<GrammarError> *errors = resultCache.object(key);
+		out << key << qint32(errors->size());
+		foreach (const GrammarError &error, *errors)
+			out << qint32(error.offset) << qint32(error.length) << qint32(error.error) << error.message << error.corrections;
+	}
+	resultCacheModified = false;
+}
+
 void GrammarCheck::backendChecked(uint crticket, int subticket, const QList<GrammarError> &backendErrors, bool directCall)
 {
 	if (shuttingDown) return;
@@ -676,6 +863,8 @@ void GrammarCheckLanguageToolJSON::finished(QNetworkReply *nreply)
             if (delayedRequests.size()) delayedRequests.clear();
             nam->deleteLater(); // shutdown unnecessary network manager (Bug 1717/1738)
             nam = nullptr;
+            nreply->deleteLater();
+            emit checked(ticket, subticket, QList<GrammarError>(), false); // also drops the delayed and pending requests
             return; //confirmed: no backend
         }
         //there might be a backend now, but we still don't have the results
@@ -699,7 +888,10 @@ void GrammarCheckLanguageToolJSON::finished(QNetworkReply *nreply)
         if (lang.contains('-')) {
             languagesCodesFail.insert(lang);
             check(ticket, subticket, lang, text);
+        } else {
+            emit checked(ticket, subticket, QList<GrammarError>(), false);
         }
+        nreply->deleteLater();
         return;
     }
 
@@ -768,7 +960,7 @@ void GrammarCheckLanguageToolJSON::finished(QNetworkReply *nreply)
         //qDebug() << realfrom << len;
     }
 
-    emit checked(ticket, subticket, results);
+    emit checked(ticket, subticket, results, status == 200);
 
     nreply->deleteLater();
 
@@ -7,6 +7,7 @@
 #include "configmanagerinterface.h"
 
 #include "grammarcheck_config.h"
+#include <QCache>
 class QDocumentLineHandle;
 class LatexDocument;
 
@@ -44,6 +45,7 @@ struct LanguageGrammarData {
 class GrammarCheckBackend;
 
 struct CheckRequest;
+struct BatchBlock;
 
 typedef QHash<QDocumentLineHandle *, QPair<uint, int> > TicketHash;
 
@@ -71,10 +73,15 @@ private slots:
 	void processLoop();
 	void process(int reqId);
 	void backendChecked(uint ticket, int subticket, const QList<GrammarError> &errors, bool directCall = false);
+	void backendBatchChecked(uint batchId, int subticket, const QList<GrammarError> &errors, bool success);
     void updateLTStatus();
 private:
 	QString languageFromHunspellToLanguageTool(QString language);
 	QString languageFromLanguageToolToHunspell(QString language);
+	void sendBatches();
+	void initResultCache();
+	void loadResultCache();
+	void saveResultCache();
 	LTStatus ltstatus;
     QSharedPointer<LatexParser> latexParser;
 	GrammarCheckerConfig config;
@@ -88,6 +95,14 @@ private:
 	QList<CheckRequest> requests;
 	QSet<QString> floatingEnvs;
 	QHash<QString, QString> languageMapping;
+
+	uint batchId;
+	QList<BatchBlock> queuedBlocks; ///< blocks of the current process loop, which are not cached
+	QHash<uint, QList<BatchBlock> > batches; ///< blocks sent to the backend, by batch id
+	QCache<QByteArray, QList<GrammarError> > resultCache; ///< backend results by hash of language and block text
+	QString resultCacheFileName;
+	QByteArray resultCacheConfigHash; ///< hash of the settings which change the backend results
+	bool resultCacheModified;
 };
 
 struct CheckRequestBackend;
@@ -105,7 +120,7 @@ public:
 	virtual void shutdown() = 0;
     virtual QString getLastErrorMessage() = 0;
 signals:
-	void checked(uint ticket, int subticket, const QList<GrammarError> &errors);
+	void checked(uint ticket, int subticket, const QList<GrammarError> &errors, bool success);
     void languageToolStatusChanged();
     void errorMessage(QString message);
 };
@@ -22,6 +22,7 @@ public:
 	QString specialIds1, specialIds2, specialIds3, specialIds4;
 
     QString appDir,configDir;
+    QString cachingDir; ///< folder for storing checked results, empty to disable storing
 };
 
 Q_DECLARE_METATYPE(GrammarCheckerConfig)
@@ -17,8 +17,7 @@
 #include "qdocument.h"
 
 #include <algorithm>
-#include <QtConcurrentFilter>
-#include <QtConcurrentMap>
+#include <numeric>
 
 
 //------------------------------Default Input Binding--------------------------------
@@ -957,14 +956,165 @@ void CompletionListModel::setEnvironMode(bool mode)
 	mEnvMode = mode;
 }
 /*!
- * \brief special less operator for comapring fuzzy based on scores
- * \param s1
- * \param s2
+ * \brief order of fuzzy matches: higher score first, equal scores in list order
+ * \param m1 (score, index)
+ * \param m2 (score, index)
  * \return
  */
-bool cwLessThan(const CompletionWord &s1, const CompletionWord &s2)
+static bool fuzzyLessThan(const QPair<int, int> &m1, const QPair<int, int> &m2)
 {
-    return s1.score > s2.score;
+    return m1.first > m2.first || (m1.first == m2.first && m1.second < m2.second);
+}
+/*!
+ * \brief bitmask of the characters contained in text
+ * Letters and digits get a bit each, all other characters share two bits.
+ * A text can only contain a subsequence if its mask contains the mask of the subsequence.
+ * \param text
+ * \return
+ */
+static quint64 fuzzyMask(const QString &text)
+{
+    quint64 mask = 0;
+    for (const QChar &c : text) {
+        ushort u = c.unicode();
+        int bit;
+        if (u >= 'a' && u <= 'z') bit = u - 'a';
+        else if (u >= 'A' && u <= 'Z') bit = 26 + u - 'A';
+        else if (u >= '0' && u <= '9') bit = 52 + u - '0';
+        else bit = 62 + (u & 1);
+        mask |= quint64(1) << bit;
+    }
+    return mask;
+}
+/*!
+ * \brief check if all characters of pattern appear in text in the same order
+ */
+static bool isSubsequence(const QString &pattern, const QString &text)
+{
+    int l = 0;
+    for (int i = 0; i < text.length() && l < pattern.length(); i++) {
+        if (text.at(i) == pattern.at(l))
+            l++;
+    }
+    return l == pattern.length();
+}
+/*!
+ * \brief score of a fuzzy match
+ * Consecutive matching characters are upvoted, late matches and unused commands are degraded.
+ * \param word typed text
+ * \param cw matching completion word
+ * \return
+ */
+static int fuzzyScore(const QString &word, const CompletionWord &cw)
+{
+    int score=0;
+    int l=0;
+    int lastMatch=-2;
+    for(int i=0;i<cw.sortWord.length();i++){
+        if(l>=word.length())
+            break;
+        if(cw.sortWord.at(i)==word.at(l)){
+            if(lastMatch+1==i)
+                score+=20;
+            score-=i; // later position are degraded
+            lastMatch=i;
+            l++;
+        }
+    }
+    // reduce score for atypical or unused
+    if(cw.index && !cw.word.contains('@')){
+        // don't upvote reference commands
+        score+=cw.usageCount<=0 ? 10*cw.usageCount : 10;
+    }
+    return score;
+}
+/*!
+ * \brief completion word shown for a fuzzy match
+ * \param cw matching completion word
+ * \param score
+ * \return
+ */
+static CompletionWord fuzzyCompletionWord(const CompletionWord &cw, int score)
+{
+    CompletionWord result = cw;
+    if (cw.word.contains('@')) {
+        QString ln = cw.lines[0];
+        if(cw.word.contains("@@")){ // special treatment for command-names containing @
+            ln.replace("@@", "@");
+        }else{
+            ln.replace("{@}", "{%<bibid%>}");
+            ln.replace("{@l}", "{%<label%>}");
+        }
+        result=CompletionWord(ln);
+    }
+    result.score = score;
+    return result;
+}
+/*!
+ * \brief invalidate the state of filterList() which refers to baselist
+ * Has to be called after baselist has been replaced or modified.
+ * The state is not kept as shared copy of baselist, as that would force a deep copy on every later modification.
+ */
+void CompletionListModel::baselistChanged()
+{
+    m_baseRevision++;
+    m_rangePos = m_rangeEnd = 0;
+    m_fuzzyMatches.clear();
+    m_fuzzyShown = 0;
+}
+/*!
+ * \brief fuzzy filtering of baselist
+ * All words whose sortWord contains the typed characters in order are matched.
+ * If the typed word extends the previous one, only the previous matches are checked again. Character masks reject most words before they are compared.
+ * Matches are only sorted up to the shown page, further pages are sorted on fetchMore().
+ * \param word
+ * \param fetchMore
+ */
+void CompletionListModel::filterFuzzy(const QString &word, bool fetchMore)
+{
+    if (!fetchMore) {
+        const QString pattern = word.startsWith('\\') ? word.mid(1) : word;
+        const quint64 needed = fuzzyMask(pattern);
+        bool sameBase = m_fuzzyRevision == m_baseRevision && m_fuzzyMasks.size() == baselist.size();
+        bool refine = sameBase && !m_fuzzyWord.isNull() && word.startsWith(m_fuzzyWord) && m_fuzzyFilter == m_filter;
+        if (!sameBase) {
+            m_fuzzyRevision = m_baseRevision;
+            m_fuzzyMasks.resize(baselist.size());
+            for (int i = 0; i < baselist.size(); i++)
+                m_fuzzyMasks[i] = fuzzyMask(baselist.at(i).sortWord);
+        }
+        QVector<QPair<int, int> > matches;
+        auto check = [&](int i) {
+            if ((m_fuzzyMasks.at(i) & needed) != needed)
+                return;
+            const CompletionWord &cw = baselist.at(i);
+            if (!cw.environmentRestriction.isEmpty() && cw.environmentRestriction != m_filter)
+                return;
+            if (isSubsequence(pattern, cw.sortWord))
+                matches.append(qMakePair(fuzzyScore(word, cw), i));
+        };
+        if (refine) {
+            for (const QPair<int, int> &match : std::as_const(m_fuzzyMatches))
+                check(match.second);
+        } else {
+            for (int i = 0; i < baselist.size(); i++)
+                check(i);
+        }
+        m_fuzzyMatches.swap(matches);
+        m_fuzzyWord = word;
+        m_fuzzyFilter = m_filter;
+        m_fuzzyShown = 0;
+    }
+    // like the prefix search, add pages of 101 words (see fetchMore())
+    int from = m_fuzzyShown;
+    int to = qMin(from + 101, m_fuzzyMatches.size());
+    std::partial_sort(m_fuzzyMatches.begin() + from, m_fuzzyMatches.begin() + to, m_fuzzyMatches.end(), fuzzyLessThan);
+    for (int i = from; i < to; i++) {
+        const QPair<int, int> &match = m_fuzzyMatches.at(i);
+        words.append(fuzzyCompletionWord(baselist.at(match.second), match.first));
+    }
+    m_fuzzyShown = to;
+    mCanFetchMore = to < m_fuzzyMatches.size();
 }
 /*!
  * \brief replace key in completion word with replacement
@@ -1004,6 +1154,71 @@ CompletionWord manipulateCompletionWord(CompletionWord cw,QString key,QString re
     return cw;
 }
 
+/*!
+ * \brief rebuild prefix index if baselist has been changed
+ * The index contains the positions of baselist sorted by sortWord and by case folded sortWord.
+ * baselist is usually sorted by sortWord already, but may have been extended by abbreviations or context words.
+ */
+void CompletionListModel::updatePrefixIndex()
+{
+    if (m_indexRevision == m_baseRevision && m_sortedIndex.size() == baselist.size())
+        return;
+    m_indexRevision = m_baseRevision;
+    const int n = baselist.size();
+    m_sortedIndex.resize(n);
+    std::iota(m_sortedIndex.begin(), m_sortedIndex.end(), 0);
+    std::stable_sort(m_sortedIndex.begin(), m_sortedIndex.end(), [this](int i, int j) {
+        return baselist.at(i).sortWord < baselist.at(j).sortWord;
+    });
+    QVector<QString> folded(n);
+    for (int i = 0; i < n; i++)
+        folded[i] = baselist.at(i).sortWord.toCaseFolded();
+    m_foldedIndex = m_sortedIndex;
+    std::stable_sort(m_foldedIndex.begin(), m_foldedIndex.end(), [&folded](int i, int j) {
+        return folded.at(i) < folded.at(j);
+    });
+    m_foldedKeys.resize(n);
+    for (int i = 0; i < n; i++)
+        m_foldedKeys[i] = folded.at(m_foldedIndex.at(i));
+}
+/*!
+ * \brief find range of words whose sortWord starts with prefix
+ * Sets m_rangePos/m_rangeEnd, words in range are accessed by rangeWord().
+ * \param prefix
+ * \param caseFolded compare case insensitively
+ */
+void CompletionListModel::findPrefixRange(const QString &prefix, bool caseFolded)
+{
+    updatePrefixIndex();
+    m_rangeFolded = caseFolded;
+    const int n = prefix.length();
+    if (caseFolded) {
+        const QString key = prefix.toCaseFolded();
+        QVector<QString>::const_iterator from = std::lower_bound(m_foldedKeys.constBegin(), m_foldedKeys.constEnd(), key);
+        QVector<QString>::const_iterator to = std::upper_bound(from, m_foldedKeys.constEnd(), key, [n](const QString &k, const QString &s) {
+            return QStringView(k).compare(QStringView(s).left(n)) < 0;
+        });
+        m_rangePos = int(from - m_foldedKeys.constBegin());
+        m_rangeEnd = int(to - m_foldedKeys.constBegin());
+    } else {
+        QVector<int>::const_iterator from = std::lower_bound(m_sortedIndex.constBegin(), m_sortedIndex.constEnd(), prefix, [this](int i, const QString &k) {
+            return baselist.at(i).sortWord < k;
+        });
+        QVector<int>::const_iterator to = std::upper_bound(from, m_sortedIndex.constEnd(), prefix, [this, n](const QString &k, int i) {
+            return QStringView(k).compare(QStringView(baselist.at(i).sortWord).left(n)) < 0;
+        });
+        m_rangePos = int(from - m_sortedIndex.constBegin());
+        m_rangeEnd = int(to - m_sortedIndex.constBegin());
+    }
+}
+/*!
+ * \brief word at position pos of the range found by findPrefixRange()
+ */
+const CompletionWord &CompletionListModel::rangeWord(int pos) const
+{
+    return baselist.at(m_rangeFolded ? m_foldedIndex.at(pos) : m_sortedIndex.at(pos));
+}
+
 void CompletionListModel::filterList(const QString &word, int mostUsed, bool fetchMore, CodeSnippet::Type type)
 {
     if (mostUsed < 0)
@@ -1024,73 +1239,16 @@ void CompletionListModel::filterList(const QString &word, int mostUsed, bool fet
 		checkFirstChar = LatexCompleter::config->caseSensitive == LatexCompleterConfig::CCS_FIRST_CHARACTER_CASE_SENSITIVE && word.length() > 1;
 	}
 	int cnt = 0;
-	QString sortWord = makeSortWord(word);
+	QString sortWord = CompletionWord(word).sortWord; // same key as the words in baselist, see CodeSnippet::CodeSnippet()
     if(mostUsed==2){
-        //fuzzy search
-        // proof of concept
-        // generate regexp
-        //QTime tm;
-        //tm.start();
-#if (QT_VERSION>=QT_VERSION_CHECK(5,14,0))
-        QStringList chars=word.split("",Qt::SkipEmptyParts);
-#else
-        QStringList chars=word.split("",QString::SkipEmptyParts);
-#endif
-        if(chars.value(0)==QChar('\\')){
-            chars.takeFirst();
-        }
-        QString regExpression=chars.join(".*");
-
-        QRegularExpression rx(regExpression);
-
-        words=QtConcurrent::blockingFiltered(baselist,[rx,this](const CompletionWord &item){
-            return item.sortWord.contains(rx) && (item.environmentRestriction.isEmpty() || item.environmentRestriction==m_filter);
-        });
-
-        QtConcurrent::blockingMap(words,[word](CompletionWord &item){
-            int score=0;
-            int l=0;
-            int lastMatch=-2;
-            for(int i=0;i<item.sortWord.length();i++){
-                if(l>=word.length())
-                    break;
-                if(item.sortWord.at(i)==word.at(l)){
-                    if(lastMatch+1==i)
-                        score+=20;
-                    score-=i; // later position are degraded
-                    lastMatch=i;
-                    l++;
-                }
-            }
-            if (item.word.contains('@')) {
-                if(item.word.contains("@@")){ // special treatment for command-names containing @
-                    QString ln = item.lines[0];
-                    ln.replace("@@", "@");
-                    item=CompletionWord(ln);
-                }else{
-                    QString ln = item.lines[0];
-                    ln.replace("{@}", "{%<bibid%>}");
-                    ln.replace("{@l}", "{%<label%>}");
-                    item=CompletionWord(ln);
-                }
-            }
-            // reduce score for atypical or unused
-            if(item.index){
-                // don't upvote reference commands
-                score+=item.usageCount<=0 ? 10*item.usageCount : 10;
-            }
-            item.score=score;
-        });
-
-        std::stable_sort(words.begin(),words.end(),cwLessThan);
-        //qDebug()<<tm.elapsed();
+        filterFuzzy(word, fetchMore);
     }else{
         // normal sorting
         if (!fetchMore) {
-            it = std::lower_bound(baselist.begin(), baselist.end(), CompletionWord(word));
+            findPrefixRange(sortWord, cs == Qt::CaseInsensitive);
         }
         // special treatment for citation commands as they generated on the fly
-        if (it == baselist.end() || !it->word.startsWith(word, cs)) {
+        if (m_rangePos >= m_rangeEnd || !rangeWord(m_rangePos).word.startsWith(word, cs)) {
             int i = word.lastIndexOf("{");
             QString test = word.left(i) + "{";
             QList<CompletionWord>::iterator lIt = std::lower_bound(baselist.begin(), baselist.end(), CompletionWord(test));
@@ -1151,18 +1309,22 @@ void CompletionListModel::filterList(const QString &word, int mostUsed, bool fet
         //
         CompletionWord mostUsedCW;
         int mostUsedPosition=-1;
-        while (it != baselist.end()) {
+        // the range contains all words whose sortWord starts with sortWord (case folded if case insensitive)
+        for (; m_rangePos < m_rangeEnd; ++m_rangePos) {
+            if (cnt > 100) {
+                mCanFetchMore = true;
+                break;
+            }
+            const CompletionWord *it = &rangeWord(m_rangePos);
             if (it->word.startsWith(word, cs) &&
                     (!checkFirstChar || it->word[1] == word[1]) ) {
 
                 // leave out words which are restricted to a certain environment (except for all-mode)
                 if (mostUsed < 2 && !it->environmentRestriction.isEmpty() && it->environmentRestriction != m_filter) {
-                    ++it;
                     continue;
                 }
                 if (mostUsed == 3 || it->usageCount >= mostUsed || it->usageCount == -2) {
                     if (mostUsed < 2 && type != CodeSnippet::none && it->type != type) {
-                        ++it;
                         continue; // leave out words which don't have the proper type (except for all-mode)
                     }
                     if (mEnvMode) {
@@ -1234,14 +1396,6 @@ void CompletionListModel::filterList(const QString &word, int mostUsed, bool fet
                     }
                     cnt++;
                 }
-            } else {
-                if (!it->sortWord.startsWith(sortWord))
-                    break; // sorted list
-            }
-            ++it;
-            if (cnt > 100) {
-                mCanFetchMore = true;
-                break;
             }
         }
         // switch most used to top position (favorite)
@@ -1257,24 +1411,15 @@ void CompletionListModel::filterList(const QString &word, int mostUsed, bool fet
         if (!words.isEmpty())
             mLastWordInList = words.last();
     }
-    if (mCanFetchMore && !fetchMore) {
-        // calculate real number of rows
-        QString wordp = word;
-        if (wordp.isEmpty()) {
-            mWordCount = baselist.count();
-            mLastWordInList = baselist.last();
-        } else {
-            QChar lst = wordp[wordp.length() - 1];
-            ushort nr = lst.unicode();
-            wordp[wordp.length() - 1] = QChar(nr + 1);
-            QList<CompletionWord>::const_iterator it2 = std::lower_bound(baselist.constBegin(),baselist.constEnd(), CompletionWord(wordp));
-            mWordCount = it2 - it;
-            if(it2==baselist.constBegin()){
-                mLastWordInList = baselist.last();
-            }else{
-                mLastWordInList = *(--it2);
-            }
-        }
+    if (mCanFetchMore && !fetchMore && mostUsed == 2) {
+        // fuzzy matches are only sorted up to the shown page
+        mWordCount = m_fuzzyMatches.size();
+        const QPair<int, int> &last = *std::max_element(m_fuzzyMatches.constBegin(), m_fuzzyMatches.constEnd(), fuzzyLessThan);
+        mLastWordInList = fuzzyCompletionWord(baselist.at(last.second), last.first);
+    } else if (mCanFetchMore && !fetchMore) {
+        // upper bound of the real number of rows
+        mWordCount = words.count() + m_rangeEnd - m_rangePos;
+        mLastWordInList = rangeWord(m_rangeEnd - 1);
     }
 
 	if (!fetchMore) {
@@ -1360,6 +1505,7 @@ void CompletionListModel::setBaseWords(const QSet<QString> &newwords, Completion
 	//if (completionType==CT_NORMALTEXT) wordsText=newWordList;
 	//else wordsCommands=newWordList;
 	baselist = wordsCommands;
+	baselistChanged();
 }
 
 void CompletionListModel::setBaseWords(const std::set<QString> &newwords, CompletionType completionType)
@@ -1402,6 +1548,7 @@ void CompletionListModel::setBaseWords(const std::set<QString> &newwords, Comple
     //if (completionType==CT_NORMALTEXT) wordsText=newWordList;
     //else wordsCommands=newWordList;
     baselist = wordsCommands;
+    baselistChanged();
 }
 
 void CompletionListModel::setBaseWords(const QList<CompletionWord> &newwords, CompletionType completionType)
@@ -1427,6 +1574,7 @@ void CompletionListModel::setBaseWords(const QList<CompletionWord> &newwords, Co
 	}
 
 	baselist = wordsCommands;
+	baselistChanged();
 }
 
 void CompletionListModel::setBaseWords(const CodeSnippetList &baseCommands, const CodeSnippetList &newwords, CompletionType completionType)
@@ -1454,6 +1602,7 @@ void CompletionListModel::setBaseWords(const CodeSnippetList &baseCommands, cons
 	}
 
 	baselist = newWordList;
+	baselistChanged();
 }
 
 void CompletionListModel::setAbbrevWords(const QList<CompletionWord> &newwords)
@@ -1842,6 +1991,7 @@ void LatexCompleter::complete(QEditor *newEditor, const CompletionFlags &flags)
 		QList<CompletionWord>::iterator middle = listModel->baselist.end() - listModel->wordsAbbrev.length();
 		std::inplace_merge(listModel->baselist.begin(), middle, listModel->baselist.end());
 	}
+	listModel->baselistChanged();
 	if ( editor->currentPlaceHolder() >= 0 && editor->currentPlaceHolder() < editor->placeHolderCount() ) {
 		PlaceHolder ph = editor->getPlaceHolder(editor->currentPlaceHolder());
 		if (ph.mirrors.count() > 0)
@@ -1960,6 +2110,7 @@ void LatexCompleter::directoryLoaded(QString , QSet<QString> content)
 {
 	listModel->setBaseWords(content, CT_NORMALTEXT);
 	listModel->baselist = listModel->wordsText;
+	listModel->baselistChanged();
 	//setTab(2);
     completerInputBinding->setMostUsed(3); // all
 	adjustWidget();
@@ -15,7 +15,7 @@ class CompletionListModel : public QAbstractListModel
 	Q_OBJECT
 
 public:
-    CompletionListModel(QObject *parent = 0): QAbstractListModel(parent), mostUsedUpdated(false), mCanFetchMore(false), mLastMU(0), mLastType(CodeSnippet::none), mEnvMode(false),m_disable_mostUsed_sorting(false), mWordCount(0), mCitCount(-1) {}
+    CompletionListModel(QObject *parent = 0): QAbstractListModel(parent), mostUsedUpdated(false), mCanFetchMore(false), mLastMU(0), mLastType(CodeSnippet::none), mEnvMode(false),m_disable_mostUsed_sorting(false), mWordCount(0), mCitCount(-1), m_indexRevision(-1), m_rangeFolded(false), m_rangePos(0), m_rangeEnd(0), m_baseRevision(0), m_fuzzyRevision(-1), m_fuzzyShown(0) {}
 
 	int rowCount(const QModelIndex &parent = QModelIndex()) const;
 	QVariant data(const QModelIndex &index, int role)const;
@@ -68,7 +68,29 @@ private:
 
     QString m_filter; // for showing also cwls which contain the filter string (by default hidden)
 
-	QList<CompletionWord>::iterator it;
+    // prefix index of baselist, see updatePrefixIndex()
+    int m_indexRevision; ///< revision of baselist the index refers to
+    QVector<int> m_sortedIndex; ///< positions in baselist sorted by sortWord
+    QVector<int> m_foldedIndex; ///< positions in baselist sorted by case folded sortWord
+    QVector<QString> m_foldedKeys; ///< case folded sortWords in order of m_foldedIndex
+    bool m_rangeFolded; ///< current range refers to m_foldedIndex
+    int m_rangePos, m_rangeEnd; ///< current range of prefix matches, m_rangePos is advanced by fetchMore()
+
+    void updatePrefixIndex();
+    void findPrefixRange(const QString &prefix, bool caseFolded);
+    const CompletionWord &rangeWord(int pos) const;
+
+    int m_baseRevision; ///< incremented on every change of baselist, see baselistChanged()
+    void baselistChanged();
+
+    // state of fuzzy filtering, see filterFuzzy()
+    int m_fuzzyRevision; ///< revision of baselist m_fuzzyMasks and m_fuzzyMatches refer to
+    QVector<quint64> m_fuzzyMasks; ///< character masks of the sortWords in baselist
+    QString m_fuzzyWord, m_fuzzyFilter; ///< word and environment filter of m_fuzzyMatches
+    QVector<QPair<int, int> > m_fuzzyMatches; ///< (score, index in baselist) of all matches, sorted up to m_fuzzyShown
+    int m_fuzzyShown;
+
+    void filterFuzzy(const QString &word, bool fetchMore);
 
 	static LatexCompleterConfig *config;
 };
@@ -9,6 +9,7 @@
 #include "qeditor.h"
 #include "latexcompleter.h"
 #include "latexcompleter_config.h"
+#include "misspellingindex.h"
 #include "configmanagerinterface.h"
 #include "smallUsefulFunctions.h"
 #include "latexparser/latexparsing.h"
@@ -25,6 +26,53 @@ UserCommandPair::UserCommandPair(const QString &name, const QString &snippet): n
     this->snippet.type=CodeSnippet::userCommand;
 }
 
+void ReferenceIndex::insert(QDocumentLineHandle *dlh, const ReferencePair &rp)
+{
+	m_items[rp.name].append(qMakePair(dlh, rp.start));
+}
+
+void ReferenceIndex::remove(QDocumentLineHandle *dlh, const QList<ReferencePair> &rps)
+{
+	foreach (const ReferencePair &rp, rps) {
+		QHash<QString, QList<QPair<QDocumentLineHandle *, int> > >::iterator it = m_items.find(rp.name);
+		if (it == m_items.end())
+			continue;
+		it.value().removeOne(qMakePair(dlh, rp.start));
+		if (it.value().isEmpty())
+			m_items.erase(it);
+	}
+}
+
+void ReferenceIndex::clear()
+{
+	m_items.clear();
+}
+
+int ReferenceIndex::count(const QString &name) const
+{
+	return m_items.value(name).count();
+}
+
+bool ReferenceIndex::contains(const QString &name) const
+{
+	return m_items.contains(name);
+}
+
+QList<QPair<QDocumentLineHandle *, int> > ReferenceIndex::occurrences(const QString &name) const
+{
+	return m_items.value(name);
+}
+
+/*!
+ * \brief add the number of occurrences of each name to counts
+ */
+void ReferenceIndex::addCounts(QHash<QString, int> &counts) const
+{
+	QHash<QString, QList<QPair<QDocumentLineHandle *, int> > >::const_iterator it;
+	for (it = m_items.constBegin(); it != m_items.constEnd(); ++it)
+		counts[it.key()] += it.value().count();
+}
+
 // languages for LaTeX syntax checking (exact name from qnfa file)
 const QSet<QString> LatexDocument::LATEX_LIKE_LANGUAGES = QSet<QString>() << "(La)TeX" << "Pweave" << "Sweave" << "TeX dtx file";
 /*! \brief constructor
@@ -41,6 +89,8 @@ LatexDocument::LatexDocument(QObject *parent): QDocument(parent), remeberAutoRel
     blockList->title = tr("BLOCKS"); */
 	mLabelItem.clear();
 	mBibItem.clear();
+	mLabelIndex.clear();
+	mBibIndex.clear();
 	mUserCommandList.clear();
 	mMentionedBibTeXFiles.clear();
 	masterDocument = nullptr;
@@ -57,12 +107,15 @@ LatexDocument::LatexDocument(QObject *parent): QDocument(parent), remeberAutoRel
     synChecker.setLtxCommands(lp);
 
     connect(&synChecker, SIGNAL(checkNextLine(QDocumentLineHandle*,bool,int,int)), SLOT(checkNextLine(QDocumentLineHandle*,bool,int,int)), Qt::QueuedConnection);
+
+    mMisspellingIndex = new MisspellingIndex(this, this);
 }
 
 LatexDocument::~LatexDocument()
 {
     synChecker.stop();
     synChecker.wait();
+    delete mMisspellingIndex; // stops the sweep before the lines are deleted
 
 	foreach (QDocumentLineHandle *dlh, mLineSnapshot) {
 		dlh->deref();
@@ -215,6 +268,9 @@ void LatexDocument::initClearStructure()
 	mLabelItem.clear();
 	mBibItem.clear();
 	mRefItem.clear();
+	mLabelIndex.clear();
+	mBibIndex.clear();
+	mRefIndex.clear();
 	mMentionedBibTeXFiles.clear();
 
 	mAppendixLine = nullptr;
@@ -255,17 +311,16 @@ void LatexDocument::patchStructureRemoval(QDocumentLineHandle *dlh, int hint,int
 
     for(int i=0;i<count;++i){
         if (mLabelItem.contains(dlh)) {
-            QList<ReferencePair> labels = mLabelItem.values(dlh);
+            QList<ReferencePair> labels = removeReferences(mLabelItem, mLabelIndex, dlh);
             completerNeedsUpdate = true;
-            mLabelItem.remove(dlh);
             foreach (const ReferencePair &rp, labels)
                 updateRefsLabels(rp.name);
         }
-        mRefItem.remove(dlh);
+        removeReferences(mRefItem, mRefIndex, dlh);
         if (mMentionedBibTeXFiles.remove(dlh))
             bibTeXFilesNeedsUpdate = true;
         if (mBibItem.contains(dlh)) {
-            mBibItem.remove(dlh);
+            removeReferences(mBibItem, mBibIndex, dlh);
             bibTeXFilesNeedsUpdate = true;
         }
 
@@ -284,7 +339,9 @@ void LatexDocument::patchStructureRemoval(QDocumentLineHandle *dlh, int hint,int
                     int i = word.indexOf('%', 1);
                     QString category = word.left(i);
                     QString elem = word.mid(i + 1);
-                    lp->possibleCommands[category].remove(elem);
+                    QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*lp);
+                    snapshot->possibleCommands[category].remove(elem);
+                    publishLtxCommands(snapshot);
                     ltxCommands.possibleCommands[category].remove(elem);
                 }else{
                     int i = word.indexOf("{");
@@ -375,7 +432,93 @@ void LatexDocument::lexLinesSimple(const int lineNr,const int count){
         line(i).setFlag(QDocumentLine::lexedPass2InComplete,false);
         line(i).setFlag(QDocumentLine::argumentsParsed,false);
     }
-    QtConcurrent::blockingMap(l_dlh,Parsing::simpleLexLatexLine);
+    if(m_tokenCache.isOpen()){
+        // lines are restored from cache if possible, lexed otherwise
+        QtConcurrent::blockingMap(l_dlh,[this](QDocumentLineHandle *dlh){
+            if(!m_tokenCache.restoreRawTokens(dlh)){
+                Parsing::simpleLexLatexLine(dlh);
+            }
+        });
+    }else{
+        QtConcurrent::blockingMap(l_dlh,Parsing::simpleLexLatexLine);
+    }
+}
+
+static const int speculativeLexMinLines = 2000; ///< documents shorter than this are lexed sequentially in pass 2
+static const int speculativeLexMinSegment = 256; ///< minimum number of lines in a speculatively lexed segment
+
+/*!
+ * \brief run pass 2 of the lexer on lines from..to-1 in parallel
+ * Pass 2 depends on the lexer state (remainder and command stack) of the previous line.
+ * The lines are split into segments after empty lines, where the state is usually empty, and every segment is lexed in parallel assuming an empty state at its start.
+ * Afterwards the assumption is checked against the state the previous segment actually ended with.
+ * If it doesn't hold, the first line of the segment is flagged for sequential lexing, which continues as long as the remainder differs from the speculated one.
+ * Segments which contain a possible run-away argument are left to sequential lexing completely, as it needs to filter them.
+ * \return lines which don't need sequential lexing, relative to from
+ */
+QBitArray LatexDocument::lexLinesSpeculative(const int from,const int to,const bool useTokenCache){
+    if (to - from < speculativeLexMinLines) return QBitArray();
+    QVector<QDocumentLineHandle *> handles;
+    handles.reserve(to - from);
+    for (int i = from; i < to; i++) {
+        if (line(i).hasFlag(QDocumentLine::lexedPass2Complete)) return QBitArray(); // partially lexed already, sequential lexing only redoes what is needed
+        handles << line(i).handle();
+    }
+    QList<QPair<int,int> > segments;
+    int segmentStart = 0;
+    for (int i = 1; i < handles.size(); i++) {
+        if (i - segmentStart >= speculativeLexMinSegment && handles[i - 1]->text().trimmed().isEmpty()) {
+            segments << qMakePair(segmentStart, i);
+            segmentStart = i;
+        }
+    }
+    segments << qMakePair(segmentStart, int(handles.size()));
+    if (segments.size() < 2) return QBitArray();
+
+    TokenStack initialRemainder;
+    CommandStack initialCommandStack;
+    QDocumentLineHandle *lastHandle = line(from - 1).handle();
+    if (lastHandle) {
+        initialRemainder = lastHandle->getRemainderLocked();
+        initialCommandStack = lastHandle->getCommandStackLocked();
+    }
+    QtConcurrent::blockingMap(segments, [&](const QPair<int,int> &segment){
+        TokenStack remainder;
+        CommandStack commandStack;
+        if (segment.first == 0) {
+            remainder = initialRemainder;
+            commandStack = initialCommandStack;
+        }
+        for (int i = segment.first; i < segment.second; i++) {
+            bool remainderChanged = false;
+            if (!useTokenCache || !m_tokenCache.restoreLine(handles[i], from + i, remainder, commandStack, remainderChanged))
+                Parsing::latexDetermineContexts2(handles[i], remainder, commandStack, lp);
+        }
+    });
+
+    QBitArray accepted(handles.size(), true);
+    for (const QPair<int,int> &segment : segments) {
+        bool runaway = false;
+        for (int i = segment.first; i < segment.second && !runaway; i++) {
+            const TokenStack remainder = handles[i]->getRemainderLocked();
+            for (const Token &tk : remainder) {
+                if (tk.type == Token::openBrace && tk.subtype != Token::text && tk.subtype != Token::none && tk.argLevel == 0) {
+                    runaway = true;
+                    break;
+                }
+            }
+        }
+        if (runaway) {
+            for (int i = segment.first; i < segment.second; i++) {
+                handles[i]->setFlag(QDocumentLine::lexedPass2Complete, false);
+                accepted.clearBit(i);
+            }
+        } else if (segment.first > 0 && (!handles[segment.first - 1]->getRemainderLocked().isEmpty() || !handles[segment.first - 1]->getCommandStackLocked().isEmpty())) {
+            handles[segment.first]->setFlag(QDocumentLine::lexedPass2Complete, false);
+            accepted.clearBit(segment.first);
+        }
+    }
+    return accepted;
 }
 
 /*!
@@ -394,25 +537,37 @@ int LatexDocument::lexLines(int &lineNr,int &count,bool recheck){
     CommandStack oldCommandStack;
 
     int stoppedAtLine=-1;
+    int end=qMin(lineCount(),lineNr+count);
+    if(lineNr==0 && count==lineCount() && !recheck) {
+        for (int i = lineNr; i < end; ++i) {
+            if (line(i).text() == "\\begin{document}"){
+                stoppedAtLine=i;
+                end=i;
+                break; // do recheck quickly as usepackages probably need to be loaded
+            }
+        }
+    }
     TokenList l_tkFilter;
     QDocumentLineHandle *lastHandle = line(lineNr - 1).handle();
     if (lastHandle) {
-        oldRemainder = lastHandle->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
-        oldCommandStack = lastHandle->getCookieLocked(QDocumentLine::LEXER_COMMANDSTACK_COOKIE).value<CommandStack >();
+        oldRemainder = lastHandle->getRemainderLocked();
+        oldCommandStack = lastHandle->getCommandStackLocked();
     }
+    // cached results are only valid if they were generated with the same set of commands
+    const bool useTokenCache = m_tokenCache.isOpen() && m_tokenCache.matches(*lp);
+    // lines lexed in parallel, which are taken over unless their predecessor changes
+    QBitArray speculated = lexLinesSpeculative(lineNr, end, useTokenCache);
     for (int i = lineNr; i < lineCount() && i < lineNr + count; ++i) {
-        if (line(i).text() == "\\begin{document}"){
-            if(lineNr==0 && count==lineCount() && !recheck) {
-                stoppedAtLine=i;
-                break; // do recheck quickly as usepackages probably need to be loaded
-            }
-        }
-        if(line(i).hasFlag(QDocumentLine::lexedPass2Complete)){
-            oldRemainder = line(i).getCookie(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
-            oldCommandStack = line(i).getCookie(QDocumentLine::LEXER_COMMANDSTACK_COOKIE).value<CommandStack >();
+        if (i == stoppedAtLine) break;
+        if(line(i).hasFlag(QDocumentLine::lexedPass2Complete) || (i - lineNr < speculated.size() && speculated.testBit(i - lineNr))){
+            oldRemainder = line(i).handle()->getRemainder();
+            oldCommandStack = line(i).handle()->getCommandStack();
             continue;
         }else{
-            bool remainderChanged = Parsing::latexDetermineContexts2(line(i).handle(), oldRemainder, oldCommandStack, lp);
+            bool remainderChanged = false;
+            if(!useTokenCache || !m_tokenCache.restoreLine(line(i).handle(), i, oldRemainder, oldCommandStack, remainderChanged)){
+                remainderChanged = Parsing::latexDetermineContexts2(line(i).handle(), oldRemainder, oldCommandStack, lp);
+            }
             bool leaveLoop=false;
             if(oldRemainder.size()>0){
                 for(int k=0;k<oldRemainder.size();++k){
@@ -429,7 +584,7 @@ int LatexDocument::lexLines(int &lineNr,int &count,bool recheck){
                     // store filtered as remainder into line
                     QDocumentLineHandle *dlh=line(i).handle();
                     dlh->lockForWrite();
-                    dlh->setCookie(QDocumentLine::LEXER_REMAINDER_COOKIE, QVariant::fromValue<TokenStack>(oldRemainder));
+                    dlh->setRemainder(oldRemainder);
                     dlh->unlock();
                     continue;
                 }
@@ -447,12 +602,13 @@ int LatexDocument::lexLines(int &lineNr,int &count,bool recheck){
                         line(j).setFlag(QDocumentLine::lexedPass2Complete,false);
                         line(j).setFlag(QDocumentLine::lexedPass2InComplete,false);
                         line(j).setFlag(QDocumentLine::argumentsParsed,false);
+                        if (j >= lineNr && j - lineNr < speculated.size()) speculated.clearBit(j - lineNr);
                     }
                     i=i-ConfigManager::RUNAWAYLIMIT;
                     lastHandle = line(i).handle();
                     if (lastHandle) {
-                        oldRemainder = lastHandle->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
-                        oldCommandStack = lastHandle->getCookieLocked(QDocumentLine::LEXER_COMMANDSTACK_COOKIE).value<CommandStack >();
+                        oldRemainder = lastHandle->getRemainderLocked();
+                        oldCommandStack = lastHandle->getCommandStackLocked();
                     }else{
                         oldRemainder.clear();
                         oldCommandStack.clear();
@@ -462,6 +618,7 @@ int LatexDocument::lexLines(int &lineNr,int &count,bool recheck){
             }
             if (remainderChanged && i + 1 < lineCount()) { // remainder changed in last line which is to be checked
                 line(i + 1).setFlag(QDocumentLine::lexedPass2Complete,false);
+                if (i + 1 - lineNr < speculated.size()) speculated.clearBit(i + 1 - lineNr);
                 if(i + 1 == lineNr + count){
                     ++count; // check also next line ...
                 }
@@ -478,7 +635,7 @@ int LatexDocument::lexLines(int &lineNr,int &count,bool recheck){
  */
 void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std::list<StructureEntry*>::iterator &docStructureIter){
     //
-    QPair<int,int> commentStart = dlh->getCookieLocked(QDocumentLine::LEXER_COMMENTSTART_COOKIE).value<QPair<int,int> >();
+    QPair<int,int> commentStart = dlh->getCommentStartLocked();
     int col = commentStart.first;
     if (col >= 0) {
         // all
@@ -494,7 +651,7 @@ void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std
             replaceOrAdd(docStructureIter,dlh,newTodo);
             // save comment type into cookie
             commentStart.second=Token::todoComment;
-            dlh->setCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE, QVariant::fromValue<QPair<int,int> >(commentStart));
+            dlh->setCommentStart(commentStart);
         }
         //// parameter comment
         if (curLine.startsWith("%&")) {
@@ -518,7 +675,7 @@ void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std
                 }
             }
             commentStart.second=Token::magicComment;
-            dlh->setCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE, QVariant::fromValue<QPair<int,int> >(commentStart));
+            dlh->setCommentStart(commentStart);
         }
         //// magic comment
         static const QRegularExpression rxMagicTexComment("^%\\ ?!T[eE]X");
@@ -528,7 +685,7 @@ void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std
         if (matchMagicTexComment.hasMatch()) {
             addMagicComment(text.mid(matchMagicTexComment.capturedLength()).trimmed(), curLineNr, docStructureIter);
             commentStart.second=Token::magicComment;
-            dlh->setCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE, QVariant::fromValue<QPair<int,int> >(commentStart));
+            dlh->setCommentStart(commentStart);
         } else if (matchMagicBibComment.hasMatch()) {
             // workaround to also support "% !BIB program = biber" syntax used by TeXShop and TeXWorks
             text = text.mid(matchMagicBibComment.capturedLength()).trimmed();
@@ -538,7 +695,7 @@ void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std
             if ((name == "TS-program" || name == "program") && (val == "biber" || val == "bibtex" || val == "bibtex8")) {
                 addMagicComment(QString("TXS-program:bibliography = txs:///%1").arg(val), curLineNr, docStructureIter);
                 commentStart.second=Token::magicComment;
-                dlh->setCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE, QVariant::fromValue<QPair<int,int> >(commentStart));
+                dlh->setCommentStart(commentStart);
             }
         }
     }
@@ -555,7 +712,7 @@ void LatexDocument::handleComments(QDocumentLineHandle *dlh, int &curLineNr, std
  */
 void LatexDocument::interpretCommandArguments(QDocumentLineHandle *dlh, const int currentLineNr, HandledData &data, bool recheckLabels, std::list<StructureEntry*>::iterator & docStructureIter){
     if(dlh->hasFlag(QDocumentLine::argumentsParsed)) return;
-    TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList >();
+    TokenList tl = dlh->getTokensLocked();
 
     const QString curLine=dlh->text();
     bool parsingComplete = true;
@@ -572,7 +729,7 @@ void LatexDocument::interpretCommandArguments(QDocumentLineHandle *dlh, const in
             ReferencePair elem;
             elem.name = tk.getText();
             elem.start = tk.start;
-            mRefItem.insert(dlh, elem);
+            insertReference(mRefItem, mRefIndex, dlh, elem);
         }
 
         //// label ////
@@ -580,7 +737,7 @@ void LatexDocument::interpretCommandArguments(QDocumentLineHandle *dlh, const in
             ReferencePair elem;
             elem.name = tk.getText();
             elem.start = tk.start;
-            mLabelItem.insert(dlh, elem);
+            insertReference(mLabelItem, mLabelIndex, dlh, elem);
             data.completerNeedsUpdate = true;
             StructureEntry *newLabel = new StructureEntry(this, StructureEntry::SE_LABEL);
             newLabel->title = elem.name;
@@ -607,7 +764,7 @@ void LatexDocument::interpretCommandArguments(QDocumentLineHandle *dlh, const in
             ReferencePair elem;
             elem.name = tk.getText();
             elem.start = tk.start;
-            mBibItem.insert(dlh, elem);
+            insertReference(mBibItem, mBibIndex, dlh, elem);
             data.bibItemsChanged = true;
             continue;
         }
@@ -1195,17 +1352,19 @@ void LatexDocument::handleRescanDocuments(HandledData changedCommands){
                 }
             }
             if(!changedCommands.addedUserCommands.isEmpty()){
-                lp->possibleCommands["user"].unite(ltxCommands.possibleCommands["user"]);
+                QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*lp);
+                snapshot->possibleCommands["user"].unite(ltxCommands.possibleCommands["user"]);
                 // handle specialDef commands
                 for(const QString &key: changedCommands.addedUserCommands){
                     if(key.startsWith("%")){
                         const int i = key.indexOf('%', 1);
                         QString category = key.left(i);
                         QString elem = key.mid(i + 1);
-                        lp->possibleCommands[category].insert(elem);
+                        snapshot->possibleCommands[category].insert(elem);
                         ltxCommands.possibleCommands[category].insert(elem);
                     }
                 }
+                publishLtxCommands(snapshot);
                 if(cntAddedUserCommands<changedCommands.addedUserCommands.size()){
                     // new usercommands were generated when reinterpretCommandArguments was called, fix #3885
                     updateCompletionFiles(false,true);
@@ -1213,15 +1372,17 @@ void LatexDocument::handleRescanDocuments(HandledData changedCommands){
                 changedCommands.addedUserCommands.clear();
             }
             if(!changedCommands.removedUserCommands.isEmpty()){
+                QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*lp);
                 for(const QString &key: changedCommands.removedUserCommands){
                     if(key.startsWith("%")){
                         const int i = key.indexOf('%', 1);
                         QString category = key.left(i);
                         QString elem = key.mid(i + 1);
-                        lp->possibleCommands[category].remove(elem);
+                        snapshot->possibleCommands[category].remove(elem);
                         ltxCommands.possibleCommands[category].remove(elem);
                     }
                 }
+                publishLtxCommands(snapshot);
                 changedCommands.removedUserCommands.clear();
             }
 
@@ -1284,13 +1445,12 @@ void LatexDocument::removeLineElements(QDocumentLineHandle *dlh, HandledData &ch
         }
     }
     if (mLabelItem.contains(dlh)) {
-        QList<ReferencePair> labels = mLabelItem.values(dlh);
+        QList<ReferencePair> labels = removeReferences(mLabelItem, mLabelIndex, dlh);
         changedCommands.completerNeedsUpdate = true;
-        mLabelItem.remove(dlh);
         foreach (const ReferencePair &rp, labels)
             updateRefsLabels(rp.name);
     }
-    mRefItem.remove(dlh);
+    removeReferences(mRefItem, mRefIndex, dlh);
     changedCommands.removedIncludes = mIncludedFilesList.values(dlh);
     changedCommands.removedIncludes.append(mImportedFilesList.values(dlh));
     mIncludedFilesList.remove(dlh);
@@ -1309,7 +1469,7 @@ void LatexDocument::removeLineElements(QDocumentLineHandle *dlh, HandledData &ch
         }
         mUserCommandList.remove(dlh);
     }
-    if (mBibItem.remove(dlh))
+    if (!removeReferences(mBibItem, mBibIndex, dlh).isEmpty())
         changedCommands.bibTeXFilesNeedsUpdate = true;
 
     changedCommands.removedUsepackages << mUsepackageList.values(dlh);
@@ -1364,7 +1524,7 @@ void LatexDocument::patchStructure(int linenr, int count, bool recheck)
 	int newCount = count;
 	if (linenr > 0) {
 		QDocumentLineHandle *previous = line(linenr - 1).handle();
-		remainder = previous->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+		remainder = previous->getRemainderLocked();
 		if (!remainder.isEmpty() && remainder.top().subtype != Token::none) {
 			QDocumentLineHandle *lh = remainder.top().dlh;
 			lineNrStart = lh->document()->indexOf(lh);
@@ -1375,6 +1535,12 @@ void LatexDocument::patchStructure(int linenr, int count, bool recheck)
 	// usepackage list
     HandledData changedCommands;
 
+    // initial lexing of complete document, use lexer results from last session where possible
+    const bool useTokenCache = linenr == 0 && count == lineCount() && !recheck;
+    if (useTokenCache) {
+        openTokenCache();
+    }
+
     //lex lines
     lexLines(linenr,count,recheck);
 
@@ -1475,6 +1641,10 @@ void LatexDocument::patchStructure(int linenr, int count, bool recheck)
 
     handleRescanDocuments(changedCommands);
 
+    if (useTokenCache) {
+        m_tokenCache.close();
+    }
+
     emit structureUpdated();
 
     if(changedCommands.completerNeedsUpdate){
@@ -1555,8 +1725,7 @@ int LatexDocument::countLabels(const QString &name)
 {
 	int result = 0;
 	foreach (const LatexDocument *elem, getListOfDocs()) {
-		QStringList items = elem->labelItems();
-		result += items.count(name);
+		result += elem->mLabelIndex.count(name);
 	}
 	return result;
 }
@@ -1565,8 +1734,7 @@ int LatexDocument::countRefs(const QString &name)
 {
 	int result = 0;
 	foreach (const LatexDocument *elem, getListOfDocs()) {
-		QStringList items = elem->refItems();
-		result += items.count(name);
+		result += elem->mRefIndex.count(name);
 	}
 	return result;
 }
@@ -1576,7 +1744,7 @@ bool LatexDocument::bibIdValid(const QString &name)
 	bool result = !findFileFromBibId(name).isEmpty();
 	if (!result) {
 		foreach (const LatexDocument *doc, getListOfDocs()) {
-			if (doc->bibItems().contains(name)) {
+			if (doc->mBibIndex.contains(name)) {
 				result = true;
 				break;
 			}
@@ -1589,7 +1757,7 @@ bool LatexDocument::isBibItem(const QString &name)
 {
 	bool result = false;
 	foreach (const LatexDocument *doc, getListOfDocs()) {
-		if (doc->bibItems().contains(name)) {
+		if (doc->mBibIndex.contains(name)) {
 			result = true;
 			break;
 		}
@@ -1613,11 +1781,10 @@ QMultiHash<QDocumentLineHandle *, int> LatexDocument::getBibItems(const QString
 {
     QMultiHash<QDocumentLineHandle *, int> result;
 	foreach (const LatexDocument *elem, getListOfDocs()) {
-		QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-		for (it = elem->mBibItem.constBegin(); it != elem->mBibItem.constEnd(); ++it) {
-			ReferencePair rp = it.value();
-			if (rp.name == name && elem->indexOf(it.key()) >= 0) {
-				result.insert(it.key(), rp.start);
+		typedef QPair<QDocumentLineHandle *, int> Occurrence;
+		foreach (const Occurrence &occ, elem->mBibIndex.occurrences(name)) {
+			if (elem->indexOf(occ.first) >= 0) {
+				result.insert(occ.first, occ.second);
 			}
 		}
 	}
@@ -1628,11 +1795,10 @@ QMultiHash<QDocumentLineHandle *, int> LatexDocument::getLabels(const QString &n
 {
     QMultiHash<QDocumentLineHandle *, int> result;
 	foreach (const LatexDocument *elem, getListOfDocs()) {
-		QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-		for (it = elem->mLabelItem.constBegin(); it != elem->mLabelItem.constEnd(); ++it) {
-			ReferencePair rp = it.value();
-			if (rp.name == name && elem->indexOf(it.key()) >= 0) {
-				result.insert(it.key(), rp.start);
+		typedef QPair<QDocumentLineHandle *, int> Occurrence;
+		foreach (const Occurrence &occ, elem->mLabelIndex.occurrences(name)) {
+			if (elem->indexOf(occ.first) >= 0) {
+				result.insert(occ.first, occ.second);
 			}
 		}
 	}
@@ -1645,12 +1811,8 @@ QMultiHash<QDocumentLineHandle *, int> LatexDocument::getLabels(const QString &n
  */
 LatexDocument* LatexDocument::getDocumentForLabel(const QString &name){
     foreach (LatexDocument *elem, getListOfDocs()) {
-        QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-        for (it = elem->mLabelItem.constBegin(); it != elem->mLabelItem.constEnd(); ++it) {
-            ReferencePair rp = it.value();
-            if (rp.name == name) {
-                return elem;
-            }
+        if (elem->mLabelIndex.contains(name)) {
+            return elem;
         }
     }
     return nullptr;
@@ -1704,11 +1866,10 @@ QMultiHash<QDocumentLineHandle *, int> LatexDocument::getRefs(const QString &nam
 {
     QMultiHash<QDocumentLineHandle *, int> result;
 	foreach (const LatexDocument *elem, getListOfDocs()) {
-		QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-		for (it = elem->mRefItem.constBegin(); it != elem->mRefItem.constEnd(); ++it) {
-			ReferencePair rp = it.value();
-			if (rp.name == name && elem->indexOf(it.key()) >= 0) {
-				result.insert(it.key(), rp.start);
+		typedef QPair<QDocumentLineHandle *, int> Occurrence;
+		foreach (const Occurrence &occ, elem->mRefIndex.occurrences(name)) {
+			if (elem->indexOf(occ.first) >= 0) {
+				result.insert(occ.first, occ.second);
 			}
 		}
 	}
@@ -1770,11 +1931,12 @@ void LatexDocument::replaceItems(QMultiHash<QDocumentLineHandle *, ReferencePair
 void LatexDocument::replaceLabel(const QString &name, const QString &newName, QDocumentCursor *cursor)
 {
 	QMultiHash<QDocumentLineHandle *, ReferencePair> labelItemsMatchingName;
-	QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-	for (it = mLabelItem.constBegin(); it != mLabelItem.constEnd(); ++it) {
-		if (it.value().name == name) {
-            labelItemsMatchingName.insert(it.key(), it.value());
-		}
+	typedef QPair<QDocumentLineHandle *, int> Occurrence;
+	foreach (const Occurrence &occ, mLabelIndex.occurrences(name)) {
+		ReferencePair rp;
+		rp.name = name;
+		rp.start = occ.second;
+		labelItemsMatchingName.insert(occ.first, rp);
 	}
 	replaceItems(labelItemsMatchingName, newName, cursor);
 }
@@ -1787,11 +1949,12 @@ void LatexDocument::replaceLabel(const QString &name, const QString &newName, QD
 void LatexDocument::replaceRefs(const QString &name, const QString &newName, QDocumentCursor *cursor)
 {
 	QMultiHash<QDocumentLineHandle *, ReferencePair> refItemsMatchingName;
-	QMultiHash<QDocumentLineHandle *, ReferencePair>::const_iterator it;
-	for (it = mRefItem.constBegin(); it != mRefItem.constEnd(); ++it) {
-		if (it.value().name == name) {
-            refItemsMatchingName.insert(it.key(), it.value());
-		}
+	typedef QPair<QDocumentLineHandle *, int> Occurrence;
+	foreach (const Occurrence &occ, mRefIndex.occurrences(name)) {
+		ReferencePair rp;
+		rp.name = name;
+		rp.start = occ.second;
+		refItemsMatchingName.insert(occ.first, rp);
 	}
 	replaceItems(refItemsMatchingName, newName, cursor);
 }
@@ -1814,14 +1977,10 @@ void LatexDocument::setMasterDocument(LatexDocument *doc, bool recheck)
     }
     if (recheck) {
         QList<LatexDocument *>listOfDocs = getListOfDocs();
-
-        QStringList items;
-        foreach (const LatexDocument *elem, listOfDocs) {
-            items << elem->labelItems();
-        }
+        QHash<QString, int> labels = countLabels(listOfDocs);
 
         foreach (LatexDocument *elem, listOfDocs) {
-            elem->recheckRefsLabels(listOfDocs,items);
+            elem->recheckRefsLabels(listOfDocs,labels);
         }
     }
 }
@@ -1885,7 +2044,16 @@ void LatexDocument::updateRefHighlight(ReferencePairEx p){
     }
 }
 
-void LatexDocument::recheckRefsLabels(QList<LatexDocument*> listOfDocs,QStringList items)
+QHash<QString, int> LatexDocument::countLabels(const QList<LatexDocument *> &listOfDocs)
+{
+    QHash<QString, int> result;
+    foreach (const LatexDocument *elem, listOfDocs) {
+        elem->mLabelIndex.addCounts(result);
+    }
+    return result;
+}
+
+void LatexDocument::recheckRefsLabels(QList<LatexDocument*> listOfDocs,QHash<QString, int> labelCounts)
 {
 	// get occurences (refs)
 	int referenceMultipleFormat = getFormatId("referenceMultiple");
@@ -1895,12 +2063,10 @@ void LatexDocument::recheckRefsLabels(QList<LatexDocument*> listOfDocs,QStringLi
     QList<ReferencePairEx> results;
 
     if(listOfDocs.isEmpty()){
-        // if not empty, assume listOfDocs *and* items are provided.
+        // if not empty, assume listOfDocs *and* labelCounts are provided.
         // this avoid genearting both lists for each document again
         listOfDocs=getListOfDocs();
-        foreach (const LatexDocument *elem, listOfDocs) {
-            items << elem->labelItems();
-        }
+        labelCounts=countLabels(listOfDocs);
     }
 
 
@@ -1922,7 +2088,7 @@ void LatexDocument::recheckRefsLabels(QList<LatexDocument*> listOfDocs,QStringLi
         p.formatList=formatList;
         p.dlh=dlh;
         for(const ReferencePair &rp : mLabelItem.values(dlh)) {
-            int cnt = items.count(rp.name);
+            int cnt = labelCounts.value(rp.name);
             int format= referenceMissingFormat;
             if (cnt > 1) {
                 format=referenceMultipleFormat;
@@ -1932,7 +2098,7 @@ void LatexDocument::recheckRefsLabels(QList<LatexDocument*> listOfDocs,QStringLi
             p.formats<<format;
 		}
         for(const ReferencePair &rp :  mRefItem.values(dlh)) {
-            int cnt = items.count(rp.name);
+            int cnt = labelCounts.value(rp.name);
             int format= referenceMissingFormat;
             if (cnt > 1) {
                 format=referenceMultipleFormat;
@@ -1958,6 +2124,22 @@ QStringList LatexDocument::someItems(const QMultiHash<QDocumentLineHandle *, Ref
 	return result;
 }
 
+void LatexDocument::insertReference(QMultiHash<QDocumentLineHandle *, ReferencePair> &items, ReferenceIndex &index, QDocumentLineHandle *dlh, const ReferencePair &rp)
+{
+	items.insert(dlh, rp);
+	index.insert(dlh, rp);
+}
+
+QList<ReferencePair> LatexDocument::removeReferences(QMultiHash<QDocumentLineHandle *, ReferencePair> &items, ReferenceIndex &index, QDocumentLineHandle *dlh)
+{
+	QList<ReferencePair> removed = items.values(dlh);
+	if (!removed.isEmpty()) {
+		items.remove(dlh);
+		index.remove(dlh, removed);
+	}
+	return removed;
+}
+
 
 QStringList LatexDocument::labelItems() const
 {
@@ -2393,6 +2575,24 @@ QString LatexDocuments::getCachingFolder() const
 {
     return m_cachingFolder;
 }
+/*!
+ * \brief get trigram index of the folder of the root document of doc
+ * Indexing is started if necessary and stopped if it has been disabled.
+ * \param doc
+ * \return index or nullptr if indexing is disabled or the root document has not been saved yet
+ */
+TrigramIndex *LatexDocuments::getTrigramIndex(LatexDocument *doc)
+{
+    auto *conf=dynamic_cast<ConfigManager *>(ConfigManagerInterface::getInstance());
+    LatexDocument *root = doc ? getRootDocumentForDoc(doc) : nullptr;
+    if(!conf || !conf->indexProjectFiles || !root || root->getFileName().isEmpty()){
+        if(!conf || !conf->indexProjectFiles)
+            m_trigramIndex.setFolder(QString(), QString());
+        return nullptr;
+    }
+    m_trigramIndex.setFolder(root->getFileInfo().absolutePath(), conf->cacheDocuments ? m_cachingFolder : QString());
+    return &m_trigramIndex;
+}
 
 bool LatexDocuments::singleMode() const
 {
@@ -2507,14 +2707,11 @@ std::pair<bool,bool> LatexDocuments::addDocsToLoad(QStringList filenames, LatexD
                     doc->load(fn,QDocument::defaultCodec());
                 }
                 doc->setLtxCommands(parentDocument->lp);
+                QList<LatexDocument *>childDocs;
                 if(doc->isIncompleteInMemory()){
                     // gather all commands from all child documents
                     // needed for cached files
-                    QList<LatexDocument *>listOfDocs = doc->getListOfDocs();
-                    foreach (const LatexDocument *elem, listOfDocs) {
-                        if(elem==doc) continue;
-                        doc->lp->append(elem->ltxCommands);
-                    }
+                    childDocs = doc->getListOfDocs();
                 }
                 if(!isHigherLevel){
                     // child document is added
@@ -2523,7 +2720,14 @@ std::pair<bool,bool> LatexDocuments::addDocsToLoad(QStringList filenames, LatexD
                     parentDocument->addChild(doc);
                 }
                 doc->patchStructure(0,-1);
-                doc->lp->append(doc->ltxCommands);
+                // extend a new snapshot, the shared one may be in use (e.g. by the syntax checker)
+                QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*doc->lp);
+                foreach (const LatexDocument *elem, childDocs) {
+                    if(elem==doc) continue;
+                    snapshot->append(elem->ltxCommands);
+                }
+                snapshot->append(doc->ltxCommands);
+                doc->publishLtxCommands(snapshot);
                 docForUpdate=doc;
                 newPackagesFound|=!doc->usedPackages(true).isEmpty();
                 newUserCommandsFound|=!doc->userCommandList().isEmpty();
@@ -2531,15 +2735,14 @@ std::pair<bool,bool> LatexDocuments::addDocsToLoad(QStringList filenames, LatexD
         }
         if(docForUpdate){
             QList<LatexDocument *>listOfDocs = parentDocument->getListOfDocs();
-            QStringList items;
             foreach (LatexDocument *elem, listOfDocs) {
                 elem->setLtxCommands(parentDocument->lp);
                 elem->reCheckSyntax(); //rescan as well ?
-                items << elem->labelItems();
             }
+            QHash<QString, int> labels = LatexDocument::countLabels(listOfDocs);
             foreach (LatexDocument *elem, listOfDocs) {
                 if(elem->getEditorView()){
-                    elem->recheckRefsLabels(listOfDocs,items);
+                    elem->recheckRefsLabels(listOfDocs,labels);
                     elem->getEditorView()->updateCitationFormats(); // TODO: inefficent -> improve
                 }
             }
@@ -3255,25 +3458,78 @@ QString LatexDocuments::findPackageByCommand(const QString command)
 }
 
 
+/*!
+ * \brief rebuild the latex commands (lp) of all documents of this project
+ * A new snapshot is published instead of changing lp in place, so that the previous one stays valid for its users.
+ * Unchanged containers are shared between the snapshots.
+ * If lp contains the commands of all documents and these were only extended since (usually by added packages), only the added commands are appended.
+ * If documents joined or left the project since lp was built, all commands are rebuilt, so that the commands of removed documents are dropped.
+ * \param updateAll update and recheck all documents of the project, not only this one
+ * \param updatePackages rebuild all commands, otherwise only user commands are updated
+ */
 void LatexDocument::updateLtxCommands(bool updateAll,bool updatePackages)
 {
     QList<LatexDocument *>listOfDocs = getListOfDocs();
+    const QSet<const LatexDocument *> docSet(listOfDocs.constBegin(), listOfDocs.constEnd());
+    QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*lp);
+    bool lpIsCurrent = true;
+    bool sameDocs = true;
+    foreach (const LatexDocument *elem, listOfDocs) {
+        lpIsCurrent = lpIsCurrent && elem->m_lpGeneration==lp->generation;
+        sameDocs = sameDocs && elem->m_lpDocuments==docSet;
+    }
+    if(!sameDocs){
+        lpIsCurrent=false;
+        updatePackages=true;
+    }
     if(updatePackages){
-        *lp=LatexParser::getInstance(); // append commands set in config
-        foreach (const LatexDocument *elem, listOfDocs) {
-            lp->append(elem->ltxCommands);
+        QList<LatexParser> deltas;
+        bool incremental = lpIsCurrent;
+        for (int i=0; incremental && i<listOfDocs.size(); i++) {
+            const LatexDocument *elem = listOfDocs.at(i);
+            deltas.append(LatexParser());
+            incremental = elem->ltxCommands.additionsTo(elem->m_publishedLtxCommands,deltas.last());
+        }
+        if(incremental){
+            foreach (const LatexParser &delta, deltas) {
+                snapshot->append(delta);
+            }
+        }else{
+            *snapshot=LatexParser::getInstance(); // append commands set in config
+            foreach (const LatexDocument *elem, listOfDocs) {
+                snapshot->append(elem->ltxCommands);
+            }
+        }
+        foreach (LatexDocument *elem, listOfDocs) {
+            elem->m_publishedLtxCommands=elem->ltxCommands; // cheap, containers are implicitly shared
+            elem->m_lpGeneration=snapshot->generation;
+            elem->m_lpDocuments=docSet;
         }
     }else{
-        lp->possibleCommands["user"].clear();
+        snapshot->possibleCommands["user"].clear();
         foreach (const LatexDocument *elem, listOfDocs) {
-            lp->possibleCommands["user"].unite(elem->ltxCommands.possibleCommands["user"]);
+            snapshot->possibleCommands["user"].unite(elem->ltxCommands.possibleCommands["user"]);
             QStringList keys=elem->ltxCommands.possibleCommands.keys();
             for(const auto &key : keys){
                 if(!key.startsWith("%")) continue; // unite possible user commands (special def like %color)
-                lp->possibleCommands[key].unite(elem->ltxCommands.possibleCommands[key]);
+                snapshot->possibleCommands[key].unite(elem->ltxCommands.possibleCommands[key]);
+            }
+        }
+        snapshot->generation=LatexParser::newGeneration();
+        if(lpIsCurrent){
+            // user commands of lp are up to date now
+            foreach (LatexDocument *elem, listOfDocs) {
+                const QHash<QString, QSet<QString> > &commands=elem->ltxCommands.possibleCommands;
+                for(auto it=commands.constBegin();it!=commands.constEnd();++it){
+                    if(it.key()=="user" || it.key().startsWith("%")){
+                        elem->m_publishedLtxCommands.possibleCommands.insert(it.key(),it.value());
+                    }
+                }
+                elem->m_lpGeneration=snapshot->generation;
             }
         }
     }
+    publishLtxCommands(snapshot);
 
 	if (updateAll) {
 		foreach (LatexDocument *elem, listOfDocs) {
@@ -3288,12 +3544,12 @@ void LatexDocument::updateLtxCommands(bool updateAll,bool updatePackages)
 				continue; // already handled
 			if (elem->containsChild(this)) {
 				// unhandled parent/child
-                QSharedPointer<LatexParser> lp= QSharedPointer<LatexParser>::create();
-                *lp=LatexParser::getInstance(); // start with commands set in config
+                LatexParser cmds=LatexParser::getInstance(); // start with commands set in config
 				QList<LatexDocument *>listOfDocs = elem->getListOfDocs();
                 foreach (const LatexDocument *elem, listOfDocs) {
-                    lp->append(elem->ltxCommands);
+                    cmds.append(elem->ltxCommands);
 				}
+                QSharedPointer<LatexParser> lp= QSharedPointer<LatexParser>::create(cmds);
 				foreach (LatexDocument *elem, listOfDocs) {
 					elem->setLtxCommands(lp);
 					elem->reCheckSyntax();
@@ -3316,7 +3572,26 @@ void LatexDocument::updateLtxCommands(bool updateAll,bool updatePackages)
  */
 void LatexDocument::addLtxCommands()
 {
-    lp->append(this->ltxCommands);
+    QSharedPointer<LatexParser> snapshot = QSharedPointer<LatexParser>::create(*lp);
+    snapshot->append(this->ltxCommands);
+    publishLtxCommands(snapshot);
+}
+/*!
+ * \brief replace lp by snapshot in this document and all documents which share lp
+ * lp is never changed in place, as its users (e.g. the syntax checker) may still access it.
+ * The syntax checkers are not updated, see setLtxCommands().
+ * \param snapshot
+ */
+void LatexDocument::publishLtxCommands(QSharedPointer<LatexParser> snapshot)
+{
+    if(parent){
+        foreach (LatexDocument *elem, parent->getDocuments()) {
+            if(elem!=this && elem->lp==lp){
+                elem->lp=snapshot;
+            }
+        }
+    }
+    lp=snapshot;
 }
 
 void LatexDocument::setLtxCommands(QSharedPointer<LatexParser> cmds)
@@ -3333,11 +3608,13 @@ void LatexDocument::setLtxCommands(QSharedPointer<LatexParser> cmds)
 void LatexDocument::setSpeller(SpellerUtility *speller)
 {
     synChecker.setSpeller(speller);
+    mMisspellingIndex->setSpeller(speller);
 }
 
 void LatexDocument::setReplacementList(QMap<QString, QString> replacementList)
 {
     synChecker.setReplacementList(replacementList);
+    mMisspellingIndex->setReplacementList(replacementList);
 }
 
 void LatexDocument::updateSettings()
@@ -3384,7 +3661,7 @@ void LatexDocument::checkNextLine(QDocumentLineHandle *dlh, bool clearOverlay, i
 						QVariant result = prev->getCookieLocked(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
 						if (result.isValid())
 							env = result.value<StackEnvironment>();
-						remainder = prev->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+						remainder = prev->getRemainderLocked();
                     }
                     synChecker.putLine(unclosedEnv.dlh, env, remainder, true, unclosedEnvIndex);
 				}
@@ -3397,7 +3674,7 @@ void LatexDocument::checkNextLine(QDocumentLineHandle *dlh, bool clearOverlay, i
 			}
 			return;
 		}
-		TokenStack remainder = dlh->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+		TokenStack remainder = dlh->getRemainderLocked();
         synChecker.putLine(line(index + 1).handle(), env, remainder, clearOverlay,index+1);
 	}
     dlh->deref();
@@ -3446,12 +3723,26 @@ void LatexDocument::reCheckSyntax(int lineStart, int lineNum)
 	if (lineStart == lineEnd) {
 		return;
 	}
+	// Large regions are checked in parallel, the previous environment cookies serve as guesses for the
+	// context at the borders of the parts
+	bool checkRegion = lineEnd - lineStart >= 2 * SyntaxCheck::MIN_REGION_PART_SIZE;
+	QList<QDocumentLineHandle *> handles;
+	QVector<StackEnvironment> guesses;
+	if (checkRegion) {
+		handles.reserve(lineEnd - lineStart);
+		guesses.reserve(lineEnd - lineStart);
+	}
 	// Delete the environment cookies for the specified lines to force their re-check
 	for (int i = lineStart; i < lineEnd; ++i) {
 		// We rely on the fact that QDocumentLine::removeCookie() holds a write lock of the corresponding
 		// line handle while removing the cookie. Lack of write locking causes crashes due to simultaneous
 		// access from the syntax checker thread.
-		line(i).removeCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
+		QDocumentLine ln = line(i);
+		if (checkRegion) {
+			handles << ln.handle();
+			guesses << ln.handle()->getCookieLocked(QDocumentLine::STACK_ENVIRONMENT_COOKIE).value<StackEnvironment>();
+		}
+		ln.removeCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
     }
 
 	// Enqueue the first line for syntax checking. The remaining lines will be enqueued automatically
@@ -3460,9 +3751,12 @@ void LatexDocument::reCheckSyntax(int lineStart, int lineNum)
 	getEnv(lineStart, prevEnv);
 	TokenStack prevTokens;
 	if (lineStart) {
-		prevTokens = line(lineStart-1).getCookie(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack>();
+		prevTokens = line(lineStart-1).handle()->getRemainder();
     }
-    synChecker.putLine(line(lineStart).handle(), prevEnv, prevTokens, true, lineStart);
+    if (checkRegion)
+        synChecker.putLines(handles, prevEnv, prevTokens, guesses, lineStart);
+    else
+        synChecker.putLine(line(lineStart).handle(), prevEnv, prevTokens, true, lineStart);
 }
 
 QString LatexDocument::getErrorAt(QDocumentLineHandle *dlh, int pos, StackEnvironment previous, TokenStack stack)
@@ -3540,6 +3834,7 @@ bool LatexDocument::isSubfileRoot(){
 /*!
  * \brief save internal data for caching
  * Data contains labels,user commands and children documents
+ * Lexer results are stored separately (see LatexTokenCache)
  */
 bool LatexDocument::saveCachingData(const QString &folder)
 {
@@ -3556,6 +3851,16 @@ bool LatexDocument::saveCachingData(const QString &folder)
     QFileInfo fi=getFileInfo();
     QFile file(folder+"/"+fi.baseName()+".json");
 
+    // store lexer results, lines are identified by content so this is independent of unsaved changes
+    if(lp){
+        m_tokenCache.close();
+        QList<QDocumentLineHandle *> lines;
+        for(int i=0;i<lineCount();++i){
+            lines<<line(i).handle();
+        }
+        LatexTokenCache::save(folder+"/"+fi.baseName()+".tokens",lines,*lp);
+    }
+
     // remove cache if dealing with modified, unsaved changes as saved text differs
     if(!isClean()){
         if(file.exists()){
@@ -3683,21 +3988,24 @@ bool LatexDocument::restoreCachedData(const QString &folder,const QString fileNa
         QString lbl=ja[i].toString();
         ReferencePair rp;
         rp.name=lbl;
-        mLabelItem.insert(nullptr,rp);
+        rp.start=0;
+        insertReference(mLabelItem,mLabelIndex,nullptr,rp);
     }
     ja=dd.value("refs").toArray();
     for (int i = 0; i < ja.size(); ++i) {
         QString lbl=ja[i].toString();
         ReferencePair rp;
         rp.name=lbl;
-        mRefItem.insert(nullptr,rp);
+        rp.start=0;
+        insertReference(mRefItem,mRefIndex,nullptr,rp);
     }
     ja=dd.value("bibitems").toArray();
     for (int i = 0; i < ja.size(); ++i) {
         QString lbl=ja[i].toString();
         ReferencePair rp;
         rp.name=lbl;
-        mBibItem.insert(nullptr,rp);
+        rp.start=0;
+        insertReference(mBibItem,mBibIndex,nullptr,rp);
     }
     ja=dd.value("bibtexfiles").toArray();
     for (int i = 0; i < ja.size(); ++i) {
@@ -3773,6 +4081,20 @@ bool LatexDocument::restoreCachedData(const QString &folder,const QString fileNa
     m_cachedDataOnly=true;
     return true;
 }
+/*!
+ * \brief open lexer results of last session from caching folder
+ * Lines which are unchanged since then are restored instead of lexed, see LatexTokenCache
+ * \return true if a valid cache file was found
+ */
+bool LatexDocument::openTokenCache()
+{
+    m_tokenCache.close();
+    auto *conf=dynamic_cast<ConfigManager *>(ConfigManagerInterface::getInstance());
+    if(!conf || !conf->cacheDocuments || !parent) return false;
+    const QString folder=parent->getCachingFolder();
+    if(folder.isEmpty() || getFileName().isEmpty()) return false;
+    return m_tokenCache.open(folder+"/"+getFileInfo().baseName()+".tokens");
+}
 /*!
  * \brief check if it was restored from cached data
  * Needs to load from the beginning otherwise
@@ -2,6 +2,7 @@
 #define Header_Latex_Document
 //#undef QT_NO_DEBUG
 #include "mostQtHeaders.h"
+#include <QBitArray>
 #include "latexstructure.h"
 #include "qdocument.h"
 #include "codesnippet.h"
@@ -11,12 +12,15 @@
 #include "syntaxcheck.h"
 #include "grammarcheck.h"
 #include "latexpackage.h"
+#include "latextokencache.h"
+#include "trigramindex.h"
 //#include "latexeditorview.h"
 
 //class QDocumentLineHandle;
 class LatexEditorView;
 class QDocumentCursor;
 class Macro;
+class MisspellingIndex;
 
 
 struct FileNamePair {
@@ -30,6 +34,26 @@ struct ReferencePair {
 	int start;
 };
 
+/*!
+ * \brief name lookup for the labels, references or bibitems of a document
+ *
+ * Kept in sync with the line based hashes (mLabelItem etc.), so that counting or locating an item by its name does not need to walk all items of all documents.
+ */
+class ReferenceIndex
+{
+public:
+	void insert(QDocumentLineHandle *dlh, const ReferencePair &rp);
+	void remove(QDocumentLineHandle *dlh, const QList<ReferencePair> &rps);
+	void clear();
+	int count(const QString &name) const;
+	bool contains(const QString &name) const;
+	QList<QPair<QDocumentLineHandle *, int> > occurrences(const QString &name) const;
+	void addCounts(QHash<QString, int> &counts) const;
+
+private:
+	QHash<QString, QList<QPair<QDocumentLineHandle *, int> > > m_items;
+};
+
 struct ReferencePairEx {
     QDocumentLineHandle *dlh;
     QVector<int> starts,lengths,formats;
@@ -99,6 +123,8 @@ public:
 
 private:
 	static QStringList someItems(const QMultiHash<QDocumentLineHandle *, ReferencePair> &list);
+	static void insertReference(QMultiHash<QDocumentLineHandle *, ReferencePair> &items, ReferenceIndex &index, QDocumentLineHandle *dlh, const ReferencePair &rp);
+	static QList<ReferencePair> removeReferences(QMultiHash<QDocumentLineHandle *, ReferencePair> &items, ReferenceIndex &index, QDocumentLineHandle *dlh);
 	void setFileNameInternal(const QString& fileName);
 	void setFileNameInternal(const QString& fileName, const QFileInfo &pairedFileInfo);
 
@@ -109,7 +135,8 @@ public:
 	Q_INVOKABLE QList<CodeSnippet> userCommandList() const; ///< all user commands defined in this document, sorted
     Q_INVOKABLE CodeSnippetList additionalCommandsList(QStringList &loadedFiles);
 	void updateRefsLabels(const QString &ref);
-    void recheckRefsLabels(QList<LatexDocument *> listOfDocs=QList<LatexDocument*>(), QStringList items=QStringList());
+    void recheckRefsLabels(QList<LatexDocument *> listOfDocs=QList<LatexDocument*>(), QHash<QString, int> labelCounts=QHash<QString, int>());
+    static QHash<QString, int> countLabels(const QList<LatexDocument *> &listOfDocs); ///< number of definitions of every label in the given documents
     static void updateRefHighlight(ReferencePairEx p);
 	Q_INVOKABLE int countLabels(const QString &name);
 	Q_INVOKABLE int countRefs(const QString &name);
@@ -197,8 +224,10 @@ public:
     Q_INVOKABLE bool isSubfileRoot();
     bool saveCachingData(const QString &folder);
     bool restoreCachedData(const QString &folder, const QString fileName);
+    bool openTokenCache();
     bool isIncompleteInMemory();
     void startSyntaxChecker();
+    MisspellingIndex *misspellingIndex() const {return mMisspellingIndex;}
 
     struct HandledData {
         QStringList removedUsepackages;
@@ -224,6 +253,7 @@ public:
 
     int lexLines(int &lineNr,int &count,bool recheck=false);
     void lexLinesSimple(const int lineNr,const int count);
+    QBitArray lexLinesSpeculative(const int from,const int to,const bool useTokenCache);
     void handleComments(QDocumentLineHandle *dlh, int &curLineNr, std::list<StructureEntry*>::iterator &docStructureIter);
     void removeLineElements(QDocumentLineHandle *dlh, HandledData &changedCommands);
     void handleRescanDocuments(HandledData changedCommands);
@@ -252,6 +282,9 @@ private:
 	QMultiHash<QDocumentLineHandle *, ReferencePair> mLabelItem;
 	QMultiHash<QDocumentLineHandle *, ReferencePair> mBibItem;
 	QMultiHash<QDocumentLineHandle *, ReferencePair> mRefItem;
+	ReferenceIndex mLabelIndex;
+	ReferenceIndex mBibIndex;
+	ReferenceIndex mRefIndex;
 	QMultiHash<QDocumentLineHandle *, FileNamePair> mMentionedBibTeXFiles;
 	QMultiHash<QDocumentLineHandle *, UserCommandPair> mUserCommandList;
 	QMultiHash<QDocumentLineHandle *, QString> mUsepackageList;
@@ -263,7 +296,12 @@ private:
 	QSet<QString> mCompleterWords; // local list of completer words
 	QSet<QString> mCWLFiles;
 
+    LatexParser m_publishedLtxCommands; // ltxCommands contained in the last lp which has been published for this document, see updateLtxCommands()
+    quint64 m_lpGeneration=0; // generation of that lp
+    QSet<const LatexDocument *> m_lpDocuments; // documents whose commands that lp was built from
+
 	QString mSpellingDictName;
+	MisspellingIndex *mMisspellingIndex;
 
 	QString mClassOptions; // store class options, if they are defined in this doc
 
@@ -287,6 +325,7 @@ private:
     bool m_isSubfileRoot=false;
 
     bool m_cachedDataOnly=false;
+    LatexTokenCache m_tokenCache; ///< lexer results of last session, only open during initial lexing of the document
 
     bool m_hideNonTextGrammarErrors=true;
     QList<int> m_grammarFormats;
@@ -305,6 +344,7 @@ public slots:
     void updateLtxCommands(bool updateAll = false, bool updatePackages=true);
     void addLtxCommands();
     void setLtxCommands(QSharedPointer<LatexParser> cmds);
+    void publishLtxCommands(QSharedPointer<LatexParser> snapshot);
     void setSpeller(SpellerUtility *speller);
     void setReplacementList(QMap<QString,QString> replacementList);
 	void updateSettings();
@@ -374,6 +414,7 @@ public:
 	void settingsRead();
     void setCachingFolder(const QString &folder);
     QString getCachingFolder() const;
+    TrigramIndex *getTrigramIndex(LatexDocument *doc);
 
 	Q_INVOKABLE bool singleMode() const;
 
@@ -419,6 +460,7 @@ public slots:
 private:
 	bool m_patchEnabled;
     QString m_cachingFolder;
+    TrigramIndex m_trigramIndex;
 };
 
 #endif // LATEXDOCUMENT_H
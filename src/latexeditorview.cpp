@@ -558,7 +558,7 @@ bool DefaultInputBinding::contextMenuEvent(QContextMenuEvent *event, QEditor *ed
 		//check input/include
 		//find context of cursor
 		QDocumentLineHandle *dlh = cursor.line().handle();
-		TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+		TokenList tl = dlh->getTokensLocked();
 		int i = Parsing::getTokenAtCol(tl, cursor.columnNumber());
 		Token tk;
 		if (i >= 0)
@@ -1110,7 +1110,7 @@ void LatexEditorView::checkForLinkOverlay(QDocumentCursor cursor)
 	if (validPosition) {
 		QDocumentLineHandle *dlh = cursor.line().handle();
 
-        TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList tl = dlh->getTokensLocked();
 		Token tk = Parsing::getTokenAtCol(dlh, cursor.columnNumber());
 
 		if (tk.type == Token::labelRef || tk.type == Token::labelRefList) {
@@ -1725,7 +1725,7 @@ void LatexEditorView::updatePackageFormats()
         QDocumentLineHandle *dlh=editor->document()->line(i).handle();
         QList<QFormatRange> li = dlh->getOverlays(-1);
         QString curLineText = dlh->text();
-        TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList tl = dlh->getTokensLocked();
         for (const Token &tk : tl) {
             if(tk.type != Token::package && tk.type!=Token::beamertheme && tk.type!=Token::documentclass) continue;
             QString preambel;
@@ -1888,6 +1888,7 @@ void LatexEditorView::updateSettings()
 	QDocument::setShowSpaces(config->showWhitespace ? (QDocument::ShowTrailing | QDocument::ShowLeading | QDocument::ShowTabs) : QDocument::ShowNone);
 	QDocument::setTabStop(config->tabStop);
 	QDocument::setLineSpacingFactor(config->lineSpacingPercent / 100.0);
+	QDocument::setUndoMemoryLimit(qint64(config->undoMemoryLimitMB) * 1024 * 1024);
 
 	editor->m_preEditFormat = preEditFormat;
 
@@ -2267,7 +2268,7 @@ void LatexEditorView::documentContentChanged(int linenr, int count)
 
         QDocumentLineHandle *dlh = line.handle();
         // handle % TODO
-        QPair<int,int> commentStart = dlh->getCookieLocked(QDocumentLine::LEXER_COMMENTSTART_COOKIE).value<QPair<int,int> >();
+        QPair<int,int> commentStart = dlh->getCommentStartLocked();
         if(commentStart.second==Token::todoComment){
             int col=commentStart.first;
             QString curLine=line.text();
@@ -2281,7 +2282,7 @@ void LatexEditorView::documentContentChanged(int linenr, int count)
         }
 
 		// alternative context detection
-        TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList tl = dlh->getTokensLocked();
 		for (int tkNr = 0; tkNr < tl.length(); tkNr++) {
 			Token tk = tl.at(tkNr);
 			if (tk.subtype == Token::verbatim)
@@ -2736,7 +2737,7 @@ void LatexEditorView::mouseHovered(QPoint pos)
 		TokenStack remainder;
 		int i = cursor.lineNumber();
 		if (document->line(i - 1).handle())
-			remainder = document->line(i - 1).handle()->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+			remainder = document->line(i - 1).handle()->getRemainderLocked();
 		QString text = l.text();
 		if (!text.isEmpty()) {
 			QString message = document->getErrorAt(l.handle(), cursor.columnNumber(), env, remainder);
@@ -2747,7 +2748,7 @@ void LatexEditorView::mouseHovered(QPoint pos)
 	// new way
 	QDocumentLineHandle *dlh = cursor.line().handle();
 
-	TokenList tl = dlh ? dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>() : TokenList();
+	TokenList tl = dlh ? dlh->getTokensLocked() : TokenList();
 
 	//Tokens tk=getTokenAtCol(dlh,cursor.columnNumber());
 	TokenStack ts = Parsing::getContext(dlh, cursor.columnNumber());
@@ -208,6 +208,8 @@ private:
 
 	friend class DefaultInputBinding;
 	friend class SyntaxCheckTest;
+	friend class LatexEditorViewBenchmark;
+	friend class MisspellingIndexTest;
 
 	SpellerManager *spellerManager;
 	SpellerUtility *speller;
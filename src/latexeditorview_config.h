@@ -28,6 +28,7 @@ public:
 	QString fontFamily;
 	int fontSize;
 	int lineSpacingPercent;
+	int undoMemoryLimitMB; // 0: unlimited
 	int lineWidth;
 	bool closeSearchAndReplace;
 	bool useLineForSearch, searchOnlyInSelection;
@@ -8,6 +8,13 @@ LatexLogModel::LatexLogModel(QObject *parent): QAbstractTableModel(parent)
 	markIDs[LT_WARNING] = QLineMarksInfoCenter::instance()->markTypeId("warning");
 	markIDs[LT_BADBOX] = QLineMarksInfoCenter::instance()->markTypeId("badbox");
 	foundType[LT_NONE] = foundType[LT_ERROR] = foundType[LT_WARNING] = foundType[LT_BADBOX] = false;
+	liveFilter = nullptr;
+	liveEntries = 0;
+}
+
+LatexLogModel::~LatexLogModel()
+{
+	delete liveFilter;
 }
 
 int LatexLogModel::columnCount(const QModelIndex &parent) const
@@ -82,6 +89,9 @@ void LatexLogModel::clear()
 	beginResetModel();
 	log.clear();
 	endResetModel();
+	delete liveFilter;
+	liveFilter = nullptr;
+	liveEntries = 0;
 }
 
 const LatexLogEntry &LatexLogModel::at(int i)
@@ -90,11 +100,13 @@ const LatexLogEntry &LatexLogModel::at(int i)
 }
 
 //Parse a latex log file to find errors, warnings, bad boxes...
-void LatexLogModel::parseLogDocument(QTextDocument *doc, QString baseFileName)
+void LatexLogModel::parseLogDocument(QTextDocument *doc, QString baseFileName, const QString &logFileName)
 {
 	LatexOutputFilter outputFilter;
 	//TODO: investigate why it crashes if outputFilter is a member variable, m_infoList is set to a global variable by the LatexLogModel constructor instead here, but only if the m_filelookup member of LatexOutputFilter does exist
 	outputFilter.setSource(baseFileName);
+	if (!logFileName.isEmpty())
+		outputFilter.readRecorderFile(logFileName);
 	outputFilter.run(doc);
 
 	beginResetModel();
@@ -113,6 +125,49 @@ void LatexLogModel::parseLogDocument(QTextDocument *doc, QString baseFileName)
 	endResetModel();
 }
 
+/*!
+ * Starts parsing the output of a running compilation, so that errors are listed before the log file is complete.
+ * The entries are replaced by parseLogDocument when the log file is loaded after the compilation.
+ */
+void LatexLogModel::beginLiveLog(const QString &baseFileName)
+{
+	clear();
+	liveFilter = new LatexOutputFilter();
+	liveFilter->setSource(baseFileName);
+	liveFilter->begin();
+}
+
+void LatexLogModel::addLiveLogChunk(const QString &chunk)
+{
+	if (!liveFilter) return;
+	liveFilter->addChunk(chunk);
+	takeLiveEntries();
+}
+
+void LatexLogModel::endLiveLog()
+{
+	if (!liveFilter) return;
+	liveFilter->end();
+	takeLiveEntries();
+	delete liveFilter;
+	liveFilter = nullptr;
+	liveEntries = 0;
+}
+
+//appends the entries the live filter has completed since the last call
+void LatexLogModel::takeLiveEntries()
+{
+	int n = liveFilter->m_infoList.count();
+	if (n <= liveEntries) return;
+	beginInsertRows(QModelIndex(), log.count(), log.count() + n - liveEntries - 1);
+	for (; liveEntries < n; liveEntries++)
+		log << liveFilter->m_infoList.at(liveEntries);
+	foundType[LT_ERROR] = liveFilter->m_nErrors > 0;
+	foundType[LT_BADBOX] = liveFilter->m_nBadBoxes > 0;
+	foundType[LT_WARNING] = liveFilter->m_nWarnings > 0;
+	endInsertRows();
+}
+
 bool LatexLogModel::found(LogType lt) const
 {
 	Q_ASSERT_X(lt > 0 && lt < 4, "found logtype", "unbound array index");
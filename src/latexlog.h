@@ -11,9 +11,14 @@ private:
 	QList<LatexLogEntry> log;
 	bool foundType[4];
 	int markIDs[4];
+	LatexOutputFilter *liveFilter; // parses the output of a running compilation
+	int liveEntries;
+
+	void takeLiveEntries();
 
 public:
 	LatexLogModel(QObject *parent = 0);
+	~LatexLogModel();
 
 	int columnCount(const QModelIndex &parent) const;
 	int rowCount(const QModelIndex &parent) const;
@@ -24,7 +29,10 @@ public:
 	void clear();
 	const LatexLogEntry &at(int i);
 
-	void parseLogDocument(QTextDocument *doc, QString baseFileName);
+	void parseLogDocument(QTextDocument *doc, QString baseFileName, const QString &logFileName = QString());
+	void beginLiveLog(const QString &baseFileName);
+	void addLiveLogChunk(const QString &chunk);
+	void endLiveLog();
 
 	bool found(LogType lt) const;
 	int markID(LogType lt) const;
@@ -157,7 +157,7 @@ bool LatexLogWidget::loadLogFile(const QString &logname, const QString &compiled
 
 		log->setPlainText(codec->toUnicode(fullLog));
 
-		logModel->parseLogDocument(log->document(), compiledFileName);
+		logModel->parseLogDocument(log->document(), compiledFileName, logname);
 
 		logpresent = true;
 
@@ -187,6 +187,25 @@ void LatexLogWidget::resetLog()
 	emit logResetted();
 }
 
+/*!
+ * Lists the errors of a compilation while it is running. The entries are replaced when the log file is loaded afterwards.
+ */
+void LatexLogWidget::beginLiveLog(const QString &compiledFileName)
+{
+	resetLog();
+	logModel->beginLiveLog(compiledFileName);
+}
+
+void LatexLogWidget::addLiveLogChunk(const QString &chunk)
+{
+	logModel->addLiveLogChunk(chunk);
+}
+
+void LatexLogWidget::endLiveLog()
+{
+	logModel->endLiveLog();
+}
+
 bool LatexLogWidget::logEntryNumberValid(int logEntryNumber)
 {
 	return logEntryNumber >= 0 && logEntryNumber < logModel->count();
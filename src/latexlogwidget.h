@@ -21,6 +21,8 @@ public:
 	bool logEntryNumberValid(int logEntryNumber);
 	bool logPresent();
 	void resetLog();
+	void beginLiveLog(const QString &compiledFileName);
+	void endLiveLog();
 	void selectLogEntry(int logEntryNumber);
 
 	void copy();
@@ -34,6 +36,7 @@ signals:
 	void logResetted();
 
 public slots:
+	void addLiveLogChunk(const QString &chunk);
 
 private slots:
 	void clickedOnLogModelIndex(const QModelIndex &index);
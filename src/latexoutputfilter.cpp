@@ -117,7 +117,7 @@ void LatexLogEntry::clear()
 
 //===========================OutputFilter===============================
 OutputFilter::OutputFilter() : QObject(),
-	m_nOutputLines(0), m_log(QString())
+	m_nOutputLines(0), m_cookie(0)
 {
 }
 
@@ -143,25 +143,70 @@ void OutputFilter::setSource(const QString &src)
 
 bool OutputFilter::run(const QTextDocument *log)
 {
-	short sCookie = 0;
-	QString s;
+	begin();
+
+	// read the blocks directly instead of copying the whole document with toPlainText()
+	for (QTextBlock block = log->begin(); block.isValid(); block = block.next()) {
+		QString line = block.text();
+		line.replace(QChar::Nbsp, ' '); // as toPlainText() does
+		// toPlainText() also breaks lines at line separators within a block
+		const QStringList parts = line.split(QChar::LineSeparator);
+		const bool lastBlock = !block.next().isValid();
+		for (int i = 0; i < parts.size(); i++) {
+			if (lastBlock && i == parts.size() - 1 && parts.at(i).isEmpty()) break; // trailing newline of the document
+			parseOutputLine(parts.at(i));
+		}
+	}
 
-	m_log.clear();
-	m_nOutputLines = 0;
+	return onTerminate();
+}
 
-	QString pt = log->toPlainText();
-	QTextStream t(&pt, QIODevice::ReadOnly);
-	while (!t.atEnd()) {
-		s = t.readLine();
-		sCookie = parseLine(s, sCookie);
-		++m_nOutputLines;
+/*!
+ * Resets the state before the first line of a new output is parsed.
+ */
+void OutputFilter::begin()
+{
+	m_cookie = 0;
+	m_nOutputLines = 0;
+	m_pendingLine.clear();
+}
 
-		m_log += s + '\n';
+/*!
+ * Parses the complete lines of a part of the output, e.g. what a running compiler has written so far.
+ * An incomplete last line is kept until it is completed by the next chunk or end() is called.
+ */
+void OutputFilter::addChunk(const QString &chunk)
+{
+	int start = 0;
+	for (int nl = chunk.indexOf('\n'); nl >= 0; nl = chunk.indexOf('\n', start)) {
+		QString line = m_pendingLine.isEmpty() ? chunk.mid(start, nl - start) : m_pendingLine + chunk.mid(start, nl - start);
+		m_pendingLine.clear();
+		if (line.endsWith('\r')) line.chop(1);
+		parseOutputLine(line);
+		start = nl + 1;
 	}
+	m_pendingLine += chunk.mid(start);
+}
 
+/*!
+ * Parses the rest of an output passed with addChunk().
+ */
+bool OutputFilter::end()
+{
+	if (!m_pendingLine.isEmpty()) {
+		if (m_pendingLine.endsWith('\r')) m_pendingLine.chop(1);
+		parseOutputLine(m_pendingLine);
+		m_pendingLine.clear();
+	}
 	return onTerminate();
 }
 
+void OutputFilter::parseOutputLine(const QString &line)
+{
+	m_cookie = parseLine(line, m_cookie);
+	++m_nOutputLines;
+}
+
 /*!
 Returns the zero based index of the currently parsed line in the output file.
 */
@@ -176,7 +221,8 @@ LatexOutputFilter::LatexOutputFilter() : OutputFilter(),
 	m_nErrors(0),
 	m_nWarnings(0),
 	m_nBadBoxes(0),
-	m_nParens(0)
+	m_nParens(0),
+	m_recorderComplete(false)
 {
 }
 
@@ -200,35 +246,73 @@ bool LatexOutputFilter::fileExists(const QString &name)
 
 QString LatexOutputFilter::absoluteFileName(const QString &name)
 {
-	static QFileInfo fi;
-	if (m_filelookup.contains(name))
-		return m_filelookup[name];
+	QHash<QString, QString>::const_iterator it = m_filelookup.constFind(name);
+	if (it != m_filelookup.constEnd())
+		return it.value();
+
+	QString result;
+	if (!m_recorderFiles.isEmpty()) {
+		// the file stack heuristics test many partial names, look them up in the recorder file before touching the file system
+		QString candidate = QDir::cleanPath(QDir::isAbsolutePath(name) ? name : path() + '/' + name);
+		if (m_recorderFiles.contains(candidate)) result = candidate;
+		else if (!QDir::isAbsolutePath(name) && m_recorderFiles.contains(candidate + ".tex")) result = candidate + ".tex";
+		else if (!m_recorderComplete) result = statFileName(name);
+	} else result = statFileName(name);
+
+	m_filelookup.insert(name, result);
+	return result;
+}
 
+QString LatexOutputFilter::statFileName(const QString &name)
+{
+	QFileInfo fi;
 	if (QDir::isAbsolutePath(name)) {
 		fi.setFile(name);
-		if (fi.exists() && !fi.isDir()) {
-			m_filelookup[name] = fi.absoluteFilePath();
-			return m_filelookup[name];
-		} else {
-			m_filelookup[name] = "";
-			return m_filelookup[name];
-		}
+		if (fi.exists() && !fi.isDir())
+			return fi.absoluteFilePath();
+		return "";
 	}
 
 	fi.setFile(path() + '/' + name);
-	if (fi.exists() && !fi.isDir()) {
-		m_filelookup[name] = fi.absoluteFilePath();
-		return m_filelookup[name];
-	}
+	if (fi.exists() && !fi.isDir())
+		return fi.absoluteFilePath();
 
 	fi.setFile(path() + '/' + name + ".tex");//m_extensions->latexDocumentDefault());
-	if (fi.exists() && !fi.isDir()) {
-		m_filelookup[name] = fi.absoluteFilePath();
-		return m_filelookup[name];
-	}
+	if (fi.exists() && !fi.isDir())
+		return fi.absoluteFilePath();
 
-	m_filelookup[name] = "";
-	return m_filelookup[name];
+	return "";
+}
+
+/*!
+ * Reads the input files from the .fls file written by the -recorder option next to the given log file.
+ * Files listed there are resolved without accessing the file system. If the .fls file was written by the same
+ * compilation as the log, files not listed are assumed not to exist.
+ * Returns false if there is no .fls file.
+ */
+bool LatexOutputFilter::readRecorderFile(const QString &logFileName)
+{
+	m_recorderFiles.clear();
+	m_recorderComplete = false;
+
+	QFileInfo logInfo(logFileName);
+	QFileInfo flsInfo(logInfo.absolutePath() + '/' + logInfo.completeBaseName() + ".fls");
+	QFile f(flsInfo.absoluteFilePath());
+	if (!f.open(QIODevice::ReadOnly)) return false;
+
+	QString pwd = logInfo.absolutePath();
+	while (!f.atEnd()) {
+		QString line = QString::fromUtf8(f.readLine()).trimmed();
+		if (line.startsWith("PWD ")) {
+			pwd = line.mid(4);
+		} else if (line.startsWith("INPUT ")) {
+			QString name = line.mid(6);
+			m_recorderFiles.insert(QDir::cleanPath(QDir::isAbsolutePath(name) ? name : pwd + '/' + name));
+		}
+	}
+	// both files are written by the same run; allow for the log being closed a little later
+	m_recorderComplete = !m_recorderFiles.isEmpty() && flsInfo.lastModified().addSecs(5) >= logInfo.lastModified();
+	return true;
 }
 
 
@@ -254,8 +338,6 @@ QString LatexOutputFilter::absoluteFileName(const QString &name)
  */
 void LatexOutputFilter::updateFileStack(const QString &strLine, short &dwCookie)
 {
-	static QString strPartialFileName;
-
 	switch (dwCookie) {
 	//we're looking for a filename
 	case Start :
@@ -266,7 +348,7 @@ void LatexOutputFilter::updateFileStack(const QString &strLine, short &dwCookie)
 		//TeX is opening a file
 		if (strLine.startsWith(":<+ ")) {
 			//grab the filename, it might be a partial name (i.e. continued on the next line)
-			strPartialFileName = strLine.mid(4).trimmed();
+			m_partialFileName = strLine.mid(4).trimmed();
 
 			//change the cookie so we remember we aren't sure the filename is complete
 			dwCookie = FileName;
@@ -288,9 +370,9 @@ void LatexOutputFilter::updateFileStack(const QString &strLine, short &dwCookie)
 		//since we don't want the filename on the stack twice.
 		if (strLine.startsWith('(') || strLine.startsWith("\\openout")) {
 			//push the filename on the stack and mark it as 'reliable'
-			m_stackFile.push(LOFStackItem(strPartialFileName, true));
-            printFileStack("pushed", strPartialFileName);
-			strPartialFileName.clear();
+			m_stackFile.push(LOFStackItem(m_partialFileName, true));
+            printFileStack("pushed", m_partialFileName);
+			m_partialFileName.clear();
 			dwCookie = Start;
 			updateFileStackHeuristic2(strLine, dwCookie);
 		} else if (strLine.startsWith(":<-")) {
@@ -301,16 +383,16 @@ void LatexOutputFilter::updateFileStack(const QString &strLine, short &dwCookie)
 		//Don't push it on the stack, instead try to detect the error.
 		else if (strLine.startsWith('!')) {
 			dwCookie = Start;
-			strPartialFileName.clear();
+			m_partialFileName.clear();
 			detectError(strLine, dwCookie);
 		} else if (strLine.startsWith("No file")) {
 			dwCookie = Start;
-			strPartialFileName.clear();
+			m_partialFileName.clear();
 			detectWarning(strLine, dwCookie);
 		}
 		//Partial filename still isn't complete.
 		else {
-			strPartialFileName = strPartialFileName + strLine.trimmed();
+			m_partialFileName = m_partialFileName + strLine.trimmed();
 		}
 		break;
 
@@ -334,17 +416,16 @@ bool LatexOutputFilter::likelyNoFileStart(const QString &s, const QChar &nextCha
 	return true;
 }
 
-// returns true if the given string exists as a file or ends with an extension of 1-4 characters, e.g. ".tex" or ".jpeg"
+// returns true if the given string ends with an extension of 1-4 characters, e.g. ".tex" or ".jpeg", or exists as a file
 bool LatexOutputFilter::fileNameLikelyComplete(const QString &partialFileName)
 {
     static QRegularExpression extensionRx("^.*\\.\\w{1,4}$");
-    return QFileInfo(partialFileName).exists() || extensionRx.match(partialFileName).hasMatch();
+    return extensionRx.match(partialFileName).hasMatch() || fileExists(partialFileName);
 }
 
 void LatexOutputFilter::updateFileStackHeuristic2(const QString &strLine, short &dwCookie)
 {
-	static QString partialFileName;
-	if (dwCookie == Start) partialFileName.clear();
+	if (dwCookie == Start) m_heuristicPartialFileName.clear();
 
 	QChar c;
 	int fnStart = 0;
@@ -379,31 +460,31 @@ void LatexOutputFilter::updateFileStackHeuristic2(const QString &strLine, short
 			break;
 		case InQuotedFileName:
 			if (c == '"') {
-				partialFileName += strLine.mid(fnStart, i - fnStart);
-				m_stackFile.push(LOFStackItem(partialFileName));
-                printFileStack("push1", partialFileName);
-				partialFileName.clear();
+				m_heuristicPartialFileName += strLine.mid(fnStart, i - fnStart);
+				m_stackFile.push(LOFStackItem(m_heuristicPartialFileName));
+                printFileStack("push1", m_heuristicPartialFileName);
+				m_heuristicPartialFileName.clear();
 				dwCookie = Start;
 				continue;
 			}
 			break;
 		case InFileName:
 			if (c == ')') {
-				partialFileName += strLine.mid(fnStart, i - fnStart);
+				m_heuristicPartialFileName += strLine.mid(fnStart, i - fnStart);
 				fnStart = i;
-				// qDebug() << strLine << partialFileName << fileNameLikelyComplete(partialFileName);
+				// qDebug() << strLine << m_heuristicPartialFileName << fileNameLikelyComplete(m_heuristicPartialFileName);
 				// we can only guess if the ')' is in the filename or terminates it
-				if (fileNameLikelyComplete(partialFileName) || likelyNoFileStart(partialFileName, c)) {
-					partialFileName.clear(); // we don't have to push the filename, because it's directly closed again
+				if (fileNameLikelyComplete(m_heuristicPartialFileName) || likelyNoFileStart(m_heuristicPartialFileName, c)) {
+					m_heuristicPartialFileName.clear(); // we don't have to push the filename, because it's directly closed again
 					dwCookie = Start;
 					continue;
 				}
 			}
 			if (c.isSpace() || c == '(') {
-				partialFileName += strLine.mid(fnStart, i - fnStart);
+				m_heuristicPartialFileName += strLine.mid(fnStart, i - fnStart);
 				fnStart = i;
 				// we can only guess if the space is in the filename or terminates it
-				if (fileNameLikelyComplete(partialFileName) || likelyNoFileStart(partialFileName, c)) {
+				if (fileNameLikelyComplete(m_heuristicPartialFileName) || likelyNoFileStart(m_heuristicPartialFileName, c)) {
 					// We need likelyNoFileStart together with the space a an abort criterion for
 					// file scanning in normal text.
 					// It may seem strange at first, that we also push if likelyNoFileStart, but
@@ -412,9 +493,9 @@ void LatexOutputFilter::updateFileStackHeuristic2(const QString &strLine, short
 					// we would erronously step down in the stack.
 					// The pushed value (even if its false) will only make for a local error, but
 					// is may even be correct since likelyNoFileStart is also just a heuristic.
-					m_stackFile.push(LOFStackItem(partialFileName));
-                    printFileStack("push2", partialFileName);
-					partialFileName.clear();
+					m_stackFile.push(LOFStackItem(m_heuristicPartialFileName));
+                    printFileStack("push2", m_heuristicPartialFileName);
+					m_heuristicPartialFileName.clear();
 					if (c == '(') {
 						dwCookie = ExpectingFileName;
 					} else {
@@ -427,17 +508,17 @@ void LatexOutputFilter::updateFileStackHeuristic2(const QString &strLine, short
 	}
 	// special handling at end of line:
 	if (dwCookie == InFileName) {
-		partialFileName += strLine.mid(fnStart);
+		m_heuristicPartialFileName += strLine.mid(fnStart);
 		if (strLine.length() < 78  // a)  line is not full: file name must be at end;
-		        || fileExists(partialFileName) // or b) if line is full and the file exists: assume at filename end, otherwise continue with next line
+		        || fileExists(m_heuristicPartialFileName) // or b) if line is full and the file exists: assume at filename end, otherwise continue with next line
 		   ) {
-			m_stackFile.push(LOFStackItem(partialFileName));
-            printFileStack("push3", partialFileName);
-			partialFileName.clear();
+			m_stackFile.push(LOFStackItem(m_heuristicPartialFileName));
+            printFileStack("push3", m_heuristicPartialFileName);
+			m_heuristicPartialFileName.clear();
 			dwCookie = Start;
 		}
 	} else if (dwCookie == InQuotedFileName) {
-		partialFileName += strLine.mid(fnStart);
+		m_heuristicPartialFileName += strLine.mid(fnStart);
 	}
 }
 
@@ -1062,16 +1143,18 @@ short LatexOutputFilter::parseLine(const QString &strLine, short dwCookie)
 //
 // dani 18.02.2005
 
-bool LatexOutputFilter::run(const QTextDocument *log)
+void LatexOutputFilter::begin()
 {
+	OutputFilter::begin();
 	m_filelookup.clear();
 	m_infoList.clear();
 	m_nErrors = m_nWarnings = m_nBadBoxes = m_nParens = 0;
+	m_currentItem.clear();
+	m_partialFileName.clear();
+	m_heuristicPartialFileName.clear();
 	m_stackFile.clear();
 	QString mainfile = QFileInfo(source()).fileName();
 	m_stackFile.push(LOFStackItem(mainfile, true));
     printFileStack("push", mainfile);
-
-	return OutputFilter::run(log);
 }
 
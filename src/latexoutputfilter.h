@@ -88,8 +88,9 @@ public:
 	//virtual bool Run(const QString& logfile);
 	virtual bool run(const QTextDocument *log);
 
-	//void setLog(const QString &log) { m_log = log; }
-	const QString &log() const { return m_log; }
+	virtual void begin();
+	void addChunk(const QString &chunk);
+	bool end();
 
 	void setSource(const QString &src);
 	const QString &source() const { return m_source; }
@@ -101,8 +102,12 @@ protected:
 	int GetCurrentOutputLine() const;
 
 private:
+	void parseOutputLine(const QString &line);
+
 	unsigned int m_nOutputLines;  // number of current line in output file
-	QString m_log, m_source, m_srcPath;
+	short m_cookie;
+	QString m_pendingLine; // incomplete last line of the chunks passed to addChunk()
+	QString m_source, m_srcPath;
 };
 
 
@@ -114,7 +119,7 @@ public:
 	LatexOutputFilter();
 	~LatexOutputFilter();
 
-	virtual bool run(const QTextDocument *log);
+	virtual void begin();
 	//void sendProblems();
 	//void updateInfoLists(const QString &texfilename, int selrow, int docrow);
 
@@ -128,7 +133,7 @@ protected:
 	void updateFileStackHeuristic(const QString &strLine, short &dwCookie);
 	void updateFileStackHeuristic2(const QString &strLine, short &dwCookie);
 	static bool likelyNoFileStart(const QString &s, const QChar &nextChar);
-	static bool fileNameLikelyComplete(const QString &s);
+	bool fileNameLikelyComplete(const QString &s);
 	void flushCurrentItem();
 
 	// overridings
@@ -151,8 +156,11 @@ protected:
 
 	bool fileExists(const QString &name);
 	QString absoluteFileName(const QString &name);  //returns "" if the file doesn't exists, uses m_filelookup
+	QString statFileName(const QString &name);
 
 public:
+	bool readRecorderFile(const QString &logFileName);
+
 	/** number or errors detected */
 	int m_nErrors;
 
@@ -173,7 +181,12 @@ private:
 	/** The item currently parsed. */
 	LatexLogEntry m_currentItem;
 
-	QMap<QString, QString> m_filelookup; //maps relative filenames to absolute ones
+	/** File names which may continue on the next line (updateFileStack, updateFileStackHeuristic2) */
+	QString m_partialFileName, m_heuristicPartialFileName;
+
+	QHash<QString, QString> m_filelookup; //maps relative filenames to absolute ones, cleared for every run
+	QSet<QString> m_recorderFiles; //absolute names of the input files listed in the .fls file
+	bool m_recorderComplete; //the .fls file belongs to the parsed log, so files not listed in it were not read
 public:                                                                     // Public attributes
 	/** Pointer to list of Latex output information */
 	QList<LatexLogEntry> m_infoList;
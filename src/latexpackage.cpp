@@ -2,10 +2,290 @@
 #include "latexcompleter_config.h"
 #include "latexparser/latexparser.h"
 #include "tablemanipulation.h"
+#include "utilsVersion.h"
+#include <QCryptographicHash>
+#include <QSaveFile>
 
 
 CommandDescription extractCommandDef(QString line, QString definition);
 CommandDescription extractCommandDefKeyVal(QString line, QString &key);
+Token::TokenType registerSpecialArg(const QString &name);
+
+namespace {
+const quint32 CWL_CACHE_MAGIC = 0x54585343; ///< "TXSC"
+const qint32 CWL_CACHE_VERSION = 1;
+
+/*!
+ * \brief global changes done while parsing a cwl file
+ * They need to be repeated when the package is taken from the cache.
+ */
+struct CwlSideEffects {
+	QStringList specialCompletionKeys; ///< for LatexCompleterConfig::specialCompletionKeys
+	QStringList tabularNames; ///< for LatexTables::tabularNames
+	QStringList mathTables; ///< for LatexTables::mathTables
+	QList<QPair<QString, int> > specialArgs; ///< %special arguments and the token type they were given, see registerSpecialArg()
+};
+
+CwlSideEffects *recordingCwlSideEffects = nullptr; ///< side effects of the cwl file which is parsed at the moment
+
+/*!
+ * \brief check if parsing the cwl file again would give the recorded token types of its special arguments
+ * Nothing is registered here, the arguments are registered by registerSpecialArg() only after the whole cache entry has been found valid.
+ * Names which are registered already keep their token type.
+ * \param specialArgs special arguments in order of registration and their token types
+ */
+bool specialArgsReproducible(const QList<QPair<QString, int> > &specialArgs)
+{
+	const LatexParser *latexParserInstance = LatexParser::getInstancePtr();
+	QMap<int, QString> args = latexParserInstance ? latexParserInstance->mapSpecialArgs : QMap<int, QString>();
+	for (int i = 0; i < specialArgs.size(); i++) {
+		const QString &name = specialArgs.at(i).first;
+		const int type = specialArgs.at(i).second;
+		const int index = args.key(name, -1);
+		if (index >= 0) {
+			if (type != Token::specialArg + index && type != Token::specialArg)
+				return false;
+		} else if (!latexParserInstance || args.size() >= Token::_end - Token::specialArg) {
+			if (type != Token::specialArg)
+				return false;
+		} else {
+			if (type != Token::specialArg + args.size())
+				return false;
+			args.insert(args.size(), name);
+		}
+	}
+	return true;
+}
+
+/*!
+ * \brief binary cache of parsed cwl files
+ *
+ * A parsed LatexPackage is stored in the folder "cwlcache" of the config folder.
+ * The cache file is memory-mapped and used only if size, modification time and content hash of the cwl file match and the special argument types can be registered identically.
+ * Packages which contain #ifOption sections are cached for each set of options.
+ */
+class CwlCache
+{
+public:
+	CwlCache(const QFile &cwlFile, const LatexCompleterConfig *config, QStringList conditions);
+	bool load(LatexPackage &package, CwlSideEffects &effects);
+	void save(const LatexPackage &package, const CwlSideEffects &effects);
+
+private:
+	bool read(const QString &fileName, LatexPackage &package, CwlSideEffects &effects) const;
+	QString cacheFileName(bool conditional) const;
+
+	QString m_fileName; ///< name for opening the cwl file, may use the cwl: search path
+	QString m_source; ///< absolute path of the cwl file
+	QString m_folder;
+	QString m_conditions;
+	qint64 m_size;
+	qint64 m_lastModified;
+	QByteArray m_hash;
+};
+
+void writeCommandDescriptions(QDataStream &out, const CommandDescriptionHash &cds)
+{
+	out << qint32(cds.size());
+	for (CommandDescriptionHash::const_iterator it = cds.constBegin(); it != cds.constEnd(); ++it) {
+		const CommandDescription &cd = it.value();
+		out << it.key() << qint32(cd.level) << cd.bracketCommand << cd.verbatimAfterOptionalArg << cd.optionalCommandName << qint32(cd.arguments.size());
+		foreach (const ArgumentDescription &ad, cd.arguments)
+			out << qint32(ad.type) << qint32(ad.tokenType);
+	}
+}
+
+void readCommandDescriptions(QDataStream &in, CommandDescriptionHash &cds)
+{
+	qint32 count;
+	in >> count;
+	for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		QString key;
+		CommandDescription cd;
+		qint32 level, args;
+		in >> key >> level >> cd.bracketCommand >> cd.verbatimAfterOptionalArg >> cd.optionalCommandName >> args;
+		cd.level = level;
+		for (int j = 0; j < args && in.status() == QDataStream::Ok; j++) {
+			qint32 type, tokenType;
+			in >> type >> tokenType;
+			cd.arguments << ArgumentDescription{ArgumentDescription::ArgType(type), Token::TokenType(tokenType)};
+		}
+		cds.insert(key, cd);
+	}
+}
+
+void writeCodeSnippets(QDataStream &out, const CodeSnippetList &snippets)
+{
+	out << qint32(snippets.size());
+	foreach (const CodeSnippet &cs, snippets) {
+		out << cs.word << cs.sortWord << cs.lines << qint32(cs.cursorLine) << qint32(cs.cursorOffset) << qint32(cs.anchorOffset)
+		    << qint32(cs.usageCount) << quint32(cs.index) << qint32(cs.snippetLength) << qint32(cs.score) << qint32(cs.type)
+		    << cs.environmentRestriction << cs.getName() << qint32(cs.placeHolders.size());
+		foreach (const QList<CodeSnippetPlaceHolder> &line, cs.placeHolders) {
+			out << qint32(line.size());
+			foreach (const CodeSnippetPlaceHolder &ph, line)
+				out << qint32(ph.offset) << qint32(ph.length) << qint32(ph.id) << qint32(ph.flags);
+		}
+	}
+}
+
+void readCodeSnippets(QDataStream &in, CodeSnippetList &snippets)
+{
+	qint32 count;
+	in >> count;
+	for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		CodeSnippet cs;
+		QString name;
+		qint32 cursorLine, cursorOffset, anchorOffset, usageCount, snippetLength, score, type, lines;
+		quint32 index;
+		in >> cs.word >> cs.sortWord >> cs.lines >> cursorLine >> cursorOffset >> anchorOffset
+		   >> usageCount >> index >> snippetLength >> score >> type
+		   >> cs.environmentRestriction >> name >> lines;
+		cs.cursorLine = cursorLine;
+		cs.cursorOffset = cursorOffset;
+		cs.anchorOffset = anchorOffset;
+		cs.usageCount = usageCount;
+		cs.index = index;
+		cs.snippetLength = snippetLength;
+		cs.score = score;
+		cs.type = CodeSnippet::Type(type);
+		cs.setName(name);
+		for (int l = 0; l < lines && in.status() == QDataStream::Ok; l++) {
+			qint32 phCount;
+			in >> phCount;
+			QList<CodeSnippetPlaceHolder> line;
+			for (int j = 0; j < phCount && in.status() == QDataStream::Ok; j++) {
+				qint32 offset, length, id, flags;
+				in >> offset >> length >> id >> flags;
+				line << CodeSnippetPlaceHolder{offset, length, id, flags};
+			}
+			cs.placeHolders << line;
+		}
+		snippets.append(cs);
+	}
+}
+
+CwlCache::CwlCache(const QFile &cwlFile, const LatexCompleterConfig *config, QStringList conditions): m_size(-1), m_lastModified(0)
+{
+	if (!config || config->importedCwlBaseDir.isEmpty())
+		return; // caching disabled
+	QFileInfo fi(cwlFile);
+	m_fileName = cwlFile.fileName();
+	m_source = fi.canonicalFilePath();
+	if (m_source.isEmpty())
+		m_source = fi.absoluteFilePath();
+	m_size = fi.size();
+	m_lastModified = fi.lastModified().toMSecsSinceEpoch();
+	m_folder = config->importedCwlBaseDir + "cwlcache/";
+	conditions.sort();
+	m_conditions = conditions.join(',');
+}
+
+QString CwlCache::cacheFileName(bool conditional) const
+{
+	QString key = conditional ? m_source + "#" + m_conditions : m_source;
+	return m_folder + QString::fromLatin1(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex()) + ".cwlc";
+}
+/*!
+ * \brief restore package from cache
+ * \return false if there is no valid cache entry, package and effects are undefined in that case
+ */
+bool CwlCache::load(LatexPackage &package, CwlSideEffects &effects)
+{
+	if (m_folder.isEmpty())
+		return false;
+	QFile f(m_fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	uchar *mapped = f.map(0, f.size());
+	m_hash = QCryptographicHash::hash(mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(f.size())) : f.readAll(), QCryptographicHash::Md5);
+	if (mapped)
+		f.unmap(mapped);
+
+	bool found = read(cacheFileName(false), package, effects) && !package.containsOptionalSections;
+	if (!found) {
+		package = LatexPackage();
+		effects = CwlSideEffects();
+		found = read(cacheFileName(true), package, effects);
+	}
+	if (found) {
+		// the token types of special arguments are given in order of registration, see specialArgsReproducible()
+		for (int i = 0; i < effects.specialArgs.size(); i++)
+			registerSpecialArg(effects.specialArgs.at(i).first);
+	}
+	return found;
+}
+
+bool CwlCache::read(const QString &fileName, LatexPackage &package, CwlSideEffects &effects) const
+{
+	QFile f(fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	uchar *mapped = f.map(0, f.size());
+	if (!mapped)
+		return false;
+	QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(f.size())));
+	in.setVersion(QDataStream::Qt_5_12);
+	quint32 magic;
+	qint32 version;
+	QString txsVersion, source, conditions;
+	qint64 size, lastModified;
+	QByteArray hash;
+	in >> magic >> version >> txsVersion >> source >> size >> lastModified >> hash;
+	bool valid = in.status() == QDataStream::Ok && magic == CWL_CACHE_MAGIC && version == CWL_CACHE_VERSION && txsVersion == TXSVERSION
+	             && source == m_source && size == m_size && lastModified == m_lastModified && hash == m_hash;
+	if (valid) {
+		qint32 count;
+		in >> package.containsOptionalSections >> conditions;
+		valid = !package.containsOptionalSections || conditions == m_conditions;
+		in >> package.packageName >> package.requiredPackages >> package.possibleCommands >> package.specialDefCommands >> package.optionCommands >> count;
+		for (int i = 0; valid && i < count && in.status() == QDataStream::Ok; i++) {
+			QString key, value;
+			in >> key >> value;
+			package.environmentAliases.insert(key, value);
+		}
+		readCommandDescriptions(in, package.commandDescriptions);
+		readCodeSnippets(in, package.completionWords);
+		in >> effects.specialCompletionKeys >> effects.tabularNames >> effects.mathTables >> count;
+		for (int i = 0; valid && i < count && in.status() == QDataStream::Ok; i++) {
+			QString name;
+			qint32 type;
+			in >> name >> type;
+			effects.specialArgs << qMakePair(name, int(type));
+		}
+		valid = valid && in.status() == QDataStream::Ok && specialArgsReproducible(effects.specialArgs);
+	}
+	f.unmap(mapped);
+	return valid;
+}
+
+void CwlCache::save(const LatexPackage &package, const CwlSideEffects &effects)
+{
+	if (m_folder.isEmpty() || m_hash.isEmpty())
+		return;
+	if (!effects.specialArgs.isEmpty() && !LatexParser::getInstancePtr())
+		return; // token types can't be reproduced
+	QDir().mkpath(m_folder);
+	QSaveFile f(cacheFileName(package.containsOptionalSections));
+	if (!f.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&f);
+	out.setVersion(QDataStream::Qt_5_12);
+	out << CWL_CACHE_MAGIC << CWL_CACHE_VERSION << QString(TXSVERSION) << m_source << m_size << m_lastModified << m_hash;
+	out << package.containsOptionalSections << m_conditions;
+	out << package.packageName << package.requiredPackages << package.possibleCommands << package.specialDefCommands << package.optionCommands;
+	out << qint32(package.environmentAliases.size());
+	for (QMultiHash<QString, QString>::const_iterator it = package.environmentAliases.constBegin(); it != package.environmentAliases.constEnd(); ++it)
+		out << it.key() << it.value();
+	writeCommandDescriptions(out, package.commandDescriptions);
+	writeCodeSnippets(out, package.completionWords);
+	out << effects.specialCompletionKeys << effects.tabularNames << effects.mathTables << qint32(effects.specialArgs.size());
+	for (int i = 0; i < effects.specialArgs.size(); i++)
+		out << effects.specialArgs.at(i).first << qint32(effects.specialArgs.at(i).second);
+	if (out.status() == QDataStream::Ok)
+		f.commit();
+}
+}
 
 
 LatexPackage::LatexPackage() : notFound(false)
@@ -84,18 +364,33 @@ void LatexPackage::unite(LatexPackage &add, bool forCompletion)
 typedef QPair<int, int> PairIntInt;
 
 
+/*!
+ * \brief load cwl file
+ * Parsed files are cached in binary form (see CwlCache) if config is given.
+ * \param fileName name of cwl file, searched in cwl: path if not absolute
+ * \param config completer config, usage counts are taken from there
+ * \param conditions package options, which enable #ifOption sections
+ * \return package
+ */
 LatexPackage loadCwlFile(const QString fileName, LatexCompleterConfig *config, QStringList conditions)
 {
 	CodeSnippetList words;
 	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 	LatexPackage package;
+	CwlSideEffects effects;
 
 	QFile tagsfile("cwl:" + fileName);
     if(QFileInfo(fileName).isAbsolute() && !tagsfile.exists()){
         tagsfile.setFileName(fileName);
     }
+	CwlCache cache(tagsfile, config, conditions);
 	bool skipSection = false;
-	if (tagsfile.exists() && tagsfile.open(QFile::ReadOnly)) {
+	if (tagsfile.exists() && cache.load(package, effects)) {
+		// taken from cache
+	} else if (tagsfile.exists() && tagsfile.open(QFile::ReadOnly)) {
+		package = LatexPackage();
+		effects = CwlSideEffects();
+		recordingCwlSideEffects = &effects;
 		QString line;
 		QTextStream stream(&tagsfile);
 #if QT_VERSION < QT_VERSION_CHECK(6,0,0)
@@ -405,14 +700,12 @@ LatexPackage loadCwlFile(const QString fileName, LatexCompleterConfig *config, Q
                             package.specialDefCommands.insert(rxComMatch3.captured(1), definition);
 					}
 					if (definition.startsWith('%')) {
-						if (config)
-							config->specialCompletionKeys.insert(definition);
+						effects.specialCompletionKeys << definition;
 					} else {
 						if (definition.length() > 2) {
 							QString helper = definition.mid(1, definition.length() - 2);
 							if (helper.startsWith('%')) {
-								if (config)
-									config->specialCompletionKeys.insert(helper);
+								effects.specialCompletionKeys << helper;
 							}
 						}
 					}
@@ -558,10 +851,10 @@ LatexPackage loadCwlFile(const QString fileName, LatexCompleterConfig *config, Q
                                 foreach (const QString &elem, env){
                                     package.environmentAliases.insert(rxComMatch.captured(3), elem);
                                     if(elem=="tabular"){
-                                        LatexTables::tabularNames.insert(envName);
+                                        effects.tabularNames << envName;
                                     }
                                     if(elem=="array"){
-                                        LatexTables::mathTables.insert(envName);
+                                        effects.mathTables << envName;
                                     }
                                 }
 							}
@@ -627,30 +920,62 @@ LatexPackage loadCwlFile(const QString fileName, LatexCompleterConfig *config, Q
                     if(valid.contains('e') && !env.isEmpty()){
                         it->environmentRestriction = env.first(); // only use first env for now
                     }
-					if (config) {
-						QList<QPair<int, int> >res = config->usage.values(hash);
-						foreach (const PairIntInt &elem, res) {
-							if (elem.first == it->snippetLength) {
-								it->usageCount = elem.second;
-								break;
-							}
-						}
-					}
 				}
 			}
 		}
+		recordingCwlSideEffects = nullptr;
+		package.completionWords = words;
+		cache.save(package, effects);
 	} else {
 		//qDebug() << "Completion file not found:" << fileName;
 		package.packageName = "<notFound>";
 		package.notFound = true;
 	}
 
+	foreach (const QString &key, effects.specialCompletionKeys) {
+		if (config)
+			config->specialCompletionKeys.insert(key);
+	}
+	foreach (const QString &envName, effects.tabularNames)
+		LatexTables::tabularNames.insert(envName);
+	foreach (const QString &envName, effects.mathTables)
+		LatexTables::mathTables.insert(envName);
+	if (config) {
+		for (CodeSnippetList::iterator it = package.completionWords.begin(); it != package.completionWords.end(); ++it) {
+			QList<QPair<int, int> >res = config->usage.values(it->index);
+			foreach (const PairIntInt &elem, res) {
+				if (elem.first == it->snippetLength) {
+					it->usageCount = elem.second;
+					break;
+				}
+			}
+		}
+	}
+
 	QApplication::restoreOverrideCursor();
-	package.completionWords = words;
 	return package;
 }
 
 
+/*!
+ * \brief register special argument type in LatexParser
+ * \param name e.g. %color
+ * \return token type for newly registered names, Token::specialArg otherwise
+ */
+Token::TokenType registerSpecialArg(const QString &name)
+{
+	Token::TokenType type = Token::specialArg;
+	LatexParser *latexParserInstance = LatexParser::getInstancePtr();
+	if (latexParserInstance) {
+		int cnt = latexParserInstance->mapSpecialArgs.count();
+		if (!latexParserInstance->mapSpecialArgs.values().contains(name) && cnt < Token::_end - Token::specialArg) { // token types are stored in 8 bit
+			latexParserInstance->mapSpecialArgs.insert(cnt, name);
+			type = Token::TokenType(type + cnt);
+		}
+	}
+	return type;
+}
+
 Token::TokenType tokenTypeFromCwlArg(QString arg, QString &definition)
 {
 	int i = arg.indexOf('%');
@@ -675,16 +1000,10 @@ Token::TokenType tokenTypeFromCwlArg(QString arg, QString &definition)
             return Token::defSpecialArg;
         }
 		if (suffix == "%special") {
-			Token::TokenType type = Token::specialArg;
 			arg.chop(8);
-			LatexParser *latexParserInstance = LatexParser::getInstancePtr();
-			if (latexParserInstance) {
-				if (!latexParserInstance->mapSpecialArgs.values().contains("%" + arg)) {
-					int cnt = latexParserInstance->mapSpecialArgs.count();
-					latexParserInstance->mapSpecialArgs.insert(cnt, "%" + arg);
-					type = Token::TokenType(type + cnt);
-				}
-			}
+			Token::TokenType type = registerSpecialArg("%" + arg);
+			if (recordingCwlSideEffects)
+				recordingCwlSideEffects->specialArgs << qMakePair("%" + arg, int(type));
 			return type;
 		}
 	}
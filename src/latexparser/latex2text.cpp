@@ -5,7 +5,7 @@
 LineInfo::LineInfo(QDocumentLineHandle* line): line(line){
 	text = line->text();
 	// blank irrelevant content, i.e. commands, non-text, comments, verbatim
-	TokenList tl = line->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+	TokenList tl = line->getTokensLocked();
 	if(tl.isEmpty()){
 		// special treatment of in verbatim env, as no tokens are generated
 		text.fill(' ',text.length());
@@ -16,7 +16,9 @@ const int LatexParser::MAX_STRUCTURE_LEVEL = 10;
 
 LatexParser *LatexParserInstance = nullptr;
 
-LatexParser::LatexParser()
+QAtomicInteger<quint64> LatexParserGeneration;
+
+LatexParser::LatexParser(): generation(newGeneration())
 {
 	if (!LatexParserInstance) {
 		LatexParserInstance = this;
@@ -31,6 +33,7 @@ LatexParser::~LatexParser()
 	}
 }
 LatexParser::LatexParser(const LatexParser &other){
+    generation=other.generation;
     commandDefs=other.commandDefs;
     environmentCommands=other.environmentCommands;
     mathStartCommands=other.mathStartCommands;
@@ -45,6 +48,7 @@ LatexParser::LatexParser(const LatexParser &other){
 
 LatexParser &LatexParser::operator=(const LatexParser &other)
 {
+    generation=other.generation;
     commandDefs=other.commandDefs;
     environmentCommands=other.environmentCommands;
     mathStartCommands=other.mathStartCommands;
@@ -67,6 +71,14 @@ LatexParser * LatexParser::getInstancePtr()
 {
 	return LatexParserInstance;
 }
+/*!
+ * \brief new unique generation number
+ * Used to identify published parser snapshots, see LatexDocument::updateLtxCommands()
+ */
+quint64 LatexParser::newGeneration()
+{
+	return LatexParserGeneration.fetchAndAddRelaxed(1) + 1;
+}
 
 void LatexParser::init()
 {
@@ -230,6 +242,7 @@ void LatexParser::append(const LatexParser &elem)
 	commandDefs.unite(elem.commandDefs);
 	mapSpecialArgs.unite(elem.mapSpecialArgs);
 #endif
+	generation = newGeneration();
 }
 
 void LatexParser::substract(const LatexParser &elem)
@@ -244,11 +257,77 @@ void LatexParser::substract(const LatexParser &elem)
 	foreach (QString key, elem.commandDefs.keys()) {
 		commandDefs.remove(key);
 	}
+	generation = newGeneration();
+}
+/*!
+ * \brief determine the values which have been added compared to base
+ * Only values which are merged by append() are considered.
+ * If this succeeds, appending delta to a parser which contains base gives the same result as appending this, without touching the unchanged values.
+ * \param base previous state
+ * \param delta receives added and changed values
+ * \return false if values of base have been removed
+ */
+bool LatexParser::additionsTo(const LatexParser &base, LatexParser &delta) const
+{
+	delta.possibleCommands.clear();
+	delta.environmentAliases.clear();
+	delta.specialDefCommands.clear();
+	delta.mapSpecialArgs.clear();
+	delta.commandDefs.clear();
+	for (QHash<QString, QSet<QString> >::const_iterator i = base.possibleCommands.constBegin(); i != base.possibleCommands.constEnd(); ++i) {
+		if (!i.value().isEmpty() && !possibleCommands.value(i.key()).contains(i.value()))
+			return false;
+	}
+	for (QHash<QString, QSet<QString> >::const_iterator i = possibleCommands.constBegin(); i != possibleCommands.constEnd(); ++i) {
+		const QSet<QString> baseSet = base.possibleCommands.value(i.key());
+		if (baseSet.size() == i.value().size())
+			continue; // base is contained, so equal
+		QSet<QString> added = i.value();
+		added.subtract(baseSet);
+		delta.possibleCommands.insert(i.key(), added);
+	}
+	for (QMultiHash<QString, QString>::const_iterator i = base.environmentAliases.constBegin(); i != base.environmentAliases.constEnd(); ++i) {
+		if (!environmentAliases.contains(i.key(), i.value()))
+			return false;
+	}
+	for (QMultiHash<QString, QString>::const_iterator i = environmentAliases.constBegin(); i != environmentAliases.constEnd(); ++i) {
+		if (!base.environmentAliases.contains(i.key(), i.value()))
+			delta.environmentAliases.insert(i.key(), i.value());
+	}
+	foreach (const QString &key, base.specialDefCommands.keys()) {
+		if (!specialDefCommands.contains(key))
+			return false;
+	}
+	foreach (int key, base.mapSpecialArgs.keys()) {
+		if (!mapSpecialArgs.contains(key))
+			return false;
+	}
+	foreach (const QString &key, base.commandDefs.keys()) {
+		if (!commandDefs.contains(key))
+			return false;
+	}
+	for (QHash<QString, QString>::const_iterator i = specialDefCommands.constBegin(); i != specialDefCommands.constEnd(); ++i) {
+		QHash<QString, QString>::const_iterator b = base.specialDefCommands.constFind(i.key());
+		if (b == base.specialDefCommands.constEnd() || b.value() != i.value())
+			delta.specialDefCommands.insert(i.key(), i.value());
+	}
+	for (QMap<int, QString>::const_iterator i = mapSpecialArgs.constBegin(); i != mapSpecialArgs.constEnd(); ++i) {
+		QMap<int, QString>::const_iterator b = base.mapSpecialArgs.constFind(i.key());
+		if (b == base.mapSpecialArgs.constEnd() || b.value() != i.value())
+			delta.mapSpecialArgs.insert(i.key(), i.value());
+	}
+	for (CommandDescriptionHash::const_iterator i = commandDefs.constBegin(); i != commandDefs.constEnd(); ++i) {
+		CommandDescriptionHash::const_iterator b = base.commandDefs.constFind(i.key());
+		if (b == base.commandDefs.constEnd() || !(b.value() == i.value()))
+			delta.commandDefs.insert(i.key(), i.value());
+	}
+	return true;
 }
 
 void LatexParser::clear()
 {
 	init();
+	generation = newGeneration();
 }
 
 void LatexParser::importCwlAliases(const QString filename)
@@ -47,9 +47,13 @@ public:
 
 	CommandDescriptionHash commandDefs; ///< command definitions
 
+	quint64 generation; ///< identifies the content, changed by append/substract/clear. Copies share the generation (and, as implicitly shared containers, the data).
+
 	void append(const LatexParser &elem); ///< append values
 	void substract(const LatexParser &elem); ///< remove values
+	bool additionsTo(const LatexParser &base, LatexParser &delta) const; ///< values added compared to base
 	void clear(); ///< set to default values
+	static quint64 newGeneration();
     void importCwlAliases(const QString filename); ///< import package aliases from disc
 };
 Q_DECLARE_METATYPE(LatexParser)
@@ -8,6 +8,7 @@ HEADERS += \
     $$PWD/argumentlist.h \
     $$PWD/latex2text.h \
     $$PWD/latextokens.h \
+    $$PWD/latextokencache.h \
     $$PWD/latexparser.h \
     $$PWD/latexparsing.h \
     $$PWD/latexreader.h \
@@ -17,6 +18,7 @@ SOURCES += \
     $$PWD/argumentlist.cpp \
     $$PWD/latex2text.cpp \
     $$PWD/latextokens.cpp \
+    $$PWD/latextokencache.cpp \
     $$PWD/latexparser.cpp \
     $$PWD/latexparsing.cpp \
     $$PWD/latexreader.cpp \
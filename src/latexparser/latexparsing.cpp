@@ -143,7 +143,7 @@ TokenList simpleLexLatexLine(QDocumentLineHandle *dlh)
 		lexed.append(present);
 		previous = present;
 	}
-	dlh->setCookie(QDocumentLine::LEXER_RAW_COOKIE, QVariant::fromValue<TokenList>(lexed));
+	dlh->setTokens(lexed, QDocumentLine::LEXER_RAW_COOKIE);
     dlh->removeCookie(QDocumentLine::LEXER_COOKIE);
 	dlh->unlock();
 	return lexed;
@@ -155,9 +155,9 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
 	if (!dlh)
 	    return false;
 	dlh->lockForWrite();
-	TokenList tl = dlh->getCookie(QDocumentLine::LEXER_RAW_COOKIE).value<TokenList>();
-	TokenStack oldRemainder = dlh->getCookie(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
-	CommandStack oldCommandStack = dlh->getCookie(QDocumentLine::LEXER_COMMANDSTACK_COOKIE).value<CommandStack >();
+	TokenList tl = dlh->getTokens(QDocumentLine::LEXER_RAW_COOKIE);
+	TokenStack oldRemainder = dlh->getRemainder();
+	CommandStack oldCommandStack = dlh->getCommandStack();
 	QString line = dlh->text();
 	bool verbatimMode = false;
 	int level = 0;
@@ -265,10 +265,10 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
             }
             if (tk2.type == Token::openBrace && closingFound) {
                 QString env = line.mid(tk3.start, tk_closing.start-tk3.start);
-                if (lp->possibleCommands["%verbatimEnv"].contains(env)) { // incomplete check if closing corresponds to open !
+                if (lp->possibleCommands.value("%verbatimEnv").contains(env)) { // incomplete check if closing corresponds to open !
                     Token verbatimStart=stack.top();
                     // second option, env in optionalCommandName
-                    if(verbatimStart.optionalCommandName.isEmpty() || verbatimStart.optionalCommandName==env){
+                    if(!verbatimStart.hasOptionalCommandName() || verbatimStart.optionalCommandName()==env){
                         verbatimMode = false;
                         stack.pop();
                     }else{
@@ -294,7 +294,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
             if(tk.type==Token::openBrace){
                 tk.subtype=tokenType;
                 tk.level = level; // push old level on stack in order to restore that level later and to distinguish between arguments and arbitrary braces
-                tk.argLevel = ConfigManager::RUNAWAYLIMIT; // run-away prevention
+                tk.argLevel = qMin(ConfigManager::RUNAWAYLIMIT, int(Token::MAX_ARG_LEVEL)); // run-away prevention
                 stack.push(tk);
                 tk.level++;
                 lexed << tk;
@@ -385,7 +385,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                         // add [( etc to command
                         Token tk2=tl.at(i + 1);
                         if(Token::tkOpen().contains(tk2.type)||Token::tkClose().contains(tk2.type)){
-                            tk.optionalCommandName=command;
+                            tk.setOptionalCommandName(command);
                             command.append(line.mid(tk2.start, 1));
                             tk.length++;
                             i++;
@@ -425,7 +425,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                         // handle as independet braces, like commandless brace below
                         // e.g. \hline {... (\hline accepts optional arguments, but no braces)
                         tk.level = level;
-                        tk.argLevel = ConfigManager::RUNAWAYLIMIT; // run-away prevention, needs to be >0 as otherwise closing barces are misinterpreted
+                        tk.argLevel = qMin(ConfigManager::RUNAWAYLIMIT, int(Token::MAX_ARG_LEVEL)); // run-away prevention, needs to be >0 as otherwise closing barces are misinterpreted
                         if (!stack.isEmpty()) {
                             tk.subtype = stack.top().subtype;
                             if(tk.subtype==Token::text){
@@ -436,9 +436,9 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                                 if(lastComma>0){
                                     // -> val
                                     tk.subtype=Token::keyVal_val;
-                                    QString cmd=lexed[lastComma].optionalCommandName;
+                                    QString cmd=lexed[lastComma].optionalCommandName();
                                     QString key=line.mid(lexed[lastComma].start, lexed[lastComma].length);
-                                    tk.optionalCommandName=cmd+"/"+key;
+                                    tk.setOptionalCommandName(cmd+"/"+key);
                                 }else{
                                     tk.subtype=Token::keyVal_key; // not sure if that is a real scenario
                                 }
@@ -502,7 +502,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                 }
 
                 tk.level = level; // push old level on stack in order to restore that level later and to distinguish between arguments and arbitrary braces
-                tk.argLevel = ConfigManager::RUNAWAYLIMIT; // run-away prevention
+                tk.argLevel = qMin(ConfigManager::RUNAWAYLIMIT, int(Token::MAX_ARG_LEVEL)); // run-away prevention
                 if(tk.subtype==Token::beginEnv || tk.subtype==Token::env){
                     // cut runaway as is must stay within one line
                     tk.argLevel = 0;
@@ -522,7 +522,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                 if(tk.type==Token::openBrace){ // check braces within arguments, not brackets/squareBrackets
                     //level++; // not an argument
                     tk.level = level;
-                    tk.argLevel = ConfigManager::RUNAWAYLIMIT; // run-away prevention, needs to be >0 as otherwise closing barces are misinterpreted
+                    tk.argLevel = qMin(ConfigManager::RUNAWAYLIMIT, int(Token::MAX_ARG_LEVEL)); // run-away prevention, needs to be >0 as otherwise closing barces are misinterpreted
                     if (!stack.isEmpty()) {
                         tk.subtype = stack.top().subtype;
                         if(tk.subtype==Token::text){
@@ -533,9 +533,9 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                             if(lastComma>0){
                                 // -> val
                                 tk.subtype=Token::keyVal_val;
-                                QString cmd=lexed[lastComma].optionalCommandName;
+                                QString cmd=lexed[lastComma].optionalCommandName();
                                 QString key=line.mid(lexed[lastComma].start, lexed[lastComma].length);
-                                tk.optionalCommandName=cmd+"/"+key;
+                                tk.setOptionalCommandName(cmd+"/"+key);
                             }else{
                                 tk.subtype=Token::keyVal_key; // not sure if that is a real scenario
                             }
@@ -624,7 +624,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                                 QString env = line.mid(tk2.start, tk2.length);
                                 CommandDescription cd = lp->commandDefs.value("\\begin{" + env + "}", CommandDescription());
                                 // special treatment for verbatim
-                                if (lp->possibleCommands["%verbatimEnv"].contains(env)) {
+                                if (lp->possibleCommands.value("%verbatimEnv").contains(env)) {
                                     if(cd.args()==1 && cd.args(ArgumentDescription::OPTIONAL)==1 && i<(tl.length()-1) && tl[i+1].type==Token::openSquare){ // next Token needs to be [ i.e. optional arg, otherwise start verbatim directly
                                         // special treatment for \begin{abc}[...]
                                         cd.verbatimAfterOptionalArg=true;
@@ -639,7 +639,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                                         tk3.dlh = dlh;
                                         tk3.level = level - 1;
                                         tk3.type = Token::verbatim;
-                                        tk3.optionalCommandName=env; // store verbatim env name (fix #2386, \end{diffVerbatim} was falsely used to close verbatim)
+                                        tk3.setOptionalCommandName(env); // store verbatim env name (fix #2386, \end{diffVerbatim} was falsely used to close verbatim)
                                         stack.push(tk3);
                                     }
                                 } else { // only care for further arguments if not in verbatim mode (see minted)
@@ -691,7 +691,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                             tk3.level = level - 1;
                             tk3.type = Token::verbatim;
                             QString env=cd.optionalCommandName.mid(7,cd.optionalCommandName.length()-8); // dirty solution, does not use tokens as it should
-                            tk3.optionalCommandName=env;
+                            tk3.setOptionalCommandName(env);
                             stack.push(tk3);
                         }
                     }
@@ -759,7 +759,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                 tk.type = Token::keyVal_key;
                 if(!commandStack.isEmpty()){
                     const CommandDescription &cd = commandStack.top();
-                    tk.optionalCommandName=cd.optionalCommandName;
+                    tk.setOptionalCommandName(cd.optionalCommandName);
                 }
                 keyName = line.mid(tk.start, tk.length);
                 lexed << tk;
@@ -803,9 +803,9 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
                         continue;
                     }
                     // add cmd/key as optionalCommandName
-                    QString cmd=lexed[lastComma].optionalCommandName;
+                    QString cmd=lexed[lastComma].optionalCommandName();
                     QString key=line.mid(lexed[lastComma].start, lexed[lastComma].length);
-                    tk.optionalCommandName=cmd+"/"+key;
+                    tk.setOptionalCommandName(cmd+"/"+key);
                     // special treatment for word if is adjacent to "-"
                     if (tk.type == Token::word) {
                         if(lastComma==(lexed.length()-2)){
@@ -877,7 +877,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
             tk.level = level;
             if (!stack.isEmpty()) {
                 tk.subtype = stack.top().subtype;
-                tk.optionalCommandName = stack.top().optionalCommandName;
+                tk.setOptionalCommandName(stack.top());
                 tk.argLevel=-1; // tk is part of brace
             }
             if (!commandStack.isEmpty() && commandStack.top().level == level) {
@@ -943,7 +943,7 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
         }
     }
 
-    dlh->setCookie(QDocumentLine::LEXER_COOKIE, QVariant::fromValue<TokenList>(lexed));
+    dlh->setTokens(std::move(lexed));
 
     for (int i = 0; i < stack.size(); i++) {
         if (stack[i].type == Token::verbatim)
@@ -954,9 +954,9 @@ bool latexDetermineContexts2(QDocumentLineHandle *dlh, TokenStack &stack, Comman
             i--;
         }
     }
-    dlh->setCookie(QDocumentLine::LEXER_REMAINDER_COOKIE, QVariant::fromValue<TokenStack>(stack));
-    dlh->setCookie(QDocumentLine::LEXER_COMMANDSTACK_COOKIE, QVariant::fromValue<CommandStack>(commandStack));
-    dlh->setCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE, QVariant::fromValue<QPair<int,int> >({commentStart, Token::unknownComment}));
+    dlh->setRemainder(stack);
+    dlh->setCommandStack(commandStack);
+    dlh->setCommentStart({commentStart, Token::unknownComment});
     dlh->setFlag(QDocumentLine::lexedPass2InComplete,unknownCommandsPresent);
     dlh->setFlag(QDocumentLine::lexedPass2Complete,!unknownCommandsPresent);
     dlh->setFlag(QDocumentLine::argumentsParsed,false);
@@ -995,7 +995,7 @@ int findCommandWithArgsFromTL(const TokenList &tl, Token &cmd, TokenList &args,
         QDocumentLineHandle *t_dlh=cmd.dlh;
         int t_end=cmd.start+cmd.length;
 		for (; i < tl.length(); i++) {
-			Token tk = tl.at(i);
+			const Token &tk = tl.at(i);
 			if (tk.type == Token::comment)
 				break;
 			if (tk.level < level)
@@ -1141,7 +1141,7 @@ QString getArg(TokenList tl, QDocumentLineHandle *dlh, int argNumber, ArgumentLi
         }
         dlh=doc->line(lineNr).handle();
         if(dlh)
-            tl= dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl= dlh->getTokensLocked();
         cnt++;
     }
 
@@ -1159,7 +1159,7 @@ QString findRestArg(QDocumentLineHandle *dlh, Token::TokenType type, int hint, i
 	if (index + 1 >= document->lines())
 		return QString(); // last line reached
 	dlh = document->line(index + 1).handle();
-	TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+	TokenList tl = dlh->getTokens();
 	QString result = dlh->text();
     if(!tl.isEmpty()){
         int len=tl.last().start+tl.last().length;
@@ -1201,10 +1201,12 @@ QString findRestArg(QDocumentLineHandle *dlh, Token::TokenType type, int hint, i
 Token getTokenAtCol(QDocumentLineHandle *dlh, int pos, bool first)
 {
 	if (!dlh) return Token();
-	TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+	static const QSet<Token::TokenType> braces = Token::tkBraces();
+	static const QSet<Token::TokenType> closing = Token::tkClose();
+	const TokenList tl = dlh->getTokensLocked();
 	Token tk;
 	for (int i = 0; i < tl.length(); i++) {
-		Token elem = tl.at(i);
+		const Token &elem = tl.at(i);
 		if (elem.start > pos)
 			break;
 		if (elem.start + elem.length >= pos) {
@@ -1212,7 +1214,7 @@ Token getTokenAtCol(QDocumentLineHandle *dlh, int pos, bool first)
 			if (first)
 				break;
 		}
-		if (!Token::tkBraces().contains(elem.type) && !Token::tkClose().contains(elem.type) && elem.start + elem.length >= pos) { // get abc|} -> abc
+		if (!braces.contains(elem.type) && !closing.contains(elem.type) && elem.start + elem.length >= pos) { // get abc|} -> abc
 			tk = elem; // get deepest element at col
 			if (first)
 				break;
@@ -1233,7 +1235,7 @@ int getTokenAtCol(TokenList &tl, int pos, bool first)
 {
 	int result = -1;
 	for (int i = 0; i < tl.length(); i++) {
-		Token elem = tl.at(i);
+		const Token &elem = tl.at(i);
 		if (elem.start > pos)
 			break;
 		if (elem.start + elem.length >= pos) {
@@ -1262,7 +1264,7 @@ TokenList getArgContent(Token &tk)
 	if (!dlh)
 		return results;
 	dlh->lockForRead();
-	TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+	TokenList tl = dlh->getTokens();
 	dlh->unlock();
 	for (int i = 0; i < tl.length(); i++) {
 		if (tk == tl.at(i)) {
@@ -1324,7 +1326,7 @@ TokenList getArgContent(TokenList &tl, int pos, int level, int runAwayPrevention
 		TokenList tl;
 		while (index + 1 < document->lines()) {
 			QDocumentLineHandle *dlh = document->line(index + 1).handle();
-            tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl = dlh->getTokensLocked();
 			if (!tl.isEmpty())
 				break;
 			index++;
@@ -1349,7 +1351,7 @@ TokenStack getContext(QDocumentLineHandle *dlh, int pos)
 {
 	if (!dlh) return TokenStack();
 	dlh->lockForRead();
-	TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+	TokenList tl = dlh->getTokens();
 	dlh->unlock();
 	QDocument *doc = dlh->document();
 	int lineNr = doc->indexOf(dlh);
@@ -1357,7 +1359,7 @@ TokenStack getContext(QDocumentLineHandle *dlh, int pos)
 	if (lineNr > 0) {
 		QDocumentLineHandle *previous = doc->line(lineNr - 1).handle();
 		previous->lockForRead();
-		stack = previous->getCookie(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+		stack = previous->getRemainder();
 		previous->unlock();
 	}
 	// find innermost token at pos
@@ -1430,8 +1432,8 @@ TokenStack getContext(QDocumentLineHandle *dlh, int pos)
 QString getCommandFromToken(Token tk)
 {
     // don't use outside of main thread as "previous" may be invalid
-    if(!tk.optionalCommandName.isEmpty()){
-        QString cmd=tk.optionalCommandName;
+    if(tk.hasOptionalCommandName()){
+        QString cmd=tk.optionalCommandName();
         int i=cmd.indexOf('/');
         if(i>-1){
             cmd=cmd.left(i);
@@ -1448,15 +1450,15 @@ QString getCommandFromToken(Token tk)
             int lineNr = doc->indexOf(dlh);
             if (lineNr > 0) {
                 QDocumentLineHandle *previous = doc->line(lineNr - 1).handle();
-                TokenStack stack=previous->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack >();
+                TokenStack stack=previous->getRemainderLocked();
                 if(!stack.isEmpty()){
                     Token tk_group=stack.top();
                     if(tk_group.dlh){
-                        tl<< tk_group.dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+                        tl<< tk_group.dlh->getTokensLocked();
                     }
                 }
             }
-            tl<< dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl<< dlh->getTokensLocked();
 
             Token result = getCommandTokenFromToken(tl, tk);
             if (result.type == Token::command) {
@@ -1565,7 +1567,7 @@ TokenList findRestArgTL(QDocumentLineHandle *dlh, Token::TokenType type, int hin
     if (index + 1 >= document->lines())
         return TokenList(); // last line reached
     dlh = document->line(index + 1).handle();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     for (int i = 0; i < tl.length(); i++) {
         Token tk = tl.at(i);
         if (tk.type == type) {
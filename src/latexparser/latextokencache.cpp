@@ -0,0 +1,469 @@
+#include "latextokencache.h"
+#include "latexparser.h"
+#include "qdocument.h"
+#include "qdocumentline_p.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const char TOKEN_CACHE_MAGIC[8] = {'T', 'X', 'S', 'T', 'O', 'K', 'C', '\0'};
+const quint32 TOKEN_CACHE_VERSION = 1;
+const int TOKEN_CACHE_HEADER_SIZE = 32;
+const int TOKEN_CACHE_INDEX_ENTRY_SIZE = 16; // key (8), offset (4), length (4)
+const QDataStream::Version TOKEN_CACHE_STREAM_VERSION = QDataStream::Qt_5_12;
+
+/// FNV-1a, stable between sessions (unlike qHash which is seeded per process)
+quint64 hashBytes(const void *data, qsizetype len, quint64 h = 14695981039346656037ULL)
+{
+    const uchar *p = static_cast<const uchar *>(data);
+    for (qsizetype i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+quint64 hashString(const QString &s)
+{
+    return hashBytes(s.constData(), s.size() * qsizetype(sizeof(QChar)));
+}
+
+quint64 combine(quint64 a, quint64 b)
+{
+    return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+}
+
+/// splitmix64 finalizer, used to distribute hashes before order-independent summation
+quint64 mix(quint64 h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+/// line distance of token origin relative to line \a lineNr, -1 if unknown
+qint32 relativeLine(const Token &tk, QDocumentLineHandle *dlh, int lineNr)
+{
+    if (!tk.dlh) return -1;
+    if (tk.dlh == dlh) return 0;
+    QDocument *doc = dlh->document();
+    int ln = doc ? doc->indexOf(tk.dlh, lineNr) : -1;
+    if (ln < 0 || ln > lineNr) return -1;
+    return lineNr - ln;
+}
+
+QDocumentLineHandle *resolveLine(qint32 rel, QDocumentLineHandle *dlh, int lineNr)
+{
+    if (rel < 0) return nullptr;
+    if (rel == 0) return dlh;
+    QDocument *doc = dlh->document();
+    return doc ? doc->line(lineNr - rel).handle() : nullptr;
+}
+
+void writeToken(QDataStream &s, const Token &tk, qint32 rel)
+{
+    s << qint32(tk.start) << qint32(tk.length) << qint32(tk.level) << qint32(tk.argLevel);
+    s << quint8(tk.type) << quint8(tk.subtype) << quint8(tk.ignoreSpelling ? 1 : 0);
+    s << tk.optionalCommandName() << rel;
+}
+
+void readToken(QDataStream &s, Token &tk, qint32 &rel)
+{
+    qint32 start, length, level, argLevel;
+    quint8 type, subtype, ignoreSpelling;
+    s >> start >> length >> level >> argLevel;
+    s >> type >> subtype >> ignoreSpelling;
+    QString optionalCommandName;
+    s >> optionalCommandName >> rel;
+    tk.setOptionalCommandName(optionalCommandName);
+    tk.start = start;
+    tk.length = length;
+    tk.level = level;
+    tk.argLevel = argLevel;
+    tk.type = Token::TokenType(type);
+    tk.subtype = Token::TokenType(subtype);
+    tk.ignoreSpelling = ignoreSpelling != 0;
+}
+
+template<typename TokenContainer>
+void writeTokens(QDataStream &s, const TokenContainer &tl, QDocumentLineHandle *dlh, int lineNr)
+{
+    s << qint32(tl.size());
+    for (const Token &tk : tl) {
+        writeToken(s, tk, relativeLine(tk, dlh, lineNr));
+    }
+}
+
+bool readTokens(QDataStream &s, TokenList &tl, QDocumentLineHandle *dlh, int lineNr)
+{
+    qint32 n;
+    s >> n;
+    if (n < 0 || s.status() != QDataStream::Ok) return false;
+    tl.reserve(n);
+    for (qint32 i = 0; i < n; ++i) {
+        Token tk;
+        qint32 rel;
+        readToken(s, tk, rel);
+        tk.dlh = resolveLine(rel, dlh, lineNr);
+        tl.append(tk);
+    }
+    return s.status() == QDataStream::Ok;
+}
+
+void writeCommandStack(QDataStream &s, const CommandStack &commandStack)
+{
+    s << qint32(commandStack.size());
+    for (const CommandDescription &cd : commandStack) {
+        s << qint32(cd.level) << cd.bracketCommand << cd.verbatimAfterOptionalArg << cd.optionalCommandName;
+        s << qint32(cd.arguments.size());
+        for (const ArgumentDescription &ad : cd.arguments) {
+            s << quint8(ad.type) << quint8(ad.tokenType);
+        }
+    }
+}
+
+bool readCommandStack(QDataStream &s, CommandStack &commandStack)
+{
+    qint32 n;
+    s >> n;
+    if (n < 0 || s.status() != QDataStream::Ok) return false;
+    for (qint32 i = 0; i < n; ++i) {
+        CommandDescription cd;
+        qint32 level, args;
+        s >> level >> cd.bracketCommand >> cd.verbatimAfterOptionalArg >> cd.optionalCommandName;
+        s >> args;
+        if (args < 0 || s.status() != QDataStream::Ok) return false;
+        cd.level = level;
+        for (qint32 k = 0; k < args; ++k) {
+            quint8 type, tokenType;
+            s >> type >> tokenType;
+            ArgumentDescription ad;
+            ad.type = ArgumentDescription::ArgType(type);
+            ad.tokenType = Token::TokenType(tokenType);
+            cd.arguments.append(ad);
+        }
+        commandStack.push(cd);
+    }
+    return s.status() == QDataStream::Ok;
+}
+
+/*!
+ * \brief hash of the lexer state at the start of line \a lineNr
+ * Tokens are hashed with their origin relative to \a lineNr, so that the hash does not depend on the absolute position in the document.
+ */
+quint64 hashState(const TokenStack &stack, const CommandStack &commandStack, QDocumentLineHandle *dlh, int lineNr)
+{
+    if (stack.isEmpty() && commandStack.isEmpty()) return 0;
+    QByteArray ba;
+    QDataStream s(&ba, QIODevice::WriteOnly);
+    s.setVersion(TOKEN_CACHE_STREAM_VERSION);
+    s << qint32(stack.size());
+    for (const Token &tk : stack) {
+        // ignoreSpelling is not part of the lexer state
+        s << qint32(tk.start) << qint32(tk.length) << qint32(tk.level) << qint32(tk.argLevel);
+        s << quint8(tk.type) << quint8(tk.subtype) << tk.optionalCommandName() << relativeLine(tk, dlh, lineNr);
+    }
+    writeCommandStack(s, commandStack);
+    return hashBytes(ba.constData(), ba.size());
+}
+
+void appendLE32(QByteArray &ba, quint32 v)
+{
+    uchar buf[4];
+    qToLittleEndian(v, buf);
+    ba.append(reinterpret_cast<const char *>(buf), 4);
+}
+
+void appendLE64(QByteArray &ba, quint64 v)
+{
+    uchar buf[8];
+    qToLittleEndian(v, buf);
+    ba.append(reinterpret_cast<const char *>(buf), 8);
+}
+
+void appendIndex(QByteArray &ba, const QMap<quint64, QPair<quint32, quint32> > &index)
+{
+    for (auto it = index.cbegin(); it != index.cend(); ++it) {
+        appendLE64(ba, it.key());
+        appendLE32(ba, it.value().first);
+        appendLE32(ba, it.value().second);
+    }
+}
+
+}
+
+LatexTokenCache::LatexTokenCache(): m_file(nullptr), m_data(nullptr), m_size(0), m_fingerprint(0), m_rawCount(0), m_lineCount(0)
+{
+}
+
+LatexTokenCache::~LatexTokenCache()
+{
+    close();
+}
+
+/*!
+ * \brief map cache file into memory
+ * \param fileName
+ * \return true if the file is a valid cache file
+ */
+bool LatexTokenCache::open(const QString &fileName)
+{
+    close();
+    m_file = new QFile(fileName);
+    if (!m_file->open(QIODevice::ReadOnly) || m_file->size() < TOKEN_CACHE_HEADER_SIZE) {
+        close();
+        return false;
+    }
+    m_size = m_file->size();
+    m_data = m_file->map(0, m_size);
+    if (!m_data || memcmp(m_data, TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC)) != 0 || qFromLittleEndian<quint32>(m_data + 8) != TOKEN_CACHE_VERSION) {
+        close();
+        return false;
+    }
+    m_fingerprint = qFromLittleEndian<quint64>(m_data + 16);
+    m_rawCount = qFromLittleEndian<quint32>(m_data + 24);
+    m_lineCount = qFromLittleEndian<quint32>(m_data + 28);
+    if (TOKEN_CACHE_HEADER_SIZE + qint64(m_rawCount + qint64(m_lineCount)) * TOKEN_CACHE_INDEX_ENTRY_SIZE > m_size) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void LatexTokenCache::close()
+{
+    if (m_file) {
+        if (m_data) m_file->unmap(const_cast<uchar *>(m_data));
+        delete m_file;
+    }
+    m_file = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+    m_fingerprint = 0;
+    m_rawCount = 0;
+    m_lineCount = 0;
+}
+
+bool LatexTokenCache::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+/*!
+ * \brief check if the cache was generated with the same set of commands as \a lp
+ */
+bool LatexTokenCache::matches(const LatexParser &lp) const
+{
+    return isOpen() && m_fingerprint == fingerprint(lp);
+}
+
+/*!
+ * \brief binary search for \a key in index table
+ * \return pointer to payload or nullptr if not found
+ */
+const uchar *LatexTokenCache::find(const uchar *index, quint32 count, quint64 key, quint32 &length) const
+{
+    quint32 lo = 0, hi = count;
+    while (lo < hi) {
+        quint32 mid = lo + (hi - lo) / 2;
+        quint64 k = qFromLittleEndian<quint64>(index + mid * TOKEN_CACHE_INDEX_ENTRY_SIZE);
+        if (k < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo >= count) return nullptr;
+    const uchar *entry = index + lo * TOKEN_CACHE_INDEX_ENTRY_SIZE;
+    if (qFromLittleEndian<quint64>(entry) != key) return nullptr;
+    const qint64 payloadStart = TOKEN_CACHE_HEADER_SIZE + qint64(m_rawCount + qint64(m_lineCount)) * TOKEN_CACHE_INDEX_ENTRY_SIZE;
+    const quint32 offset = qFromLittleEndian<quint32>(entry + 8);
+    length = qFromLittleEndian<quint32>(entry + 12);
+    if (payloadStart + offset + length > m_size) return nullptr;
+    return m_data + payloadStart + offset;
+}
+
+/*!
+ * \brief restore result of first lexing pass (LEXER_RAW_COOKIE) from cache
+ * Thread-safe, can be used in parallel like Parsing::simpleLexLatexLine
+ * \param dlh
+ * \return true if line was found in cache
+ */
+bool LatexTokenCache::restoreRawTokens(QDocumentLineHandle *dlh) const
+{
+    if (!isOpen() || !dlh) return false;
+    dlh->lockForWrite();
+    const QString text = dlh->text();
+    quint32 length;
+    const uchar *payload = find(m_data + TOKEN_CACHE_HEADER_SIZE, m_rawCount, hashString(text), length);
+    if (!payload) {
+        dlh->unlock();
+        return false;
+    }
+    QByteArray ba = QByteArray::fromRawData(reinterpret_cast<const char *>(payload), length);
+    QDataStream s(ba);
+    s.setVersion(TOKEN_CACHE_STREAM_VERSION);
+    qint32 textLength;
+    s >> textLength;
+    TokenList tl;
+    if (textLength != text.length() || !readTokens(s, tl, dlh, 0)) {
+        dlh->unlock();
+        return false;
+    }
+    dlh->setTokens(tl, QDocumentLine::LEXER_RAW_COOKIE);
+    dlh->removeCookie(QDocumentLine::LEXER_COOKIE);
+    dlh->unlock();
+    return true;
+}
+
+/*!
+ * \brief restore result of second lexing pass from cache
+ * Replaces Parsing::latexDetermineContexts2 for lines which are found in the cache.
+ * \param dlh
+ * \param lineNr line number of dlh
+ * \param stack remainder of previous line, is updated with remainder of this line
+ * \param commandStack command stack of previous line, is updated
+ * \param remainderChanged set to true if remainder or command stack differ from the ones stored on the line before
+ * \return true if line was found in cache
+ */
+bool LatexTokenCache::restoreLine(QDocumentLineHandle *dlh, int lineNr, TokenStack &stack, CommandStack &commandStack, bool &remainderChanged) const
+{
+    if (!isOpen() || !dlh) return false;
+    const quint64 key = combine(hashString(dlh->text()), hashState(stack, commandStack, dlh, lineNr));
+    quint32 length;
+    const uchar *payload = find(m_data + TOKEN_CACHE_HEADER_SIZE + m_rawCount * TOKEN_CACHE_INDEX_ENTRY_SIZE, m_lineCount, key, length);
+    if (!payload) return false;
+
+    QByteArray ba = QByteArray::fromRawData(reinterpret_cast<const char *>(payload), length);
+    QDataStream s(ba);
+    s.setVersion(TOKEN_CACHE_STREAM_VERSION);
+    TokenList lexed;
+    TokenList remainder;
+    CommandStack newCommandStack;
+    qint32 commentStart, commentType;
+    if (!readTokens(s, lexed, dlh, lineNr) || !readTokens(s, remainder, dlh, lineNr) || !readCommandStack(s, newCommandStack)) {
+        return false;
+    }
+    s >> commentStart >> commentType;
+    if (s.status() != QDataStream::Ok) return false;
+    TokenStack newStack;
+    for (const Token &tk : remainder) {
+        newStack.push(tk);
+    }
+
+    dlh->lockForWrite();
+    TokenStack oldRemainder = dlh->getRemainder();
+    CommandStack oldCommandStack = dlh->getCommandStack();
+    dlh->setTokens(std::move(lexed));
+    dlh->setRemainder(newStack);
+    dlh->setCommandStack(newCommandStack);
+    dlh->setCommentStart({commentStart, commentType});
+    dlh->setFlag(QDocumentLine::lexedPass2InComplete, false);
+    dlh->setFlag(QDocumentLine::lexedPass2Complete, true);
+    dlh->setFlag(QDocumentLine::argumentsParsed, false);
+    dlh->unlock();
+
+    remainderChanged = (newStack != oldRemainder) || (newCommandStack != oldCommandStack);
+    stack = newStack;
+    commandStack = newCommandStack;
+    return true;
+}
+
+/*!
+ * \brief write lexer results of \a lines to cache file
+ * Only lines which are completely lexed (no unknown commands) are stored for pass 2.
+ * Identical lines with identical lexer state are stored only once.
+ * \param fileName
+ * \param lines line handles in document order
+ * \param lp command set which was used for lexing
+ * \return success
+ */
+bool LatexTokenCache::save(const QString &fileName, const QList<QDocumentLineHandle *> &lines, const LatexParser &lp)
+{
+    QByteArray payload;
+    QDataStream s(&payload, QIODevice::WriteOnly);
+    s.setVersion(TOKEN_CACHE_STREAM_VERSION);
+    QMap<quint64, QPair<quint32, quint32> > rawIndex, lineIndex;
+
+    for (int i = 0; i < lines.size(); ++i) {
+        QDocumentLineHandle *dlh = lines.at(i);
+        if (!dlh || !dlh->hasFlag(QDocumentLine::lexedPass1)) continue;
+        TokenStack prevStack;
+        CommandStack prevCommandStack;
+        if (i > 0 && lines.at(i - 1)) {
+            prevStack = lines.at(i - 1)->getRemainderLocked();
+            prevCommandStack = lines.at(i - 1)->getCommandStackLocked();
+        }
+        dlh->lockForRead();
+        const QString text = dlh->text();
+        const quint64 textHash = hashString(text);
+        if (!rawIndex.contains(textHash)) {
+            const quint32 offset = payload.size();
+            s << qint32(text.length());
+            writeTokens(s, dlh->getTokens(QDocumentLine::LEXER_RAW_COOKIE), dlh, i);
+            rawIndex.insert(textHash, qMakePair(offset, quint32(payload.size()) - offset));
+        }
+        if (dlh->hasFlag(QDocumentLine::lexedPass2Complete)) {
+            const quint64 key = combine(textHash, hashState(prevStack, prevCommandStack, dlh, i));
+            if (!lineIndex.contains(key)) {
+                const quint32 offset = payload.size();
+                writeTokens(s, dlh->getTokens(), dlh, i);
+                TokenStack stack = dlh->getRemainder();
+                writeTokens(s, stack, dlh, i);
+                writeCommandStack(s, dlh->getCommandStack());
+                QPair<int,int> commentStart = dlh->getCommentStart();
+                s << qint32(commentStart.first) << qint32(commentStart.second);
+                lineIndex.insert(key, qMakePair(offset, quint32(payload.size()) - offset));
+            }
+        }
+        dlh->unlock();
+    }
+
+    QByteArray header(TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC));
+    appendLE32(header, TOKEN_CACHE_VERSION);
+    appendLE32(header, 0); // reserved
+    appendLE64(header, fingerprint(lp));
+    appendLE32(header, rawIndex.size());
+    appendLE32(header, lineIndex.size());
+    appendIndex(header, rawIndex);
+    appendIndex(header, lineIndex);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.write(header);
+    file.write(payload);
+    return true;
+}
+
+/*!
+ * \brief stable, order independent hash of the command set of \a lp
+ * Any change in known commands or their argument definitions changes the fingerprint.
+ */
+quint64 LatexTokenCache::fingerprint(const LatexParser &lp)
+{
+    quint64 result = mix(quint64(lp.commandDefs.size()));
+    for (auto it = lp.commandDefs.cbegin(); it != lp.commandDefs.cend(); ++it) {
+        const CommandDescription &cd = it.value();
+        quint64 h = combine(hashString(it.key()), hashString(cd.optionalCommandName));
+        h = combine(h, quint64(cd.level) << 2 | quint64(cd.bracketCommand) << 1 | quint64(cd.verbatimAfterOptionalArg));
+        for (const ArgumentDescription &ad : cd.arguments) {
+            h = combine(h, quint64(ad.type) << 8 | quint64(ad.tokenType));
+        }
+        result += mix(h);
+    }
+    for (auto it = lp.possibleCommands.cbegin(); it != lp.possibleCommands.cend(); ++it) {
+        const quint64 hk = hashString(it.key());
+        for (const QString &cmd : it.value()) {
+            result += mix(combine(hk, hashString(cmd)));
+        }
+    }
+    for (auto it = lp.specialDefCommands.cbegin(); it != lp.specialDefCommands.cend(); ++it) {
+        result += mix(combine(hashString(it.key()), ~hashString(it.value())));
+    }
+    return result;
+}
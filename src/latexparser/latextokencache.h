@@ -0,0 +1,53 @@
+#ifndef Header_Latex_TokenCache
+#define Header_Latex_TokenCache
+
+#include "mostQtHeaders.h"
+#include "latextokens.h"
+#include "commanddescription.h"
+
+class QDocumentLineHandle;
+class LatexParser;
+
+/*!
+ * \brief persistent cache of lexer results
+ *
+ * Stores the result of both lexing passes (\see Token) per line on disc, so that unchanged lines don't need to be lexed again after reopening a document.
+ * Pass 1 results are addressed by the hash of the line text only.
+ * Pass 2 results depend on the lexer state at the start of the line, so they are addressed by the hash of the line text combined with the hash of the remainder/command stack of the previous line.
+ * Line handles within tokens are stored relative to the line they belong to.
+ *
+ * The cache file consists of a fixed header, two sorted index tables and a payload section.
+ * It is memory-mapped on open and entries are only decoded on lookup.
+ * The whole cache is invalid if the LatexParser (i.e. the set of known commands) differs from the one which was used to generate it.
+ */
+class LatexTokenCache
+{
+public:
+    LatexTokenCache();
+    ~LatexTokenCache();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+    bool matches(const LatexParser &lp) const;
+
+    bool restoreRawTokens(QDocumentLineHandle *dlh) const;
+    bool restoreLine(QDocumentLineHandle *dlh, int lineNr, TokenStack &stack, CommandStack &commandStack, bool &remainderChanged) const;
+
+    static bool save(const QString &fileName, const QList<QDocumentLineHandle *> &lines, const LatexParser &lp);
+    static quint64 fingerprint(const LatexParser &lp);
+
+private:
+    Q_DISABLE_COPY(LatexTokenCache)
+
+    const uchar *find(const uchar *index, quint32 count, quint64 key, quint32 &length) const;
+
+    QFile *m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    quint64 m_fingerprint;
+    quint32 m_rawCount;
+    quint32 m_lineCount;
+};
+
+#endif // Header_Latex_TokenCache
@@ -1,5 +1,6 @@
 #include "latextokens.h"
 #include "qdocument_p.h"
+#include <QReadWriteLock>
 
 const int MAKE_HASH_VA_GUARDIAN = 0xAFE235FA;
 
@@ -55,7 +56,7 @@ QDebug operator<<(QDebug dbg, Token tk) {
 	dbg << qPrintable("Token(\"" + tk.getText() + "\"){"
 					  + QString("type: %1, ").arg(Token::tokenTypeName(tk.type))
 					  + QString("subtype: %1, ").arg(Token::tokenTypeName(tk.subtype))
-					  + QString("arglevel: %1").arg(tk.argLevel)
+					  + QString("arglevel: %1").arg(int(tk.argLevel))
 					  + "}"
 					  );
 	return dbg;
@@ -316,6 +317,88 @@ bool Token::operator ==(const Token &v) const
            (this->start == v.start)  && (this->subtype == v.subtype);
 }
 
+namespace {
+// Largest id of an interned command name, limited by the width of Token::commandNameId (19 bits).
+// Names beyond that limit (more than half a million distinct names) are not stored, the token has no name then.
+const int MAX_COMMAND_NAME_ID = (1 << 19) - 1;
+const int NAME_CHUNK_BITS = 10;
+const int NAME_CHUNK_SIZE = 1 << NAME_CHUNK_BITS;
+
+/*!
+ * table of interned command names, index 0 is reserved for "no name"
+ * Names are stored in chunks which are never moved, and a name is written before its id is handed out and never changed afterwards.
+ * So names can be read without locking.
+ */
+struct CommandNameTable {
+	QReadWriteLock lock; ///< protects ids and count
+	QHash<QString, quint32> ids;
+	int count = 1;
+	bool overflowReported = false;
+	QAtomicPointer<QString> chunks[(MAX_COMMAND_NAME_ID >> NAME_CHUNK_BITS) + 1] = {};
+};
+
+CommandNameTable &commandNameTable()
+{
+	static CommandNameTable table;
+	return table;
+}
+}
+
+/*!
+ * \brief optional command name, e.g. env name for verbatim or cmd/key for key/val arguments
+ */
+QString Token::optionalCommandName() const
+{
+	if (commandNameId == 0)
+		return QString();
+	const QString *chunk = commandNameTable().chunks[commandNameId >> NAME_CHUNK_BITS].loadAcquire();
+	return chunk ? chunk[commandNameId & (NAME_CHUNK_SIZE - 1)] : QString();
+}
+
+/*!
+ * \brief set optional command name
+ * Names are interned, i.e. the token only stores an index into a table shared by all tokens.
+ * The table holds half a million distinct names, which is not reached in practice even with many user defined keys.
+ * Should it be full nevertheless, further names are not stored and a warning is issued, see MAX_COMMAND_NAME_ID.
+ */
+void Token::setOptionalCommandName(const QString &name)
+{
+	if (name.isEmpty()) {
+		commandNameId = 0;
+		return;
+	}
+	CommandNameTable &table = commandNameTable();
+	{
+		QReadLocker locker(&table.lock);
+		auto it = table.ids.constFind(name);
+		if (it != table.ids.constEnd()) {
+			commandNameId = it.value();
+			return;
+		}
+	}
+	QWriteLocker locker(&table.lock);
+	auto it = table.ids.constFind(name); // may have been added in the meantime
+	if (it != table.ids.constEnd()) {
+		commandNameId = it.value();
+		return;
+	}
+	if (table.count > MAX_COMMAND_NAME_ID) {
+		if (!table.overflowReported) {
+			table.overflowReported = true;
+			qWarning("Token: table of command names is full (%d names), further names are dropped", MAX_COMMAND_NAME_ID);
+		}
+		commandNameId = 0;
+		return;
+	}
+	quint32 id = quint32(table.count++);
+	QAtomicPointer<QString> &chunk = table.chunks[id >> NAME_CHUNK_BITS];
+	if (!chunk.loadRelaxed())
+		chunk.storeRelease(new QString[NAME_CHUNK_SIZE]);
+	chunk.loadRelaxed()[id & (NAME_CHUNK_SIZE - 1)] = name;
+	table.ids.insert(name, id);
+	commandNameId = id;
+}
+
 /*!
  * \brief returns the starting position of the inner part of the token
  * (currently only applies to all forms of braces)
@@ -19,7 +19,7 @@ class EnumsTokenType
     Q_ENUMS(TokenType)
 
 public:
-	enum TokenType {
+	enum TokenType : quint8 {
         none = 0, word, command, braces, bracket,
         squareBracket, openBrace, openBracket, openSquare, less,
         closeBrace, closeBracket, closeSquareBracket, greater, math,
@@ -35,6 +35,12 @@ public:
         overlayRegion, defXparseArg, defSpecialArg, _end = 255
 	};
 };
+#if QT_VERSION < QT_VERSION_CHECK(6,0,0)
+inline uint qHash(EnumsTokenType::TokenType key, uint seed = 0)
+{
+	return qHash(uint(key), seed);
+}
+#endif
 
 /*!
  * \brief repesent syntax information on text element
@@ -59,16 +65,27 @@ public:
  level=1                                       [label/none 8 3]
  \endverbatim
  The level is encoded via the level-property. The list is actually still linear.
+
+ Tokens are kept small and trivially copyable (24 bytes on 64 bit) as a document holds millions of them.
+ TokenList stores them contiguously. The optional command name is interned in a table shared by all tokens.
  */
 class Token : public EnumsTokenType
 {
 public:
-	Token(): start(-1), length(-1), level(-1), dlh(nullptr), type(none), subtype(none), argLevel(0) {}
+	Token(): start(-1), length(-1), dlh(nullptr), level(-1), type(none), subtype(none), argLevel(0), ignoreSpelling(false), commandNameId(0) {}
 	int start;
 	int length;
-	int level;
-	QString optionalCommandName;
 	QDocumentLineHandle *dlh;
+	qint16 level;
+	TokenType type;
+	/// subtype is used to determine the type of argument
+	TokenType subtype;
+	qint32 argLevel : 12; ///< number of argument (>0) or option (<0, =-numberOfOption), see MAX_ARG_LEVEL
+	quint32 ignoreSpelling : 1;
+private:
+	quint32 commandNameId : 19; ///< index of optional command name in shared name table (0: no name), see setOptionalCommandName()
+public:
+	static constexpr int MAX_ARG_LEVEL = 2047; ///< largest value of argLevel, also limits the run-away counter stored there
 
 	enum CommentType {
 		unknownComment = 0, todoComment, magicComment
@@ -76,11 +93,10 @@ public:
 
 	static QString tokenTypeName(TokenType t);
 
-	TokenType type;
-	/// subtype is used to determine the type of argument
-	TokenType subtype;
-    bool ignoreSpelling;
-	int argLevel; ///< number of argument (>0) or option (<0, =-numberOfOption)
+	QString optionalCommandName() const;
+	void setOptionalCommandName(const QString &name);
+	void setOptionalCommandName(const Token &other) { commandNameId = other.commandNameId; } ///< take over name of \a other without table lookup
+	bool hasOptionalCommandName() const { return commandNameId != 0; }
 	static const QHash<TokenType, int> leftDelimWidth;  ///< width of the left delimiter in the token (if applicable)
 	static const QHash<TokenType, int> rightDelimWidth;  ///< width of the right delimiter in the token (if applicable)
 	static QSet<TokenType> tkArg();
@@ -98,10 +114,11 @@ public:
 	QString getText() const;
 	QString getInnerText() const;
 };
+Q_DECLARE_TYPEINFO(Token, Q_MOVABLE_TYPE);
 QDebug operator<<(QDebug dbg, Token::TokenType tk);
 QDebug operator<<(QDebug dbg, Token tk);
 
-typedef QList<Token> TokenList;
+typedef QVector<Token> TokenList;
 typedef QStack<Token> TokenStack;
 
 Q_DECLARE_METATYPE(Token::TokenType);
@@ -0,0 +1,262 @@
+#include "misspellingindex.h"
+#include "qdocument.h"
+#include "qdocumentline_p.h"
+#include "smallUsefulFunctions.h"
+#include "spellerutility.h"
+#include <QtConcurrent>
+
+namespace {
+const int SWEEP_DELAY = 1500; ///< ms after the last change, gives the syntax check time to update the tokens first
+}
+
+SpellerManager *MisspellingIndex::spellerManager = nullptr;
+
+MisspellingIndex::MisspellingIndex(QDocument *doc, QObject *parent): QObject(parent), m_doc(doc), m_speller(nullptr)
+{
+	m_pool.setMaxThreadCount(1);
+	m_sweepTimer.setSingleShot(true);
+	m_sweepTimer.setInterval(SWEEP_DELAY);
+	connect(&m_sweepTimer, &QTimer::timeout, this, &MisspellingIndex::startSweep);
+	connect(&m_sweepWatcher, &QFutureWatcher<void>::finished, this, &MisspellingIndex::sweepDone);
+	connect(m_doc, &QDocument::contentsChanged, this, &MisspellingIndex::scheduleSweep);
+	connect(m_doc, &QDocument::lineRemoved, this, &MisspellingIndex::lineRemoved);
+	connect(m_doc, &QDocument::lineDeleted, this, &MisspellingIndex::lineRemoved);
+}
+
+MisspellingIndex::~MisspellingIndex()
+{
+	stopSweep();
+}
+
+void MisspellingIndex::setSpeller(SpellerUtility *speller)
+{
+	if (speller == m_speller)
+		return;
+	stopSweep();
+	if (m_speller)
+		disconnect(m_speller, &SpellerUtility::aboutToDelete, this, &MisspellingIndex::spellerDeleted);
+	m_speller = speller;
+	if (m_speller)
+		connect(m_speller, &SpellerUtility::aboutToDelete, this, &MisspellingIndex::spellerDeleted);
+	m_lock.lock();
+	m_lines.clear();
+	m_lock.unlock();
+	scheduleSweep();
+}
+
+void MisspellingIndex::setReplacementList(const QMap<QString, QString> &replacementList)
+{
+	if (replacementList == m_replacementList)
+		return;
+	stopSweep();
+	m_replacementList = replacementList;
+	m_lock.lock();
+	m_lines.clear();
+	m_lock.unlock();
+	scheduleSweep();
+}
+
+/*!
+ * \brief set the manager providing the default speller for documents without a speller
+ */
+void MisspellingIndex::setSpellerManager(SpellerManager *manager)
+{
+	spellerManager = manager;
+}
+
+/*!
+ * \brief spell checked words of the line which are misspelled, ordered by column
+ * Uses the stored result if the line is unchanged, otherwise the line is checked now.
+ */
+QList<MisspellingIndex::Misspelling> MisspellingIndex::lineMisspellings(QDocumentLineHandle *dlh)
+{
+	SpellerUtility *speller = currentSpeller();
+	if (!speller || !dlh)
+		return QList<Misspelling>();
+	if (isUpToDate(dlh, speller)) {
+		QMutexLocker locker(&m_lock);
+		QHash<QDocumentLineHandle *, LineEntry>::const_iterator it = m_lines.constFind(dlh);
+		if (it != m_lines.constEnd())
+			return it->misspellings;
+	}
+
+	LineEntry entry = checkLine(dlh, speller, m_replacementList);
+	QMutexLocker locker(&m_lock);
+	m_lines.insert(dlh, entry);
+	return entry.misspellings;
+}
+
+/*!
+ * \brief all misspelled words of the document with the lines containing them
+ */
+QMap<QString, QList<QDocumentLineHandle *> > MisspellingIndex::misspelledWords()
+{
+	QMap<QString, QList<QDocumentLineHandle *> > result;
+	for (int i = 0; i < m_doc->lines(); i++) {
+		QDocumentLineHandle *dlh = m_doc->line(i).handle();
+		foreach (const Misspelling &m, lineMisspellings(dlh)) {
+			QList<QDocumentLineHandle *> &lines = result[m.word];
+			if (lines.isEmpty() || lines.last() != dlh)
+				lines.append(dlh);
+		}
+	}
+	return result;
+}
+
+bool MisspellingIndex::isSweeping() const
+{
+	return m_sweepWatcher.isRunning() || m_sweepTimer.isActive();
+}
+
+/*!
+ * \brief tokens which are spell checked, same selection as in SpellerDialog
+ */
+bool MisspellingIndex::isSpellChecked(const Token &tk)
+{
+	if (tk.type != Token::word || tk.ignoreSpelling)
+		return false;
+	return tk.subtype == Token::text || tk.subtype == Token::title || tk.subtype == Token::shorttitle || tk.subtype == Token::todo || tk.subtype == Token::none;
+}
+
+void MisspellingIndex::scheduleSweep()
+{
+	if (m_speller)
+		m_sweepTimer.start();
+}
+
+void MisspellingIndex::startSweep()
+{
+	if (!m_speller)
+		return;
+	if (m_sweepWatcher.isRunning()) {
+		m_sweepTimer.start(); // try again after the running sweep
+		return;
+	}
+	releaseSweepLines();
+	m_sweepLines.reserve(m_doc->lines());
+	for (int i = 0; i < m_doc->lines(); i++) {
+		QDocumentLineHandle *dlh = m_doc->line(i).handle();
+		dlh->ref();
+		m_sweepLines.append(dlh);
+	}
+	m_stop.storeRelaxed(0);
+	m_sweepWatcher.setFuture(QtConcurrent::run(&m_pool, [this, speller = m_speller, replacementList = m_replacementList]() {
+		sweep(m_sweepLines, speller, replacementList);
+	}));
+}
+
+void MisspellingIndex::sweepDone()
+{
+	releaseSweepLines();
+	emit sweepFinished();
+}
+
+/*!
+ * \brief forget the entry of a line which was removed from the document
+ * If the line is reinserted (undo), it is checked again.
+ */
+void MisspellingIndex::lineRemoved(QDocumentLineHandle *dlh)
+{
+	QMutexLocker locker(&m_lock);
+	m_lines.remove(dlh);
+	if (!m_sweepLines.isEmpty())
+		m_removedLines.insert(dlh); // keeps the running sweep from adding it again
+}
+
+void MisspellingIndex::spellerDeleted()
+{
+	setSpeller(nullptr);
+}
+
+/*!
+ * \brief speller of the document, or the default speller if the document has none
+ */
+SpellerUtility *MisspellingIndex::currentSpeller()
+{
+	if (m_speller)
+		return m_speller;
+	SpellerUtility *speller = spellerManager ? spellerManager->getSpeller("<default>") : nullptr;
+	if (speller != m_defaultSpeller.data()) {
+		// entries of a deleted speller could be mistaken for entries of a new one at the same address
+		m_lock.lock();
+		m_lines.clear();
+		m_lock.unlock();
+		m_defaultSpeller = speller;
+	}
+	return speller;
+}
+
+void MisspellingIndex::stopSweep()
+{
+	m_sweepTimer.stop();
+	m_stop.storeRelaxed(1);
+	m_pool.waitForDone();
+	releaseSweepLines();
+}
+
+// may delete lines, so only called in the main thread
+void MisspellingIndex::releaseSweepLines()
+{
+	QVector<QDocumentLineHandle *> lines;
+	lines.swap(m_sweepLines);
+	m_lock.lock();
+	m_removedLines.clear();
+	m_lock.unlock();
+	foreach (QDocumentLineHandle *dlh, lines)
+		dlh->deref();
+}
+
+void MisspellingIndex::sweep(const QVector<QDocumentLineHandle *> &lines, SpellerUtility *speller, const QMap<QString, QString> &replacementList)
+{
+	foreach (QDocumentLineHandle *dlh, lines) {
+		if (m_stop.loadRelaxed())
+			return;
+		if (isUpToDate(dlh, speller))
+			continue;
+		LineEntry entry = checkLine(dlh, speller, replacementList);
+		QMutexLocker locker(&m_lock);
+		if (!m_removedLines.contains(dlh))
+			m_lines.insert(dlh, entry);
+	}
+}
+
+bool MisspellingIndex::isUpToDate(QDocumentLineHandle *dlh, SpellerUtility *speller) const
+{
+	int spellerGeneration = speller->checkGeneration();
+	dlh->lockForRead();
+	int ticket = dlh->getCurrentTicket();
+	int tokenRevision = dlh->getTokenRevision();
+	dlh->unlock();
+	QMutexLocker locker(&m_lock);
+	QHash<QDocumentLineHandle *, LineEntry>::const_iterator it = m_lines.constFind(dlh);
+	return it != m_lines.constEnd() && it->speller == speller && it->ticket == ticket && it->tokenRevision == tokenRevision && it->spellerGeneration == spellerGeneration;
+}
+
+MisspellingIndex::LineEntry MisspellingIndex::checkLine(QDocumentLineHandle *dlh, SpellerUtility *speller, const QMap<QString, QString> &replacementList)
+{
+	LineEntry entry;
+	entry.speller = speller;
+	// read the generation first, so that a change during the check makes the entry outdated
+	entry.spellerGeneration = speller->checkGeneration();
+	dlh->lockForRead();
+	entry.ticket = dlh->getCurrentTicket();
+	entry.tokenRevision = dlh->getTokenRevision();
+	QString text = dlh->text();
+	TokenList tl = dlh->getTokens();
+	dlh->unlock();
+
+	for (int i = 0; i < tl.length(); i++) {
+		const Token &tk = tl.at(i);
+		if (!isSpellChecked(tk))
+			continue;
+		QString word = latexToPlainWordwithReplacementList(text.mid(tk.start, tk.length), replacementList);
+		if (speller->check(word))
+			continue;
+		Misspelling m;
+		m.start = tk.start;
+		m.length = tk.length;
+		m.word = word;
+		entry.misspellings.append(m);
+	}
+	return entry;
+}
@@ -0,0 +1,91 @@
+#ifndef Header_MisspellingIndex
+#define Header_MisspellingIndex
+
+#include "mostQtHeaders.h"
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QThreadPool>
+
+class QDocument;
+class QDocumentLineHandle;
+class SpellerManager;
+class SpellerUtility;
+class Token;
+
+/*!
+ * \brief misspelled words of a document, maintained in a background thread
+ *
+ * For every line, the misspelled Token::word tokens are stored together with the line ticket, the token revision and the check generation of the speller.
+ * A line is only checked again if one of them has changed, i.e. if its text, its tokens (e.g. after the syntax check marked it as math) or the dictionary/ignore list changed.
+ * After changes of the document, a sweep in a background thread brings all lines up to date, so navigating to the next misspelling or listing all misspellings rarely needs to call the speller.
+ * Documents without a speller of their own (e.g. hidden documents of a project) are checked on request with the default speller, but are not swept.
+ */
+class MisspellingIndex : public QObject
+{
+	Q_OBJECT
+	friend class MisspellingIndexTest;
+
+public:
+	struct Misspelling {
+		int start;
+		int length;
+		QString word; ///< word as passed to the speller, i.e. without latex markup
+	};
+
+	explicit MisspellingIndex(QDocument *doc, QObject *parent = nullptr);
+	~MisspellingIndex();
+
+	void setSpeller(SpellerUtility *speller);
+	void setReplacementList(const QMap<QString, QString> &replacementList);
+	static void setSpellerManager(SpellerManager *manager);
+
+	QList<Misspelling> lineMisspellings(QDocumentLineHandle *dlh);
+	QMap<QString, QList<QDocumentLineHandle *> > misspelledWords();
+	bool isSweeping() const;
+
+	static bool isSpellChecked(const Token &tk);
+
+public slots:
+	void scheduleSweep();
+
+signals:
+	void sweepFinished();
+
+private slots:
+	void startSweep();
+	void sweepDone();
+	void lineRemoved(QDocumentLineHandle *dlh);
+	void spellerDeleted();
+
+private:
+	struct LineEntry {
+		SpellerUtility *speller; ///< only compared, may be deleted meanwhile
+		int ticket;
+		int tokenRevision;
+		int spellerGeneration;
+		QList<Misspelling> misspellings;
+	};
+
+	void stopSweep();
+	void releaseSweepLines();
+	void sweep(const QVector<QDocumentLineHandle *> &lines, SpellerUtility *speller, const QMap<QString, QString> &replacementList);
+	bool isUpToDate(QDocumentLineHandle *dlh, SpellerUtility *speller) const;
+	SpellerUtility *currentSpeller();
+	static LineEntry checkLine(QDocumentLineHandle *dlh, SpellerUtility *speller, const QMap<QString, QString> &replacementList);
+
+	QDocument *m_doc;
+	SpellerUtility *m_speller;
+	QPointer<SpellerUtility> m_defaultSpeller; ///< speller used if there is no m_speller
+	static SpellerManager *spellerManager;
+	QMap<QString, QString> m_replacementList;
+	mutable QMutex m_lock; ///< protects m_lines and m_removedLines
+	QHash<QDocumentLineHandle *, LineEntry> m_lines;
+	QSet<QDocumentLineHandle *> m_removedLines; ///< lines removed from the document during the running sweep, protected by m_lock
+	QThreadPool m_pool; ///< single background thread for sweeping
+	QFutureWatcher<void> m_sweepWatcher;
+	QVector<QDocumentLineHandle *> m_sweepLines; ///< lines of the running sweep, referenced until it is done
+	QTimer m_sweepTimer;
+	QAtomicInt m_stop;
+};
+
+#endif // Header_MisspellingIndex
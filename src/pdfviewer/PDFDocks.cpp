@@ -518,6 +518,11 @@ PDFBaseSearchDock::PDFBaseSearchDock(PDFDocument *doc): QDockWidget(doc), docume
 
 	gridLayout->addWidget(bPrevious, 0, 4, 1, 1);
 
+	lResultInfo = new QLabel(this);
+	lResultInfo->setObjectName(("lResultInfo"));
+
+	gridLayout->addWidget(lResultInfo, 0, 5, 1, 1);
+
 	QFrame *frame_6 = new QFrame(this);
 	sizePolicy1.setHeightForWidth(frame_6->sizePolicy().hasHeightForWidth());
 	frame_6->setSizePolicy(sizePolicy1);
@@ -571,6 +576,14 @@ bool PDFBaseSearchDock::hasFlagCaseSensitive() const
 	return cbCase->isChecked();
 }
 
+/*!
+ * \brief show the number of matches next to the search buttons
+ */
+void PDFBaseSearchDock::setResultInfo(const QString &info)
+{
+	lResultInfo->setText(info);
+}
+
 void PDFBaseSearchDock::setFocus()
 {
 	leFind->setFocus();
@@ -228,6 +228,7 @@ public:
 	QString getSearchText() const;
 	void setSearchText(QString text);
 	bool hasFlagCaseSensitive() const;
+	void setResultInfo(const QString &info);
 
 	virtual void setFocus();
 
@@ -253,6 +254,7 @@ private:
 	//QToolButton *bClose;
 	QLineEdit *leFind;
     QToolButton *bNext, *bPrevious;
+	QLabel *lResultInfo;
 	QCheckBox *cbCase;
 	/*QCheckBox *cbWords;
 	QCheckBox *cbRegExp;*/
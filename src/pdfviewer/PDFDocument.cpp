@@ -2874,7 +2874,7 @@ PDFScrollArea *PDFWidget::getScrollArea() const
 QList<PDFDocument *> PDFDocument::docList;
 
 PDFDocument::PDFDocument(PDFDocumentConfig *const pdfConfig, bool embedded)
-    : renderManager(nullptr), curFileSize(0), menubar(nullptr), exitFullscreen(nullptr), watcher(nullptr), reloadTimer(nullptr), dwClock(nullptr), dwOutline(nullptr), dwFonts(nullptr), dwInfo(nullptr), dwOverview(nullptr), dwSearch(nullptr),
+    : renderManager(nullptr), curFileSize(0), menubar(nullptr), exitFullscreen(nullptr), watcher(nullptr), reloadTimer(nullptr), dwClock(nullptr), dwOutline(nullptr), dwFonts(nullptr), dwInfo(nullptr), dwOverview(nullptr), dwSearch(nullptr), textIndex(nullptr), searchResultInfoTimer(nullptr),
       syncFromSourceBlocked(false), syncToSourceBlocked(false)
 {
     REQUIRE(pdfConfig);
@@ -3494,6 +3494,15 @@ void PDFDocument::init(bool embedded)
 		dw->hide();
     connect(dwSearch, SIGNAL(search(bool,bool)),  SLOT(search(bool,bool)));
     connect(dwSearch, SIGNAL(visibilityChanged(bool)),  SLOT(clearHightlight(bool)));
+
+	textIndex = new PDFTextIndex(this);
+	searchResultInfoTimer = new QTimer(this);
+	searchResultInfoTimer->setSingleShot(true);
+	searchResultInfoTimer->setInterval(250);
+	connect(searchResultInfoTimer, SIGNAL(timeout()), SLOT(updateSearchResultInfo()));
+	connect(textIndex, SIGNAL(pageIndexed(int)), SLOT(textIndexPageIndexed()));
+	connect(textIndex, SIGNAL(finished()), SLOT(updateSearchResultInfo()));
+	connect(textIndex, SIGNAL(counted()), SLOT(updateSearchResultInfo()));
 	addDockWidget(Qt::BottomDockWidgetArea, dw);
 	menuShow->addAction(dw->toggleViewAction());
 
@@ -3757,11 +3766,13 @@ retryNow:
 		}
 		pdfWidget->hide();
 		pdfWidget->setDocument(document, embeddedMode);
+		textIndex->setDocument(document, 0);
 		if (error == PDFRenderManager::FileIncomplete)
 			reloadWhenIdle();
 	} else {
 		pdfWidget->setDocument(document, embeddedMode);
 		pdfWidget->show();
+		textIndex->setDocument(document, renderManager->threadCount());
 
 		annotations = new PDFAnnotations(this);
 		annotationTable->setModel(annotations->createModel());
@@ -4079,6 +4090,37 @@ void PDFDocument::search(bool backwards, bool incremental)
 {
 	if (!dwSearch) return;
 	search(dwSearch->getSearchText(), backwards, incremental, dwSearch->hasFlagCaseSensitive(), dwSearch->hasFlagWholeWords(), dwSearch->hasFlagSync());
+	updateSearchResultInfo();
+}
+
+/*!
+ * \brief show the number of matches of the search dock text in the dock
+ * The matches are counted by the text index in the background. Until all pages are counted, the matches of the pages counted so far are shown.
+ */
+void PDFDocument::updateSearchResultInfo()
+{
+	if (!dwSearch || !textIndex) return;
+	searchResultInfoTimer->stop();
+	QString text = dwSearch->getSearchText();
+	if (text.isEmpty() || document.isNull() || !dwSearch->isVisible()) {
+		textIndex->setCountQuery(QString(), false, false);
+		dwSearch->setResultInfo(QString());
+		return;
+	}
+	textIndex->setCountQuery(text, dwSearch->hasFlagCaseSensitive(), dwSearch->hasFlagWholeWords());
+	int countedPages = 0;
+	int matches = textIndex->matchCount(&countedPages);
+	int pages = textIndex->pageCount();
+	if (countedPages < pages)
+		dwSearch->setResultInfo(tr("%1 matches in %2 of %3 pages").arg(matches).arg(countedPages).arg(pages));
+	else
+		dwSearch->setResultInfo(tr("%1 matches").arg(matches));
+}
+
+void PDFDocument::textIndexPageIndexed()
+{
+	if (dwSearch && dwSearch->isVisible() && !searchResultInfoTimer->isActive())
+		searchResultInfoTimer->start();
 }
 //better use flags for this
 void PDFDocument::search(const QString &searchText, bool backwards, bool incremental, bool caseSensitive, bool wholeWords, bool sync)
@@ -4153,19 +4195,33 @@ void PDFDocument::search(const QString &searchText, bool backwards, bool increme
 			if (pageIdx < 0 || pageIdx >= pdfWidget->realNumPages())
 				return;
 
-			statusBar()->showMessage(tr("Searching for") + QString(" '%1' (Page %2)").arg(searchText).arg(pageIdx+1), 1000);
-
-            std::unique_ptr<Poppler::Page> page(document->page(pageIdx));
-			if (!page)
-				return;
-
-			double rectLeft, rectTop, rectRight, rectBottom;
-			rectLeft = lastSearchResult.selRect.left();
-			rectTop = lastSearchResult.selRect.top();
-			rectRight = lastSearchResult.selRect.right();
-			rectBottom = lastSearchResult.selRect.bottom();
-			if (page->search(searchText, rectLeft, rectTop, rectRight, rectBottom , searchDir, searchFlags)) {
-			        lastSearchResult.selRect = QRectF(rectLeft, rectTop, rectRight - rectLeft, rectBottom - rectTop);
+			bool found = false;
+			if (textIndex->isIndexed(pageIdx)) {
+				QList<QRectF> matches = textIndex->search(pageIdx, searchText, caseSensitive, wholeWords);
+				int match = PDFTextIndex::nextMatch(matches, lastSearchResult.selRect, backwards);
+				if (match >= 0) {
+					lastSearchResult.selRect = matches.at(match);
+					found = true;
+				}
+			} else {
+				// page is not yet indexed
+				statusBar()->showMessage(tr("Searching for") + QString(" '%1' (Page %2)").arg(searchText).arg(pageIdx+1), 1000);
+
+				std::unique_ptr<Poppler::Page> page(document->page(pageIdx));
+				if (!page)
+					return;
+
+				double rectLeft, rectTop, rectRight, rectBottom;
+				rectLeft = lastSearchResult.selRect.left();
+				rectTop = lastSearchResult.selRect.top();
+				rectRight = lastSearchResult.selRect.right();
+				rectBottom = lastSearchResult.selRect.bottom();
+				if (page->search(searchText, rectLeft, rectTop, rectRight, rectBottom , searchDir, searchFlags)) {
+					lastSearchResult.selRect = QRectF(rectLeft, rectTop, rectRight - rectLeft, rectBottom - rectTop);
+					found = true;
+				}
+			}
+			if (found) {
 
 				lastSearchResult.doc = this;
 				lastSearchResult.pageIdx = pageIdx;
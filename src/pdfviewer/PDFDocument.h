@@ -42,6 +42,7 @@
 #include "qsynctex.h"
 
 #include "pdfrendermanager.h"
+#include "pdftextindex.h"
 
 
 const int kPDFWindowStateVersion = 1;
@@ -527,6 +528,8 @@ private slots:
 
 	void search(bool backward, bool incremental);
     void clearHightlight(bool visible);
+	void updateSearchResultInfo();
+	void textIndexPageIndexed();
 public:
 	void search(const QString &searchText, bool backward, bool incremental, bool caseSensitive, bool wholeWords, bool sync);
 	void search();
@@ -713,6 +716,8 @@ private:
 	bool wasShowToolBar;
 	bool wasFullScreen;
 	PDFSearchDock *dwSearch;
+	PDFTextIndex *textIndex;
+	QTimer *searchResultInfoTimer;
 
 	PDFSearchResult lastSearchResult;
 	// stores the page idx a search was started on
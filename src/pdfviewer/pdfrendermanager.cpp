@@ -134,6 +134,14 @@ void PDFRenderManager::setLoadStrategy(int strategy)
 	loadStrategy = strategy;
 }
 
+/*!
+ * \brief number of threads which render pages in parallel
+ */
+int PDFRenderManager::threadCount() const
+{
+	return queueAdministration->num_renderQueues;
+}
+
 class HiddenByteArray: public QByteArray
 {
 public:
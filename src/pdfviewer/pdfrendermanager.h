@@ -113,6 +113,7 @@ public:
 	void fillCache(int pg = -1);
 	qreal getResLimit();
 	void setLoadStrategy(int strategy);
+	int threadCount() const;
 
 public slots:
 	void addToCache(QImage img, int pageNr, int ticket);
@@ -0,0 +1,263 @@
+#ifndef NO_POPPLER_PREVIEW
+
+#include "pdftextindex.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+PDFTextIndex::PDFTextIndex(QObject *parent): QObject(parent), numPages(0), queryGeneration(0)
+{
+	query.caseSensitive = false;
+	query.wholeWords = false;
+	countPool.setMaxThreadCount(1);
+}
+
+PDFTextIndex::~PDFTextIndex()
+{
+	stop();
+}
+
+/*!
+ * \brief index all pages of doc
+ * The previous index is discarded.
+ * \param doc document, null to clear the index
+ * \param threadCount number of pages which are extracted in parallel
+ */
+void PDFTextIndex::setDocument(const QSharedPointer<Poppler::Document> &doc, int threadCount)
+{
+	stop();
+	lock.lock();
+	pages.clear();
+	pageMatches.clear();
+	numPages = doc.isNull() ? 0 : doc->numPages();
+	lock.unlock();
+	if (numPages <= 0)
+		return;
+
+	stopped.storeRelaxed(0);
+	nextPage.storeRelaxed(0);
+	int workerCount = qBound(1, threadCount, numPages);
+	pool.setMaxThreadCount(workerCount);
+	runningWorkers.storeRelaxed(workerCount);
+	for (int i = 0; i < workerCount; i++)
+		workers << QtConcurrent::run(&pool, [this, doc]() { extractPages(doc); });
+}
+
+bool PDFTextIndex::isIndexed(int page) const
+{
+	QMutexLocker locker(&lock);
+	return pages.contains(page);
+}
+
+int PDFTextIndex::indexedPageCount() const
+{
+	QMutexLocker locker(&lock);
+	return pages.size();
+}
+
+int PDFTextIndex::pageCount() const
+{
+	QMutexLocker locker(&lock);
+	return numPages;
+}
+
+/*!
+ * \brief bounding rectangles of all occurrences of text on an indexed page, in reading order
+ * Coordinates are in points, like the results of Poppler::Page::search.
+ */
+QList<QRectF> PDFTextIndex::search(int page, const QString &text, bool caseSensitive, bool wholeWords) const
+{
+	QMutexLocker locker(&lock);
+	QHash<int, PageText>::const_iterator it = pages.constFind(page);
+	if (it == pages.constEnd())
+		return QList<QRectF>();
+	PageText pt = *it;
+	locker.unlock();
+	return search(pt, text, caseSensitive, wholeWords);
+}
+
+/*!
+ * \brief count the occurrences of text on all indexed pages in a background thread
+ * Pages indexed later are counted by the extracting threads. Setting the current query again keeps its counts.
+ * \param text query, empty to stop counting
+ */
+void PDFTextIndex::setCountQuery(const QString &text, bool caseSensitive, bool wholeWords)
+{
+	QMutexLocker locker(&lock);
+	if (text == query.text && caseSensitive == query.caseSensitive && wholeWords == query.wholeWords)
+		return;
+	query.text = text;
+	query.caseSensitive = caseSensitive;
+	query.wholeWords = wholeWords;
+	pageMatches.clear();
+	int generation = ++queryGeneration;
+	locker.unlock();
+	if (!text.isEmpty())
+		QtConcurrent::run(&countPool, [this, generation]() { countPages(generation); });
+}
+
+/*!
+ * \brief number of occurrences of the count query on the pages counted so far
+ * \param countedPages returns the number of counted pages
+ */
+int PDFTextIndex::matchCount(int *countedPages) const
+{
+	QMutexLocker locker(&lock);
+	if (countedPages)
+		*countedPages = pageMatches.size();
+	int result = 0;
+	foreach (int matches, pageMatches)
+		result += matches;
+	return result;
+}
+
+/*!
+ * \brief find the match following/preceding a rectangle, like Poppler::Page::search with NextResult/PreviousResult
+ * \param matches result of search()
+ * \param from previous result, QRectF() to start at the top of the page, a rectangle below the page to start at the bottom
+ * \return index in matches, -1 if there is none
+ */
+int PDFTextIndex::nextMatch(const QList<QRectF> &matches, const QRectF &from, bool backwards)
+{
+	if (backwards) {
+		for (int i = matches.size() - 1; i >= 0; i--) {
+			const QRectF &m = matches.at(i);
+			bool sameLine = m.top() < from.bottom() && m.bottom() > from.top();
+			if (m.bottom() <= from.top() || (sameLine && m.left() < from.left()))
+				return i;
+		}
+	} else {
+		for (int i = 0; i < matches.size(); i++) {
+			const QRectF &m = matches.at(i);
+			bool sameLine = m.top() < from.bottom() && m.bottom() > from.top();
+			if (m.top() >= from.bottom() || (sameLine && m.left() > from.left()))
+				return i;
+		}
+	}
+	return -1;
+}
+
+void PDFTextIndex::stop()
+{
+	stopped.storeRelaxed(1);
+	lock.lock();
+	queryGeneration++; // abort counting
+	lock.unlock();
+	pool.waitForDone();
+	countPool.waitForDone();
+	workers.clear();
+}
+
+void PDFTextIndex::extractPages(const QSharedPointer<Poppler::Document> &doc)
+{
+	QThread::currentThread()->setPriority(QThread::LowPriority); // rendering is more important
+	const int count = doc->numPages();
+	for (int p = nextPage.fetchAndAddRelaxed(1); p < count && !stopped.loadRelaxed(); p = nextPage.fetchAndAddRelaxed(1)) {
+		PageText pt;
+		std::unique_ptr<Poppler::Page> page(doc->page(p));
+		if (page)
+			pt = extract(page.get());
+		lock.lock();
+		pages.insert(p, pt);
+		const Query q = query;
+		const int generation = queryGeneration;
+		lock.unlock();
+		if (!q.text.isEmpty()) {
+			int matches = search(pt, q.text, q.caseSensitive, q.wholeWords).size();
+			lock.lock();
+			if (generation == queryGeneration)
+				pageMatches.insert(p, matches);
+			lock.unlock();
+		}
+		emit pageIndexed(p);
+	}
+	if (runningWorkers.fetchAndAddRelaxed(-1) == 1 && !stopped.loadRelaxed())
+		emit finished();
+}
+
+/*!
+ * \brief count the query on the pages indexed so far, the extracting threads count the remaining ones
+ * \param generation queryGeneration of the query, counting stops if it changes
+ */
+void PDFTextIndex::countPages(int generation)
+{
+	lock.lock();
+	const QHash<int, PageText> indexed = pages;
+	const Query q = query;
+	bool current = generation == queryGeneration;
+	lock.unlock();
+	if (!current)
+		return;
+	for (QHash<int, PageText>::const_iterator it = indexed.constBegin(); it != indexed.constEnd(); ++it) {
+		int matches = search(it.value(), q.text, q.caseSensitive, q.wholeWords).size();
+		QMutexLocker locker(&lock);
+		if (generation != queryGeneration)
+			return;
+		pageMatches.insert(it.key(), matches);
+	}
+	emit counted();
+}
+
+PDFTextIndex::PageText PDFTextIndex::extract(Poppler::Page *page)
+{
+	PageText pt;
+	auto boxes = page->textList();
+	for (const auto &box : boxes) {
+		Word w;
+		w.start = pt.text.length();
+		const QString text = box->text();
+		w.length = text.length();
+		w.box = box->boundingBox();
+		pt.text += text;
+		for (int i = 0; i < text.length(); i++) {
+			QRectF charBox = box->charBoundingBox(i);
+			pt.charLeft << float(charBox.isNull() ? w.box.left() : charBox.left());
+		}
+		pt.words << w;
+		// line ends are treated as space, so that phrases spanning lines are found
+		if (box->hasSpaceAfter() || !box->nextWord()) {
+			pt.text += ' ';
+			pt.charLeft << float(w.box.right());
+		}
+	}
+#if QT_VERSION_MAJOR<6
+	qDeleteAll(boxes);
+#endif
+	return pt;
+}
+
+QList<QRectF> PDFTextIndex::search(const PageText &pt, const QString &text, bool caseSensitive, bool wholeWords)
+{
+	QList<QRectF> result;
+	if (text.isEmpty())
+		return result;
+	Qt::CaseSensitivity cs = caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+	for (int i = pt.text.indexOf(text, 0, cs); i >= 0; i = pt.text.indexOf(text, i + 1, cs)) {
+		int end = i + text.length();
+		if (wholeWords && ((i > 0 && pt.text.at(i - 1).isLetterOrNumber()) || (end < pt.text.length() && pt.text.at(end).isLetterOrNumber())))
+			continue;
+		QRectF r = pt.rect(i, end);
+		if (!r.isNull()) result << r;
+	}
+	return result;
+}
+
+/*!
+ * \brief bounding rectangle of the characters start..end-1
+ */
+QRectF PDFTextIndex::PageText::rect(int start, int end) const
+{
+	QRectF result;
+	// first word which ends after start
+	QVector<Word>::const_iterator it = std::upper_bound(words.constBegin(), words.constEnd(), start, [](int pos, const Word &w) {
+		return pos < w.start + w.length;
+	});
+	for (; it != words.constEnd() && it->start < end; ++it) {
+		QRectF r = it->box;
+		if (start > it->start) r.setLeft(charLeft.at(start));
+		if (end < it->start + it->length) r.setRight(charLeft.at(end));
+		result = result.isNull() ? r : result.united(r);
+	}
+	return result;
+}
+
+#endif
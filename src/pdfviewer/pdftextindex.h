@@ -0,0 +1,91 @@
+#ifndef Header_PDF_TextIndex
+#define Header_PDF_TextIndex
+
+#ifndef NO_POPPLER_PREVIEW
+
+#include "mostQtHeaders.h"
+
+#if QT_VERSION_MAJOR>5
+#include "poppler-qt6.h"
+#else
+#include "poppler-qt5.h"
+#endif
+
+#include <QFuture>
+#include <QMutex>
+#include <QThreadPool>
+
+/*!
+ * \brief text and word boxes of all pages of a pdf document
+ *
+ * The text is extracted in background threads after loading, so that searching does not need to ask poppler for every page.
+ * Pages are available for searching as soon as they are extracted.
+ * The matches of one query are counted in background threads as well, so that the search dock can show their number.
+ */
+class PDFTextIndex : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit PDFTextIndex(QObject *parent = nullptr);
+	~PDFTextIndex();
+
+	void setDocument(const QSharedPointer<Poppler::Document> &doc, int threadCount);
+
+	bool isIndexed(int page) const;
+	int indexedPageCount() const;
+	int pageCount() const;
+
+	QList<QRectF> search(int page, const QString &text, bool caseSensitive, bool wholeWords) const;
+	void setCountQuery(const QString &text, bool caseSensitive, bool wholeWords);
+	int matchCount(int *countedPages = nullptr) const;
+
+	static int nextMatch(const QList<QRectF> &matches, const QRectF &from, bool backwards);
+
+signals:
+	void pageIndexed(int page); ///< emitted in the extracting thread
+	void finished(); ///< emitted in the extracting thread
+	void counted(); ///< emitted in the counting thread after all pages indexed so far were counted
+
+private:
+	struct Word {
+		int start; ///< position in PageText::text
+		int length;
+		QRectF box;
+	};
+	struct PageText {
+		QString text; ///< words of the page, separated by a space if there is space between them in the pdf
+		QVector<Word> words;
+		QVector<float> charLeft; ///< left edge of every character of text
+		QRectF rect(int start, int end) const;
+	};
+
+	struct Query {
+		QString text;
+		bool caseSensitive;
+		bool wholeWords;
+	};
+
+	void stop();
+	void extractPages(const QSharedPointer<Poppler::Document> &doc);
+	void countPages(int generation);
+	static PageText extract(Poppler::Page *page);
+	static QList<QRectF> search(const PageText &pt, const QString &text, bool caseSensitive, bool wholeWords);
+
+	mutable QMutex lock; ///< protects pages, query, queryGeneration and pageMatches
+	QHash<int, PageText> pages;
+	int numPages;
+	Query query;
+	int queryGeneration; ///< changed whenever the counts in pageMatches are discarded
+	QHash<int, int> pageMatches; ///< number of matches of query per counted page
+	QThreadPool pool;
+	QThreadPool countPool;
+	QList<QFuture<void> > workers;
+	QAtomicInt nextPage;
+	QAtomicInt runningWorkers;
+	QAtomicInt stopped;
+};
+
+#endif
+
+#endif // Header_PDF_TextIndex
@@ -15,6 +15,7 @@ isEmpty(NO_POPPLER_PREVIEW) {
         $$PWD/PDFDocks.h \
         $$PWD/pdfrenderengine.h \
         $$PWD/pdfrendermanager.h \
+        $$PWD/pdftextindex.h \
         $$PWD/PDFDocument_config.h \
         $$PWD/pdfannotationdlg.h \
         $$PWD/pdfannotation.h \
@@ -25,6 +26,7 @@ isEmpty(NO_POPPLER_PREVIEW) {
         $$PWD/PDFDocks.cpp \
         $$PWD/pdfrenderengine.cpp \
         $$PWD/pdfrendermanager.cpp \
+        $$PWD/pdftextindex.cpp \
         $$PWD/pdfannotationdlg.cpp \
         $$PWD/pdfannotation.cpp \
         $$PWD/qsynctex.cpp
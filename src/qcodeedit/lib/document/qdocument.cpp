@@ -113,8 +113,14 @@ inline int ncolsToNextTabStop(int column,int tabstop){
 #include <QTextStream>
 #include <QTextLayout>
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QVarLengthArray>
 #include <QMessageBox>
+#include <limits>
+
+// documents with more lines wrap only the lines around the view synchronously, see QDocumentPrivate::setWidth()
+static const int lazyWrapLineCount = 2000;
 
 struct RenderRange
 {
@@ -324,6 +330,9 @@ void QDocument::applyHardLineWrap(const QList<QDocumentLineHandle*>& in_handles)
 			int lineNr = this->indexOf(dlh);
 			if (lineNr < 0) continue;
 
+			if (dlh->hasFlag(QDocumentLine::WrapPending))
+				m_impl->rewrapLine(lineNr);
+
 			QList<int> lineBreaks = dlh->getBreaks();
 			if (lineBreaks.isEmpty()) continue;
 
@@ -519,10 +528,26 @@ void QDocument::clearUndo()
 {
 	if ( m_impl )
 	{
-		m_impl->m_commands.clear();
+		m_impl->clearUndo();
 	}
 }
 
+/*!
+	\return estimated number of bytes the undo stack keeps in memory
+*/
+qint64 QDocument::undoMemoryUsage() const
+{
+	return m_impl ? m_impl->undoMemoryUsage() : 0;
+}
+
+/*!
+	\return number of bytes of undo history moved to a temporary file, \see setUndoMemoryLimit()
+*/
+qint64 QDocument::undoSpillSize() const
+{
+	return m_impl ? m_impl->m_undoSpill.size() : 0;
+}
+
 /*!
  * \brief give current state of undo-stack for debugging
  *
@@ -577,7 +602,7 @@ QString QDocument::text(int mode) const
 	if ( nextIndent < 0 )
 		nextIndent = 0;
 
-	foreach ( const QDocumentLineHandle *l, m_impl->m_lines )
+	for ( const QDocumentLineHandle *l : m_impl->m_lines )
 	{
 		int prevIndent = curIndent;
 		curIndent = nextIndent;
@@ -646,7 +671,7 @@ QStringList QDocument::textLines() const{
 	QStringList res;
 	if ( !m_impl || m_impl->m_lines.isEmpty() )
 		return res;
-	foreach ( const QDocumentLineHandle *l, m_impl->m_lines )
+	for ( const QDocumentLineHandle *l : m_impl->m_lines )
 		res << l->text();
 	return res;
 }
@@ -667,7 +692,21 @@ void QDocument::setText(const QString& s, bool allowUndo)
 		return;
 	}
 
-	int last = 0, idx = 0;
+	startChunkLoading();
+	addChunk(s);
+	stopChunkLoading();
+}
+
+/*!
+	\brief Start setting the content of the document piecewise
+
+	The current content is removed, the new content is added with addChunk()
+	and finalized with stopChunkLoading(), which also notifies about the changed content.
+*/
+void QDocument::startChunkLoading()
+{
+	if ( !m_impl )
+		return;
 
 	m_impl->m_deleting = true;
 
@@ -681,7 +720,7 @@ void QDocument::setText(const QString& s, bool allowUndo)
     }
 
 
-    foreach ( QDocumentLineHandle *h, m_impl->m_lines )
+    for ( QDocumentLineHandle *h : m_impl->m_lines )
 	{
 		h->m_doc = nullptr;
 		h->deref();
@@ -690,13 +729,15 @@ void QDocument::setText(const QString& s, bool allowUndo)
 	m_impl->discardAutoUpdatedCursors();
 
 	m_impl->m_lines.clear();
+	m_impl->invalidateLineIndex(0);
 	m_impl->m_marks.clear();
 	m_impl->m_status.clear();
 	m_impl->m_hidden.clear();
 	m_impl->m_wrapped.clear();
+	m_impl->invalidateVisualLineIndex();
 	m_impl->m_matches.clear();
 	m_impl->m_largest.clear();
-	m_impl->m_commands.clear();
+	m_impl->clearUndo();
 
 	m_impl->m_deleting = false;
 
@@ -704,9 +745,28 @@ void QDocument::setText(const QString& s, bool allowUndo)
 	m_impl->_dos = 0;
 	m_impl->_mac = 0;
 
+	m_leftOver.clear();
+}
+
+/*!
+	\brief Add a piece of text to the document
+
+	The text is split into lines directly, only an incomplete last line is kept until the next chunk arrives.
+	\see startChunkLoading()
+*/
+void QDocument::addChunk(const QString& c)
+{
+	if ( !m_impl || c.isEmpty() )
+		return;
+
+	const QString s = m_leftOver.isEmpty() ? c : m_leftOver + c;
+	int last = 0, idx = 0;
+
 	while ( idx < s.length() )
 	{
 		if ( s.at(idx) == '\r') {
+			if ( idx + 1 == s.length() )
+				break; // \r\n might be split between chunks
 			m_impl->m_lines << new QDocumentLineHandle(
 						s.mid(last, idx - last),
 						this
@@ -730,21 +790,33 @@ void QDocument::setText(const QString& s, bool allowUndo)
 		}
 	}
 
-	if ( idx != last )
+	m_leftOver = s.mid(last);
+}
+
+/*!
+	\brief Finish setting the content of the document piecewise
+	\see startChunkLoading()
+*/
+void QDocument::stopChunkLoading()
+{
+	if ( !m_impl )
+		return;
+
+	if ( m_leftOver.endsWith('\r') )
 	{
-		m_impl->m_lines << new QDocumentLineHandle(
-								s.mid(last, s.length() - last),
-								this
-							);
+		m_leftOver.chop(1);
+		m_impl->m_lines << new QDocumentLineHandle(m_leftOver, this);
+		++(m_impl->_mac);
+		m_leftOver.clear();
+	}
 
+	if ( !m_leftOver.isEmpty() )
+	{
+		m_impl->m_lines << new QDocumentLineHandle(m_leftOver, this);
+		m_leftOver.clear();
 	} else {
-		Q_ASSERT(s.isEmpty() || s.endsWith("\n") || s.endsWith("\r"));
 		m_impl->m_lines << new QDocumentLineHandle(this); //last character was \n, or empty string
 	}
-//
-//	if ( (idx > 0) && ((idx - 1) < s.length()) && ((s.at(idx - 1) == '\n') || (s.at(idx - 1) == '\r')) )
-//		m_impl->m_lines << new QDocumentLineHandle(this);
-//
 
 	//qDebug("[one go] dos : %i; nix : %i", m_impl->_dos, m_impl->_nix);
 
@@ -775,6 +847,9 @@ QTextCodec* guessEncoding(const QByteArray& data){
 
 /*!
  * \brief load text from file using codec
+ *
+ * The file is memory-mapped if possible and decoded in chunks which are split into lines immediately,
+ * so neither the raw data nor the complete decoded text are held in memory besides the document.
  * \param file
  * \param codec
  */
@@ -789,11 +864,24 @@ void QDocument::load(const QString& file, QTextCodec* codec){
 		return;
 	}
 
-    QByteArray d = f.readAll();
+	const qint64 size = f.size();
+	uchar *mapped = (size > 0 && size < std::numeric_limits<int>::max()) ? f.map(0, size) : nullptr;
+	QByteArray d = mapped ? QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), int(size)) : f.readAll();
     if (codec == nullptr)
         codec=guessEncoding(d);
 
-    setText(codec->toUnicode(d), false);
+	// the decoder keeps multi-byte sequences which are split between chunks
+	const int chunkSize = 1 << 20;
+	QScopedPointer<QTextDecoder> decoder(codec->makeDecoder());
+	startChunkLoading();
+	for (int pos = 0; pos < d.size(); pos += chunkSize) {
+		addChunk(decoder->toUnicode(d.constData() + pos, qMin(chunkSize, d.size() - pos)));
+	}
+	stopChunkLoading();
+
+	d.clear();
+	if (mapped)
+		f.unmap(mapped);
 
 	setCodecDirect(codec);
 	setLastModified(QFileInfo(file).lastModified());
@@ -1244,6 +1332,26 @@ void QDocument::setTabStop(int n)
 	}
 }
 
+/*!
+	\return memory limit of the undo stack of each document in bytes, 0 if unlimited
+*/
+qint64 QDocument::undoMemoryLimit()
+{
+	return QDocumentPrivate::m_undoMemoryLimit;
+}
+
+/*!
+	\brief Set the memory limit of the undo stack of each document
+
+	When the undo stack takes more memory, the text of the oldest commands is moved to a temporary file
+	and the caches of the lines they hold are released. The history itself is kept.
+	\param bytes limit, 0 for no limit
+*/
+void QDocument::setUndoMemoryLimit(qint64 bytes)
+{
+	QDocumentPrivate::m_undoMemoryLimit = bytes;
+}
+
 /*!
 	\return the whitesapce display mode
 */
@@ -1600,18 +1708,12 @@ QDocumentConstIterator QDocument::iterator(int ln) const
 
 /*!
 	\overload
-	\note If you can avoid using this method, do so unless performance really isn't an issue
 */
 QDocumentConstIterator QDocument::iterator(const QDocumentLine& l) const
 {
 	Q_ASSERT(m_impl);
 
-	QDocumentConstIterator it = begin(), e = end();
-
-	while ( (*it != l.handle()) && (it != e) )
-		++it;
-
-	return it;
+	return m_impl->index(l.handle());
 }
 
 /*!
@@ -1977,6 +2079,7 @@ void QDocument::correctFolding(int fromInc, int toInc, bool forceCorrection){
 	}
 	for (int i=0;i<blockStartList.size();i++)
         m_impl->m_hidden.insert(blockStartList[i].first,lines()-1-blockStartList[i].first);
+	m_impl->invalidateVisualLineIndex();
 
 	m_impl->setHeight();
 	//emitFormatsChange(line, count);
@@ -2174,11 +2277,13 @@ void QDocument::setOverwriteMode(bool overwrite)
 QDocumentLineHandle::QDocumentLineHandle(QDocument *d)
  : m_doc(d)
  , m_ref(1)
+ , m_lineIndex(-1)
  , m_indent(0)
  , m_state(QDocumentLine::LayoutDirty)
  , m_layout(nullptr)
  , lineHasSelection(QDocumentLineHandle::noSel)
  , mTicket(0)
+ , mTokenRevision(0)
 {
 
 }
@@ -2190,11 +2295,13 @@ QDocumentLineHandle::QDocumentLineHandle(const QString& s, QDocument *d)
  : m_text(s)
  , m_doc(d)
  , m_ref(1)
+ , m_lineIndex(-1)
  , m_indent(0)
  , m_state(QDocumentLine::LayoutDirty)
  , m_layout(nullptr)
  , lineHasSelection(QDocumentLineHandle::noSel)
  , mTicket(0)
+ , mTokenRevision(0)
 {
 
 }
@@ -2312,9 +2419,25 @@ QList<int> QDocumentLineHandle::getBreaks(){
 	return res;
 }
 
+/*!
+	\brief Release the composed formats and lexer results of a line which is only kept by the undo stack
+
+	Everything released is recomputed when the line is inserted into the document again, as after a text change.
+*/
+void QDocumentLineHandle::releaseCaches()
+{
+	lockForWriteText(); // clears the lexed states, so the line is lexed again on reinsertion
+	m_cache.clear();
+	m_cache.squeeze();
+	setFlag(QDocumentLine::FormatsApplied, false);
+	mLexerCookies = LexerCookies();
+	unlock();
+}
+
 void QDocumentLineHandle::updateWrap(int lineNr) const
 {
 	QReadLocker locker(&mLock);
+	setFlag(QDocumentLine::WrapPending, false);
 	m_indent = 0;
 	m_frontiers.clear();
 
@@ -2518,6 +2641,7 @@ void QDocumentLineHandle::updateWrapAndNotifyDocument(int line) const{
 
 	if ( lw ) m_doc->impl()->m_wrapped[line] = lw;
 	else m_doc->impl()->m_wrapped.remove(line);
+	m_doc->impl()->updateVisualLineIndex(line);
     m_doc->impl()->m_height += 1.*(lw-oldLW)*m_doc->impl()->m_lineSpacing;
 }
 
@@ -3137,6 +3261,17 @@ QVector<int> QDocumentLineHandle::getCachedFormats() const
  */
 QVariant QDocumentLineHandle::getCookie(int type) const
 {
+	if (isLexerCookie(type)) {
+		if (!(mLexerCookies.present & (1 << type)))
+			return QVariant();
+		switch (type) {
+		case QDocumentLine::LEXER_COOKIE: return QVariant::fromValue<TokenList>(mLexerCookies.tokens);
+		case QDocumentLine::LEXER_RAW_COOKIE: return QVariant::fromValue<TokenList>(mLexerCookies.rawTokens);
+		case QDocumentLine::LEXER_REMAINDER_COOKIE: return QVariant::fromValue<TokenStack>(mLexerCookies.remainder);
+		case QDocumentLine::LEXER_COMMANDSTACK_COOKIE: return QVariant::fromValue<CommandStack>(mLexerCookies.commandStack);
+		default: return QVariant::fromValue<QPair<int,int> >(mLexerCookies.commentStart);
+		}
+	}
 	return mCookies.value(type,QVariant());
 }
 
@@ -3150,7 +3285,7 @@ QVariant QDocumentLineHandle::getCookie(int type) const
 QVariant QDocumentLineHandle::getCookieLocked(int type) const
 {
 	QReadLocker locker(&mLock);
-	return mCookies.value(type,QVariant());
+	return getCookie(type);
 }
 
 /*!
@@ -3162,7 +3297,14 @@ QVariant QDocumentLineHandle::getCookieLocked(int type) const
  */
 void QDocumentLineHandle::setCookie(int type,QVariant data)
 {
-	mCookies.insert(type,data);
+	switch (type) {
+	case QDocumentLine::LEXER_COOKIE: setTokens(data.value<TokenList>()); break;
+	case QDocumentLine::LEXER_RAW_COOKIE: setTokens(data.value<TokenList>(), type); break;
+	case QDocumentLine::LEXER_REMAINDER_COOKIE: setRemainder(data.value<TokenStack>()); break;
+	case QDocumentLine::LEXER_COMMANDSTACK_COOKIE: setCommandStack(data.value<CommandStack>()); break;
+	case QDocumentLine::LEXER_COMMENTSTART_COOKIE: setCommentStart(data.value<QPair<int,int> >()); break;
+	default: mCookies.insert(type,data);
+	}
 }
 
 /*!
@@ -3175,6 +3317,8 @@ void QDocumentLineHandle::setCookie(int type,QVariant data)
  */
 bool QDocumentLineHandle::hasCookie(int type) const
 {
+	if (isLexerCookie(type))
+		return mLexerCookies.present & (1 << type);
 	return mCookies.contains(type);
 }
 
@@ -3189,9 +3333,126 @@ bool QDocumentLineHandle::hasCookie(int type) const
  */
 bool QDocumentLineHandle::removeCookie(int type)
 {
+	if (isLexerCookie(type)) {
+		bool present = mLexerCookies.present & (1 << type);
+		mLexerCookies.present &= ~(1 << type);
+		switch (type) {
+		case QDocumentLine::LEXER_COOKIE: mLexerCookies.tokens = TokenList(); mTokenRevision++; break;
+		case QDocumentLine::LEXER_RAW_COOKIE: mLexerCookies.rawTokens = TokenList(); break;
+		case QDocumentLine::LEXER_REMAINDER_COOKIE: mLexerCookies.remainder = TokenStack(); break;
+		case QDocumentLine::LEXER_COMMANDSTACK_COOKIE: mLexerCookies.commandStack = CommandStack(); break;
+		default: mLexerCookies.commentStart = QPair<int,int>();
+		}
+		return present;
+	}
 	return mCookies.remove(type);
 }
 
+bool QDocumentLineHandle::isLexerCookie(int type)
+{
+	return type >= QDocumentLine::LEXER_COOKIE && type <= QDocumentLine::LEXER_COMMENTSTART_COOKIE;
+}
+
+/*!
+ * \brief Returns the token list of the line (LEXER_COOKIE) or the result of the first lexer pass (LEXER_RAW_COOKIE).
+ * \details Like getCookie(), but without conversion to QVariant. The list is implicitly shared, i.e. not copied.
+ * Not thread safe. Caller must hold a read lock of the line.
+ * \param[in] type LEXER_COOKIE or LEXER_RAW_COOKIE
+ * \return Returns the tokens, an empty list if the cookie is not set.
+ */
+TokenList QDocumentLineHandle::getTokens(int type) const
+{
+	return type == QDocumentLine::LEXER_RAW_COOKIE ? mLexerCookies.rawTokens : mLexerCookies.tokens;
+}
+
+/*!
+ * \brief Returns the token list of the line.
+ * \details Thread safe version of getTokens().
+ */
+TokenList QDocumentLineHandle::getTokensLocked(int type) const
+{
+	QReadLocker locker(&mLock);
+	return getTokens(type);
+}
+
+/*!
+ * \brief Sets the token list of the line (LEXER_COOKIE) or the result of the first lexer pass (LEXER_RAW_COOKIE).
+ * \details Not thread safe. Caller must hold a write lock of the line.
+ */
+void QDocumentLineHandle::setTokens(TokenList tl, int type)
+{
+	mLexerCookies.present |= 1 << type;
+	if (type == QDocumentLine::LEXER_RAW_COOKIE) {
+		mLexerCookies.rawTokens = std::move(tl);
+	} else {
+		mLexerCookies.tokens = std::move(tl);
+		mTokenRevision++;
+	}
+}
+
+/*!
+ * \brief Returns the open tokens at the end of the line (LEXER_REMAINDER_COOKIE).
+ * \details Not thread safe. Caller must hold a read lock of the line.
+ */
+TokenStack QDocumentLineHandle::getRemainder() const
+{
+	return mLexerCookies.remainder;
+}
+
+TokenStack QDocumentLineHandle::getRemainderLocked() const
+{
+	QReadLocker locker(&mLock);
+	return mLexerCookies.remainder;
+}
+
+void QDocumentLineHandle::setRemainder(TokenStack stack)
+{
+	mLexerCookies.present |= 1 << QDocumentLine::LEXER_REMAINDER_COOKIE;
+	mLexerCookies.remainder = std::move(stack);
+}
+
+/*!
+ * \brief Returns the open commands at the end of the line (LEXER_COMMANDSTACK_COOKIE).
+ * \details Not thread safe. Caller must hold a read lock of the line.
+ */
+CommandStack QDocumentLineHandle::getCommandStack() const
+{
+	return mLexerCookies.commandStack;
+}
+
+CommandStack QDocumentLineHandle::getCommandStackLocked() const
+{
+	QReadLocker locker(&mLock);
+	return mLexerCookies.commandStack;
+}
+
+void QDocumentLineHandle::setCommandStack(CommandStack stack)
+{
+	mLexerCookies.present |= 1 << QDocumentLine::LEXER_COMMANDSTACK_COOKIE;
+	mLexerCookies.commandStack = std::move(stack);
+}
+
+/*!
+ * \brief Returns start column and type of the comment in the line (LEXER_COMMENTSTART_COOKIE).
+ * \details Not thread safe. Caller must hold a read lock of the line.
+ */
+QPair<int,int> QDocumentLineHandle::getCommentStart() const
+{
+	return mLexerCookies.commentStart;
+}
+
+QPair<int,int> QDocumentLineHandle::getCommentStartLocked() const
+{
+	QReadLocker locker(&mLock);
+	return mLexerCookies.commentStart;
+}
+
+void QDocumentLineHandle::setCommentStart(QPair<int,int> commentStart)
+{
+	mLexerCookies.present |= 1 << QDocumentLine::LEXER_COMMENTSTART_COOKIE;
+	mLexerCookies.commentStart = commentStart;
+}
+
 bool QDocumentLineHandle::isRTLByLayout() const{
 	if (!m_layout) return false;
 	else {
@@ -3457,6 +3718,7 @@ void QDocumentLineHandle::layout(int lineNr) const
 		if ( m_doc && lw != oldLW ) {
 			if ( lw ) m_doc->impl()->m_wrapped[lineNr] = lw;
 			else m_doc->impl()->m_wrapped.remove(lineNr);
+			m_doc->impl()->updateVisualLineIndex(lineNr);
             m_doc->impl()->m_height += 1.*(lw-oldLW)*m_doc->impl()->m_lineSpacing;
 		}
 	} else {
@@ -3789,6 +4051,7 @@ void QDocumentLineHandle::draw(int lineNr,	QPainter *p,
 
         qreal mergeXpos=-1;
         int mergeFormat=-1;
+        int mergeFont=-1;
 		QString mergeText;
 		foreach ( const RenderRange& r, ranges )
 		{
@@ -3799,7 +4062,7 @@ void QDocumentLineHandle::draw(int lineNr,	QPainter *p,
 				//flush mergedRange
 				if(mergeXpos>=0){
                     p->restore();
-                    p->drawText(QPointF(mergeXpos, ypos + QDocumentPrivate::m_ascent), mergeText);
+                    d->drawShapedText(p, this, mergeFont, mergeXpos, ypos, mergeText);
 					mergeXpos=-1;
 					mergeText.clear();
 				}
@@ -3859,7 +4122,7 @@ void QDocumentLineHandle::draw(int lineNr,	QPainter *p,
 			if(mergeXpos>=0 && (fmt&(~FORMAT_SPACE)) != (mergeFormat&(~FORMAT_SPACE))){
 				// flush
                 p->restore();
-                p->drawText(QPointF(mergeXpos, ypos + QDocumentPrivate::m_ascent), mergeText);
+                d->drawShapedText(p, this, mergeFont, mergeXpos, ypos, mergeText);
 				mergeXpos=-1;
 				mergeText.clear();
 			}
@@ -4049,6 +4312,7 @@ void QDocumentLineHandle::draw(int lineNr,	QPainter *p,
 					if(mergeXpos<0){
 						mergeXpos=xpos;
 						mergeFormat=fmt;
+						mergeFont=newFont;
 						p->save();
 					}
 					xpos += rwidth;
@@ -4217,7 +4481,7 @@ void QDocumentLineHandle::draw(int lineNr,	QPainter *p,
 		if(mergeXpos>=0){
 			//final flush
 			p->restore();
-            p->drawText(QPointF(mergeXpos, ypos + QDocumentPrivate::m_ascent), mergeText);
+            d->drawShapedText(p, this, mergeFont, mergeXpos, ypos, mergeText);
 		}
 
 		if (hasUnboundedSelection || wrapAroundHighlight) {
@@ -6445,6 +6709,8 @@ QVector<QFont> QDocumentPrivate::m_fonts;
 QList<QFontMetricsF> QDocumentPrivate::m_fontMetrics;
 
 int QDocumentPrivate::m_defaultTabStop = 4;
+qint64 QDocumentPrivate::m_undoMemoryLimit = 64 * 1024 * 1024;
+static const int undoMemoryCheckInterval = 64; ///< number of pushed commands after which the undo memory is measured again
 QFormatScheme* QDocumentPrivate::m_defaultFormatScheme = getStaticDefault<QFormatScheme>();
 
 QList<QDocumentPrivate*> QDocumentPrivate::m_documents;
@@ -6466,6 +6732,7 @@ QDocument::LineEnding QDocumentPrivate::m_defaultLineEnding = QDocument::Conserv
 
 QDocumentPrivate::QDocumentPrivate(QDocument *d)
  : 	m_doc(d),
+	m_undoPushesSinceCheck(0),
 	m_editCursor(nullptr),
 	m_drawCursorBold(true),
 	m_deleting(false),
@@ -6490,7 +6757,11 @@ QDocumentPrivate::QDocumentPrivate(QDocument *d)
 	m_lineCacheXOffset(0), m_lineCacheWidth(0),
 	m_instanceCachesLogicalDpiY(-1),
 	m_forceLineWrapCalculation(false),
-	m_overwrite(false)
+	m_wrapScanPos(-1), m_wrapScanRestarted(false), m_wrapScheduled(false),
+	m_lastDrawnLines(0, 0),
+	m_visualLineIndexValid(false),
+	m_overwrite(false),
+	m_lineIndexValid(0)
 {
 	m_documents << this;
 }
@@ -6503,7 +6774,7 @@ QDocumentPrivate::~QDocumentPrivate()
 	m_deleting = true;
 
 	//qDeleteAll(m_lines);
-	foreach ( QDocumentLineHandle *h, m_lines )
+	for ( QDocumentLineHandle *h : m_lines )
 		h->deref();
 
 	discardAutoUpdatedCursors(true);
@@ -6650,7 +6921,45 @@ void QDocumentPrivate::execute(QDocumentCommand *cmd)
 		m_macros.top()->addCommand(cmd);
 	} else {
 	m_commands.push(cmd);
+	if ( ++m_undoPushesSinceCheck >= undoMemoryCheckInterval )
+		checkUndoMemory();
+}
+}
+
+/*!
+	\brief Spill the oldest undo commands if the undo stack exceeds m_undoMemoryLimit
+
+	Commands are counted from the newest one, all commands which don't fit into the limit any more are spilled.
+	The newest command and the command before the current index are always kept in memory, as following
+	commands may be merged into them.
+*/
+void QDocumentPrivate::checkUndoMemory()
+{
+	m_undoPushesSinceCheck = 0;
+	qint64 usage = 0;
+	for ( int i = m_commands.count() - 1; i >= 0; --i )
+	{
+		QDocumentCommand *c = const_cast<QDocumentCommand*>(static_cast<const QDocumentCommand*>(m_commands.command(i)));
+		if ( m_undoMemoryLimit > 0 && usage > m_undoMemoryLimit && i < m_commands.count() - 1 && i != m_commands.index() - 1 )
+			c->spill(&m_undoSpill);
+		usage += c->memoryUsage();
+	}
+	emit m_doc->undoMemoryChanged(usage, m_undoSpill.size());
+}
+
+qint64 QDocumentPrivate::undoMemoryUsage() const
+{
+	qint64 usage = 0;
+	for ( int i = 0; i < m_commands.count(); ++i )
+		usage += static_cast<const QDocumentCommand*>(m_commands.command(i))->memoryUsage();
+	return usage;
 }
+
+void QDocumentPrivate::clearUndo()
+{
+	m_commands.clear();
+	m_undoSpill.clear();
+	m_undoPushesSinceCheck = 0;
 }
 
 void QDocumentPrivate::draw(QPainter *p, QDocument::PaintContext& cxt)
@@ -6668,6 +6977,9 @@ void QDocumentPrivate::draw(QPainter *p, QDocument::PaintContext& cxt)
     if ( fmod(cxt.height,m_lineSpacing)>0.1 )
 		++lastLine;
 
+	// keep the shaped text of about three screens, so that scrolling back and forth does not reshape lines
+	m_glyphRunCache.setMaxCost(qMax(256, 3 * (lastLine - firstLine + 1)));
+
 	QFormatScheme* scheme = m_formatScheme;
 	if (!scheme) scheme = QDocument::defaultFormatScheme();
 	if (!scheme) return;
@@ -6732,6 +7044,8 @@ void QDocumentPrivate::draw(QPainter *p, QDocument::PaintContext& cxt)
 	                                // leftPadding is still included, because here the background has to be drawn
 
 
+	const int firstDocLine = lcxt.docLineNr;
+	bool heightChanged = false;
 	for ( ; lcxt.editLineNr <= lastLine; ++lcxt.docLineNr )
 	{
 		if ( lcxt.docLineNr >= m_lines.count() )
@@ -6739,9 +7053,20 @@ void QDocumentPrivate::draw(QPainter *p, QDocument::PaintContext& cxt)
 			//qDebug("line %i not valid", i);
 			break;
 		}
+		QDocumentLineHandle *dlh = m_lines.at(lcxt.docLineNr);
+		if ( dlh->hasFlag(QDocumentLine::WrapPending) )
+		{
+			// the background wrapping has not reached this line yet
+			m_LineCache.remove(dlh);
+			if ( rewrapLine(lcxt.docLineNr) )
+				heightChanged = true;
+		}
         drawTextLine(p, cxt, lcxt);
 	}
+	m_lastDrawnLines = qMakePair(firstDocLine, lcxt.docLineNr - 1);
     p->translate(-m_leftMargin, 0);
+	if ( heightChanged )
+		setHeight();
 	//qDebug("painting done in %i ms...", t.elapsed());
 
 	drawPlaceholders(p, cxt);
@@ -7146,7 +7471,7 @@ int QDocumentPrivate::position(const QDocumentLineHandle *l) const
 {
 	int pos = 0;
 
-	int idx = m_lines.indexOf(const_cast<QDocumentLineHandle*>(l));
+	int idx = indexOf(l);
 
 	if ( idx == -1 )
 		return -1;
@@ -7215,6 +7540,9 @@ void QDocumentPrivate::setWidth(qreal width)
 		if ( oldConstraint && oldWidth < width && m_constrained )
 		{
 			// expand : simply remove old wraps if possible
+			const bool lazy = m_lines.count() > lazyWrapLineCount;
+			const int margin = qMax(100, m_lastDrawnLines.second - m_lastDrawnLines.first + 1);
+			bool pending = false;
 
 			QMap<int, int>::iterator it = m_wrapped.begin();
 
@@ -7222,6 +7550,15 @@ void QDocumentPrivate::setWidth(qreal width)
 			{
 				QDocumentLineHandle *h = it.key() < m_lines.count() ? m_lines.at(it.key()) : nullptr;
 
+				if ( h && lazy && (it.key() < m_lastDrawnLines.first - margin || it.key() > m_lastDrawnLines.second + margin) )
+				{
+					// far from the view, keep the old wrap until the background wrapping gets there
+					h->setFlag(QDocumentLine::WrapPending, true);
+					pending = true;
+					++it;
+					continue;
+				}
+
 				if ( h )
 					h->updateWrap(it.key());
 
@@ -7237,6 +7574,14 @@ void QDocumentPrivate::setWidth(qreal width)
 					it = m_wrapped.erase(it);
 				}
 			}
+			invalidateVisualLineIndex();
+
+			if ( pending )
+			{
+				m_wrapScanPos = qMin(m_lastDrawnLines.second + 1, m_lines.count());
+				m_wrapScanRestarted = false;
+				processPendingWrapsLater();
+			}
 		} else if ( oldWidth > width || m_forceLineWrapCalculation ) {
 			// shrink : scan whole document and create new wraps wherever needed
 			//qDebug("global width scan [constraint on]");
@@ -7246,6 +7591,7 @@ void QDocumentPrivate::setWidth(qreal width)
 	} else {
 		//qDebug("global width scan [constraint off]");
 		m_wrapped.clear();
+		invalidateVisualLineIndex();
 		setWidth();
 	}
 
@@ -7263,6 +7609,7 @@ void QDocumentPrivate::setWidth(qreal width)
 
 void QDocumentPrivate::removeWrap(int i){
 	m_wrapped.remove(i);
+	updateVisualLineIndex(i);
 }
 
 QList<int> QDocumentPrivate::testGetHiddenLines(){
@@ -7284,31 +7631,35 @@ void QDocumentPrivate::setWidth()
 	{
 		int first = -1;
 
-		for ( int i = 0; i < max; ++i )
+		// in large documents only the lines around the view are wrapped immediately,
+		// the others are marked and wrapped in the background (see processPendingWraps())
+		int syncFirst = 0, syncLast = max - 1;
+		if ( max > lazyWrapLineCount )
 		{
-			QDocumentLineHandle *l = m_lines.at(i);
-			int olw = l->m_frontiers.count();
-
-			l->updateWrap(i);
-
-			int lw = l->m_frontiers.count();
-
-			if ( olw == lw )
-				continue;
+			const int margin = qMax(100, m_lastDrawnLines.second - m_lastDrawnLines.first + 1);
+			syncFirst = qMax(0, m_lastDrawnLines.first - margin);
+			syncLast = qMin(max - 1, m_lastDrawnLines.second + margin);
+		}
 
-			if ( lw )
+		for ( int i = 0; i < max; ++i )
+		{
+			if ( i < syncFirst || i > syncLast )
 			{
-				//qDebug("added wrap on line %i", line);
-				m_wrapped[i] = lw;
-			} else {
-				//qDebug("removed wrap on line %i", line);
-				m_wrapped.remove(i);
+				m_lines.at(i)->setFlag(QDocumentLine::WrapPending, true);
+				continue;
 			}
 
-			if ( first == -1 )
+			if ( rewrapLine(i) && first == -1 )
 				first = i;
 		}
 
+		if ( syncFirst > 0 || syncLast < max - 1 )
+		{
+			m_wrapScanPos = syncLast + 1;
+			m_wrapScanRestarted = false;
+			processPendingWrapsLater();
+		}
+
 		if ( first != -1 && m_constrained )
 			emitFormatsChange(first, -1);
 	}
@@ -7317,7 +7668,7 @@ void QDocumentPrivate::setWidth()
 
 		m_width = 0;
 
-		foreach ( QDocumentLineHandle *l, m_lines )
+		for ( QDocumentLineHandle *l : m_lines )
 		{
 			if ( l->hasFlag(QDocumentLine::Hidden) )
 				continue;
@@ -7370,6 +7721,7 @@ void QDocumentPrivate::adjustWidth(int line, bool multiLine)
 				//qDebug("removed wrap on line %i", line);
 				m_wrapped.remove(line);
 			}
+			updateVisualLineIndex(line);
             if(!multiLine){
                 emitFormatsChange(line, -1);
                 setHeight();
@@ -7398,6 +7750,95 @@ void QDocumentPrivate::adjustWidth(int line, bool multiLine)
 	}
 }
 
+/*!
+	\brief Recompute the wrap of a line and update the wrap map
+
+	\return whether the number of visual lines of the line changed
+*/
+bool QDocumentPrivate::rewrapLine(int line)
+{
+	QDocumentLineHandle *l = m_lines.at(line);
+	int olw = l->m_frontiers.count();
+
+	l->updateWrap(line);
+
+	int lw = l->m_frontiers.count();
+
+	if ( olw == lw )
+		return false;
+
+	if ( lw )
+	{
+		//qDebug("added wrap on line %i", line);
+		m_wrapped[line] = lw;
+	} else {
+		//qDebug("removed wrap on line %i", line);
+		m_wrapped.remove(line);
+	}
+	updateVisualLineIndex(line);
+	return true;
+}
+
+/*!
+	\brief Wrap lines marked as WrapPending for a few milliseconds, then yield to the event loop
+
+	The scan starts below the view, continues to the end of the document and then
+	restarts at the top. Each line and its entry in m_wrapped are updated together,
+	so the wrap information stays consistent for cursor movement while the scan is
+	in progress, only possibly outdated for lines which have not been reached yet.
+*/
+void QDocumentPrivate::processPendingWraps()
+{
+	m_wrapScheduled = false;
+	if ( m_wrapScanPos < 0 )
+		return;
+
+	QElapsedTimer timer;
+	timer.start();
+	int first = -1;
+
+	while ( timer.elapsed() < 10 )
+	{
+		if ( m_wrapScanPos >= m_lines.count() )
+		{
+			if ( m_wrapScanRestarted )
+			{
+				m_wrapScanPos = -1;
+				break;
+			}
+			m_wrapScanRestarted = true;
+			m_wrapScanPos = 0;
+			continue;
+		}
+
+		const int i = m_wrapScanPos++;
+		QDocumentLineHandle *l = m_lines.at(i);
+		if ( !l->hasFlag(QDocumentLine::WrapPending) )
+			continue;
+
+		m_LineCache.remove(l);
+		if ( rewrapLine(i) && (first == -1 || i < first) )
+			first = i;
+	}
+
+	if ( first != -1 )
+	{
+		setHeight();
+		emitFormatsChange(first, -1);
+	}
+
+	if ( m_wrapScanPos >= 0 )
+		processPendingWrapsLater();
+}
+
+void QDocumentPrivate::processPendingWrapsLater()
+{
+	if ( m_wrapScheduled )
+		return;
+	m_wrapScheduled = true;
+	QTimer::singleShot(0, m_doc, [this]() { processPendingWraps(); });
+}
+
 void QDocumentPrivate::setHeight()
 {
     qreal oldHeight = m_height;
@@ -7683,6 +8124,52 @@ void QDocumentPrivate::drawText(QPainter& p, int fid, const QColor& baseColor, b
 	}
 }
 
+/*!
+ * Draws text of a single font at (xpos, ypos) (top of the line), like p->drawText() would.
+ * The shaped glyph runs are cached per line handle and reused as long as the line text is
+ * unchanged, so repainting a line (e.g. the current line or after a selection change) does
+ * not need to shape it again.
+ */
+void QDocumentPrivate::drawShapedText(QPainter *p, const QDocumentLineHandle *dlh, int fid, qreal xpos, qreal ypos, const QString& text){
+	if ( fid < 0 || fid >= m_fonts.size() || (m_workArounds & QDocument::DisableLineCache) ) {
+		p->drawText(QPointF(xpos, ypos + m_ascent), text);
+		return;
+	}
+
+	const int ticket = dlh->getCurrentTicket();
+	const int dpi = p->device() ? p->device()->logicalDpiY() : 0;
+	QDocumentLineGlyphRuns *cached = m_glyphRunCache.object(dlh);
+	if ( !cached || cached->ticket != ticket || cached->dpi != dpi || cached->texts.size() > 256 ) {
+		// different formats yield different splits of the text, so stale entries are dropped now and then
+		cached = new QDocumentLineGlyphRuns;
+		cached->ticket = ticket;
+		cached->dpi = dpi;
+		m_glyphRunCache.insert(dlh, cached);
+	}
+
+	const QPair<int, QString> key(fid, text);
+	QHash<QPair<int, QString>, QDocumentLineGlyphRuns::Shaped>::const_iterator it = cached->texts.constFind(key);
+	if ( it == cached->texts.constEnd() ) {
+		QTextLayout layout(text, m_fonts.at(fid), p->device());
+		QTextOption opt;
+		opt.setWrapMode(QTextOption::NoWrap);
+		layout.setTextOption(opt);
+		layout.beginLayout();
+		QTextLine line = layout.createLine();
+		layout.endLayout();
+
+		QDocumentLineGlyphRuns::Shaped shaped;
+		shaped.ascent = line.isValid() ? line.ascent() : m_ascent;
+		shaped.runs = layout.glyphRuns();
+		it = cached->texts.insert(key, shaped);
+	}
+
+	// glyph positions are relative to the top of the layout, align its baseline with the line baseline
+	const QPointF origin(xpos, ypos + m_ascent - it->ascent);
+	foreach ( const QGlyphRun& run, it->runs )
+		p->drawGlyphRun(origin, run);
+}
+
 void QDocumentPrivate::updateFormatCache(const QPaintDevice *pd)
 {
 	if ( !m_font )
@@ -7692,6 +8179,9 @@ void QDocumentPrivate::updateFormatCache(const QPaintDevice *pd)
 
 	m_fonts.clear();
 	m_fontMetrics.clear();
+	// cached glyph runs are keyed by font id, they are invalid once the fonts change
+	foreach ( QDocumentPrivate *d, m_documents )
+		d->m_glyphRunCache.clear();
 
 	if ( !m_formatScheme )
 	{
@@ -7793,17 +8283,24 @@ void QDocumentPrivate::insertLines(int after, const QList<QDocumentLineHandle*>&
 	++after;
 	updateHidden(after, l.count());
 	updateWrapped(after, l.count());
+	invalidateLineIndex(after);
+
+	QVector<QDocumentLineHandle*> handles;
+	handles.reserve(l.count());
 
 	while ( i < l.count() )
 	{
 		// TODO : move (and abstract somehow) inside the line (handle?)
 		l.at(i)->m_context.reset();
 
-		m_lines.insert(after + i, l.at(i));
+		handles << l.at(i);
 
 		++i;
 	}
 
+	m_lines.insert(after, handles);
+	insertVisualLines(after, l.count());
+
 	emit m_doc->lineCountChanged(m_lines.count());
 }
 
@@ -7898,6 +8395,8 @@ void QDocumentPrivate::removeLines(int after, int n)
 	}
     emit m_doc->linesRemoved(m_lines[after],after,n);
 	m_lines.remove(after, n);
+	invalidateLineIndex(after);
+	removeVisualLines(after, n);
 
 	emit m_doc->lineCountChanged(m_lines.count());
 	setHeight();
@@ -7907,25 +8406,53 @@ QDocumentLineHandle* QDocumentPrivate::at(int line) const
 {
 	return ((line >= 0) && (line < m_lines.count())) ? m_lines.at(line) : nullptr;
 }
-template <typename T> inline int hintedIndexOf (const QVector<T>& list, const T& elem, int hint) {
-	if (hint < 2) return list.indexOf(elem);
-	int backward = hint, forward = hint + 1;
-	for (;backward >= 0 && forward < list.size(); backward--, forward++) {
-		if (list[backward] == elem) return backward;
-		if (list[forward] == elem) return forward;
-	}
-	if (backward >= list.size()) backward = list.size() - 1;
-	for (;backward >= 0; backward--)
-		if (list[backward] == elem) return backward;
-	if (forward < 0) forward = 0;
-	for (;forward < list.size(); forward++)
-		if (list[forward] == elem) return forward;
+/*!
+	\internal
+	\brief Position of a line handle in the document, or -1 if it does not belong to it
+
+	Every handle remembers its last known position (m_lineIndex). The positions of all lines
+	before m_lineIndexValid are known to be correct, the others are renumbered lazily,
+	only as far as needed to find the requested line. Thus, mapping a handle to its line number
+	is O(1) for unchanged parts of the document and amortized O(1) after an edit, instead of
+	a linear search for every call.
+
+	\a hint is only kept for compatibility, the stored position is always checked first.
+*/
+int QDocumentPrivate::indexOf(const QDocumentLineHandle *l, int hint) const
+{
+	Q_UNUSED(hint)
+	if ( !l )
+		return -1;
+
+	int idx = l->m_lineIndex.loadAcquire();
+	if ( idx >= 0 && idx < m_lines.count() && m_lines.at(idx) == l )
+		return idx;
+
+	QMutexLocker locker(&m_lineIndexMutex);
+	// the stored position of lines before m_lineIndexValid is correct, so l can only be found after it
+	for ( QDocumentConstIterator it = m_lines.constBegin() + m_lineIndexValid, e = m_lines.constEnd(); it != e; ++it )
+	{
+		QDocumentLineHandle *h = *it;
+		h->m_lineIndex.storeRelease(it.lineNumber());
+		if ( h == l )
+		{
+			m_lineIndexValid = it.lineNumber() + 1;
+			return it.lineNumber();
+		}
+	}
+	m_lineIndexValid = m_lines.count();
 	return -1;
 }
 
-int QDocumentPrivate::indexOf(const QDocumentLineHandle *l, int hint) const
+/*!
+	\internal
+	\brief Mark stored line positions from \a line on as outdated, needs to be called whenever lines are inserted into or removed from m_lines
+*/
+void QDocumentPrivate::invalidateLineIndex(int line)
 {
-	return hintedIndexOf<QDocumentLineHandle*>(m_lines, const_cast<QDocumentLineHandle *>(l), hint);
+	QMutexLocker locker(&m_lineIndexMutex);
+	if ( line < m_lineIndexValid )
+		m_lineIndexValid = qMax(line, 0);
 }
 
 QDocumentIterator QDocumentPrivate::index(const QDocumentLineHandle *l)
@@ -7952,7 +8479,7 @@ QDocumentLineHandle* QDocumentPrivate::next(const QDocumentLineHandle *l) const
 		return m_lines.count() ? m_lines.first() : nullptr;
 	}
 
-	int idx = m_lines.indexOf(const_cast<QDocumentLineHandle*>(l));
+	int idx = indexOf(l);
 
 	return ((idx != -1) && ((idx + 1) < m_lines.count())) ? m_lines.at(idx + 1) : nullptr;
 }
@@ -7963,7 +8490,7 @@ QDocumentLineHandle* QDocumentPrivate::previous(const QDocumentLineHandle *l) co
 		return m_lines.count() ? m_lines.last() : nullptr;
 	}
 
-	int idx = m_lines.indexOf(const_cast<QDocumentLineHandle*>(l));
+	int idx = indexOf(l);
 
 	return (idx > 0) ? m_lines.at(idx - 1) : nullptr;
 }
@@ -8298,203 +8825,422 @@ void QDocumentPrivate::removeMark(QDocumentLineHandle *h, int mid)
 	emitMarkChanged(h, mid, false);
 }
 
-int QDocumentPrivate::visualLine(int textLine) const
+static void fenwickAdd(QVector<int>& tree, int i, int delta)
 {
-	if ( textLine < 0 )
-		return 0;
+	for ( ++i; i < tree.size(); i += i & -i )
+		tree[i] += delta;
+}
 
-	int hiddenLines = 0, wrappedLines = 0;
-	QMap<int, int>::const_iterator hit, wit, he, we;
-	hit = m_hidden.constBegin();
-	wit = m_wrapped.constBegin();
-	he = m_hidden.constEnd();
-	we = m_wrapped.constEnd();
+static int fenwickSum(const QVector<int>& tree, int n)
+{
+	int sum = 0;
+	for ( int i = n; i > 0; i -= i & -i )
+		sum += tree.at(i);
+	return sum;
+}
 
-	//qDebug("translating %i", visualLine);
+/*
+	\return the number of leading entries whose sum does not exceed value, value is reduced by that sum
+*/
+static int fenwickFind(const QVector<int>& tree, int& value)
+{
+	const int n = tree.size() - 1;
+	int step = 1;
+	while ( step * 2 <= n )
+		step *= 2;
 
-	while ( hit != he || wit != we )
+	int pos = 0;
+	for ( ; step > 0; step /= 2 )
 	{
-		if ( hit != he && (wit == we || hit.key() <= wit.key()) )
+		if ( pos + step <= n && tree.at(pos + step) <= value )
 		{
-			int hl = hit.key();
+			pos += step;
+			value -= tree.at(pos);
+		}
+	}
+	return pos;
+}
 
-			if ( hl >= textLine )
-				break;
+static void fenwickBuild(QVector<int>& tree)
+{
+	const int n = tree.size() - 1;
+	for ( int i = 1; i <= n; ++i )
+	{
+		const int parent = i + (i & -i);
+		if ( parent <= n )
+			tree[parent] += tree.at(i);
+	}
+}
 
-			int max = 0;
+void QDocumentVisualLineIndex::reset(const QVector<int>& counts)
+{
+	m_size = counts.size();
+	m_blocks.clear();
+	m_blocks.reserve(m_size / BlockSize + 1);
+	for ( int i = 0; i < m_size; i += BlockSize )
+	{
+		Block b;
+		b.counts = counts.mid(i, BlockSize);
+		b.total = 0;
+		foreach ( int c, b.counts )
+			b.total += c;
+		m_blocks << b;
+	}
+	rebuild();
+}
 
-			do
-			{
-				max = qMax(max, hit.key() - hl + *hit);
-				++hit;
-			} while ( (hit != he) && (hit.key() <= hl + max) );
+void QDocumentVisualLineIndex::rebuild()
+{
+	const int n = m_blocks.size();
+	m_lineTree.fill(0, n + 1);
+	m_countTree.fill(0, n + 1);
+	for ( int b = 0; b < n; ++b )
+	{
+		m_lineTree[b + 1] = m_blocks.at(b).counts.size();
+		m_countTree[b + 1] = m_blocks.at(b).total;
+	}
+	fenwickBuild(m_lineTree);
+	fenwickBuild(m_countTree);
+}
 
-			hiddenLines += max;
+/*!
+	\return the block containing the given text line (< size()), line becomes the offset in that block
+*/
+int QDocumentVisualLineIndex::locate(int& line) const
+{
+	return fenwickFind(m_lineTree, line);
+}
 
-			if ( wit != we && wit.key() == hl )
-			{
-				wrappedLines += *wit;
-				++wit;
-			}
+int QDocumentVisualLineIndex::count(int line) const
+{
+	const int b = locate(line);
+	return m_blocks.at(b).counts.at(line);
+}
 
-			while ( wit != we )
-			{
-				if ( wit.key() > hl + max )
-					break;
+int QDocumentVisualLineIndex::total() const
+{
+	return fenwickSum(m_countTree, m_blocks.size());
+}
 
-				++wit;
-			}
+void QDocumentVisualLineIndex::set(int line, int count)
+{
+	const int b = locate(line);
+	Block& block = m_blocks[b];
+	const int delta = count - block.counts.at(line);
+	if ( !delta )
+		return;
+	block.counts[line] = count;
+	block.total += delta;
+	fenwickAdd(m_countTree, b, delta);
+}
 
-		} else {
-			if ( wit.key() >= textLine )
-				break;
+/*!
+	\brief Set the counts of the text lines starting at line, with one tree update per block
+*/
+void QDocumentVisualLineIndex::set(int line, const QVector<int>& counts)
+{
+	int i = 0;
+	while ( i < counts.size() )
+	{
+		int offset = line + i;
+		const int b = locate(offset);
+		Block& block = m_blocks[b];
+		int delta = 0;
+		for ( ; i < counts.size() && offset < block.counts.size(); ++i, ++offset )
+		{
+			delta += counts.at(i) - block.counts.at(offset);
+			block.counts[offset] = counts.at(i);
+		}
+		if ( delta )
+		{
+			block.total += delta;
+			fenwickAdd(m_countTree, b, delta);
+		}
+	}
+}
 
-			if ( m_lines.at(wit.key())->hasFlag(QDocumentLine::Hidden) )
-			{
-				++wit;
-				continue;
-			}
+/*!
+	\brief Insert n text lines taking one visual line each before the given line
+*/
+void QDocumentVisualLineIndex::insert(int line, int n)
+{
+	if ( n <= 0 )
+		return;
 
-			wrappedLines += *wit;
-			++wit;
-		}
+	bool structureChanged = m_blocks.isEmpty();
+	if ( structureChanged )
+	{
+		Block b;
+		b.total = 0;
+		m_blocks << b;
 	}
 
-	//qDebug("translating %i => %i", textLine, textLine - hiddenLines + wrappedLines);
+	int b = m_blocks.size() - 1;
+	if ( line < m_size )
+		b = locate(line);
+	else
+		line = m_blocks.at(b).counts.size();
+
+	Block& block = m_blocks[b];
+	block.counts.insert(line, n, 1);
+	block.total += n;
+	m_size += n;
+
+	if ( block.counts.size() > 2 * BlockSize )
+	{
+		// split the block, the trees have to be rebuilt as the block indices change
+		QVector<Block> blocks = m_blocks.mid(0, b);
+		const QVector<int> counts = block.counts;
+		for ( int i = 0; i < counts.size(); i += BlockSize )
+		{
+			Block part;
+			part.counts = counts.mid(i, BlockSize);
+			part.total = 0;
+			foreach ( int c, part.counts )
+				part.total += c;
+			blocks << part;
+		}
+		blocks << m_blocks.mid(b + 1);
+		m_blocks = blocks;
+		structureChanged = true;
+	}
 
-	return textLine - hiddenLines + wrappedLines;
+	if ( structureChanged )
+	{
+		rebuild();
+	} else {
+		fenwickAdd(m_lineTree, b, n);
+		fenwickAdd(m_countTree, b, n);
+	}
 }
 
-int QDocumentPrivate::textLine(int visualLine, int *wrap) const
+/*!
+	\brief Remove n text lines starting at the given line
+*/
+void QDocumentVisualLineIndex::remove(int line, int n)
 {
-	if ( visualLine < 0 )
-		return 0;
-
-	int hiddenLines = 0, wrappedLines = 0, vis = 0, txt = 0, mess = 0;
-	QMap<int, int>::const_iterator
-		h = m_hidden.constBegin(),
-		w = m_wrapped.constBegin(),
-		he = m_hidden.constEnd(),
-		we = m_wrapped.constEnd();
+	n = qMin(n, m_size - line);
+	if ( n <= 0 )
+		return;
 
-	//qDebug("translating %i", visualLine);
+	bool emptied = false;
+	while ( n > 0 )
+	{
+		int offset = line;
+		const int b = locate(offset);
+		Block& block = m_blocks[b];
+		const int k = qMin(n, block.counts.size() - offset);
+		int removed = 0;
+		for ( int i = offset; i < offset + k; ++i )
+			removed += block.counts.at(i);
+		block.counts.remove(offset, k);
+		block.total -= removed;
+		fenwickAdd(m_lineTree, b, -k);
+		fenwickAdd(m_countTree, b, -removed);
+		emptied |= block.counts.isEmpty();
+		m_size -= k;
+		n -= k;
+	}
 
-	while ( vis < visualLine )
+	if ( emptied )
 	{
-		if ( h != he )
-		{
-			int hl = h.key();
+		for ( int b = m_blocks.size() - 1; b >= 0; --b )
+			if ( m_blocks.at(b).counts.isEmpty() )
+				m_blocks.remove(b);
+		rebuild();
+	}
+}
 
-			if ( w == we || hl <= w.key() )
-			{
-				if ( visualLine + mess <= hl )
-					break;
+/*!
+	\return the number of visual lines before the given text line
+*/
+int QDocumentVisualLineIndex::prefix(int line) const
+{
+	if ( line >= m_size )
+		return total();
 
-				if ( w != we && w.key() == hl )
-				{
-					//qDebug("trying to solve : h=(%i, %i), w=(%i, %i)", hl, *h, w.key(), *w);
-					const int off = (visualLine + mess) - hl;
-					if ( off <= *w )
-					{
-						//qDebug("%i -> %i + %i", visualLine, hl, off);
-						if ( wrap )
-							*wrap = off;
+	const int b = locate(line);
+	int sum = fenwickSum(m_countTree, b);
+	const QVector<int>& counts = m_blocks.at(b).counts;
+	for ( int i = 0; i < line; ++i )
+		sum += counts.at(i);
+	return sum;
+}
 
-						return hl;
-					}
-				}
+/*!
+	\return the text line containing the given visual line, size() if it is beyond the end
+*/
+int QDocumentVisualLineIndex::find(int visualLine) const
+{
+	const int b = fenwickFind(m_countTree, visualLine);
+	if ( b >= m_blocks.size() )
+		return m_size;
 
-				int max = 0;
+	const QVector<int>& counts = m_blocks.at(b).counts;
+	int i = 0;
+	while ( i < counts.size() && counts.at(i) <= visualLine )
+		visualLine -= counts.at(i++);
+	return fenwickSum(m_lineTree, b) + i;
+}
 
-				do
-				{
-					max = qMax(max, h.key() - hl + *h);
-					++h;
-				} while ( (h != he) && (h.key() <= hl + max) );
+/*!
+	\brief Rebuild the visual line index from m_wrapped and m_hidden, if it is outdated
 
-				// very important : do not forget possible wrapping on folded block start
-				if ( w != we && w.key() == hl )
-				{
-					wrappedLines += *w;
-					++w;
-				}
+	A text line takes one visual line plus its wraps, folded lines take none.
+*/
+void QDocumentPrivate::ensureVisualLineIndex() const
+{
+	const int n = m_lines.count();
+	if ( m_visualLineIndexValid && m_visualLineIndex.size() == n )
+		return;
 
-				while ( w != we )
-				{
-					if ( w.key() > txt + max )
-						break;
+	QVector<int> counts(n, 1);
 
-					++w;
-				}
+	for ( QMap<int, int>::const_iterator it = m_wrapped.constBegin(); it != m_wrapped.constEnd(); ++it )
+		if ( it.key() < n && !m_lines.at(it.key())->hasFlag(QDocumentLine::Hidden) )
+			counts[it.key()] += *it;
 
-				hiddenLines += max;
+	for ( QMap<int, int>::const_iterator it = m_hidden.constBegin(); it != m_hidden.constEnd(); ++it )
+		for ( int i = it.key() + 1; i <= it.key() + *it && i < n; ++i )
+			counts[i] = 0;
 
-			} else {
-				txt = w.key();
+	m_visualLineIndex.reset(counts);
+	m_visualLineIndexValid = true;
+}
 
-				if ( m_lines.at(txt)->hasFlag(QDocumentLine::Hidden) )
-				{
-					++w;
-					continue;
-				}
+/*!
+	\brief Update the visual line index after the wrap of a single line changed
+*/
+void QDocumentPrivate::updateVisualLineIndex(int line)
+{
+	if ( !m_visualLineIndexValid )
+		return;
 
-				if ( visualLine + mess < txt )
-					break;
+	if ( line < 0 || line >= m_visualLineIndex.size() || m_visualLineIndex.size() != m_lines.count() )
+	{
+		m_visualLineIndexValid = false;
+		return;
+	}
 
-				wrappedLines += *w;
-				++w;
-			}
-		} else if ( w != we ) {
-			txt = w.key();
+	if ( !m_visualLineIndex.count(line) )
+		return; // folded
 
-			if ( m_lines.at(txt)->hasFlag(QDocumentLine::Hidden) )
-			{
-				++w;
-				continue;
-			}
+	m_visualLineIndex.set(line, m_lines.at(line)->hasFlag(QDocumentLine::Hidden) ? 1 : 1 + m_wrapped.value(line));
+}
 
-			if ( visualLine + mess < txt )
-				break;
+/*!
+	\brief Recompute the visual line index for the text lines first to last and the folded blocks touching them
+*/
+void QDocumentPrivate::updateVisualLineIndex(int first, int last)
+{
+	if ( !m_visualLineIndexValid )
+		return;
 
-			wrappedLines += *w;
-			++w;
-		} else {
-			break;
+	if ( m_visualLineIndex.size() != m_lines.count() )
+	{
+		m_visualLineIndexValid = false;
+		return;
+	}
+
+	QMap<int, int>::const_iterator it = m_hidden.constBegin();
+
+	for ( ; it != m_hidden.constEnd() && it.key() <= last; ++it )
+	{
+		if ( it.key() + *it >= first )
+		{
+			first = qMin(first, it.key() + 1);
+			last = qMax(last, it.key() + *it);
 		}
+	}
+
+	first = qMax(first, 0);
+	last = qMin(last, m_lines.count() - 1);
+
+	if ( first > last )
+		return;
+
+	QVector<int> counts(last - first + 1, 1);
+
+	for ( it = m_wrapped.lowerBound(first); it != m_wrapped.constEnd() && it.key() <= last; ++it )
+		if ( !m_lines.at(it.key())->hasFlag(QDocumentLine::Hidden) )
+			counts[it.key() - first] += *it;
+
+	for ( it = m_hidden.constBegin(); it != m_hidden.constEnd() && it.key() < last; ++it )
+		for ( int i = qMax(it.key() + 1, first); i <= it.key() + *it && i <= last; ++i )
+			counts[i - first] = 0;
 
-		mess = hiddenLines - wrappedLines;
-		vis = txt - mess;
+	m_visualLineIndex.set(first, counts);
+}
+
+/*!
+	\brief Update the visual line index after count lines have been inserted before line
+*/
+void QDocumentPrivate::insertVisualLines(int line, int count)
+{
+	if ( !m_visualLineIndexValid )
+		return;
+
+	if ( m_visualLineIndex.size() + count != m_lines.count() )
+	{
+		m_visualLineIndexValid = false;
+		return;
 	}
 
-	we = m_wrapped.constBegin();
+	m_visualLineIndex.insert(line, count);
+	updateVisualLineIndex(line, line + count - 1);
+}
+
+/*!
+	\brief Update the visual line index after count lines have been removed at line
+*/
+void QDocumentPrivate::removeVisualLines(int line, int count)
+{
+	if ( !m_visualLineIndexValid )
+		return;
 
-	if ( m_wrapped.count() && w != we )
+	if ( m_visualLineIndex.size() - count != m_lines.count() )
 	{
-		--w;
+		m_visualLineIndexValid = false;
+		return;
+	}
 
-		int wl = w.key();
-		bool hwrap = m_lines.at(wl)->hasFlag(QDocumentLine::Hidden);
+	m_visualLineIndex.remove(line, count);
+	// folded blocks starting in the removed lines have been moved before them by updateHidden()
+	updateVisualLineIndex(line - count, line);
+}
 
-		if ( !hwrap )
-		{
-			int base = this->visualLine(wl);
+int QDocumentPrivate::visualLine(int textLine) const
+{
+	if ( textLine < 0 )
+		return 0;
 
-			if ( visualLine >= base && visualLine <= base + *w )
-			{
-				//qDebug("rebased : %i to %i", visualLine, base);
+	ensureVisualLineIndex();
 
-				if ( wrap )
-					*wrap = visualLine - base;
+	const int n = m_visualLineIndex.size();
 
-				return wl;
-			}
-		}
-	}
+	if ( textLine >= n )
+		return m_visualLineIndex.total() + textLine - n;
+
+	const int before = m_visualLineIndex.prefix(textLine);
 
-	//qDebug("[visual:text] : %i : %i", visualLine, visualLine + mess);
-	int off = visualLine + mess - (m_lines.count() - 1);
+	if ( m_visualLineIndex.count(textLine) )
+		return before;
 
-	if ( off > 0 )
+	// folded line: the whole folded block is already subtracted, i.e. the end of
+	// the block maps to the last visual line of the block start
+	const int blockEnd = m_visualLineIndex.find(before) - 1;
+
+	return before - 1 - (blockEnd - textLine);
+}
+
+int QDocumentPrivate::textLine(int visualLine, int *wrap) const
+{
+	if ( visualLine < 0 || m_lines.isEmpty() )
+		return 0;
+
+	ensureVisualLineIndex();
+
+	if ( visualLine >= m_visualLineIndex.total() )
 	{
 		if ( wrap )
 			*wrap = m_lines.last()->m_frontiers.count();
@@ -8502,12 +9248,19 @@ int QDocumentPrivate::textLine(int visualLine, int *wrap) const
 		return m_lines.count();
 	}
 
-	return visualLine + mess;
+	const int line = m_visualLineIndex.find(visualLine);
+
+	if ( wrap )
+		*wrap = visualLine - m_visualLineIndex.prefix(line);
+
+	return line;
 }
 
 void QDocumentPrivate::hideEvent(int line, int count)
 {
+	const int previous = m_hidden.value(line, 0);
     m_hidden.insert(line, count);
+	updateVisualLineIndex(line + 1, line + qMax(count, previous));
 
 	setHeight();
 	//emitFormatsChange(line, count);
@@ -8517,16 +9270,19 @@ void QDocumentPrivate::hideEvent(int line, int count)
 void QDocumentPrivate::showEvent(int line, int count)
 {
 	QMap<int, int>::iterator it = m_hidden.find(line);
+	int shown = 0;
 
 	while ( (it != m_hidden.end()) && (it.key() == line)  )
 	{
 		if ( *it == count  || count == -1)
 		{
 //			qDebug("showing %i lines from %i", count, line);
+			shown = qMax(shown, *it);
 			it = m_hidden.erase(it);
 		} else
 			++it;
 	}
+	updateVisualLineIndex(line + 1, line + shown);
 
 	setHeight();
 	//emitFormatsChange(line, count);
@@ -8551,6 +9307,10 @@ void QDocumentPrivate::updateHidden(int line, int count)
 		{
             m_hidden.insert(it.key(), *it);
 		} else {
+			// a folded block moved onto another one replaces it, this is not tracked incrementally
+			if ( m_hidden.contains(it.key() + count) )
+				invalidateVisualLineIndex();
+
             m_hidden.insert(it.key() + count, *it);
 		}
 
@@ -8560,6 +9320,10 @@ void QDocumentPrivate::updateHidden(int line, int count)
 
 void QDocumentPrivate::updateWrapped(int line, int count)
 {
+	// keep the background wrapping at the same line
+	if ( m_wrapScanPos >= line )
+		m_wrapScanPos = qMax(line, m_wrapScanPos + count);
+
     if ( m_wrapped.isEmpty() || (line > (--m_wrapped.constEnd()).key() ) )
 		return;
 
@@ -8624,7 +9388,7 @@ void QDocumentPrivate::emitContentsChange(int line, int lines)
 }
 
 void QDocumentPrivate::markFormatCacheDirty(){
-	foreach(QDocumentLineHandle *dlh,m_lines){
+	for(QDocumentLineHandle *dlh : m_lines){
 		dlh->setFlag(QDocumentLine::FormatsApplied,false);
 	}
 }
@@ -8698,18 +9462,22 @@ void QDocumentPrivate::emitContentsChanged()
 
 void QDocumentPrivate::emitLineDeleted(QDocumentLineHandle *h)
 {
+	// a new handle may be allocated at the same address, with the same ticket
+	m_glyphRunCache.remove(h);
+
 	if ( !m_deleting )
 	{
 		m_marks.remove(h);
 		m_status.remove(h);
 
-		int idx = m_lines.indexOf(h);
+		int idx = indexOf(h);
 
 		if ( idx != -1 )
 		{
 			//qDebug("removing line %i", idx);
 
 			m_lines.remove(idx);
+			invalidateLineIndex(idx);
 
 			if ( m_largest.count() && (m_largest.at(0).first == h) )
 			{
@@ -8719,6 +9487,9 @@ void QDocumentPrivate::emitLineDeleted(QDocumentLineHandle *h)
 
 			m_hidden.remove(idx);
 			m_wrapped.remove(idx);
+			updateHidden(idx + 1, -1);
+			updateWrapped(idx + 1, -1);
+			removeVisualLines(idx, 1);
 
 			setHeight();
 		}
@@ -38,6 +38,7 @@
 #include <QTextCodec>
 
 #include "qdocumentcursor.h"
+#include "qdocumentbuffer.h"
 
 class QRect;
 class QPrinter;
@@ -58,8 +59,8 @@ class QDocumentCommand;
 class QDocumentLineHandle;
 class QDocumentCursorHandle;
 
-typedef QVector<QDocumentLineHandle*>::iterator QDocumentIterator;
-typedef QVector<QDocumentLineHandle*>::const_iterator QDocumentConstIterator;
+typedef QDocumentBuffer::iterator QDocumentIterator;
+typedef QDocumentBuffer::const_iterator QDocumentConstIterator;
 
 template<typename T> class FastCache{
 public:
@@ -188,6 +189,10 @@ class QCE_EXPORT QDocument : public QObject
 
 		void load(const QString& file, QTextCodec* codec);
 
+		void startChunkLoading();
+		void addChunk(const QString& c);
+		void stopChunkLoading();
+
         enum SaveErrorCode
         {
             success,
@@ -328,6 +333,9 @@ class QCE_EXPORT QDocument : public QObject
 		static int tabStop();
 		static void setTabStop(int n);
 
+		static qint64 undoMemoryLimit();
+		static void setUndoMemoryLimit(qint64 bytes);
+
 		static WhiteSpaceMode showSpaces();
 		static void setShowSpaces(WhiteSpaceMode y);
 
@@ -386,6 +394,8 @@ class QCE_EXPORT QDocument : public QObject
 		void redo();
 
 		void clearUndo();
+		qint64 undoMemoryUsage() const;
+		qint64 undoSpillSize() const;
 		void setClean();
 
 		void highlight();
@@ -426,6 +436,8 @@ class QCE_EXPORT QDocument : public QObject
 		void slowOperationStarted();
 		void slowOperationEnded();
 
+		void undoMemoryChanged(qint64 inMemory, qint64 spilled);
+
         void bookmarkRemoved(QDocumentLineHandle *dlh);
         void bookmarkAdded(QDocumentLineHandle *dlh,int nr);
 	public:
@@ -37,6 +37,8 @@
 #include <QFontMetricsF>
 #include <QUndoCommand>
 #include <QCache>
+#include <QMutex>
+#include <QGlyphRun>
 
 class QDocument;
 class QDocumentBuffer;
@@ -49,9 +51,65 @@ class QLanguageDefinition;
 Q_DECLARE_TYPEINFO(QDocumentSelection, Q_PRIMITIVE_TYPE);
 
 #include "qdocumentline_p.h"
+#include "qdocumentcommand.h"
 
 #include "qdocumentcursor_p.h"
 
+/*! shaped text of one line, reused by QDocumentLineHandle::draw while the line text is unchanged
+ */
+struct QDocumentLineGlyphRuns
+{
+	struct Shaped {
+		QList<QGlyphRun> runs;
+		qreal ascent;
+	};
+
+	int ticket; // QDocumentLineHandle::getCurrentTicket() at creation
+	int dpi;
+	QHash<QPair<int, QString>, Shaped> texts; // keyed by font id and merged text
+};
+
+/*! Number of visual lines of each text line (0 for folded lines), used to convert between
+ *  text and visual lines in O(log n + BlockSize)
+ *
+ *  The counts are stored in blocks of about BlockSize lines, with Fenwick trees over the number
+ *  of lines and the number of visual lines of each block. Inserting or removing lines only
+ *  touches the blocks concerned, the trees are rebuilt when a block is split or emptied.
+ */
+class QDocumentVisualLineIndex
+{
+	public:
+		QDocumentVisualLineIndex() : m_size(0) {}
+
+		void reset(const QVector<int>& counts);
+		void set(int line, int count);
+		void set(int line, const QVector<int>& counts);
+		void insert(int line, int n);
+		void remove(int line, int n);
+
+		int size() const { return m_size; }
+		int count(int line) const;
+		int total() const;
+		int prefix(int line) const;
+		int find(int visualLine) const;
+
+	private:
+		enum { BlockSize = 128 };
+
+		struct Block
+		{
+			QVector<int> counts;
+			int total;
+		};
+
+		int locate(int& line) const;
+		void rebuild();
+
+		QVector<Block> m_blocks;
+		QVector<int> m_lineTree, m_countTree; // 1-based
+		int m_size;
+};
+
 class QCE_EXPORT QDocumentPrivate
 {
 	friend class QEditConfig;
@@ -84,6 +142,9 @@ class QCE_EXPORT QDocumentPrivate
 		~QDocumentPrivate();
 		
 		void execute(QDocumentCommand *cmd);
+		void checkUndoMemory();
+		qint64 undoMemoryUsage() const;
+		void clearUndo();
 		
 		void draw(QPainter *p, QDocument::PaintContext& cxt);
 		void drawTextLine(QPainter *p, QDocument::PaintContext &cxt, DrawTextLineContext &lcxt);
@@ -97,6 +158,7 @@ class QCE_EXPORT QDocumentPrivate
 		
 		QDocumentLineHandle* at(int line) const;
 		int indexOf(const QDocumentLineHandle *l, int hint = -1) const;
+		void invalidateLineIndex(int line);
 		
 		QDocumentIterator index(const QDocumentLineHandle *l);
 		QDocumentConstIterator index(const QDocumentLineHandle *l) const;
@@ -110,6 +172,9 @@ class QCE_EXPORT QDocumentPrivate
 		
 		void setWidth();
 		void setHeight();
+		bool rewrapLine(int line);
+		void processPendingWraps();
+		void processPendingWrapsLater();
 		
         static void setBaseFont(const QFont& f, bool forceUpdate = false);
         static void setFontSizeModifier(int m, bool forceUpdate = false);
@@ -156,6 +221,11 @@ public:
 		
 		int visualLine(int textLine) const;
 		int textLine(int visualLine, int *wrap = 0) const;
+		void invalidateVisualLineIndex() { m_visualLineIndexValid = false; }
+		void updateVisualLineIndex(int line);
+		void updateVisualLineIndex(int first, int last);
+		void insertVisualLines(int line, int count);
+		void removeVisualLines(int line, int count);
 		void hideEvent(int line, int count);
 		void showEvent(int line, int count);
 		
@@ -235,10 +305,13 @@ public:
         qreal textWidth(int fid, const QString& text);
         qreal getRenderRangeWidth(int &columnDelta, int curColumn, const RenderRange& r, const int newFont, const QString& text);
         void drawText(QPainter& p, int fid, const QColor& baseColor, bool selected, qreal &xpos, qreal baseline, const QString& text);
+        void drawShapedText(QPainter *p, const QDocumentLineHandle *dlh, int fid, qreal xpos, qreal ypos, const QString& text);
 		
 	private:
 		QDocument *m_doc;
 		QUndoStack m_commands;
+		int m_undoPushesSinceCheck;
+		QDocumentUndoSpill m_undoSpill;
 		QDocumentCursor *m_editCursor;
 		bool m_drawCursorBold;
 		
@@ -277,6 +350,7 @@ public:
 		
 		int m_tabStop;
 		static int m_defaultTabStop;
+		static qint64 m_undoMemoryLimit;
 
 		static double m_lineSpacingFactor;
         bool m_centerDocumentInEditor;
@@ -325,10 +399,11 @@ public:
 		QString m_fileName, m_name;
 		QFileInfo m_fileInfo; 
 
-		QVector<QDocumentLineHandle*> m_lines;
+		QDocumentBuffer m_lines;
 
         QCache<QDocumentLineHandle*,QImage> m_LineCacheAlternative;
         QCache<QDocumentLineHandle*,QPixmap> m_LineCache;
+        QCache<const QDocumentLineHandle*,QDocumentLineGlyphRuns> m_glyphRunCache;
         qreal m_lineCacheXOffset, m_lineCacheWidth;
 		int m_instanceCachesLogicalDpiY;
 
@@ -337,7 +412,18 @@ public:
 
 		bool m_forceLineWrapCalculation;
 
+		int m_wrapScanPos; // next line looked at by the background wrapping, -1 if it is idle
+		bool m_wrapScanRestarted, m_wrapScheduled;
+		QPair<int, int> m_lastDrawnLines;
+
+		void ensureVisualLineIndex() const;
+		mutable QDocumentVisualLineIndex m_visualLineIndex; // derived from m_wrapped and m_hidden
+		mutable bool m_visualLineIndexValid;
+
 		bool m_overwrite;
+
+		mutable int m_lineIndexValid; // stored positions of the line handles before this line are up to date
+		mutable QMutex m_lineIndexMutex;
 };
 
 #endif
@@ -15,6 +15,8 @@
 
 #include "qdocumentbuffer.h"
 
+#include <algorithm>
+
 /*
 	Notes on design :
 	
@@ -27,10 +29,16 @@
 	
 	for such a storage to be useful the block size may not be fixed but instead
 	must be kept around an "average" value.
+	
+	Every block knows the index of its first line. After a modification only the
+	start of the following blocks is updated, which is cheap as there are only
+	count / m_optimalSize blocks. Blocks that grow beyond m_forkThresold are split
+	into blocks of about m_optimalSize lines, blocks that shrink below
+	m_mergeThresold are merged with their neighbors. Empty blocks never exist.
 */
 
 QDocumentBuffer::QDocumentBuffer()
- : m_safetyRoom(10), m_optimalSize(1000), m_forkThresold(1500), m_mergeThresold(100)
+ : m_count(0), m_optimalSize(1000), m_forkThresold(1500), m_mergeThresold(100)
 {
 	
 }
@@ -40,334 +48,213 @@ QDocumentBuffer::~QDocumentBuffer()
 	qDeleteAll(m_blocks);
 }
 
-// for loading
-void QDocumentBuffer::appendLine(QDocumentLineHandle *l)
+/*!
+	\internal
+	\brief Find the block containing line \a index and the position of the line within it
+	
+	\a index == count() gives the position past the last line of the last block.
+*/
+void QDocumentBuffer::locate(int index, int& block, int& offset) const
 {
-	Block *b = m_blocks.last();
+	if ( m_blocks.isEmpty() )
+	{
+		block = 0;
+		offset = index;
+		return;
+	}
+	
+	int lo = 0, hi = m_blocks.count() - 1;
 	
-	if ( b->size() >= m_optimalSize )
+	while ( lo < hi )
 	{
-		b = new Block();
-		m_blocks << b;
+		int mid = (lo + hi + 1) / 2;
+		
+		if ( m_blocks.at(mid)->start <= index )
+			lo = mid;
+		else
+			hi = mid - 1;
 	}
 	
-	b->lines.append(l);
+	block = lo;
+	offset = index - m_blocks.at(lo)->start;
 }
 
-int QDocumentBuffer::blockForLine(int index) const
+QDocumentLineHandle* QDocumentBuffer::at(int index) const
 {
-	// TODO : binary search?
-	for ( int i = 0; i < m_blocks.count(); ++i )
-	{
-		if ( index < m_blocks.at(i)->end )
-			return i;
-	}
+	Q_ASSERT(index >= 0 && index < m_count);
+	
+	int block, offset;
+	locate(index, block, offset);
+	
+	return m_blocks.at(block)->lines.at(offset);
+}
+
+int QDocumentBuffer::indexOf(const QDocumentLineHandle *l, int from) const
+{
+	if ( from < 0 )
+		from = qMax(from + m_count, 0);
+	else if ( from >= m_count )
+		return -1;
+	
+	for ( const_iterator it = constBegin() + from, e = constEnd(); it != e; ++it )
+		if ( *it == l )
+			return it.lineNumber();
 	
-	// too high...
 	return -1;
 }
 
-QDocumentLineHandle* QDocumentBuffer::at(int index) const
+// for loading
+void QDocumentBuffer::append(QDocumentLineHandle *l)
 {
-	int blockIndex = blockForLine(index);
+	if ( m_blocks.isEmpty() || m_blocks.last()->size() >= m_optimalSize )
+		m_blocks << new Block(m_count);
 	
-	return blockIndex != -1 ? m_blocks.at(blockIndex)->at(index) : 0;
+	m_blocks.last()->lines.append(l);
+	++m_count;
 }
 
-void QDocumentBuffer::insertLine(int index, QDocumentLineHandle *l)
+void QDocumentBuffer::insert(int index, QDocumentLineHandle* const* l, int n)
 {
-	int blockIndex = blockForLine(index);
+	Q_ASSERT(index >= 0 && index <= m_count);
 	
-	if ( blockIndex == -1 )
-	{
-		qWarning("cannot insert line at pos %i", index);
+	if ( n <= 0 )
 		return;
-	}
+	
+	if ( m_blocks.isEmpty() )
+		m_blocks << new Block(0);
+	
+	int blockIndex, offset;
+	locate(index, blockIndex, offset);
 	
 	Block *b = m_blocks.at(blockIndex);
 	
-	if ( (b->size() + 1) >= m_forkThresold )
-	{
-		// split block
-		int bounds = b->start + m_optimalSize;
-		
-		Block *nb = new Block(bounds);
-		nb->insert(bounds, b->lines.constData() + m_optimalSize, b->size() - m_optimalSize);
-		nb->lines.append(l);
-		nb->end = bounds + nb->size();
-		m_blocks.insert(blockIndex + 1, nb);
-		
-		b->lines.resize(m_optimalSize);
-		b->end = bounds;
-		
-		blockIndex += 2;
-	} else {
-		b->insert(index, l);
-	}
+	b->lines.insert(offset, n, nullptr);
+	std::copy(l, l + n, b->lines.begin() + offset);
+	m_count += n;
 	
-	// update block boundaries
-	while ( blockIndex < m_blocks.count() )
-	{
-		b = m_blocks.at(blockIndex);
-		++b->start;
-		++b->end;
-	}
+	if ( b->size() > m_forkThresold )
+		split(blockIndex);
+	
+	updateStarts(blockIndex + 1);
 }
 
-void QDocumentBuffer::removeLine(int index)
+void QDocumentBuffer::remove(int index, int n)
 {
-	int blockIndex = blockForLine(index);
+	Q_ASSERT(index >= 0 && index + n <= m_count);
 	
-	if ( blockIndex == -1 )
-	{
-		qWarning("cannot remove line at pos %i", index);
+	if ( n <= 0 )
 		return;
-	}
 	
-	Block *b = m_blocks.at(blockIndex);
-	
-	b->remove(index);
-	--b->end;
+	int blockIndex, offset;
+	locate(index, blockIndex, offset);
 	
-	// if block too small, merge it with blocks around?
+	const int first = blockIndex;
 	
-	if ( !b->size() )
+	while ( n > 0 )
 	{
-		// remove empty block
-		m_blocks.remove(blockIndex);
-		delete b;
-	} else if ( b->size() < m_mergeThresold ) {
-		// "merge" block with its neighbors
-		
-		int n = b->size();
-		n += qMin(1, n / m_safetyRoom);
+		Block *b = m_blocks.at(blockIndex);
+		int k = qMin(n, b->size() - offset);
 		
-		int roomPrev = blockIndex ? m_forkThresold - m_blocks.at(blockIndex - 1)->size() : 0;
-		int roomNext = blockIndex + 1 < m_blocks.count() ? m_forkThresold - m_blocks.at(blockIndex + 1)->size() : 0;
-		
-		bool maxPrev = false;
-		int maxRoom = 0, minRoom = 0;
-		Block *moreRoom = 0, *lessRoom = 0;
-		
-		if ( roomPrev > roomNext )
+		if ( k == b->size() )
 		{
-			maxPrev = true;
-			maxRoom = roomPrev;
-			moreRoom = m_blocks.at(blockIndex - 1);
-			
-			minRoom = roomNext;
-			
-			if ( roomNext )
-				lessRoom = m_blocks.at(blockIndex + 1);
-		} else {
-			maxRoom = roomNext;
-			
-			if ( roomNext )
-				moreRoom = m_blocks.at(blockIndex + 1);
-			
-			minRoom = roomPrev;
-			
-			if ( roomPrev )
-				lessRoom = m_blocks.at(blockIndex - 1);
-		}
-		
-		if ( maxRoom > n )
-		{
-			// put everything in one
-			moreRoom->lines << b->lines;
-			moreRoom->end += b->size();
-			
-			m_blocks.remove(blockIndex);
-			delete b;
-		} else if ( (maxRoom + minRoom) > n ) {
-			// try to alloc evenly
-			int part = b->size() * maxRoom / (maxRoom + minRoom);
-			
-			if ( maxPrev )
-			{
-				moreRoom->append(b->lines.constData(), part);
-				lessRoom->prepend(b->lines.constData() + part, b->size() - part);
-			} else {
-				moreRoom->prepend(b->lines.constData(), part);
-				lessRoom->append(b->lines.constData() + part, b->size() - part);
-			}
-			
-			moreRoom->end += part;
-			lessRoom->end += b->size() - part;
-			
 			m_blocks.remove(blockIndex);
 			delete b;
 		} else {
-			// cannot merge simply... let's forget about it for now as it is not vital
+			b->lines.remove(offset, k);
 			++blockIndex;
 		}
-	} else {
-		++blockIndex;
+		
+		m_count -= k;
+		n -= k;
+		offset = 0;
 	}
 	
-	// update block boundaries
-	while ( blockIndex < m_blocks.count() )
-	{
-		b = m_blocks.at(blockIndex);
-		--b->start;
-		--b->end;
-	}
+	// only the blocks at both ends of the removed range may have become too small
+	merge(qMax(first - 1, 0), qMin(first + 1, m_blocks.count() - 1));
+	
+	updateStarts(qMax(first - 1, 0));
 }
 
-void QDocumentBuffer::insertLines(int after, const QVector<QDocumentLineHandle*>& l)
+void QDocumentBuffer::clear()
 {
-	int index = after + 1;
-	int blockIndex = blockForLine(index);
+	qDeleteAll(m_blocks);
+	m_blocks.clear();
+	m_count = 0;
+}
+
+/*!
+	\internal
+	\brief Split an oversized block into blocks of about m_optimalSize lines
 	
-	if ( blockIndex == -1 )
-	{
-		qWarning("cannot insert line at pos %i", index);
-		return;
-	}
+	Block starts need to be updated afterwards.
+*/
+void QDocumentBuffer::split(int block)
+{
+	Block *b = m_blocks.at(block);
 	
-	int n = l.count();
-	Block *b = m_blocks.at(blockIndex);
+	const int size = b->size();
+	const int parts = (size + m_optimalSize - 1) / m_optimalSize;
+	
+	m_blocks.insert(block + 1, parts - 1, nullptr);
 	
-	if ( (b->size() + 1) >= m_forkThresold )
+	for ( int i = 1; i < parts; ++i )
 	{
-		// split block
-		int bounds = b->start + m_optimalSize;
+		const int from = int(qint64(size) * i / parts), to = int(qint64(size) * (i + 1) / parts);
 		
-		Block *nb = new Block(bounds);
-		nb->insert(bounds, b->lines.constData() + m_optimalSize, b->size() - m_optimalSize);
-		nb->append(l.constData(), n);
-		nb->end = bounds + nb->size();
-		m_blocks.insert(blockIndex + 1, nb);
-		
-		b->lines.resize(m_optimalSize);
-		b->end = bounds;
-		
-		blockIndex += 2;
-	} else {
-		b->insert(index, l.constData(), n);
+		Block *nb = new Block(b->start + from);
+		nb->lines = b->lines.mid(from, to - from);
+		m_blocks[block + i] = nb;
 	}
 	
-	// update block boundaries
-	while ( blockIndex < m_blocks.count() )
-	{
-		b = m_blocks.at(blockIndex);
-		b->start += n;
-		b->end += n;
-	}
+	b->lines.resize(size / parts);
 }
 
-void QDocumentBuffer::removeLines(int after, int n)
-{
-	int index = after + 1;
-	int blockIndex = blockForLine(index);
-	
-	if ( blockIndex == -1 )
-	{
-		qWarning("cannot remove line at pos %i", index);
-		return;
-	}
+/*!
+	\internal
+	\brief Merge undersized blocks in the range [\a from, \a to] with their successor
 	
-	// update block boundaries
-	int count = n;
-	Block *b = m_blocks.at(blockIndex);
+	Block starts need to be updated afterwards.
+*/
+void QDocumentBuffer::merge(int from, int to)
+{
+	int i = from;
 	
-	while ( count > 0 )
+	while ( i < to && i + 1 < m_blocks.count() )
 	{
-		int room = b->end - index;
-		int toRem = qMin(room, count);
+		Block *b = m_blocks.at(i), *nb = m_blocks.at(i + 1);
 		
-		b->remove(index, toRem);
-		b->end -= toRem;
-		count -= toRem;
-		
-		if ( !b->size() )
+		if ( (b->size() < m_mergeThresold || nb->size() < m_mergeThresold) && (b->size() + nb->size() <= m_forkThresold) )
 		{
-			m_blocks.remove(blockIndex);
-			delete b;
+			b->lines += nb->lines;
+			m_blocks.remove(i + 1);
+			delete nb;
+			--to;
 		} else {
-			++blockIndex;
+			++i;
 		}
-		
-		if ( blockIndex >= m_blocks.count() )
-			break;
-		
-		b = m_blocks.at(blockIndex);
-		b->start -= toRem;
-	}
-	
-	if ( index )
-	{
-		qWarning("Troubles in line removal");
 	}
+}
+
+/*!
+	\internal
+	\brief Recompute the first line of all blocks starting at block \a from
+*/
+void QDocumentBuffer::updateStarts(int from)
+{
+	int start = 0;
 	
-	if ( b->size() < m_mergeThresold )
+	if ( from > 0 && from <= m_blocks.count() )
 	{
-		// "merge" block with its neighbors
-		
-		int sz = b->size();
-		sz += qMin(1, sz / m_safetyRoom);
-		
-		int roomPrev = blockIndex ? m_forkThresold - m_blocks.at(blockIndex - 1)->size() : 0;
-		int roomNext = blockIndex + 1 < m_blocks.count() ? m_forkThresold - m_blocks.at(blockIndex + 1)->size() : 0;
-		
-		bool maxPrev = false;
-		int maxRoom = 0, minRoom = 0;
-		Block *moreRoom = 0, *lessRoom = 0;
-		
-		if ( roomPrev > roomNext )
-		{
-			maxPrev = true;
-			maxRoom = roomPrev;
-			moreRoom = m_blocks.at(blockIndex - 1);
-			
-			minRoom = roomNext;
-			
-			if ( roomNext )
-				lessRoom = m_blocks.at(blockIndex + 1);
-		} else {
-			maxRoom = roomNext;
-			
-			if ( roomNext )
-				moreRoom = m_blocks.at(blockIndex + 1);
-			
-			minRoom = roomPrev;
-			
-			if ( roomPrev )
-				lessRoom = m_blocks.at(blockIndex - 1);
-		}
-		
-		if ( maxRoom > sz )
-		{
-			// put everything in one
-			moreRoom->lines << b->lines;
-			moreRoom->end += b->size();
-			
-			m_blocks.remove(blockIndex);
-			delete b;
-		} else if ( (maxRoom + minRoom) > sz ) {
-			// try to alloc evenly
-			int part = b->size() * maxRoom / (maxRoom + minRoom);
-			
-			moreRoom->append(b->lines.constData(), part);
-			moreRoom->end += part;
-			lessRoom->end += b->size() - part;
-			lessRoom->append(b->lines.constData() + part, b->size() - part);
-			
-			m_blocks.remove(blockIndex);
-			delete b;
-		} else {
-			// cannot merge simply... let's forget about it for now as it is not vital
-			++blockIndex;
-		}
+		const Block *prev = m_blocks.at(from - 1);
+		start = prev->start + prev->size();
 	} else {
-		++blockIndex;
+		from = 0;
 	}
 	
-	// update block boundaries
-	while ( blockIndex < m_blocks.count() )
+	for ( int i = from; i < m_blocks.count(); ++i )
 	{
-		b = m_blocks.at(blockIndex);
-		b->start -= n;
-		b->end -= n;
+		Block *b = m_blocks.at(i);
+		b->start = start;
+		start += b->size();
 	}
 }
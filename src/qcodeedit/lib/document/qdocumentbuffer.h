@@ -19,126 +19,140 @@
 #include "qce-config.h"
 
 #include <QVector>
-
-#include "qdocumentline_p.h"
+#include <iterator>
 
 class QDocumentLineHandle;
 
+/*!
+	\brief Line storage of a document
+
+	Lines are kept in a list of blocks whose size is kept around an optimal value.
+	Inserting or removing a range of lines only moves the lines of the blocks
+	touched and the (much shorter) list of blocks, instead of the whole document.
+	Lookup by index is a binary search over the blocks.
+
+	The buffer does not own the line handles, reference counting is left to
+	QDocumentPrivate.
+*/
 class QCE_EXPORT QDocumentBuffer
 {
-	friend class QDocumentLineHandle;
+	struct Block
+	{
+		inline Block(int line = 0) : start(line) {}
+		
+		inline int size() const { return lines.count(); }
+		
+		int start;
+		QVector<QDocumentLineHandle*> lines;
+	};
 	
 	public:
-		class iterator
+		template <typename Buffer>
+		class Iterator
 		{
+			friend class QDocumentBuffer;
+			template <typename> friend class Iterator;
+			
 			public:
-				iterator(const iterator& i);
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef int difference_type;
+				typedef QDocumentLineHandle* value_type;
+				typedef QDocumentLineHandle* const* pointer;
+				typedef QDocumentLineHandle* const& reference;
 				
-				bool atEnd() const;
+				inline Iterator() : m_buffer(nullptr), m_block(0), m_offset(0), m_line(0) {}
+				template <typename Other>
+				inline Iterator(const Iterator<Other>& i) : m_buffer(i.m_buffer), m_block(i.m_block), m_offset(i.m_offset), m_line(i.m_line) {}
 				
-				int lineNumber() const;
-				QDocumentLineHandle* lineHandle() const;
+				inline int lineNumber() const { return m_line; }
 				
-				void move(int numLines);
+				inline reference operator * () const { return m_buffer->m_blocks.at(m_block)->lines.at(m_offset); }
 				
-			protected:
-				iterator(QDocumentBuffer *buffer, int block, int line);
+				inline bool operator == (const Iterator& i) const { return m_line == i.m_line && m_buffer == i.m_buffer; }
+				inline bool operator != (const Iterator& i) const { return !(*this == i); }
+				
+				inline Iterator& operator ++ ()
+				{
+					++m_line;
+					if ( ++m_offset >= m_buffer->m_blocks.at(m_block)->size() && m_block + 1 < m_buffer->m_blocks.count() )
+					{
+						++m_block;
+						m_offset = 0;
+					}
+					return *this;
+				}
+				inline Iterator operator ++ (int) { Iterator i(*this); ++*this; return i; }
+				
+				inline Iterator& operator -- ()
+				{
+					--m_line;
+					if ( --m_offset < 0 && m_block > 0 )
+					{
+						--m_block;
+						m_offset = m_buffer->m_blocks.at(m_block)->size() - 1;
+					}
+					return *this;
+				}
+				inline Iterator operator -- (int) { Iterator i(*this); --*this; return i; }
+				
+				inline Iterator& operator += (int n) { m_line += n; m_buffer->locate(m_line, m_block, m_offset); return *this; }
+				inline Iterator& operator -= (int n) { return *this += -n; }
+				inline Iterator operator + (int n) const { Iterator i(*this); return i += n; }
+				inline Iterator operator - (int n) const { Iterator i(*this); return i += -n; }
+				inline int operator - (const Iterator& i) const { return m_line - i.m_line; }
 				
 			private:
+				inline Iterator(Buffer *buffer, int line) : m_buffer(buffer), m_block(0), m_offset(0), m_line(line) { buffer->locate(line, m_block, m_offset); }
+				
+				Buffer *m_buffer;
 				int m_block;
+				int m_offset;
 				int m_line;
-				QDocumentBuffer *m_buffer;
 		};
 		
+		typedef Iterator<QDocumentBuffer> iterator;
+		typedef Iterator<const QDocumentBuffer> const_iterator;
+		
 		QDocumentBuffer();
 		~QDocumentBuffer();
 		
+		inline int count() const { return m_count; }
+		inline int size() const { return m_count; }
+		inline bool isEmpty() const { return !m_count; }
+		
 		QDocumentLineHandle* at(int index) const;
+		inline QDocumentLineHandle* operator [] (int index) const { return at(index); }
+		inline QDocumentLineHandle* first() const { return m_blocks.first()->lines.first(); }
+		inline QDocumentLineHandle* last() const { return m_blocks.last()->lines.last(); }
 		
-		void appendLine(QDocumentLineHandle *l);
+		int indexOf(const QDocumentLineHandle *l, int from = 0) const;
 		
-		void insertLine(int index, QDocumentLineHandle *l);
-		void removeLine(int index);
+		void append(QDocumentLineHandle *l);
+		inline QDocumentBuffer& operator << (QDocumentLineHandle *l) { append(l); return *this; }
 		
-		void insertLines(int after, const QVector<QDocumentLineHandle*>& l);
-		void removeLines(int after, int n);
+		inline void insert(int index, QDocumentLineHandle *l) { insert(index, &l, 1); }
+		inline void insert(int index, const QVector<QDocumentLineHandle*>& l) { insert(index, l.constData(), l.count()); }
+		void insert(int index, QDocumentLineHandle* const* l, int n);
 		
-	private:
-		static void cleanHelper(QVector<QDocumentLineHandle*>& l)
-		{
-			foreach ( QDocumentLineHandle *h, l )
-				h->deref();
-		}
+		void remove(int index, int n = 1);
+		void clear();
 		
-		struct Block
-		{
-			inline Block() : start(-1), end(-1) {}
-			inline Block(int line) : start(line), end(line) {}
-			~Block() { cleanHelper(lines); }
-			
-			inline void move(int numLines) { start += numLines; end += numLines; }
-			
-			inline int size() const { return lines.count(); }
-			inline QDocumentLineHandle* at(int index) const { return lines.at(index - start); }
-			
-			inline void append(QDocumentLineHandle *h) { lines.append(h); }
-			inline void prepend(QDocumentLineHandle *h) { lines.prepend(h); }
-			inline void insert(int index, QDocumentLineHandle *h) { lines.insert(index - start, h); }
-			inline void insert(int index, const QDocumentLineHandle* const* l, int n)
-			{
-				QDocumentLineHandle **d = const_cast<QDocumentLineHandle**>(l);
-				
-				int i = index - start;
-				lines.insert(i, n, 0);
-				
-				while ( n )
-				{
-					lines[i++] = *d;
-					++d;
-					--n;
-				}
-			}
-			
-			inline void append(const QDocumentLineHandle* const* l, int n)
-			{
-				QDocumentLineHandle **d = const_cast<QDocumentLineHandle**>(l);
-				
-				int i = lines.count();
-				lines.insert(i, n, 0);
-				
-				while ( n )
-				{
-					lines[i++] = *d;
-					++d;
-					--n;
-				}
-			}
-			
-			inline void prepend(const QDocumentLineHandle* const* l, int n)
-			{
-				QDocumentLineHandle **d = const_cast<QDocumentLineHandle**>(l);
-				
-				int i = 0;
-				lines.insert(i, n, 0);
-				
-				while ( n )
-				{
-					lines[i++] = *d;
-					++d;
-					--n;
-				}
-			}
-			
-			inline void remove(int index) { lines.remove(index - start); }
-			inline void remove(int index, int count) { lines.remove(index - start, qMin(count, end - index)); }
-			
-			int start, end;
-			QVector<QDocumentLineHandle*> lines;
-		};
+		inline iterator begin() { return iterator(this, 0); }
+		inline iterator end() { return iterator(this, m_count); }
+		inline const_iterator begin() const { return const_iterator(this, 0); }
+		inline const_iterator end() const { return const_iterator(this, m_count); }
+		inline const_iterator constBegin() const { return const_iterator(this, 0); }
+		inline const_iterator constEnd() const { return const_iterator(this, m_count); }
+		
+	private:
+		Q_DISABLE_COPY(QDocumentBuffer)
 		
-		int blockForLine(int index) const;
+		void locate(int index, int& block, int& offset) const;
+		void split(int block);
+		void merge(int from, int to);
+		void updateStarts(int from);
 		
-		int m_safetyRoom;
+		int m_count;
 		int m_optimalSize;
 		int m_forkThresold;
 		int m_mergeThresold;
@@ -24,6 +24,9 @@
 
 #include "stdint.h"
 
+#include <QTemporaryFile>
+#include <QDataStream>
+
 /*!
 	\ingroup document
 	@{
@@ -41,7 +44,7 @@
 QDocumentCommand::QDocumentCommand(Command c, QDocument *d, QDocumentCommand *p)
  : QUndoCommand(p),
 	m_state(false), m_first(true), m_doc(d),
-	m_redoOffset(0), m_undoOffset(0),
+	m_redoOffset(0), m_undoOffset(0), m_spillOffset(-1), m_spillCopy(-1),
     m_silent(false), m_keepAnchor(false), m_command(c), m_cursor(nullptr)
 {
 
@@ -182,6 +185,78 @@ void QDocumentCommand::setUndoOffset(int off)
 	m_undoOffset = off;
 }
 
+/*!
+	\return estimated number of bytes the command keeps in memory
+*/
+qint64 QDocumentCommand::memoryUsage() const
+{
+	return sizeof(*this);
+}
+
+/*!
+	\brief Move the text of the command to the undo spill file and release cached data of the lines it holds
+
+	The text is read back on the next undo() or redo(). The base implementation does nothing.
+*/
+void QDocumentCommand::spill(QDocumentUndoSpill *spill)
+{
+	Q_UNUSED(spill)
+}
+
+qint64 QDocumentCommand::textMemoryUsage(const TextCommandData& data) const
+{
+	qint64 usage = sizeof(QDocumentLineHandle*) * data.handles.count();
+	if ( m_spillOffset < 0 )
+		usage += sizeof(QChar) * (data.begin.size() + data.end.size());
+	if ( !m_state )
+	{
+		// the lines are not part of the document, so they are only kept alive by the undo stack
+		foreach ( QDocumentLineHandle *h, data.handles )
+			usage += sizeof(QDocumentLineHandle) + h->count() * (sizeof(QChar) + sizeof(int));
+	}
+	return usage;
+}
+
+void QDocumentCommand::spillText(QDocumentUndoSpill *spill, TextCommandData& data)
+{
+	if ( !m_state )
+	{
+		foreach ( QDocumentLineHandle *h, data.handles )
+			h->releaseCaches();
+	}
+	if ( m_spillOffset >= 0 || (data.begin.isEmpty() && data.end.isEmpty()) )
+		return;
+	qint64 offset = m_spillCopy;
+	if ( offset < 0 )
+		offset = spill->write(data.begin, data.end);
+	if ( offset < 0 )
+		return;
+	m_spillOffset = offset;
+	m_spillCopy = -1;
+	data.begin = QString();
+	data.end = QString();
+}
+
+void QDocumentCommand::restoreText(TextCommandData& data)
+{
+	if ( m_spillOffset < 0 )
+		return;
+	if ( m_doc->impl()->m_undoSpill.read(m_spillOffset, data.begin, data.end) )
+		m_spillCopy = m_spillOffset;
+	else
+		qWarning("QDocumentCommand: could not read undo text back from the spill file");
+	m_spillOffset = -1;
+}
+
+/*!
+	\brief Read the text back before it is modified, the copy in the spill file becomes outdated
+*/
+void QDocumentCommand::detachText(TextCommandData& data)
+{
+	restoreText(data);
+	m_spillCopy = -1;
+}
+
 /*!
 	\brief Insert some text
 	\param line target line
@@ -584,12 +659,14 @@ QDocumentInsertCommand::~QDocumentInsertCommand()
 bool QDocumentInsertCommand::mergeWith(const QUndoCommand *command)
 {
 	const QDocumentInsertCommand* cmd = static_cast<const QDocumentInsertCommand*>(command);
+	restoreText(m_data);
 	int new_line=cmd->m_data.lineNumber;
 	int new_startOffset=cmd->m_data.startOffset;
 	int myLenght=m_data.begin.length();
 	if(new_line==m_data.lineNumber && new_startOffset==m_data.startOffset+myLenght && 
 	   cmd->m_data.handles.count()==0 && m_data.handles.count()==0) //don't know exactly why this line is needed but otherwise undo after insertion with several lines with autoindent doesn't work
 	{
+		detachText(m_data);
 		m_data.begin+=cmd->m_data.begin;
 		return true;
 	}
@@ -598,6 +675,8 @@ bool QDocumentInsertCommand::mergeWith(const QUndoCommand *command)
 
 void QDocumentInsertCommand::redo()
 {
+	restoreText(m_data);
+
 	// state : handles used by doc
 	m_state = true;
 
@@ -647,6 +726,8 @@ void QDocumentInsertCommand::redo()
 
 void QDocumentInsertCommand::undo()
 {
+	restoreText(m_data);
+
 	// state : handles !used by doc
 	m_state = false;
 
@@ -740,6 +821,16 @@ QDocumentEraseCommand::QDocumentEraseCommand(	int bl, int bo,
     m_mergedLines=false;
 }
 
+qint64 QDocumentInsertCommand::memoryUsage() const
+{
+	return sizeof(*this) + textMemoryUsage(m_data);
+}
+
+void QDocumentInsertCommand::spill(QDocumentUndoSpill *spill)
+{
+	spillText(spill, m_data);
+}
+
 QStringList QDocumentInsertCommand::debugRepresentation() const{
 	QStringList result;
 	result << QString("INSERT COMMAND: %1:%2").arg(m_data.lineNumber).arg(m_data.startOffset).arg(m_data.lineNumber+m_data.handles.size()).arg(m_data.endOffset);
@@ -778,12 +869,14 @@ bool QDocumentEraseCommand::mergeWith(const QUndoCommand *command)
     if(eraseCommand->m_data.endOffset!=-1) return false;
 	if(m_data.endOffset!=-1) return false;
 	if(new_line==m_data.lineNumber && new_startOffset+myLenght==m_data.startOffset){ //backspace
+		detachText(m_data);
         m_data.begin=eraseCommand->m_data.begin+m_data.begin;
 		m_data.startOffset=new_startOffset;
         m_undoOffset+=eraseCommand->m_undoOffset;
 		return true;
 	}
 	if(new_line==m_data.lineNumber && new_startOffset==m_data.startOffset){ //delete char
+		detachText(m_data);
         m_data.begin+=eraseCommand->m_data.begin;
         m_undoOffset+=eraseCommand->m_undoOffset;
 		//m_data.startOffset=new_startOffset;
@@ -794,6 +887,8 @@ bool QDocumentEraseCommand::mergeWith(const QUndoCommand *command)
 
 void QDocumentEraseCommand::redo()
 {
+	restoreText(m_data);
+
 	// state : handles !used by doc
 	m_state = false;
 
@@ -845,6 +940,8 @@ void QDocumentEraseCommand::redo()
 
 void QDocumentEraseCommand::undo()
 {
+	restoreText(m_data);
+
 	// state : handles used by doc
 	m_state = true;
 
@@ -899,6 +996,16 @@ void QDocumentEraseCommand::undo()
 	//m_doc->impl()->emitContentsChanged();
 }
 
+qint64 QDocumentEraseCommand::memoryUsage() const
+{
+	return sizeof(*this) + textMemoryUsage(m_data);
+}
+
+void QDocumentEraseCommand::spill(QDocumentUndoSpill *spill)
+{
+	spillText(spill, m_data);
+}
+
 QStringList QDocumentEraseCommand::debugRepresentation() const{
 	QStringList result;
 	result << QString("ERASE COMMAND: %1:%2 to %3:%4").arg(m_data.lineNumber).arg(m_data.startOffset).arg(m_data.lineNumber+m_data.handles.size()).arg(m_data.endOffset);
@@ -1033,6 +1140,20 @@ void QDocumentCommandBlock::removeCommand(QDocumentCommand *c)
 	m_commands.removeAll(c);
 }
 
+qint64 QDocumentCommandBlock::memoryUsage() const
+{
+	qint64 usage = sizeof(*this) + sizeof(QDocumentCommand*) * m_commands.count();
+	foreach ( const QDocumentCommand *c, m_commands )
+		usage += c->memoryUsage();
+	return usage;
+}
+
+void QDocumentCommandBlock::spill(QDocumentUndoSpill *spill)
+{
+	foreach ( QDocumentCommand *c, m_commands )
+		c->spill(spill);
+}
+
 QStringList QDocumentCommandBlock::debugRepresentation() const{
 	QStringList result;
 	result << "BLOCK:";
@@ -1075,5 +1196,71 @@ QStringList QDocumentChangeMetaDataCommand::debugRepresentation() const{
 	return QStringList() << QString("META DATA CHANGE: Encoding: %1=>%2; Line-Ending: %3=>%4").arg(oldCodec?oldCodec->name().data():"0").arg(newCodec?newCodec->name().data():"0").arg(oldLineEnding).arg(newLineEnding);
 }
 
+///////////////////////////
+
+/*!
+	\class QDocumentUndoSpill
+	\brief Temporary file which takes the text of undo commands exceeding the memory limit of the undo stack
+*/
+
+QDocumentUndoSpill::QDocumentUndoSpill()
+ : m_file(nullptr)
+{
+}
+
+QDocumentUndoSpill::~QDocumentUndoSpill()
+{
+	delete m_file;
+}
+
+/*!
+	\brief Append two strings to the file
+	\return offset to read them back, -1 if the file could not be written
+*/
+qint64 QDocumentUndoSpill::write(const QString& begin, const QString& end)
+{
+	if ( !m_file )
+	{
+		m_file = new QTemporaryFile();
+		if ( !m_file->open() )
+		{
+			delete m_file;
+			m_file = nullptr;
+			return -1;
+		}
+	}
+	qint64 offset = m_file->size();
+	if ( !m_file->seek(offset) )
+		return -1;
+	QDataStream s(m_file);
+	s << begin << end;
+	if ( s.status() != QDataStream::Ok )
+		return -1;
+	return offset;
+}
+
+bool QDocumentUndoSpill::read(qint64 offset, QString& begin, QString& end)
+{
+	if ( !m_file || !m_file->seek(offset) )
+		return false;
+	QDataStream s(m_file);
+	s >> begin >> end;
+	return s.status() == QDataStream::Ok;
+}
+
+/*!
+	\return number of bytes written to the file
+*/
+qint64 QDocumentUndoSpill::size() const
+{
+	return m_file ? m_file->size() : 0;
+}
+
+void QDocumentUndoSpill::clear()
+{
+	delete m_file;
+	m_file = nullptr;
+}
+
 /*! @} */
 
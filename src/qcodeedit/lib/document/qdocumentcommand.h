@@ -32,6 +32,31 @@
 class QDocumentLine;
 class QDocumentLineHandle;
 class QDocumentCursorHandle;
+class QTemporaryFile;
+
+/*!
+	\brief Temporary file holding the text of old undo commands
+
+	Text is only appended; the space is given back when the undo stack is cleared.
+	Commands reuse their copy when they are spilled again, unless their text has changed meanwhile.
+*/
+class QCE_EXPORT QDocumentUndoSpill
+{
+	public:
+		QDocumentUndoSpill();
+		~QDocumentUndoSpill();
+
+		qint64 write(const QString& begin, const QString& end);
+		bool read(qint64 offset, QString& begin, QString& end);
+
+		qint64 size() const;
+		void clear();
+
+	private:
+		Q_DISABLE_COPY(QDocumentUndoSpill)
+
+		QTemporaryFile *m_file;
+};
 
 class QCE_EXPORT QDocumentCommand : public QUndoCommand
 {
@@ -74,11 +99,21 @@ class QCE_EXPORT QDocumentCommand : public QUndoCommand
 		void setRedoOffset(int off);
 		void setUndoOffset(int off);	
 		
+		virtual qint64 memoryUsage() const;
+		virtual void spill(QDocumentUndoSpill *spill);
+		
 		virtual QStringList debugRepresentation() const;
 	protected:
 		bool m_state, m_first;
 		QDocument *m_doc;
 		int m_redoOffset, m_undoOffset;
+		qint64 m_spillOffset; // position of the text in the undo spill file, -1 if it is in memory
+		qint64 m_spillCopy; // position of an up-to-date copy of the in-memory text in the spill file, -1 if there is none
+		
+		qint64 textMemoryUsage(const TextCommandData& data) const;
+		void spillText(QDocumentUndoSpill *spill, TextCommandData& data);
+		void restoreText(TextCommandData& data);
+		void detachText(TextCommandData& data);
 		
 		void markRedone(QDocumentLineHandle *h, bool firstTime);
 		void markUndone(QDocumentLineHandle *h);
@@ -117,6 +152,9 @@ class QCE_EXPORT QDocumentInsertCommand : public QDocumentCommand
 		virtual void redo();
 		virtual void undo();
 		
+		virtual qint64 memoryUsage() const;
+		virtual void spill(QDocumentUndoSpill *spill);
+		
 		virtual QStringList debugRepresentation() const;
 	private:
 		TextCommandData m_data;
@@ -137,6 +175,9 @@ class QCE_EXPORT QDocumentEraseCommand : public QDocumentCommand
 		virtual void redo();
 		virtual void undo();
 		
+		virtual qint64 memoryUsage() const;
+		virtual void spill(QDocumentUndoSpill *spill);
+		
 		virtual QStringList debugRepresentation() const;
 	private:
 		TextCommandData m_data;
@@ -158,6 +199,9 @@ public:
 	virtual void addCommand(QDocumentCommand *c);
 	virtual void removeCommand(QDocumentCommand *c);
 
+	virtual qint64 memoryUsage() const;
+	virtual void spill(QDocumentUndoSpill *spill);
+
 	virtual QStringList debugRepresentation() const;
 private:
 	bool m_weakLocked;
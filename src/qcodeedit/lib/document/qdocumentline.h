@@ -86,6 +86,7 @@ class QCE_EXPORT QDocumentLine
 			Hidden				= 1,
 			CollapsedBlockStart	= 2,
 			CollapsedBlockEnd	= 4,
+			WrapPending			= 8,
 			
 			LayoutDirty			= 16,
 			FormatsApplied		= 32,
@@ -29,6 +29,9 @@
 
 #include "qdocumentline.h"
 
+#include "latexparser/latextokens.h"
+#include "latexparser/commanddescription.h"
+
 #include <QPair>
 #include <QList>
 #include <QString>
@@ -134,6 +137,7 @@ public:
 		int getRef(){ return m_ref.fetchAndAddRelaxed(0); }
 
 		QList<int> getBreaks();
+		void releaseCaches();
 		void clearFrontiers(){
 		    m_frontiers.clear();
 		}
@@ -159,9 +163,12 @@ public:
 		    mLock.unlock();
 		}
 
-		int getCurrentTicket(){
+		int getCurrentTicket() const {
 		    return mTicket;
 		}
+		int getTokenRevision() const {
+		    return mTokenRevision;
+		}
 
 		QVariant getCookie(int type) const;
 		QVariant getCookieLocked(int type) const;
@@ -169,6 +176,20 @@ public:
 		bool hasCookie(int type) const;
 		bool removeCookie(int type);
 
+		// typed access to the lexer cookies, without boxing into QVariant
+		TokenList getTokens(int type = QDocumentLine::LEXER_COOKIE) const;
+		TokenList getTokensLocked(int type = QDocumentLine::LEXER_COOKIE) const;
+		void setTokens(TokenList tl, int type = QDocumentLine::LEXER_COOKIE);
+		TokenStack getRemainder() const;
+		TokenStack getRemainderLocked() const;
+		void setRemainder(TokenStack stack);
+		CommandStack getCommandStack() const;
+		CommandStack getCommandStackLocked() const;
+		void setCommandStack(CommandStack stack);
+		QPair<int,int> getCommentStart() const;
+		QPair<int,int> getCommentStartLocked() const;
+		void setCommentStart(QPair<int,int> commentStart);
+
 		bool isRTLByLayout() const;
 		bool isRTLByText() const;
 		void layout(int lineNr) const; //public for unittests
@@ -190,6 +211,7 @@ public:
 		QDocument *m_doc;
 
 		QAtomicInt m_ref;
+		mutable QAtomicInt m_lineIndex; // last known position in the document, see QDocumentPrivate::indexOf(), atomic as it is read without lock
 
         mutable qreal m_indent;
 		mutable quint16 m_state;
@@ -208,7 +230,24 @@ public:
 		QBitmap wv;
 		mutable QReadWriteLock mLock;
 		int mTicket; // increment on each write access to detect obsolete info in parallel thread
+		int mTokenRevision; // increment whenever the tokens (LEXER_COOKIE) are replaced, e.g. by the syntax check without a text change
 		QMap<int,QVariant> mCookies; // store additional info on lines. Helpful for to retrieve info on multiline commands
+
+		/*!
+		 * \brief fixed slots for the cookies which are read and written on every lexer and syntax check pass
+		 * Other cookie types are stored in mCookies.
+		 */
+		struct LexerCookies {
+			TokenList tokens; ///< LEXER_COOKIE
+			TokenList rawTokens; ///< LEXER_RAW_COOKIE
+			TokenStack remainder; ///< LEXER_REMAINDER_COOKIE
+			CommandStack commandStack; ///< LEXER_COMMANDSTACK_COOKIE
+			QPair<int,int> commentStart; ///< LEXER_COMMENTSTART_COOKIE
+			int present = 0; ///< bit (1 << type) is set for each cookie type which has been set
+		};
+		LexerCookies mLexerCookies;
+
+		static bool isLexerCookie(int type);
 };
 
 Q_DECLARE_TYPEINFO(QDocumentLineHandle*, Q_PRIMITIVE_TYPE);
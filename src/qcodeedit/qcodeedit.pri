@@ -26,6 +26,7 @@ HEADERS += $$PWD/lib/qce-config.h \
     $$PWD/lib/qformat.h \
     $$PWD/lib/document/qdocument.h \
     $$PWD/lib/document/qdocument_p.h \
+    $$PWD/lib/document/qdocumentbuffer.h \
     $$PWD/lib/document/qdocumentcommand.h \
     $$PWD/lib/document/qdocumentcursor.h \
     $$PWD/lib/document/qdocumentline.h \
@@ -56,6 +57,7 @@ SOURCES += $$PWD/lib/qeditor.cpp \
     $$PWD/lib/qeditorinputbinding.cpp \
     $$PWD/lib/qformat.cpp \
     $$PWD/lib/document/qdocument.cpp \
+    $$PWD/lib/document/qdocumentbuffer.cpp \
     $$PWD/lib/document/qdocumentcommand.cpp \
     $$PWD/lib/document/qdocumentcursor.cpp \
     $$PWD/lib/document/qdocumentcursor_p.h \
@@ -1,6 +1,10 @@
 #include "searchquery.h"
 #include "latexdocument.h"
+#include "misspellingindex.h"
 #include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 // TODO: dependency should be refactored
 #include "buildmanager.h"
 
@@ -9,7 +13,8 @@ SearchQuery::SearchQuery(QString expr, QString replaceText, SearchFlags f) :
 {
 	mModel = new SearchResultModel(this);
 	mModel->setSearchExpression(expr, replaceText, flag(IsCaseSensitive), flag(IsWord), flag(IsRegExp));
-    connect(&m_SearchInFilesWatcher, &QFutureWatcher<QStringList>::finished, this, &SearchQuery::searchInFilesFinished);
+    connect(&m_SearchInFilesWatcher, &QFutureWatcher<SearchInfo>::resultReadyAt, this, &SearchQuery::searchInFileFinished);
+    connect(&m_SearchInFilesWatcher, &QFutureWatcher<SearchInfo>::finished, this, &SearchQuery::searchInFilesFinished);
 }
 
 SearchQuery::SearchQuery(QString expr, QString replaceText, bool isCaseSensitive, bool isWord, bool isRegExp) :
@@ -25,7 +30,14 @@ SearchQuery::SearchQuery(QString expr, QString replaceText, bool isCaseSensitive
 	}
 	mModel = new SearchResultModel(this);
 	mModel->setSearchExpression(expr, replaceText, flag(IsCaseSensitive), flag(IsWord), flag(IsRegExp));
-    connect(&m_SearchInFilesWatcher, &QFutureWatcher<QStringList>::finished, this, &SearchQuery::searchInFilesFinished);
+    connect(&m_SearchInFilesWatcher, &QFutureWatcher<SearchInfo>::resultReadyAt, this, &SearchQuery::searchInFileFinished);
+    connect(&m_SearchInFilesWatcher, &QFutureWatcher<SearchInfo>::finished, this, &SearchQuery::searchInFilesFinished);
+}
+
+SearchQuery::~SearchQuery()
+{
+    // running searches access this object
+    cancelSearchInFiles(true);
 }
 
 bool SearchQuery::flag(SearchQuery::SearchFlag f) const
@@ -70,7 +82,7 @@ int SearchQuery::getNextSearchResultColumn(QString text, int col) const
  */
 void SearchQuery::setFileFilter(const QString &filter)
 {
-    m_SearchInFilesWatcher.cancel();
+    cancelSearchInFiles();
     if(filter.contains('(')){
         int index=filter.indexOf('(');
         int endIndex=filter.indexOf(')');
@@ -89,7 +101,7 @@ void SearchQuery::setFileFilter(const QString &filter)
  */
 void SearchQuery::setSearchFolder(const QString &folder)
 {
-    m_SearchInFilesWatcher.cancel();
+    cancelSearchInFiles();
     m_fileFolder.setPath(folder);
 }
 /*!
@@ -99,7 +111,7 @@ void SearchQuery::setSearchFolder(const QString &folder)
  */
 void SearchQuery::setSearchFolder(QFileInfo folder)
 {
-    m_SearchInFilesWatcher.cancel();
+    cancelSearchInFiles();
     m_fileFolder=folder.absoluteDir();
 }
 /*!
@@ -111,33 +123,173 @@ QString SearchQuery::searchFolder() const
     return m_fileFolder.absolutePath();
 }
 
-SearchInfo SearchQuery::searchInFile(QString file, const QRegularExpression &regex){
-    QFile f(file);
-    f.open(QIODevice::ReadOnly);
-    QTextStream textStream(&f);
+/*!
+ * \brief check if raw data contains a literal
+ * The first byte is looked up with memchr, case insensitive comparison only works for ASCII literals.
+ * \param data
+ * \param length
+ * \param literal
+ * \param caseInsensitive
+ * \return literal found
+ */
+static bool containsLiteral(const char *data, int length, const QByteArray &literal, bool caseInsensitive)
+{
+    const int n = literal.size();
+    if (n == 0) return true;
+    if (length < n) return false;
+    const char *end = data + length - n + 1; // behind last possible start
+    if (!caseInsensitive) {
+        for (const char *p = data; p < end; ++p) {
+            p = static_cast<const char *>(memchr(p, literal.at(0), end - p));
+            if (!p) return false;
+            if (memcmp(p, literal.constData(), n) == 0) return true;
+        }
+        return false;
+    }
+    const char lower = char(tolower(uchar(literal.at(0))));
+    const char upper = char(toupper(uchar(literal.at(0))));
+    const char *nextLower = nullptr, *nextUpper = nullptr;
+    bool lowerDone = false, upperDone = (lower == upper);
+    for (const char *p = data; p < end; ) {
+        if (!lowerDone && (!nextLower || nextLower < p)) {
+            nextLower = static_cast<const char *>(memchr(p, lower, end - p));
+            lowerDone = !nextLower;
+        }
+        if (!upperDone && (!nextUpper || nextUpper < p)) {
+            nextUpper = static_cast<const char *>(memchr(p, upper, end - p));
+            upperDone = !nextUpper;
+        }
+        const char *c;
+        if (lowerDone && upperDone) return false;
+        else if (lowerDone) c = nextUpper;
+        else if (upperDone) c = nextLower;
+        else c = qMin(nextLower, nextUpper);
+        if (qstrnicmp(c, literal.constData(), uint(n)) == 0) return true;
+        p = c + 1;
+    }
+    return false;
+}
+
+/*!
+ * \brief check if a codec encodes ASCII characters as single ASCII bytes
+ * Only then the bytes of an ASCII text can be searched for directly in the encoded data.
+ */
+static bool isAsciiCompatible(QTextCodec *codec)
+{
+    switch (codec->mibEnum()) {
+    case 1013: case 1014: case 1015: // UTF-16
+    case 1017: case 1018: case 1019: // UTF-32
+        return false;
+    default:
+        return codec->fromUnicode(QStringLiteral("\n")) == "\n";
+    }
+}
+
+/*!
+ * \brief search regex in lines of a file
+ * The file is memory-mapped and binary files (NUL byte in the first block) are skipped.
+ * If the search expression is a plain text (\a literal), the raw data is scanned for it first, so files without possible match are not decoded at all,
+ * and only lines containing the literal are matched with \a regex.
+ * Lines are referenced in the decoded text, only matching lines are copied.
+ * Stops early when the search is cancelled.
+ * \param file
+ * \param regex
+ * \param literal plain text which is contained in any match, empty if unknown
+ * \param codec encoding of the file, if null it is detected from a BOM and otherwise the locale encoding is used
+ * \return found lines
+ */
+SearchInfo SearchQuery::searchInFile(QString file, const QRegularExpression &regex, const QString &literal, QTextCodec *codec){
     SearchInfo result;
-    int lineNr=0;
-
-    while (!textStream.atEnd()) {
-        const auto line =  textStream.readLine();
-        QRegularExpressionMatch match = regex.match(line);
-        if(match.hasMatch()){
-            result.textlines<<line;
-            result.lineNumberHints<<lineNr;
-            result.checked<<false;
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 size = f.size();
+    if (size <= 0 || size >= std::numeric_limits<int>::max())
+        return result;
+
+    uchar *mapped = f.map(0, size);
+    const QByteArray buffer = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(size)) : f.readAll();
+    const char *data = buffer.constData();
+    const int length = buffer.size();
+    const Qt::CaseSensitivity cs = regex.patternOptions().testFlag(QRegularExpression::CaseInsensitiveOption) ? Qt::CaseInsensitive : Qt::CaseSensitive;
+
+    if (!codec)
+        codec = QTextCodec::codecForUtfText(buffer, QTextCodec::codecForLocale());
+    const bool asciiCompatible = isAsciiCompatible(codec);
+    bool skip = asciiCompatible && memchr(data, 0, qMin(length, 8192));
+    if (!skip && asciiCompatible && !literal.isEmpty()) {
+        // an ASCII literal has the same bytes in any ASCII compatible encoding, other literals are only looked up in UTF-8 files
+        bool ascii = true;
+        for (const QChar &c : literal)
+            ascii = ascii && c.unicode() < 0x80;
+        if (ascii)
+            skip = !containsLiteral(data, length, literal.toLatin1(), cs == Qt::CaseInsensitive);
+        else if (codec->mibEnum() == 106 && cs == Qt::CaseSensitive)
+            skip = !containsLiteral(data, length, literal.toUtf8(), false);
+    }
+
+    if (!skip) {
+        const QString text = codec->toUnicode(data, length);
+        const QChar *chars = text.constData();
+        int lineNr = 0;
+        int start = 0;
+        while (start < text.length() && !m_searchInFilesCancelled.loadRelaxed()) {
+            if (!literal.isEmpty()) {
+                // jump to next line containing the literal
+                int pos = text.indexOf(literal, start, cs);
+                if (pos < 0) break;
+                int lineStart = text.lastIndexOf('\n', pos) + 1;
+                if (lineStart > start) {
+                    lineNr += int(std::count(chars + start, chars + lineStart, QChar('\n')));
+                    start = lineStart;
+                }
+            }
+            int end = text.indexOf('\n', start);
+            if (end < 0) end = text.length();
+            int len = end - start;
+            if (len > 0 && chars[start + len - 1] == '\r') --len;
+            const QString line = QString::fromRawData(chars + start, len);
+            if (regex.match(line).hasMatch()) {
+                result.textlines << QString(chars + start, len);
+                result.lineNumberHints << lineNr;
+                result.checked << false;
+            }
+            start = end + 1;
+            ++lineNr;
         }
-        ++lineNr;
     }
+    if (mapped)
+        f.unmap(mapped);
+
     if(!result.textlines.isEmpty()){
         result.filename=file;
     }
 
     return result;
 }
-void SearchQuery::addToSearchResults(SearchInfo &result, SearchInfo newResults){
-    result=newResults;
-    if(!newResults.filename.isEmpty())
-        addFileSearchResult(newResults);
+/*!
+ * \brief stop running search in files
+ * Pending files are not searched any more, files which are searched already stop at the next line.
+ * \param wait block until all running searches have stopped
+ */
+void SearchQuery::cancelSearchInFiles(bool wait)
+{
+    m_searchInFilesCancelled.storeRelaxed(1);
+    m_SearchInFilesWatcher.cancel();
+    if (wait)
+        m_SearchInFilesWatcher.waitForFinished();
+}
+/*!
+ * \brief add result of one file as soon as the file is searched
+ * \param index
+ */
+void SearchQuery::searchInFileFinished(int index)
+{
+    if (m_SearchInFilesWatcher.isCanceled())
+        return;
+    SearchInfo result = m_SearchInFilesWatcher.resultAt(index);
+    if (!result.filename.isEmpty())
+        addFileSearchResult(result);
 }
 /*!
  * \brief function to clean up search in files (qtconcurrent/watcher)
@@ -169,6 +321,7 @@ void SearchQuery::run(LatexDocument *doc)
 		break;
 	}
     QFileInfoList files;
+    QHash<QString, QTextCodec *> codecs; // encoding of files which are open but not in memory
     if(mScope==FilesScope){
         if(m_fileFolder.isEmpty()){
             QFileInfo fi=doc->getFileInfo();
@@ -182,6 +335,8 @@ void SearchQuery::run(LatexDocument *doc)
                 // file was loaded from cache without content
                 // search in file on disk instead
                 files<<doc->getFileInfo();
+                if (doc->codec())
+                    codecs.insert(doc->getFileInfo().absoluteFilePath(), doc->codec());
                 continue;
             }
             QList<QDocumentLineHandle *> lines;
@@ -200,17 +355,27 @@ void SearchQuery::run(LatexDocument *doc)
         }
         emit runCompleted();
     }
+    if(!files.isEmpty() && !flag(IsRegExp)){
+        // skip files which can't contain the search text
+        TrigramIndex *index = doc->parent->getTrigramIndex(doc);
+        if(index){
+            // open documents may use another encoding than the index assumes, so they are always searched
+            QFileInfoList indexedFiles, openFiles;
+            foreach (const QFileInfo &fi, files)
+                (codecs.contains(fi.absoluteFilePath()) ? openFiles : indexedFiles) << fi;
+            files = index->candidates(indexedFiles, searchExpression()) + openFiles;
+            if(files.isEmpty() && mScope==FilesScope)
+                emit runCompleted();
+        }
+    }
     if(!files.isEmpty()){
+        cancelSearchInFiles(true);
+        m_searchInFilesCancelled.storeRelaxed(0);
         QRegularExpression regex=generateRegularExpression(searchExpression(),!flag(IsCaseSensitive),flag(IsWord), flag(IsRegExp));
-        std::function<SearchInfo(const QFileInfo &)> searchInFiles = [regex, this](const QFileInfo &fi) -> SearchInfo { return this->searchInFile(fi.absoluteFilePath(),regex); };
-        std::function<void(SearchInfo &, const SearchInfo &)> reduce = [this](SearchInfo &result, const SearchInfo &value) { this->addToSearchResults(result, value); };
-        m_SearchInFilesWatcher.setFuture(
-            QtConcurrent::mappedReduced<SearchInfo>(
-                files,
-                searchInFiles,
-                reduce,
-                QtConcurrent::SequentialReduce)
-            );
+        QString literal = flag(IsRegExp) ? QString() : searchExpression();
+        std::function<SearchInfo(const QFileInfo &)> searchInFiles = [regex, literal, codecs, this](const QFileInfo &fi) -> SearchInfo { return this->searchInFile(fi.absoluteFilePath(), regex, literal, codecs.value(fi.absoluteFilePath())); };
+        // results are added by searchInFileFinished() as soon as a file is searched
+        m_SearchInFilesWatcher.setFuture(QtConcurrent::mapped(files, searchInFiles));
     }
 }
 
@@ -320,3 +485,50 @@ void LabelSearchQuery::replaceAll()
     setExpression(mModel->replacementText());
 }
 
+SpellingSearchQuery::SpellingSearchQuery() :
+	SearchQuery("", "", IsCaseSensitive | IsRegExp | SearchAgainAllowed)
+{
+	mScope = ProjectScope;
+	mType = tr("Spelling Report");
+	mModel->setAllowPartialSelection(false);
+}
+
+/*!
+ * \brief list all lines of the project which contain misspelled words
+ * The misspellings are taken from the misspelling index of each document, i.e. only lines which changed since the last background sweep are checked now.
+ * The search expression matches the misspelled words for highlighting and jumping to them.
+ */
+void SpellingSearchQuery::run(LatexDocument *doc)
+{
+	mModel->removeAllSearches();
+	QList<QPair<LatexDocument *, QList<QDocumentLineHandle *> > > results;
+	QSet<QString> words;
+	foreach (LatexDocument *elem, doc->getListOfDocs()) {
+		MisspellingIndex *index = elem->misspellingIndex();
+		QList<QDocumentLineHandle *> lines;
+		for (int i = 0; i < elem->lines(); i++) {
+			QDocumentLineHandle *dlh = elem->line(i).handle();
+			QList<MisspellingIndex::Misspelling> misspellings = index->lineMisspellings(dlh);
+			if (misspellings.isEmpty())
+				continue;
+			QString text = dlh->text();
+			foreach (const MisspellingIndex::Misspelling &m, misspellings)
+				words.insert(text.mid(m.start, m.length));
+			lines << dlh;
+		}
+		if (!lines.isEmpty())
+			results << qMakePair(elem, lines);
+	}
+
+	QStringList alternatives;
+	foreach (const QString &word, words)
+		alternatives << QRegularExpression::escape(word);
+	alternatives.sort();
+	QString expression = alternatives.isEmpty() ? QString() : QString("(?<!\\w)(?:%1)(?!\\w)").arg(alternatives.join('|'));
+	mModel->setSearchExpression(expression, flag(IsCaseSensitive), flag(IsWord), flag(IsRegExp));
+	for (int i = 0; i < results.size(); i++)
+		addDocSearchResult(results[i].first, results[i].second);
+
+	emit runCompleted();
+}
+
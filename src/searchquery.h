@@ -38,6 +38,7 @@ public:
 
 	SearchQuery(QString expr, QString replaceText, SearchFlags f);
 	SearchQuery(QString expr, QString replaceText, bool isCaseSensitive, bool isWord, bool isRegExp);
+	~SearchQuery();
 
 	bool flag(SearchFlag f) const;
 	QString type() { return mType; }
@@ -67,12 +68,13 @@ public slots:
 	virtual void replaceAll();
 
 private slots:
+    void searchInFileFinished(int index);
     void searchInFilesFinished();
 	
 protected:
 	void setFlag(SearchFlag f, bool b=true);
-    SearchInfo searchInFile(QString file, const QRegularExpression &regex);
-    void addToSearchResults(SearchInfo &result, SearchInfo newResults);
+    SearchInfo searchInFile(QString file, const QRegularExpression &regex, const QString &literal, QTextCodec *codec = nullptr);
+    void cancelSearchInFiles(bool wait = false);
 	QString mType;
 	Scope mScope;
 	SearchResultModel *mModel;
@@ -81,6 +83,7 @@ protected:
     QDir m_fileFolder;
 
     QFutureWatcher<SearchInfo> m_SearchInFilesWatcher;
+    QAtomicInt m_searchInFilesCancelled; ///< checked by running searchInFile() calls to stop early
 	
 private:
 
@@ -98,4 +101,13 @@ public:
 };
 
 
+class SpellingSearchQuery : public SearchQuery {
+	Q_OBJECT
+
+public:
+	SpellingSearchQuery();
+	virtual void run(LatexDocument *doc);
+};
+
+
 #endif // SEARCHQUERY_H
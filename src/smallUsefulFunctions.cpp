@@ -190,7 +190,7 @@ QString latexToPlainWord(const QString &word)
 
 	return result;
 }
-QString latexToPlainWordwithReplacementList(const QString &word, QMap<QString, QString> &replacementList )
+QString latexToPlainWordwithReplacementList(const QString &word, const QMap<QString, QString> &replacementList )
 {
 	QString result;
 	QString w = latexToPlainWord(word);
@@ -57,7 +57,7 @@ typedef QString (QObject::*StringToStringCallback)(const QString &) ;
 
 /// removes special latex characters
 QString latexToPlainWord(const QString &word);
-QString latexToPlainWordwithReplacementList(const QString &word, QMap<QString, QString> &replacementList );
+QString latexToPlainWordwithReplacementList(const QString &word, const QMap<QString, QString> &replacementList );
 /// replaces character with corresponding LaTeX commands
 QString textToLatex(const QString &text);
 QString latexToText(QString s);
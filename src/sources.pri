@@ -60,6 +60,7 @@ HEADERS += \
     $$PWD/manhattanstyle.h \
     $$PWD/mathassistant.h \
     $$PWD/minisplitter.h \
+    $$PWD/misspellingindex.h \
     $$PWD/modifiedQObject.h \
     $$PWD/mostQtHeaders.h \
     $$PWD/pdfsplittool.h \
@@ -92,6 +93,7 @@ HEADERS += \
     $$PWD/thesaurusdialog.h \
     $$PWD/titledpanel.h \
     $$PWD/toolwidgets.h \
+    $$PWD/trigramindex.h \
     $$PWD/txstabwidget.h \
     $$PWD/unicodeinsertion.h \
     $$PWD/universalinputdialog.h \
@@ -165,6 +167,7 @@ SOURCES += \
     $$PWD/manhattanstyle.cpp \
     $$PWD/mathassistant.cpp \
     $$PWD/minisplitter.cpp \
+    $$PWD/misspellingindex.cpp \
     $$PWD/pdfsplittool.cpp \
     $$PWD/qmetautils.cpp \
     $$PWD/quickbeamerdialog.cpp \
@@ -195,6 +198,7 @@ SOURCES += \
     $$PWD/thesaurusdialog.cpp \
     $$PWD/titledpanel.cpp \
     $$PWD/toolwidgets.cpp \
+    $$PWD/trigramindex.cpp \
     $$PWD/txstabwidget.cpp \
     $$PWD/unicodeinsertion.cpp \
     $$PWD/universalinputdialog.cpp \
@@ -10,6 +10,7 @@
 
 #include "spellerdialog.h"
 
+#include "misspellingindex.h"
 #include "smallUsefulFunctions.h"
 #include "utilsUI.h"
 
@@ -72,8 +73,6 @@ void SpellerDialog::setEditorView(LatexEditorView *edView)
 {
     editor = edView ? edView->editor : nullptr;
 	editorView = edView;
-    if(edView)
-        mReplacementList=edView->getReplacementList();
 }
 
 void SpellerDialog::startSpelling()
@@ -94,15 +93,7 @@ void SpellerDialog::startSpelling()
 		endIndex = editor->text(endLine).length();
 	}
 	curLine = startLine;
-    // determine tokenIndex from cursor index
-    QDocumentLineHandle *dlh=editor->document()->line(curLine).handle();
-    tl=dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList >();
-    for(tokenListIndex=0;tokenListIndex<tl.length();++tokenListIndex){
-        Token tk=tl.at(tokenListIndex);
-        if(tk.start+tk.length>startIndex)
-            break;
-    }
-    --tokenListIndex; // index is increased as first step in SpellingNextWord()
+	curColumn = startIndex; // words ending after this column are checked, i.e. including the word at the cursor
 	show();
 	SpellingNextWord();
 }
@@ -169,30 +160,29 @@ void SpellerDialog::slotReplace()
 	if (editor->cursor().hasSelection()) {
 		QString selectedword = editor->cursor().selectedText();
         editor->insertText(ui.lineEditNew->text());
+		curColumn = editor->cursor().columnNumber();
 	}
 	SpellingNextWord();
 }
 
 void SpellerDialog::SpellingNextWord()
 {
-	if (!editor || !m_speller) return;
+	if (!editor || !editorView || !m_speller) return;
+	// misspellings of unchanged lines are taken from the index, which is filled in the background
+	MisspellingIndex *index = editorView->document->misspellingIndex();
 	for (; curLine <= endLine; curLine++) {
         QDocumentLineHandle *dlh=editor->document()->line(curLine).handle();
-        tl=dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList >();
-        while(tokenListIndex<tl.length()-1){
-            ++tokenListIndex;
-            Token tk=tl.at(tokenListIndex);
-            if (tk.type!=Token::word)
-				continue;
-            if(tk.subtype != Token::text && tk.subtype != Token::title && tk.subtype != Token::shorttitle && tk.subtype != Token::todo && tk.subtype != Token::none)
+        foreach (const MisspellingIndex::Misspelling &m, index->lineMisspellings(dlh)) {
+            if (m.start + m.length <= curColumn)
                 continue;
-            QString word=tk.getText();
-            word = latexToPlainWordwithReplacementList(word, mReplacementList);
-            if (tk.ignoreSpelling || m_speller->check(word)) continue;
+            if (curLine == endLine && m.start >= endIndex)
+                break;
+            curColumn = m.start + m.length;
+            QString word = m.word;
             QStringList suggWords = m_speller->suggest(word);
 
-            QDocumentCursor wordSelection(editor->document(), curLine, tk.start);
-            wordSelection.movePosition(tk.length, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
+            QDocumentCursor wordSelection(editor->document(), curLine, m.start);
+            wordSelection.movePosition(m.length, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
 			editor->setCursor(wordSelection);
 
 			ui.listSuggestions->setEnabled(true);
@@ -211,7 +201,7 @@ void SpellerDialog::SpellingNextWord()
 			}
 			return;
 		}
-        tokenListIndex = -1;
+        curColumn = 0;
 	}
 
 	//no word found
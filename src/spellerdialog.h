@@ -39,11 +39,8 @@ private :
 	SpellerUtility *m_speller;
 	QEditor *editor;
 	LatexEditorView *editorView;
-    TokenList tl;
-    int tokenListIndex;
-	int startLine, startIndex, curLine, endLine, endIndex;
+	int startLine, startIndex, curLine, curColumn, endLine, endIndex;
 	bool ignoreListChanged;
-    QMap<QString, QString> mReplacementList;
 
 protected:
 	void closeEvent(QCloseEvent *);
@@ -17,10 +17,16 @@ int SpellerUtility::spellcheckErrorFormat = -1;
 bool SpellerUtility::inlineSpellChecking = true;
 bool SpellerUtility::hideNonTextSpellingErrors = true;
 
-SpellerUtility::SpellerUtility(QString name): mName(name), currentDic(""), pChecker(nullptr), spellCodec(nullptr)
+SpellerUtility::SpellerUtility(QString name): mName(name), currentDic(""), pChecker(nullptr), mPendingCheckers(0), spellCodec(nullptr)
 {
 }
 
+// upper bound for the Hunspell instances of one dictionary, each of them holds a full copy of the dictionary
+static int maxCheckers()
+{
+	return qBound(1, QThread::idealThreadCount(), 4);
+}
+
 bool SpellerUtility::loadDictionary(QString dic, QString ignoreFilePrefix)
 {
 	if (dic == currentDic) return true;
@@ -37,13 +43,19 @@ bool SpellerUtility::loadDictionary(QString dic, QString ignoreFilePrefix)
 		return false;
 	}
 	currentDic = dic;
-	pChecker = new Hunspell(affFile.toLocal8Bit(), dicFile.toLocal8Bit());
+	mAffFile = affFile.toLocal8Bit();
+	mDicFile = dicFile.toLocal8Bit();
+	pChecker = new Hunspell(mAffFile.constData(), mDicFile.constData());
 	if (!pChecker) {
 		currentDic = "";
 		ignoreListFileName = "";
 		mLastError = "Creation of Hunspell object failed.";
 		REQUIRE_RET(false, false);
 	}
+	mSpellerMutex.lock();
+	mCheckers.append(pChecker);
+	mIdleCheckers.append(pChecker);
+	mSpellerMutex.unlock();
 	spell_encoding = QString(pChecker->get_dic_encoding());
 	spellCodec = QTextCodec::codecForName(spell_encoding.toLatin1());
     if (spellCodec == nullptr) {
@@ -111,12 +123,78 @@ void SpellerUtility::saveIgnoreList()
 void SpellerUtility::unload()
 {
     QMutexLocker locker(&mSpellerMutex);
+	waitForIdleCheckers();
 	saveIgnoreList();
 	currentDic = "";
 	ignoreListFileName = "";
-    if (pChecker != nullptr) {
-		delete pChecker;
-        pChecker = nullptr;
+	qDeleteAll(mCheckers);
+	mCheckers.clear();
+	mIdleCheckers.clear();
+	pChecker = nullptr;
+	clearCheckCache();
+}
+
+/*!
+ * \brief take a Hunspell instance for exclusive use
+ * If all instances are busy, another one is loaded (up to maxCheckers()), otherwise wait for one to be released.
+ * Returns nullptr if no dictionary is loaded.
+ */
+Hunspell *SpellerUtility::acquireChecker()
+{
+	QMutexLocker locker(&mSpellerMutex);
+	forever {
+		if (mCheckers.isEmpty())
+			return nullptr;
+		if (!mIdleCheckers.isEmpty())
+			return mIdleCheckers.takeLast();
+		if (mCheckers.size() + mPendingCheckers < maxCheckers())
+			break;
+		mCheckerReleased.wait(&mSpellerMutex);
+	}
+	// loading takes a while, don't block the other instances meanwhile
+	mPendingCheckers++;
+	QByteArray affFile = mAffFile, dicFile = mDicFile;
+	QList<QByteArray> addedWords;
+	foreach (const QString &word, ignoredWords)
+		addedWords << spellCodec->fromUnicode(word);
+	locker.unlock();
+	Hunspell *checker = new Hunspell(affFile.constData(), dicFile.constData());
+	foreach (const QByteArray &word, addedWords)
+		checker->add(word.data());
+	locker.relock();
+	mPendingCheckers--;
+	mCheckers.append(checker);
+	mCheckerReleased.wakeAll();
+	return checker;
+}
+
+void SpellerUtility::releaseChecker(Hunspell *checker)
+{
+	QMutexLocker locker(&mSpellerMutex);
+	mIdleCheckers.append(checker);
+	mCheckerReleased.wakeAll();
+}
+
+/*!
+ * \brief wait until no Hunspell instance is in use, so that all of them can be changed
+ * mSpellerMutex has to be locked by the caller
+ */
+void SpellerUtility::waitForIdleCheckers()
+{
+	while (mIdleCheckers.size() != mCheckers.size() || mPendingCheckers > 0)
+		mCheckerReleased.wait(&mSpellerMutex);
+}
+
+/*!
+ * \brief drop all cached check() results
+ * Has to be called after the Hunspell instances have been changed. Checks which started before are not added to the cache anymore.
+ */
+void SpellerUtility::clearCheckCache()
+{
+	mCheckCacheGeneration.fetchAndAddOrdered(1);
+	for (int i = 0; i < CheckCacheShards; i++) {
+		QWriteLocker locker(&mCheckCache[i].lock);
+		mCheckCache[i].verdicts.clear();
 	}
 }
 /*!
@@ -127,37 +205,38 @@ void SpellerUtility::unload()
 void SpellerUtility::addToIgnoreList(QString toIgnore,bool intoIgnFile)
 {
 	QString word = latexToPlainWord(toIgnore);
-	QByteArray encodedString;
-	QString spell_encoding = QString(pChecker->get_dic_encoding());
-	QTextCodec *codec = QTextCodec::codecForName(spell_encoding.toLatin1());
-	encodedString = codec->fromUnicode(word);
     QMutexLocker locker(&mSpellerMutex);
     if(!pChecker){
         return;
     }
-	pChecker->add(encodedString.data());
+	QByteArray encodedString = spellCodec->fromUnicode(word);
+	waitForIdleCheckers();
+	foreach (Hunspell *checker, mCheckers)
+		checker->add(encodedString.data());
 	ignoredWords.insert(word);
+	clearCheckCache();
     if(intoIgnFile){
         if (!ignoredWordList.contains(word))
             ignoredWordList.insert(std::lower_bound(ignoredWordList.begin(), ignoredWordList.end(), word, localeAwareLessThan), word);
         ignoredWordsModel.setStringList(ignoredWordList);
         saveIgnoreList();
     }
+    locker.unlock();
     emit ignoredWordAdded(word);
 }
 
 void SpellerUtility::removeFromIgnoreList(QString toIgnore)
 {
-	QByteArray encodedString;
     QMutexLocker locker(&mSpellerMutex);
     if(!pChecker){
         return;
     }
-	QString spell_encoding = QString(pChecker->get_dic_encoding());
-	QTextCodec *codec = QTextCodec::codecForName(spell_encoding.toLatin1());
-	encodedString = codec->fromUnicode(toIgnore);
-	pChecker->remove(encodedString.data());
+	QByteArray encodedString = spellCodec->fromUnicode(toIgnore);
+	waitForIdleCheckers();
+	foreach (Hunspell *checker, mCheckers)
+		checker->remove(encodedString.data());
 	ignoredWords.remove(toIgnore);
+	clearCheckCache();
 	ignoredWordList.removeAll(toIgnore);
 	ignoredWordsModel.setStringList(ignoredWordList);
 	saveIgnoreList();
@@ -180,13 +259,29 @@ bool SpellerUtility::check(QString word)
 	if (word.length() <= 1) return true;
 	if (ignoredWords.contains(word)) return true;
 	if (word.endsWith('.') && ignoredWords.contains(word.left(word.length() - 1))) return true;
-    QMutexLocker locker(&mSpellerMutex);
-    if(!pChecker)
-        return true;
-    QByteArray encodedString = spellCodec->fromUnicode(word);
 
-    bool result = pChecker->spell(encodedString.toStdString());
+	CheckCacheShard &shard = mCheckCache[qHash(word) % CheckCacheShards];
+	{
+		QReadLocker locker(&shard.lock);
+		QHash<QString, bool>::const_iterator it = shard.verdicts.constFind(word);
+		if (it != shard.verdicts.constEnd())
+			return it.value();
+	}
 
+	int generation = mCheckCacheGeneration.loadAcquire();
+	Hunspell *checker = acquireChecker();
+	if (!checker)
+		return true;
+    QByteArray encodedString = spellCodec->fromUnicode(word);
+    bool result = checker->spell(encodedString.toStdString());
+	releaseChecker(checker);
+
+	QWriteLocker locker(&shard.lock);
+	if (mCheckCacheGeneration.loadAcquire() == generation) { // otherwise the dictionary changed meanwhile
+		if (shard.verdicts.size() >= CheckCacheShardLimit)
+			shard.verdicts.clear();
+		shard.verdicts.insert(word, result);
+	}
 	return result;
 }
 
@@ -198,11 +293,12 @@ QStringList SpellerUtility::suggest(QString word)
     QByteArray encodedString = spellCodec->fromUnicode(word);
     QStringList suggestion;
 
-    QMutexLocker locker(&mSpellerMutex);
-    if(!pChecker)
+    Hunspell *checker = acquireChecker();
+    if(!checker)
         return suggestion;
 
-    wlst = pChecker->suggest(encodedString.toStdString());
+    wlst = checker->suggest(encodedString.toStdString());
+    releaseChecker(checker);
 
     unsigned long ns=wlst.size();
 	if (ns > 0) {
@@ -213,6 +309,15 @@ QStringList SpellerUtility::suggest(QString word)
 	return suggestion;
 }
 
+/*!
+ * \brief number of Hunspell instances currently loaded for parallel checking
+ */
+int SpellerUtility::checkerCount()
+{
+	QMutexLocker locker(&mSpellerMutex);
+	return mCheckers.size();
+}
+
 
 SpellerManager::SpellerManager()
 {
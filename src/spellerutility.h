@@ -13,6 +13,8 @@
 
 #include "mostQtHeaders.h"
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QWaitCondition>
 
 #ifdef HUNSPELL_STATIC
 #include "hunspell/hunspell.hxx"
@@ -31,6 +33,8 @@ public:
 
 	bool check(QString word);
 	QStringList suggest(QString word);
+	int checkerCount();
+	int checkGeneration() const {return mCheckCacheGeneration.loadAcquire();} ///< changes whenever results of check() may have changed
 
 	QString name() {return mName;}
 	QString getCurrentDic() {return currentDic;}
@@ -50,15 +54,35 @@ private:
 	void saveIgnoreList();
 	void unload();
 
+	Hunspell *acquireChecker();
+	void releaseChecker(Hunspell *checker);
+	void waitForIdleCheckers();
+	void clearCheckCache();
+
+	// verdicts of check(), sharded by word hash so that parallel checks rarely contend on a lock
+	struct CheckCacheShard {
+		QReadWriteLock lock;
+		QHash<QString, bool> verdicts;
+	};
+	static const int CheckCacheShards = 16;
+	static const int CheckCacheShardLimit = 8192;
+	CheckCacheShard mCheckCache[CheckCacheShards];
+	QAtomicInt mCheckCacheGeneration;
+
 	QString mName;
 	QString mLastError;
 	QString currentDic, ignoreListFileName, spell_encoding;
 	Hunspell * pChecker;
+	QList<Hunspell *> mCheckers; ///< pChecker and further instances on the same dictionary for parallel lookups
+	QList<Hunspell *> mIdleCheckers;
+	int mPendingCheckers;
+	QWaitCondition mCheckerReleased;
+	QByteArray mAffFile, mDicFile;
 	QTextCodec *spellCodec;
 	QStringList ignoredWordList;
 	QSet<QString> ignoredWords;
 	QStringListModel ignoredWordsModel;
-    QMutex mSpellerMutex;
+    QMutex mSpellerMutex; ///< guards pChecker, mCheckers and mIdleCheckers
 };
 
 
@@ -3,6 +3,7 @@
 #include "spellerutility.h"
 #include "tablemanipulation.h"
 #include "latexparser/latexparsing.h"
+#include <QtConcurrent>
 
 /*! \class SyntaxCheck
 *
@@ -66,6 +67,43 @@ void SyntaxCheck::putLine(QDocumentLineHandle *dlh, StackEnvironment previous, T
     //mResultLock.lock(); not possible under windows
     mLinesAvailable.release();
 }
+/*!
+* \brief add a region of lines to the queue
+*
+* The lines are checked in parallel (see checkRegion()), with the same result as if the first line was added by putLine() and all environment stacks of the lines have changed.
+* \param lines consecutive linehandles
+* \param previous environment stack at start of the first line
+* \param stack tokenstack at start of the first line
+* \param guesses environment stacks at the end of the lines from a previous check, used to guess the start context of the parallel parts (may be empty)
+* \param hint line number of first line
+*/
+void SyntaxCheck::putLines(const QList<QDocumentLineHandle *> &lines, StackEnvironment previous, TokenStack stack, const QVector<StackEnvironment> &guesses, int hint)
+{
+	if (lines.isEmpty()) return;
+	if (previous.isEmpty()) return; // sanity check as activeEnv at least contains "normal"
+	SyntaxLine newLine;
+	newLine.region.reserve(lines.size());
+	newLine.regionTickets.reserve(lines.size());
+	foreach (QDocumentLineHandle *dlh, lines) {
+		dlh->ref(); // impede deletion of handle while in syntax check queue
+		dlh->lockForRead();
+		newLine.regionTickets << dlh->getCurrentTicket();
+		dlh->unlock();
+		newLine.region << dlh;
+	}
+	newLine.regionGuesses = guesses;
+	newLine.ticket = newLine.regionTickets.first();
+	newLine.stack = stack;
+	newLine.dlh = lines.first();
+	newLine.prevEnv = previous;
+	newLine.clearOverlay = true;
+	newLine.hint = hint;
+	mLinesLock.lock();
+	mLines.enqueue(newLine);
+	mLinesEnqueuedCounter.ref();
+	mLinesLock.unlock();
+	mLinesAvailable.release();
+}
 /*!
  * \brief remove all outstanding unckecked lines
  * Clear queue as all lines are rechecked
@@ -73,6 +111,10 @@ void SyntaxCheck::putLine(QDocumentLineHandle *dlh, StackEnvironment previous, T
 void SyntaxCheck::clearQueue()
 {
     mLinesLock.lock();
+    foreach (const SyntaxLine &line, mLines) {
+        foreach (QDocumentLineHandle *dlh, line.region)
+            dlh->deref(); // release handles of unchecked regions
+    }
     mLines.clear();
     int n=mLinesAvailable.available();
     if(n>0){
@@ -96,7 +138,7 @@ void SyntaxCheck::stop()
 */
 void SyntaxCheck::run()
 {
-    ltxCommands = QSharedPointer<LatexParser>::create();
+    ltxCommands = QSharedPointer<const LatexParser>(new LatexParser());
 
 	forever {
 		//wait for enqueued lines
@@ -108,7 +150,7 @@ void SyntaxCheck::run()
 			if (newLtxCommandsAvailable) {
 				newLtxCommandsAvailable = false;
                 if(newLtxCommands){
-                    *ltxCommands = *newLtxCommands;
+                    ltxCommands = newLtxCommands;
                 }
                 speller=newSpeller;
                 mReplacementList=newReplacementList;
@@ -126,86 +168,23 @@ void SyntaxCheck::run()
         }
         SyntaxLine newLine = mLines.dequeue();
 		mLinesLock.unlock();
-		// do syntax check
-		newLine.dlh->lockForRead();
-		QString line = newLine.dlh->text();
-		if (newLine.dlh->hasCookie(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE)) {
-			newLine.dlh->unlock();
-			newLine.dlh->lockForWrite();
-			newLine.dlh->removeCookie(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE); //remove possible errors from unclosed envs
+		if (!newLine.region.isEmpty()) {
+			checkRegion(newLine);
+			continue;
 		}
-		TokenList tl = newLine.dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
-        QPair<int,int> commentStart = newLine.dlh->getCookie(QDocumentLine::LEXER_COMMENTSTART_COOKIE).value<QPair<int,int> >();
-		newLine.dlh->unlock();
-
-		StackEnvironment activeEnv = newLine.prevEnv;
-		Ranges newRanges;
-
-        checkLine(line, newRanges, activeEnv, newLine.dlh, tl, newLine.stack, newLine.ticket,commentStart.first);
+		// do syntax check
+		LineResult result;
+		result.dlh = newLine.dlh;
+		result.ticket = newLine.ticket;
+		result.prevEnv = newLine.prevEnv;
+		result.stack = newLine.stack;
+		checkLineHandle(result);
 		// place results
-        if (newLine.clearOverlay){
-            QList<int> fmtList={syntaxErrorFormat,SpellerUtility::spellcheckErrorFormat};
-            fmtList.append(mFormatList.values());
-            newLine.dlh->clearOverlays(fmtList);
-        }
-		//if(newRanges.isEmpty()) continue;
-		newLine.dlh->lockForWrite();
-		if (newLine.ticket == newLine.dlh->getCurrentTicket()) { // discard results if text has been changed meanwhile
-            newLine.dlh->setCookie(QDocumentLine::LEXER_COOKIE,QVariant::fromValue<TokenList>(tl));
-            QList<QFormatRange>grammarOverlays=newLine.dlh->getOverlaysNoLock(m_nonTextGrammarFormats);
-            foreach (const Error &elem, newRanges){
-                if(!mSyntaxChecking && (elem.type!=ERR_spelling) && (elem.type!=ERR_highlight) ){
-                    // skip all syntax errors
-                    continue;
-                }
-                int fmt= (elem.type == ERR_spelling) ? SpellerUtility::spellcheckErrorFormat : syntaxErrorFormat;
-                fmt= (elem.type == ERR_highlight) ? elem.format : fmt;
-                newLine.dlh->addOverlayNoLock(QFormatRange(elem.range.first, elem.range.second, fmt));
-                // for ERR_highlight, remove grammarErrors
-                if(m_hideNonTextGrammarErrors && elem.type==ERR_highlight){
-                    for(int i = 0; i<grammarOverlays.size();++i){
-                        const QFormatRange &range=grammarOverlays.at(i);
-                        if(range.offset>=elem.range.first && range.offset<=elem.range.second){
-                            newLine.dlh->removeOverlayNoLock(range);
-                            grammarOverlays.removeAt(i);
-                            --i;
-                        }
-                    }
-                }
-            }
-            // add comment hightlight if present
-            if(commentStart.first>=0){
-                newLine.dlh->addOverlayNoLock(QFormatRange(commentStart.first, newLine.dlh->length()-commentStart.first, mFormatList["comment"]));
-            }
-			// active envs
-			QVariant oldEnvVar = newLine.dlh->getCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
-			StackEnvironment oldEnv;
-			if (oldEnvVar.isValid())
-				oldEnv = oldEnvVar.value<StackEnvironment>();
-			bool cookieChanged = !equalEnvStack(oldEnv, activeEnv);
+		if (placeResult(result, newLine.clearOverlay)) {
 			//if excessCols has changed the subsequent lines need to be rechecked.
-            // don't on initial check
-            if (cookieChanged) {
-                // handle runAway arguments
-                for (int i = 0; i < activeEnv.size(); i++) {
-                    if (activeEnv[i].runAway == 0) {
-                        activeEnv.remove(i);
-                        --i;
-                    }else{
-                        if(activeEnv[i].runAway>0){
-                            activeEnv[i].runAway = activeEnv[i].runAway - 1;
-                        }
-                    }
-                }
-				QVariant env;
-				env.setValue(activeEnv);
-				newLine.dlh->setCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE, env);
-				newLine.dlh->ref(); // avoid being deleted while in queue
-				//qDebug() << newLine.dlh->text() << ":" << activeEnv.size();
-                emit checkNextLine(newLine.dlh, true, newLine.ticket, newLine.hint);
-            }
+			newLine.dlh->ref(); // avoid being deleted while in queue
+			emit checkNextLine(newLine.dlh, true, newLine.ticket, newLine.hint);
 		}
-		newLine.dlh->unlock();
 
 		newLine.dlh->deref(); //if deleted, delete now
 	}
@@ -213,6 +192,220 @@ void SyntaxCheck::run()
 	ltxCommands = nullptr;
 }
 
+/*!
+* \brief check one line given by its handle
+*
+* Reads text and tokens of result.dlh and checks them with the context given by result.prevEnv and result.stack.
+* Apart from removing an outdated unclosed environment marker, the line is not modified; the result is placed by placeResult().
+* \param result line to check, returns the result
+*/
+void SyntaxCheck::checkLineHandle(LineResult &result) const
+{
+	QDocumentLineHandle *dlh = result.dlh;
+	dlh->lockForRead();
+	QString line = dlh->text();
+	if (dlh->hasCookie(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE)) {
+		dlh->unlock();
+		dlh->lockForWrite();
+		dlh->removeCookie(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE); //remove possible errors from unclosed envs
+	}
+	result.tl = dlh->getTokens();
+	result.commentStart = dlh->getCommentStart().first;
+	dlh->unlock();
+
+	result.activeEnv = result.prevEnv;
+	result.ranges.clear();
+	result.parens.clear();
+	checkLine(line, result.ranges, result.activeEnv, dlh, result.tl, result.stack, result.ticket, result.parens, result.commentStart);
+}
+
+/*!
+* \brief place result of checkLineHandle() on the line
+*
+* Results are discarded if the line has been changed meanwhile.
+* \param result checked line. If the environment stack at line end has changed, activeEnv returns the stack which is passed on to the next line.
+* \param clearOverlay clear syntax overlay
+* \return the environment stack at line end has changed, i.e. the next line needs to be checked
+*/
+bool SyntaxCheck::placeResult(LineResult &result, bool clearOverlay)
+{
+	QDocumentLineHandle *dlh = result.dlh;
+	StackEnvironment &activeEnv = result.activeEnv;
+	bool cookieChanged = false;
+	if (clearOverlay){
+		QList<int> fmtList={syntaxErrorFormat,SpellerUtility::spellcheckErrorFormat};
+		fmtList.append(mFormatList.values());
+		dlh->clearOverlays(fmtList);
+	}
+	//if(newRanges.isEmpty()) continue;
+	dlh->lockForWrite();
+	if (result.ticket == dlh->getCurrentTicket()) { // discard results if text has been changed meanwhile
+		dlh->setTokens(std::move(result.tl));
+		QList<QFormatRange>grammarOverlays=dlh->getOverlaysNoLock(m_nonTextGrammarFormats);
+		foreach (const Error &elem, result.ranges){
+			if(!mSyntaxChecking && (elem.type!=ERR_spelling) && (elem.type!=ERR_highlight) ){
+				// skip all syntax errors
+				continue;
+			}
+			int fmt= (elem.type == ERR_spelling) ? SpellerUtility::spellcheckErrorFormat : syntaxErrorFormat;
+			fmt= (elem.type == ERR_highlight) ? elem.format : fmt;
+			dlh->addOverlayNoLock(QFormatRange(elem.range.first, elem.range.second, fmt));
+			// for ERR_highlight, remove grammarErrors
+			if(m_hideNonTextGrammarErrors && elem.type==ERR_highlight){
+				for(int i = 0; i<grammarOverlays.size();++i){
+					const QFormatRange &range=grammarOverlays.at(i);
+					if(range.offset>=elem.range.first && range.offset<=elem.range.second){
+						dlh->removeOverlayNoLock(range);
+						grammarOverlays.removeAt(i);
+						--i;
+					}
+				}
+			}
+		}
+		// add comment hightlight if present
+		if(result.commentStart>=0){
+			dlh->addOverlayNoLock(QFormatRange(result.commentStart, dlh->length()-result.commentStart, mFormatList["comment"]));
+		}
+		// active envs
+		QVariant oldEnvVar = dlh->getCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
+		StackEnvironment oldEnv;
+		if (oldEnvVar.isValid())
+			oldEnv = oldEnvVar.value<StackEnvironment>();
+		cookieChanged = !equalEnvStack(oldEnv, activeEnv);
+		if (cookieChanged) {
+			decreaseRunAway(activeEnv);
+			QVariant env;
+			env.setValue(activeEnv);
+			dlh->setCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE, env);
+		}
+	}
+	dlh->unlock();
+	addParenthesis(dlh, result.parens);
+	return cookieChanged;
+}
+
+/*!
+* \brief handle runaway arguments at line end
+*
+* Removes environments whose runaway limit is reached and decreases the limit of the others.
+*/
+void SyntaxCheck::decreaseRunAway(StackEnvironment &env)
+{
+	for (int i = 0; i < env.size(); i++) {
+		if (env[i].runAway == 0) {
+			env.remove(i);
+			--i;
+		}else{
+			if(env[i].runAway>0){
+				env[i].runAway = env[i].runAway - 1;
+			}
+		}
+	}
+}
+
+/*!
+* \brief merge parenthesis found by the syntax check into the parenthesis of the line
+*
+* Parenthesis at the same offset are replaced.
+*/
+void SyntaxCheck::addParenthesis(QDocumentLineHandle *dlh, const QVector<QParenthesis> &parens)
+{
+	if(parens.isEmpty())
+		return;
+	// merge original parenthesis vector with new additions
+	// skip duplicates
+	QVector<QParenthesis> original_parens=dlh->parenthesis();
+	QVector<QParenthesis> result;
+	int i=0;
+	for(int j=0;j<parens.length();++j){
+		while(i<original_parens.size() && original_parens[i].offset<parens[j].offset){
+			result<<original_parens[i];
+			++i;
+		}
+		if(i<original_parens.size() && parens[j].offset==original_parens[i].offset){
+			++i;
+		}
+		result<<parens[j];
+	}
+	for(;i<original_parens.size();++i){
+		result<<original_parens[i];
+	}
+	dlh->setParenthesis(result);
+}
+
+/*!
+* \brief check a whole region of lines, split into parts which are checked in parallel
+*
+* The environment stack at the start of each part is not known before the preceding part has been checked.
+* Each part therefore assumes the stack from regionGuesses (the result of the previous check) or, if unknown, the stack at region start.
+* Afterwards the parts are verified in order: if the assumed stack differs from the actual one, the lines of the part are checked again
+* until the results coincide with the speculative ones (the check of a line only depends on its text and its start context).
+* Finally, results are placed line by line exactly as in the sequential check, i.e. placing stops at the first changed line or unchanged environment stack.
+* \param region region to check
+*/
+void SyntaxCheck::checkRegion(const SyntaxLine &region)
+{
+	const int n = region.region.size();
+	const int threads = qMax(1, QThread::idealThreadCount());
+	const int partSize = qMax(MIN_REGION_PART_SIZE, (n + threads - 1) / threads);
+
+	QVector<LineResult> results(n);
+	QVector<int> partStarts;
+	for (int i = 0; i < n; i++) {
+		LineResult &result = results[i];
+		result.dlh = region.region.at(i);
+		result.ticket = region.regionTickets.at(i);
+		result.commentStart = -1;
+		if (i % partSize == 0) {
+			partStarts << i;
+			if (i == 0 || region.regionGuesses.value(i - 1).isEmpty())
+				result.prevEnv = region.prevEnv;
+			else
+				result.prevEnv = region.regionGuesses.at(i - 1);
+		}
+	}
+
+	// check parts speculatively
+	QtConcurrent::blockingMap(partStarts, [&](int from) {
+		int to = qMin(from + partSize, n);
+		StackEnvironment env = results[from].prevEnv;
+		for (int i = from; i < to && !stopped; i++) {
+			LineResult &result = results[i];
+			result.prevEnv = env;
+			result.stack = (i == 0) ? region.stack : region.region.at(i - 1)->getRemainderLocked();
+			checkLineHandle(result);
+			env = result.activeEnv;
+			decreaseRunAway(env);
+		}
+	});
+
+	// verify assumed contexts, a line checked with the correct context stays valid
+	StackEnvironment env = region.prevEnv;
+	for (int i = 0; i < n && !stopped; i++) {
+		LineResult &result = results[i];
+		if (!identicalEnvStack(result.prevEnv, env)) {
+			result.prevEnv = env;
+			checkLineHandle(result);
+		}
+		env = result.activeEnv;
+		decreaseRunAway(env);
+	}
+
+	// place results
+	int i = 0;
+	bool continueCheck = true;
+	for (; i < n && continueCheck && !stopped; i++) {
+		continueCheck = placeResult(results[i], i == 0 ? region.clearOverlay : true);
+	}
+	if (continueCheck && !stopped) {
+		QDocumentLineHandle *last = region.region.last();
+		last->ref(); // avoid being deleted while in queue
+		emit checkNextLine(last, true, region.regionTickets.last(), region.hint < 0 ? -1 : region.hint + n - 1);
+	}
+	foreach (QDocumentLineHandle *dlh, region.region)
+		dlh->deref(); //if deleted, delete now
+}
+
 /*!
 * \brief get error description for syntax error in line 'dlh' at column 'pos'
 * \param dlh linehandle
@@ -226,10 +419,12 @@ QString SyntaxCheck::getErrorAt(QDocumentLineHandle *dlh, int pos, StackEnvironm
 	// do syntax check
 	QString line = dlh->text();
 	QStack<Environment> activeEnv = previous;
-	TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
-    QPair<int,int> commentStart = dlh->getCookieLocked(QDocumentLine::LEXER_COMMENTSTART_COOKIE).value<QPair<int,int> >();
+	TokenList tl = dlh->getTokensLocked();
+    QPair<int,int> commentStart = dlh->getCommentStartLocked();
 	Ranges newRanges;
-    checkLine(line, newRanges, activeEnv, dlh, tl, stack, dlh->getCurrentTicket(),commentStart.first);
+	QVector<QParenthesis> parens;
+    checkLine(line, newRanges, activeEnv, dlh, tl, stack, dlh->getCurrentTicket(), parens, commentStart.first);
+	addParenthesis(dlh, parens);
 	// add Error for unclosed env
 	QVariant var = dlh->getCookieLocked(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE);
 	if (var.isValid()) {
@@ -282,15 +477,16 @@ QString SyntaxCheck::getErrorAt(QDocumentLineHandle *dlh, int pos, StackEnvironm
 
 /*!
 * \brief set latex commands which are referenced for syntax checking
+* The checker thread works on an immutable snapshot. As the containers of LatexParser are implicitly shared, taking the snapshot is cheap and later changes of cmds detach from it.
 * \param cmds
 */
 void SyntaxCheck::setLtxCommands(QSharedPointer<LatexParser> cmds)
 {
 	if (stopped) return;
+	QSharedPointer<const LatexParser> snapshot(new LatexParser(*cmds));
 	mLtxCommandLock.lock();
 	newLtxCommandsAvailable = true;
-    newLtxCommands = QSharedPointer<LatexParser>::create();
-    *newLtxCommands = *cmds;
+    newLtxCommands = snapshot;
     mLtxCommandLock.unlock();
 }
 
@@ -397,7 +593,7 @@ void SyntaxCheck::waitForQueueProcess(void)
 * \param id check for `id` of the environment, <0 means check is disabled
 * \return environment id or 0
 */
-int SyntaxCheck::topEnv(const QString &name, const StackEnvironment &envs, const int id)
+int SyntaxCheck::topEnv(const QString &name, const StackEnvironment &envs, const int id) const
 {
 	if (envs.isEmpty())
 		return 0;
@@ -425,7 +621,7 @@ int SyntaxCheck::topEnv(const QString &name, const StackEnvironment &envs, const
 * \param id if >=0 check if the env has the given id.
 * \return environment id of  found env otherwise 0
 */
-int SyntaxCheck::containsEnv(const QString &name, const StackEnvironment &envs, const int id)
+int SyntaxCheck::containsEnv(const QString &name, const StackEnvironment &envs, const int id) const
 {
 	for (int i = envs.size() - 1; i > -1; --i) {
 		Environment env = envs.at(i);
@@ -452,7 +648,7 @@ int SyntaxCheck::containsEnv(const QString &name, const StackEnvironment &envs,
  * \param envs stack of environements
  * \return math is active (true) or not (false)
  */
-bool SyntaxCheck::checkMathEnvActive(const StackEnvironment &envs)
+bool SyntaxCheck::checkMathEnvActive(const StackEnvironment &envs) const
 {
     for (int i = envs.size() - 1; i > -1; --i) {
         Environment env = envs.at(i);
@@ -479,7 +675,7 @@ bool SyntaxCheck::checkMathEnvActive(const StackEnvironment &envs)
 * \param envs environment stack
 * \return is valid
 */
-bool SyntaxCheck::checkCommand(const QString &cmd, const StackEnvironment &envs)
+bool SyntaxCheck::checkCommand(const QString &cmd, const StackEnvironment &envs) const
 {
     bool textOrMathEnvUsed=false;
     for (int i = envs.size()-1; i > -1; --i) {
@@ -532,6 +728,26 @@ bool SyntaxCheck::equalEnvStack(StackEnvironment env1, StackEnvironment env2)
 	return true;
 }
 
+/*!
+* \brief compare two environment stacks including all internal information
+*
+* In contrast to equalEnvStack(), also starting line, ticket, columns and runaway counter are compared, i.e. checking a line with either stack gives the same result.
+* \param env1
+* \param env2
+* \return are identical
+*/
+bool SyntaxCheck::identicalEnvStack(const StackEnvironment &env1, const StackEnvironment &env2)
+{
+	if (env1.size() != env2.size())
+		return false;
+	for (int i = 0; i < env1.size(); i++) {
+		const Environment &e1 = env1.at(i), &e2 = env2.at(i);
+		if (e1 != e2 || e1.runAway != e2.runAway || e1.dlh != e2.dlh || e1.startingColumn != e2.startingColumn || e1.endingColumn != e2.endingColumn || e1.ticket != e2.ticket)
+			return false;
+	}
+	return true;
+}
+
 /*!
 * \brief mark environment start
 *
@@ -592,8 +808,11 @@ bool SyntaxCheck::stackContainsDefinition(const TokenStack &stack) const
 * \param tl tokenlist of line
 * \param stack token stack at start of line
 * \param ticket ticket number for current processed line
+* \param parens returns parenthesis found by the syntax check, to be added to the line with addParenthesis()
+*
+* Apart from the given arguments, no state is modified. Thus lines can be checked in parallel.
 */
-void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnvironment &activeEnv, QDocumentLineHandle *dlh, TokenList &tl, TokenStack stack, int ticket,int commentStart)
+void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnvironment &activeEnv, QDocumentLineHandle *dlh, TokenList &tl, TokenStack stack, int ticket, QVector<QParenthesis> &parens, int commentStart) const
 {
 	// do syntax check on that line
     //int cols = containsEnv(*ltxCommands, "tabular", activeEnv);
@@ -612,7 +831,6 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
             */
         }
     }
-    QVector<QParenthesis> m_parens;
     // check command-words
 	for (int i = 0; i < tl.length(); i++) {
         Token &tk = tl[i];
@@ -624,7 +842,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
         // handle single command env stop e.g. \ExplSyntaxOff
         if(tk.type==Token::command){
             const QString word=tk.getText();
-            if(ltxCommands->possibleCommands["%endEnv"].contains(word)){
+            if(ltxCommands->possibleCommands.value("%endEnv").contains(word)){
                 const QString envName=ltxCommands->environmentAliases.value(word);
                 if(activeEnv.top().name == envName){
                     activeEnv.pop();
@@ -871,7 +1089,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                 elem.range = QPair<int, int>(tk.start, tk.length);
                 newRanges.append(elem);
                 QParenthesis p(61,17,tk.start,tk.length);
-                m_parens.append(p);
+                parens.append(p);
                 continue;
 			}
 			if (ltxCommands->mathStopCommands.contains(word) && !activeEnv.isEmpty() && activeEnv.top().name == "math") {
@@ -895,7 +1113,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                     elem.range = QPair<int, int>(tk.start, tk.length);
                     newRanges.append(elem);
                     QParenthesis p(61,18,tk.start,tk.length);
-                    m_parens.append(p);
+                    parens.append(p);
 				}// ignore mismatching mathstop commands
 				continue;
 			}
@@ -937,7 +1155,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                     }
                 }
             }
-            if (ltxCommands->possibleCommands["user"].contains(word))
+            if (ltxCommands->possibleCommands.value("user").contains(word))
 				continue;
 			if (!checkCommand(word, activeEnv)) {
 				Error elem;
@@ -1077,8 +1295,11 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
             if (word.contains('@')) {
                 continue; //ignore commands containg @
             }
-            if(!tk.optionalCommandName.isEmpty() && !tk.optionalCommandName.contains("/")){
-				word=tk.optionalCommandName;
+            if(tk.hasOptionalCommandName()){
+                const QString name=tk.optionalCommandName();
+                if(!name.contains("/")){
+                    word=name;
+                }
             }
 			Token tkEnvName;
 
@@ -1092,7 +1313,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
             // special treatment for \ExplSyntaxOn, \ExplSyntaxOff
             // \ProvidesExplPackage, \ProvidesExplClass and \ProvidesExplFile
             // activate latex3 mode which ignores _ in commandnames
-            if(ltxCommands->possibleCommands["%beginEnv"].contains(word)){
+            if(ltxCommands->possibleCommands.value("%beginEnv").contains(word)){
                 const QString envName=ltxCommands->environmentAliases.value(word);
                 Environment env;
                 env.name = envName;
@@ -1132,7 +1353,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                 elem.range = QPair<int, int>(tk.start, tk.length);
                 newRanges.append(elem);
                 QParenthesis p(61,17,tk.start,tk.length);
-                m_parens.append(p);
+                parens.append(p);
 				continue;
 			}
 			if (ltxCommands->mathStopCommands.contains(word) && !activeEnv.isEmpty() && activeEnv.top().name == "math") {
@@ -1156,7 +1377,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                     elem.range = QPair<int, int>(tk.start, tk.length);
                     newRanges.append(elem);
                     QParenthesis p(61,18,tk.start,tk.length);
-                    m_parens.append(p);
+                    parens.append(p);
 				}// ignore mismatching mathstop commands
 				continue;
 			}
@@ -1256,7 +1477,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                 }
             }
 
-            if (ltxCommands->possibleCommands["user"].contains(word))
+            if (ltxCommands->possibleCommands.value("user").contains(word))
 				continue;
 
 			if (!checkCommand(word, activeEnv)) {
@@ -1271,11 +1492,11 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 				}
 
 
-				if (ltxCommands->possibleCommands["math"].contains(word))
+				if (ltxCommands->possibleCommands.value("math").contains(word))
 					elem.type = ERR_MathCommandOutsideMath;
-				if (ltxCommands->possibleCommands["tabular"].contains(word))
+				if (ltxCommands->possibleCommands.value("tabular").contains(word))
 					elem.type = ERR_TabularCommandOutsideTab;
-				if (ltxCommands->possibleCommands["tabbing"].contains(word))
+				if (ltxCommands->possibleCommands.value("tabbing").contains(word))
 					elem.type = ERR_TabbingCommandOutside;
 				if(elem.type== ERR_unrecognizedEnvironment){
 					// try to find command in unspecified envs
@@ -1287,7 +1508,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 					foreach (QString key, keys) {
 						if(key.contains("%"))
 							continue;
-						if(ltxCommands->possibleCommands[key].contains(word)){
+						if(ltxCommands->possibleCommands.value(key).contains(word)){
 							elem.type = ERR_commandOutsideEnv;
 							break;
 						}
@@ -1301,7 +1522,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 		if (tk.type == Token::specialArg) {
 			QString value = line.mid(tk.start, tk.length);
 			QString special = ltxCommands->mapSpecialArgs.value(int(tk.type - Token::specialArg));
-			if (!ltxCommands->possibleCommands[special].contains(value)) {
+			if (!ltxCommands->possibleCommands.value(special).contains(value)) {
 				Error elem;
 				elem.range = QPair<int, int>(tk.start, tk.length);
 				elem.type = ERR_unrecognizedKey;
@@ -1310,7 +1531,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 		}
 		if (tk.type == Token::keyVal_key) {
 			// special treatment for key val checking
-			QString command = tk.optionalCommandName;
+			QString command = tk.optionalCommandName();
 			QString value = line.mid(tk.start, tk.length);
 
 			// search stored keyvals
@@ -1346,7 +1567,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 				elem.clear();
 			}
 			if (!elem.isEmpty()) {
-				QStringList lst = ltxCommands->possibleCommands[elem].values();
+				QStringList lst = ltxCommands->possibleCommands.value(elem).values();
 				QStringList::iterator iterator;
 				QStringList toAppend;
 				for (iterator = lst.begin(); iterator != lst.end(); ++iterator) {
@@ -1359,7 +1580,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 						*iterator = iterator->left(i);
 					}
 					if (iterator->startsWith("%")) {
-						toAppend << ltxCommands->possibleCommands[*iterator].values();
+						toAppend << ltxCommands->possibleCommands.value(*iterator).values();
 					}
 				}
 				lst << toAppend;
@@ -1378,7 +1599,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                 continue; // assume open brace is always valid or element in braces can't be checked (will get here again w/o braces)
             }
 			// first get command
-            QString command = tk.optionalCommandName;
+            QString command = tk.optionalCommandName();
             int index=command.indexOf('/');
             QString key=command.mid(index+1);
             command=command.left(index);
@@ -1414,7 +1635,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 			}
 			if (!elem.isEmpty()) {
 				// check whether keys is valid
-				QStringList lst = ltxCommands->possibleCommands[elem].values();
+				QStringList lst = ltxCommands->possibleCommands.value(elem).values();
 				QStringList::iterator iterator;
 				QString options;
 				for (iterator = lst.begin(); iterator != lst.end(); ++iterator) {
@@ -1439,7 +1660,7 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
                         continue; // ignore values for syntax checking (#c)
                     }
                     if(options.startsWith("%")){
-                        if (!ltxCommands->possibleCommands[options].contains(word)) {
+                        if (!ltxCommands->possibleCommands.value(options).contains(word)) {
                             // special treatement for %color (mix)
                             if(options=="%color"){
                                 if(word=="!") continue;
@@ -1465,27 +1686,6 @@ void SyntaxCheck::checkLine(const QString &line, Ranges &newRanges, StackEnviron
 			}
 		}
 	}
-    if(!m_parens.isEmpty()){
-        // merge original parenthesis vector with new additions
-        // skip duplicates
-        QVector<QParenthesis> original_parens=dlh->parenthesis();
-        QVector<QParenthesis> result;
-        int i=0;
-        for(int j=0;j<m_parens.length();++j){
-            while(i<original_parens.size() && original_parens[i].offset<m_parens[j].offset){
-                result<<original_parens[i];
-                ++i;
-            }
-            if(i<original_parens.size() && m_parens[j].offset==original_parens[i].offset){
-                ++i;
-            }
-            result<<m_parens[j];
-        }
-        for(;i<original_parens.size();++i){
-            result<<original_parens[i];
-        }
-        dlh->setParenthesis(result);
-    }
     if(!activeEnv.isEmpty()){
         //check active env for env highlighting (math,verbatim)
         QStack<Environment>::Iterator it=activeEnv.begin();
@@ -17,7 +17,7 @@ class SpellerUtility;
 class Environment
 {
 public:
-    Environment(): id(-1), excessCol(0), dlh(nullptr),endingColumn(-1) , ticket(0), level(0) {} ///< constructor
+    Environment(): id(-1), excessCol(0), dlh(nullptr), startingColumn(-1), endingColumn(-1) , ticket(0), level(0) {} ///< constructor
 
 	QString name; ///< name of environment, partially an alias is used, e.g. math instead of '$'
     QString origName; ///< original name of environment if alias is used, otherwise empty
@@ -84,6 +84,9 @@ public:
 		QDocumentLineHandle *dlh; ///< linehandle
         int hint; ///< hint on lineNumber for faster look-up
         bool initialRun;
+        QVector<QDocumentLineHandle *> region; ///< all lines (starting with dlh) if a whole region is checked at once, see putLines()
+        QVector<int> regionTickets; ///< ticket numbers of the region lines
+        QVector<StackEnvironment> regionGuesses; ///< environment stacks at the end of the region lines from the previous check (may be empty)
 	};
 
     /*!
@@ -97,9 +100,12 @@ public:
 
 	typedef QList<Error > Ranges;
 
+    static const int MIN_REGION_PART_SIZE = 100; ///< minimal number of lines of a region which are checked by one thread, see checkRegion()
+
     explicit SyntaxCheck(QObject *parent = nullptr);
 
     void putLine(QDocumentLineHandle *dlh, StackEnvironment previous, TokenStack stack, bool clearOverlay = false,int hint=-1);
+    void putLines(const QList<QDocumentLineHandle *> &lines, StackEnvironment previous, TokenStack stack, const QVector<StackEnvironment> &guesses, int hint=-1);
     void clearQueue();
 	void stop();
 	void setErrFormat(int errFormat);
@@ -107,11 +113,12 @@ public:
 #ifndef NO_TESTS
 	void waitForQueueProcess(void);
 #endif
-    int containsEnv(const QString &name, const StackEnvironment &envs, const int id = -1);
-    bool checkMathEnvActive(const StackEnvironment &envs);
-	int topEnv(const QString &name, const StackEnvironment &envs, const int id = -1);
-	bool checkCommand(const QString &cmd, const StackEnvironment &envs);
+    int containsEnv(const QString &name, const StackEnvironment &envs, const int id = -1) const;
+    bool checkMathEnvActive(const StackEnvironment &envs) const;
+	int topEnv(const QString &name, const StackEnvironment &envs, const int id = -1) const;
+	bool checkCommand(const QString &cmd, const StackEnvironment &envs) const;
 	static bool equalEnvStack(StackEnvironment env1, StackEnvironment env2);
+	static bool identicalEnvStack(const StackEnvironment &env1, const StackEnvironment &env2);
 
     void setLtxCommands(QSharedPointer<LatexParser> cmds);
     void setSpeller(SpellerUtility *su);
@@ -131,9 +138,30 @@ signals:
 
 protected:
 	void run();
-    void checkLine(const QString &line, Ranges &newRanges, StackEnvironment &activeEnv, QDocumentLineHandle *dlh, TokenList &tl, TokenStack stack, int ticket, int commentStart=-1);
+    void checkLine(const QString &line, Ranges &newRanges, StackEnvironment &activeEnv, QDocumentLineHandle *dlh, TokenList &tl, TokenStack stack, int ticket, QVector<QParenthesis> &parens, int commentStart=-1) const;
 
 private:
+    /*!
+     * \brief result of checking one line, kept until it is placed on the line
+     */
+	struct LineResult {
+		QDocumentLineHandle *dlh; ///< linehandle
+		int ticket; ///< ticket number at time of enqueueing
+		StackEnvironment prevEnv; ///< environmentstack at start of line
+		TokenStack stack; ///< tokenstack at start of line
+		TokenList tl; ///< tokens of the line, updated by the check
+		int commentStart; ///< column of comment start or -1
+		Ranges ranges; ///< found errors and highlights
+		QVector<QParenthesis> parens; ///< found parenthesis
+		StackEnvironment activeEnv; ///< environmentstack at end of line
+	};
+
+	void checkLineHandle(LineResult &result) const;
+	bool placeResult(LineResult &result, bool clearOverlay);
+	void checkRegion(const SyntaxLine &region);
+	static void addParenthesis(QDocumentLineHandle *dlh, const QVector<QParenthesis> &parens);
+	static void decreaseRunAway(StackEnvironment &env);
+
 	QQueue<SyntaxLine> mLines;
 	QSemaphore mLinesAvailable;
 	QMutex mLinesLock;
@@ -143,9 +171,9 @@ private:
     int syntaxErrorFormat;
     bool m_hideNonTextGrammarErrors=true;
     QList<int> m_nonTextGrammarFormats,m_newNonTextGrammarFormats;
-    QSharedPointer<LatexParser> ltxCommands;
+    QSharedPointer<const LatexParser> ltxCommands; ///< snapshot used by the checker thread
 
-    QSharedPointer<LatexParser> newLtxCommands;
+    QSharedPointer<const LatexParser> newLtxCommands; ///< published snapshot, taken over by the checker thread
 	bool newLtxCommandsAvailable;
 	QMutex mLtxCommandLock;
 	bool stackContainsDefinition(const TokenStack &stack) const;
@@ -38,7 +38,7 @@ void LatexTables::addRow(QDocumentCursor &c, Environment env)
     QDocument *doc=dlh->document();
     int ln = doc->indexOf(dlh,c.lineNumber());
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int nextLine,nextCol;
     Token tkColDef=getDef(tl,env,ln,nextLine,nextCol,doc);
@@ -141,7 +141,7 @@ void LatexTables::removeRow(QDocumentCursor &c, Environment env)
     QDocument *doc=dlh->document();
     int ln = doc->indexOf(dlh,c.lineNumber());
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int nextLine,nextCol;
     Token tkColDef=getDef(tl,env,ln,nextLine,nextCol,doc);
@@ -183,7 +183,7 @@ void LatexTables::addColumn(Environment env, const int lineNumber, const int aft
     QDocument *doc=dlh->document();
     int ln = doc->indexOf(dlh,lineNumber);
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int nextLine,nextCol;
     Token tkColDef=getDef(tl,env,ln,nextLine,nextCol,doc);
@@ -289,7 +289,7 @@ void LatexTables::removeColumn(Environment env, const int lineNumber, const int
     QDocument *doc=dlh->document();
     int ln = doc->indexOf(dlh,lineNumber);
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int nextLine,nextCol;
     Token tkColDef=getDef(tl,env,ln,nextLine,nextCol,doc);
@@ -496,7 +496,7 @@ Token LatexTables::findColumn(QDocumentCursor &cur, Environment env)
     do{
     QDocumentLineHandle *dlh=doc->line(ln).handle();
     dlh->lockForRead();
-    tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    tl = dlh->getTokens();
     dlh->unlock();
     }while(tl.isEmpty() && ++ln<doc->lineCount()); // skip empty lines)
     if(tl.isEmpty()){
@@ -599,7 +599,7 @@ Token LatexTables::findColumn(QDocumentCursor &cur, Environment env)
             ignoreUntilColumn=-1; // reset ignore column
             QDocumentLineHandle *dlh=doc->line(ln).handle();
             dlh->lockForRead();
-            tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl = dlh->getTokens();
             dlh->unlock();
         }
     }
@@ -620,7 +620,7 @@ bool LatexTables::findNextColumn(QDocumentCursor &cur, Token &tk)
     QDocument *doc=cur.document();
     QDocumentLineHandle *dlh=doc->line(ln).handle();
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int i;
     int j=-1;
@@ -666,7 +666,7 @@ bool LatexTables::findNextColumn(QDocumentCursor &cur, Token &tk)
             }
             dlh=doc->line(ln).handle();
             dlh->lockForRead();
-            tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl = dlh->getTokens();
             dlh->unlock();
             i=-1; // reset token index
         }
@@ -693,7 +693,7 @@ LatexTables::NextRowAvailable LatexTables::findRow(QDocumentCursor &cur, Environ
     do{
         QDocumentLineHandle *dlh=doc->line(ln).handle();
         dlh->lockForRead();
-        tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        tl = dlh->getTokens();
         dlh->unlock();
     }while(tl.isEmpty() && ++ln<doc->lineCount()); // skip empty lines)
     if(tl.isEmpty()){
@@ -790,7 +790,7 @@ LatexTables::NextRowAvailable LatexTables::findRow(QDocumentCursor &cur, Environ
             ignoreUntilColumn=-1; // reset ignore column
             QDocumentLineHandle *dlh=doc->line(ln).handle();
             dlh->lockForRead();
-            tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            tl = dlh->getTokens();
             dlh->unlock();
         }
     }
@@ -834,7 +834,7 @@ int LatexTables::getColumn(const QDocumentCursor &cur,const Environment env)
     QDocument *doc=cur.document();
     QDocumentLineHandle *dlh=doc->line(ln).handle();
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int ignoreUntilColumn=-1; // special ignore new row cmd in tblr (multi line cells)
     for(int i=0;i<tl.size();++i){
@@ -1096,7 +1096,7 @@ void LatexTables::addHLine(QDocumentCursor &c, const Environment &env, const boo
     QDocument *doc=dlh->document();
     int ln = doc->indexOf(dlh,c.lineNumber());
     dlh->lockForRead();
-    TokenList tl = dlh->getCookie(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokens();
     dlh->unlock();
     int nextLine,nextCol;
     Token tkColDef=getDef(tl,env,ln,nextLine,nextCol,doc);
@@ -0,0 +1,238 @@
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include "grammarcheck_t.h"
+#include "grammarcheck.h"
+#include "latexparser/latexparser.h"
+#include "qdocument.h"
+#include "qdocumentline.h"
+#include "testutil.h"
+#include <QtTest/QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace {
+/*!
+ * \brief minimal LanguageTool server on localhost
+ * Reports every "teh" as error and counts the requests. Each reply is delayed to simulate the checking time of LanguageTool.
+ * While failing is set, the server answers with an internal error instead.
+ */
+class MockLanguageTool
+{
+public:
+	MockLanguageTool(int delay): requests(0), failing(false), delay(delay)
+	{
+		QObject::connect(&server, &QTcpServer::newConnection, [this]() {
+			while (QTcpSocket *socket = server.nextPendingConnection()) {
+				QSharedPointer<QByteArray> buffer = QSharedPointer<QByteArray>::create();
+				QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket, buffer]() { readRequests(socket, *buffer); });
+				QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			}
+		});
+		server.listen(QHostAddress::LocalHost);
+	}
+	bool isListening() const { return server.isListening(); }
+	QString url() const { return QString("http://127.0.0.1:%1/").arg(server.serverPort()); }
+
+	int requests;
+	bool failing;
+
+private:
+	void readRequests(QTcpSocket *socket, QByteArray &buffer)
+	{
+		buffer += socket->readAll();
+		forever {
+			int headerEnd = buffer.indexOf("\r\n\r\n");
+			if (headerEnd < 0) return;
+			QRegularExpressionMatch match = QRegularExpression("content-length: *(\\d+)", QRegularExpression::CaseInsensitiveOption).match(QString::fromLatin1(buffer.left(headerEnd)));
+			int length = match.hasMatch() ? match.captured(1).toInt() : 0;
+			if (buffer.size() < headerEnd + 4 + length) return;
+			QByteArray body = buffer.mid(headerEnd + 4, length);
+			buffer.remove(0, headerEnd + 4 + length);
+			requests++;
+			QByteArray response = failing ? QByteArray("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 6\r\n\r\nError.") : reply(body);
+			QTimer::singleShot(delay, socket, [socket, response]() { socket->write(response); });
+		}
+	}
+
+	static QByteArray reply(QByteArray body)
+	{
+		if (body.endsWith('\n')) body.chop(1);
+		QString text = QUrl::fromPercentEncoding(body.mid(body.indexOf("&text=") + 6));
+		QJsonArray matches;
+		QRegularExpressionMatchIterator it = QRegularExpression("\\bteh\\b").globalMatch(text);
+		while (it.hasNext()) {
+			QRegularExpressionMatch m = it.next();
+			QJsonObject match;
+			match["offset"] = m.capturedStart();
+			match["length"] = m.capturedLength();
+			match["message"] = "Possible typo";
+			match["shortMessage"] = "Typo";
+			match["replacements"] = QJsonArray() << QJsonObject({{"value", "the"}});
+			match["context"] = QJsonObject({{"text", "teh"}, {"offset", 0}});
+			match["rule"] = QJsonObject({{"id", "MOCK_TYPO"}});
+			matches << match;
+		}
+		QJsonObject result;
+		result["matches"] = matches;
+		QByteArray json = QJsonDocument(result).toJson(QJsonDocument::Compact);
+		return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(json.size()) + "\r\n\r\n" + json;
+	}
+
+	QTcpServer server;
+	int delay;
+};
+
+GrammarCheckerConfig mockConfig(const QString &url, const QString &cachingDir)
+{
+	GrammarCheckerConfig config;
+	config.longRangeRepetitionCheck = false;
+	config.maxRepetitionDelta = 3;
+	config.maxRepetitionLongRangeDelta = 10;
+	config.maxRepetitionLongRangeMinWordLength = 6;
+	config.badWordCheck = false;
+	config.languageToolURL = url;
+	config.languageToolAutorun = false;
+	config.cachingDir = cachingDir;
+	return config;
+}
+
+/*!
+ * \brief check every paragraph of the document separately like the editor after loading, wait for all results
+ */
+void checkParagraphs(GrammarCheck *gc, QDocument *doc, QHash<int, QList<GrammarError> > &results)
+{
+	results.clear();
+	QMetaObject::Connection c = QObject::connect(gc, &GrammarCheck::checked, [&results](LatexDocument *, QDocumentLineHandle *, int lineNr, const QList<GrammarError> &errors) {
+		results.insert(lineNr, errors);
+	});
+	QElapsedTimer timer;
+	timer.start();
+	int expected = 0;
+	for (int i = 0; i < doc->lines(); i++) {
+		if (doc->line(i).text().isEmpty()) continue;
+		gc->check("en_US", nullptr, QList<LineInfo>() << LineInfo(doc->line(i).handle()), i);
+		expected++;
+	}
+	while (results.size() < expected && timer.elapsed() < 10000)
+		QTest::qWait(5);
+	QObject::disconnect(c);
+}
+}
+
+void GrammarCheckTest::cacheAndBatching_data(){
+	QTest::addColumn<int>("paragraphs");
+	QTest::addColumn<int>("delay");
+
+	QTest::newRow("few paragraphs") << 5 << 10;
+	if (!all) {
+		qDebug("skipped large grammar check tests");
+		return;
+	}
+	QTest::newRow("many paragraphs") << 200 << 10;
+	QTest::newRow("many paragraphs, slow server") << 200 << 100;
+}
+
+void GrammarCheckTest::cacheAndBatching(){
+	QFETCH(int, paragraphs);
+	QFETCH(int, delay);
+
+	MockLanguageTool lt(delay);
+	QVERIFY(lt.isListening());
+	QTemporaryDir cachingDir;
+	QVERIFY(cachingDir.isValid());
+
+	QStringList lines;
+	for (int i = 0; i < paragraphs; i++)
+		lines << QString("Paragraph %1 has teh typo in it.").arg(i) << "";
+	QDocument doc;
+	doc.setText(lines.join("\n"), false);
+
+	GrammarCheck *gc = new GrammarCheck();
+	gc->init(LatexParser::getInstance(), mockConfig(lt.url(), cachingDir.path()));
+
+	QHash<int, QList<GrammarError> > results;
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), paragraphs);
+	for (int i = 0; i < paragraphs; i++) {
+		const QList<GrammarError> &errors = results.value(2 * i);
+		QEQUAL(errors.size(), 1);
+		QEQUAL(errors.first().offset, doc.line(2 * i).text().indexOf("teh"));
+		QEQUAL(errors.first().length, 3);
+		QEQUAL(errors.first().corrections.join(","), QString("the"));
+	}
+	int uncachedRequests = lt.requests;
+	QVERIFY(uncachedRequests > 0);
+	QVERIFY(uncachedRequests < paragraphs);
+
+	// checking the same text again (e.g. after undo) is answered from the cache
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), paragraphs);
+	QEQUAL(results.value(0).size(), 1);
+	QEQUAL(lt.requests, uncachedRequests);
+
+	// the cache is stored on shutdown and used after restarting
+	QPointer<GrammarCheck> oldGc = gc;
+	gc->shutdown();
+	while (oldGc)
+		QTest::qWait(5);
+	gc = new GrammarCheck();
+	gc->init(LatexParser::getInstance(), mockConfig(lt.url(), cachingDir.path()));
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), paragraphs);
+	QEQUAL(results.value(2 * (paragraphs - 1)).size(), 1);
+	QEQUAL(lt.requests, uncachedRequests);
+
+	// changed settings invalidate the cache
+	GrammarCheckerConfig config = mockConfig(lt.url(), cachingDir.path());
+	config.languageToolIgnoredRules = "SOME_RULE";
+	gc->init(LatexParser::getInstance(), config);
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), paragraphs);
+	QVERIFY(lt.requests > uncachedRequests);
+
+	oldGc = gc;
+	gc->shutdown();
+	while (oldGc)
+		QTest::qWait(5);
+}
+
+void GrammarCheckTest::failedRepliesNotCached(){
+	MockLanguageTool lt(0);
+	QVERIFY(lt.isListening());
+	QTemporaryDir cachingDir;
+	QVERIFY(cachingDir.isValid());
+
+	QDocument doc;
+	doc.setText("This has teh typo.\n\nThis one too: teh.", false);
+
+	GrammarCheck *gc = new GrammarCheck();
+	gc->init(LatexParser::getInstance(), mockConfig(lt.url(), cachingDir.path()));
+
+	// a server error still answers every line, but without backend errors
+	lt.failing = true;
+	QHash<int, QList<GrammarError> > results;
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), 2);
+	QVERIFY(results.value(0).isEmpty());
+	QVERIFY(results.value(2).isEmpty());
+	int failedRequests = lt.requests;
+	QVERIFY(failedRequests > 0);
+
+	// the failed reply was not cached, so the text is sent again
+	lt.failing = false;
+	checkParagraphs(gc, &doc, results);
+	QEQUAL(results.size(), 2);
+	QEQUAL(results.value(0).size(), 1);
+	QEQUAL(results.value(2).size(), 1);
+	QVERIFY(lt.requests > failedRequests);
+
+	QPointer<GrammarCheck> oldGc = gc;
+	gc->shutdown();
+	while (oldGc)
+		QTest::qWait(5);
+}
+
+#endif
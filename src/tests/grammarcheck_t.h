@@ -0,0 +1,20 @@
+#ifndef Header_GrammarCheck_T
+#define Header_GrammarCheck_T
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+class GrammarCheckTest: public QObject{
+	Q_OBJECT
+	public:
+		GrammarCheckTest(bool all): all(all) {}
+	private:
+		bool all;
+	private slots:
+		void cacheAndBatching_data();
+		void cacheAndBatching();
+		void failedRepliesNotCached();
+};
+
+#endif
+#endif
@@ -4,6 +4,7 @@
 #include "latexcompleter_t.h"
 #include "latexcompleter_config.h"
 #include "latexcompleter.h"
+#include "latexcompleter_p.h"
 #include "latexeditorview.h"
 #include "qdocumentcursor.h"
 #include "qdocument.h"
@@ -485,5 +486,99 @@ void LatexCompleterTest::keyval(){
     edView->editor->clearCursorMirrors();
 }
 
+void LatexCompleterTest::fuzzyRefine_data(){
+    QTest::addColumn<QString>("typed");
+    QTest::addColumn<QString>("filter");
+
+    QTest::newRow("begin") << "\\bgnal" << "";
+    QTest::newRow("section") << "\\sctn*" << "";
+    QTest::newRow("no match") << "\\qqqx" << "";
+    QTest::newRow("environment") << "\\itm" << "itemize";
+    QTest::newRow("many pages") << "\\c1" << "";
+}
+
+static QStringList fuzzyResult(CompletionListModel &model){
+    QStringList result;
+    foreach (const CompletionWord &cw, model.getWords())
+        result << cw.word + ":" + QString::number(cw.score);
+    result << QString("rows:%1").arg(model.rowCount());
+    return result;
+}
+
+void LatexCompleterTest::fuzzyRefine(){
+    QFETCH(QString, typed);
+    QFETCH(QString, filter);
+
+    QList<CompletionWord> base;
+    base << CompletionWord("\\begin{align}") << CompletionWord("\\begin{align*}") << CompletionWord("\\begin{alignat}{n}")
+         << CompletionWord("\\section{title}") << CompletionWord("\\section*{title}") << CompletionWord("\\subsection{title}")
+         << CompletionWord("\\bigl") << CompletionWord("\\bgroup") << CompletionWord("\\sectionmark");
+    CompletionWord item("\\item");
+    item.environmentRestriction = "itemize";
+    base << item;
+    for (int i = 0; i < 400; i++)
+        base << CompletionWord(QString("\\cmd%1").arg(i));
+
+    // refining: each typed character narrows the previous matches
+    CompletionListModel refined;
+    refined.setBaseWords(base, CT_COMMANDS);
+    refined.setEnvironmentFilter(filter);
+    for (int i = 1; i <= typed.length(); i++) {
+        const QString word = typed.left(i);
+        refined.filterList(word, 2);
+        // from scratch: a new base list discards all previous matches
+        CompletionListModel scratch;
+        scratch.setBaseWords(base, CT_COMMANDS);
+        scratch.setEnvironmentFilter(filter);
+        scratch.filterList(word, 2);
+        QCOMPARE(fuzzyResult(refined), fuzzyResult(scratch));
+        if (refined.canFetchMore(QModelIndex())) {
+            refined.fetchMore(QModelIndex());
+            scratch.fetchMore(QModelIndex());
+            QCOMPARE(fuzzyResult(refined), fuzzyResult(scratch));
+        }
+    }
+}
+
+void LatexCompleterTest::prefixSpecialChars_data(){
+    QTest::addColumn<QString>("typed");
+
+    // characters which are replaced in CodeSnippet::sortWord
+    QTest::newRow("bracket") << "\\section[";
+    QTest::newRow("bracket text") << "\\section[sh";
+    QTest::newRow("brace") << "\\section{";
+    QTest::newRow("star") << "\\section*";
+    QTest::newRow("star brace") << "\\begin{align*";
+    QTest::newRow("space") << "\\foo ";
+    QTest::newRow("space text") << "\\foo b";
+    QTest::newRow("no space") << "\\foo";
+}
+
+void LatexCompleterTest::prefixSpecialChars(){
+    QFETCH(QString, typed);
+
+    QStringList names;
+    names << "\\section" << "\\section[short]{title}" << "\\section{title}" << "\\section*{title}" << "\\section*[short]{title}"
+          << "\\begin{align}" << "\\begin{align*}" << "\\begin{alignat}" << "\\foo" << "\\foo bar" << "\\foo baz" << "\\foobar" << "\\foo*";
+    QList<CompletionWord> base;
+    QStringList expected;
+    foreach (const QString &name, names) {
+        base << CompletionWord(name);
+        if (name.startsWith(typed))
+            expected << name;
+    }
+    QVERIFY(!expected.isEmpty());
+
+    CompletionListModel model;
+    model.setBaseWords(base, CT_COMMANDS);
+    model.filterList(typed, 3);
+    QStringList found;
+    foreach (const CompletionWord &cw, model.getWords())
+        found << cw.word;
+    found.sort();
+    expected.sort();
+    QCOMPARE(found, expected);
+}
+
 #endif
 
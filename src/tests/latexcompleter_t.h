@@ -22,6 +22,10 @@ class LatexCompleterTest: public QObject{
 		void simple();
         void keyval_data();
         void keyval();
+        void fuzzyRefine_data();
+        void fuzzyRefine();
+        void prefixSpecialChars_data();
+        void prefixSpecialChars();
 };
 
 #endif
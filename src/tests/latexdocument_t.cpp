@@ -9,5 +9,75 @@ LatexDocumentTest::LatexDocumentTest(LatexEditorView* view): m_edView(view){
     m_doc=m_edView->getDocument();
 }
 
+void LatexDocumentTest::labelIndex(){
+    m_edView->editor->setText("\\label{a}\\ref{a}\n\\label{b}\\label{a}\n\\ref{c}\\ref{a}\n\\bibitem{x}\n", false);
+    QEQUAL(m_doc->countLabels("a"), 2);
+    QEQUAL(m_doc->countLabels("b"), 1);
+    QEQUAL(m_doc->countLabels("c"), 0);
+    QEQUAL(m_doc->countRefs("a"), 2);
+    QEQUAL(m_doc->countRefs("c"), 1);
+    QVERIFY(m_doc->isBibItem("x"));
+    QVERIFY(!m_doc->isBibItem("a"));
+    QVERIFY(m_doc->getDocumentForLabel("b") == m_doc);
+    QMultiHash<QDocumentLineHandle *, int> labels = m_doc->getLabels("a");
+    QEQUAL(labels.size(), 2);
+    QVERIFY(labels.contains(m_doc->line(0).handle(), 7));
+    QVERIFY(labels.contains(m_doc->line(1).handle(), 16));
+
+    // removing a line must drop its entries from the index
+    QDocumentCursor c(m_doc, 1, 0, 2, 0);
+    c.removeSelectedText();
+    QEQUAL(m_doc->countLabels("a"), 1);
+    QEQUAL(m_doc->countLabels("b"), 0);
+    QVERIFY(!m_doc->getDocumentForLabel("b"));
+    QEQUAL(m_doc->getRefs("a").size(), 2);
+
+    QHash<QString, int> counts = LatexDocument::countLabels(m_doc->getListOfDocs());
+    QEQUAL(counts.value("a"), 1);
+    QVERIFY(!counts.contains("b"));
+    m_edView->editor->setText("", false);
+}
+
+void LatexDocumentTest::removedChildCommands(){
+    LatexDocuments docs;
+    LatexDocument *master = new LatexDocument();
+    LatexDocument *child = new LatexDocument();
+    docs.addDocument(master);
+    docs.addDocument(child);
+    master->addChild(child);
+    child->setMasterDocument(master, false);
+    master->ltxCommands.possibleCommands["user"].insert("\\masterCommand");
+    child->ltxCommands.possibleCommands["user"].insert("\\childCommand");
+    child->ltxCommands.possibleCommands["math"].insert("\\childMathCommand");
+    master->updateLtxCommands();
+    QVERIFY(child->lp == master->lp);
+    QVERIFY(master->lp->possibleCommands["user"].contains("\\childCommand"));
+    QVERIFY(master->lp->possibleCommands["math"].contains("\\childMathCommand"));
+
+    // unchanged project, the added command is appended incrementally
+    master->ltxCommands.possibleCommands["math"].insert("\\masterMathCommand");
+    master->updateLtxCommands();
+    QVERIFY(master->lp->possibleCommands["math"].contains("\\masterMathCommand"));
+    QVERIFY(master->lp->possibleCommands["math"].contains("\\childMathCommand"));
+
+    // the child leaves the project, even an update of the user commands drops all its commands
+    master->removeChild(child);
+    child->setMasterDocument(nullptr, false);
+    master->updateLtxCommands(false, false);
+    QVERIFY(!master->lp->possibleCommands["user"].contains("\\childCommand"));
+    QVERIFY(!master->lp->possibleCommands["math"].contains("\\childMathCommand"));
+    QVERIFY(master->lp->possibleCommands["user"].contains("\\masterCommand"));
+    QVERIFY(master->lp->possibleCommands["math"].contains("\\masterMathCommand"));
+
+    // and they stay dropped in the following incremental updates
+    master->ltxCommands.possibleCommands["math"].insert("\\anotherCommand");
+    master->updateLtxCommands();
+    QVERIFY(master->lp->possibleCommands["math"].contains("\\anotherCommand"));
+    QVERIFY(!master->lp->possibleCommands["math"].contains("\\childMathCommand"));
+
+    delete child;
+    delete master;
+}
+
 #endif
 
@@ -14,6 +14,8 @@ class LatexDocumentTest: public QObject{
         LatexEditorView *m_edView;
         LatexDocument *m_doc;
 	private slots:
+        void labelIndex();
+        void removedChildCommands();
 };
 
 #endif
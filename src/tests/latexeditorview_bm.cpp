@@ -9,8 +9,10 @@
 #include "qdocumentline_p.h"
 #include "latexdocument.h"
 #include "qeditor.h"
+#include "spellerutility.h"
 #include "testutil.h"
 #include <QtTest/QtTest>
+#include <QtConcurrent>
 LatexEditorViewBenchmark::LatexEditorViewBenchmark(LatexEditorView* view, bool all): edView(view), all(all){}
 
 void LatexEditorViewBenchmark::documentChange_data(){
@@ -267,5 +269,60 @@ void LatexEditorViewBenchmark::paintEvent(){
 		edView->editor->repaint(edView->rect());
 	}
 }
+
+void LatexEditorViewBenchmark::spellCheck_data(){
+	QTest::addColumn<bool>("parallel");
+	QTest::newRow("one thread") << false;
+	QTest::newRow("all threads") << true;
+}
+void LatexEditorViewBenchmark::spellCheck(){
+	QFETCH(bool, parallel);
+
+	if (!all) {
+		qDebug() << "skipped benchmark";
+		return;
+	}
+	SpellerUtility *speller = edView->speller;
+	if (!speller || speller->getCurrentDic().isEmpty()) {
+		qDebug() << "no dictionary loaded, skipped benchmark";
+		return;
+	}
+
+	// words of a long document: a few thousand distinct words, each repeated many times
+	const QStringList base = QString("the quick brown fox jumps over the lazy dog while a sphinx of black quartz judges my vow theorem lemma proof equation").split(' ');
+	QList<QStringList> chunks;
+	QStringList words;
+	for (int i = 0; i < 200000; i++) {
+		QString word = base[i % base.size()];
+		if (i % 5 == 0) {
+			word += QChar('a' + (i / 5) % 26);
+			word += QChar('a' + (i / 130) % 26);
+		}
+		words << word;
+		if (words.size() == 1000) {
+			chunks << words;
+			words.clear();
+		}
+	}
+	auto checkChunk = [speller](const QStringList &chunk) {
+		foreach (const QString &word, chunk)
+			speller->check(word);
+	};
+
+	QElapsedTimer timer;
+	int passes = 0;
+	timer.start();
+	QBENCHMARK {
+		if (parallel) {
+			QtConcurrent::blockingMap(chunks, checkChunk);
+		} else {
+			foreach (const QStringList &chunk, chunks)
+				checkChunk(chunk);
+		}
+		passes++;
+	}
+	qint64 ms = qMax<qint64>(1, timer.elapsed());
+	qDebug() << qint64(passes) * 200000 * 1000 / ms << "checks/s with" << speller->checkerCount() << "Hunspell instances";
+}
 #endif
 
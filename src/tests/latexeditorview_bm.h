@@ -21,6 +21,8 @@ class LatexEditorViewBenchmark: public QObject{
 		void linePaint();
 		void paintEvent_data();
 		void paintEvent();
+		void spellCheck_data();
+		void spellCheck();
 };
 
 #endif
@@ -7,6 +7,8 @@
 #include "qdocumentcursor.h"
 #include "qdocument.h"
 #include "qeditor.h"
+#include "qdocumentline_p.h"
+#include "latexparser/latexparsing.h"
 #include "testutil.h"
 #include <QtTest/QtTest>
 LatexEditorViewTest::LatexEditorViewTest(LatexEditorView* view): edView(view){}
@@ -113,6 +115,41 @@ void LatexEditorViewTest::inMathEnvironment(){
 	}
 
 }
+void LatexEditorViewTest::speculativeLexing(){
+	// long enough to lex pass 2 in parallel segments, with lexer states which continue over empty lines
+	QString text;
+	for (int k = 0; k < 800; k++) {
+		text += QString("\\section{Part %1}\nSome \\textbf{bold} text with $x^2$ math.\n\n").arg(k);
+		if (k % 30 == 0) text += "{\\bfseries a\n\nb}\n\n";
+		if (k % 50 == 0) text += "\\begin{verbatim}\n\\textbf{a\n\n}\n\\end{verbatim}\n\n";
+		if (k % 70 == 0) text += "\\begin{itemize}\n\\item a\n\n\\item b\n\\end{itemize}\n\n";
+	}
+	edView->editor->setText(text);
+	QDocument *doc = edView->editor->document();
+	QVERIFY(doc->lines() > 2000);
+
+	QDocument reference;
+	reference.setText(text, false);
+	TokenStack stack;
+	CommandStack commandStack;
+	for (int i = 0; i < reference.lines(); i++) {
+		QDocumentLineHandle *dlh = reference.line(i).handle();
+		Parsing::simpleLexLatexLine(dlh);
+		Parsing::latexDetermineContexts2(dlh, stack, commandStack, edView->document->lp);
+
+		TokenList expected = dlh->getTokensLocked();
+		TokenList lexed = doc->line(i).handle()->getTokensLocked();
+		QEQUAL2(lexed.length(), expected.length(), QString("line %1").arg(i));
+		for (int k = 0; k < lexed.length(); k++) {
+			QEQUAL(int(lexed[k].type), int(expected[k].type));
+			QEQUAL(int(lexed[k].subtype), int(expected[k].subtype));
+			QEQUAL(lexed[k].start, expected[k].start);
+			QEQUAL(lexed[k].length, expected[k].length);
+			QEQUAL(lexed[k].level, expected[k].level);
+		}
+		QEQUAL2(doc->line(i).handle()->getRemainderLocked().size(), stack.size(), QString("line %1").arg(i));
+	}
+}
 
 #endif
 
@@ -548,7 +548,8 @@ void LatexOutputFilterTest::fileNameLikelyComplete() {
 	QFETCH(QString, name);
 	QFETCH(bool, result);
 
-	QEQUAL(LatexOutputFilter::fileNameLikelyComplete(name), result);
+	LatexOutputFilter filter;
+	QEQUAL(filter.fileNameLikelyComplete(name), result);
 }
 
 void LatexOutputFilterTest::isBadBoxTextQuote_data() {
@@ -723,4 +724,138 @@ void LatexOutputFilterTest::detectError()
 	QEQUAL(currentMessage(filter), message);
 }
 
+void LatexOutputFilterTest::recorderFile()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	QString base = dir.path() + "/test";
+	QFile fls(base + ".fls");
+	QVERIFY(fls.open(QIODevice::WriteOnly));
+	fls.write(QString("PWD %1\n"
+	                  "INPUT /usr/share/texlive/texmf-dist/tex/latex/base/article.cls\n"
+	                  "INPUT ./test.tex\n"
+	                  "INPUT chapter.tex\n"
+	                  "OUTPUT test.log\n").arg(dir.path()).toUtf8());
+	fls.close();
+	QFile log(base + ".log");
+	QVERIFY(log.open(QIODevice::WriteOnly));
+	log.close();
+	QFile unlisted(dir.path() + "/unlisted.tex");
+	QVERIFY(unlisted.open(QIODevice::WriteOnly));
+	unlisted.close();
+
+	LatexOutputFilter filter;
+	filter.setSource(base + ".tex");
+	QVERIFY(filter.readRecorderFile(base + ".log"));
+	QVERIFY(filter.m_recorderComplete);
+	// listed files are resolved from the recorder file, even though they do not exist here
+	QEQUAL(filter.absoluteFileName("/usr/share/texlive/texmf-dist/tex/latex/base/article.cls"), QString("/usr/share/texlive/texmf-dist/tex/latex/base/article.cls"));
+	QEQUAL(filter.absoluteFileName("./test.tex"), base + ".tex");
+	QEQUAL(filter.absoluteFileName("chapter"), dir.path() + "/chapter.tex");
+	QVERIFY(!filter.fileExists("/usr/share/texlive/texmf-dist/tex/lat"));
+	QVERIFY(!filter.fileExists("test.log"));
+	QVERIFY(!filter.fileExists("unlisted.tex"));
+
+	LatexOutputFilter noRecorder;
+	noRecorder.setSource(base + ".tex");
+	QVERIFY(!noRecorder.readRecorderFile(dir.path() + "/other.log"));
+	QVERIFY(noRecorder.fileExists("unlisted.tex"));
+}
+
+void LatexOutputFilterTest::addChunk_data()
+{
+	QTest::addColumn<int>("chunkSize");
+	QTest::addColumn<bool>("crlf");
+
+	for (int i = 1; i <= 7; i++)
+		QTest::newRow(qPrintable(QString("chunk %1").arg(i))) << i << (i % 2 == 0);
+	QTest::newRow("whole") << 100000 << false;
+}
+
+void LatexOutputFilterTest::addChunk()
+{
+	QFETCH(int, chunkSize);
+	QFETCH(bool, crlf);
+
+	QString log = "This is pdfTeX, Version 3.14159265-2.6-1.40.21 (TeX Live 2020) (preloaded format=pdflatex)\n"
+	              "(./test.tex\n"
+	              "LaTeX2e <2020-02-02> patch level 5\n"
+	              "(/usr/share/texlive/texmf-dist/tex/latex/base/article.cls\n"
+	              "Document Class: article 2019/12/20 v1.4l Standard LaTeX document class\n"
+	              ") (./test.aux)\n"
+	              "! Undefined control sequence.\n"
+	              "l.5 \\foo\n"
+	              "\n"
+	              "LaTeX Warning: Reference `sec' on page 1 undefined on input line 7.\n"
+	              "\n"
+	              "Overfull \\hbox (12.0pt too wide) in paragraph at lines 9--10\n"
+	              "[]\\OT1/cmr/m/n/10 aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n"
+	              "\n"
+	              "[1] (./test.aux) )\n"
+	              "Output written on test.pdf (1 page, 12345 bytes).";
+
+	QTextDocument doc(log);
+	LatexOutputFilter expected;
+	expected.setSource("test.tex");
+	expected.run(&doc);
+
+	if (crlf) log.replace("\n", "\r\n");
+	LatexOutputFilter filter;
+	filter.setSource("test.tex");
+	filter.begin();
+	for (int i = 0; i < log.length(); i += chunkSize)
+		filter.addChunk(log.mid(i, chunkSize));
+	filter.end();
+
+	QVERIFY(expected.m_nErrors > 0);
+	QVERIFY(expected.m_nWarnings > 0);
+	QEQUAL(filter.m_nErrors, expected.m_nErrors);
+	QEQUAL(filter.m_nWarnings, expected.m_nWarnings);
+	QEQUAL(filter.m_nBadBoxes, expected.m_nBadBoxes);
+	QEQUAL(filter.m_infoList.count(), expected.m_infoList.count());
+	for (int i = 0; i < expected.m_infoList.count(); i++) {
+		QEQUAL(filter.m_infoList.at(i).file, expected.m_infoList.at(i).file);
+		QEQUAL(int(filter.m_infoList.at(i).type), int(expected.m_infoList.at(i).type));
+		QEQUAL(filter.m_infoList.at(i).oldline, expected.m_infoList.at(i).oldline);
+		QEQUAL(filter.m_infoList.at(i).logline, expected.m_infoList.at(i).logline);
+		QEQUAL(filter.m_infoList.at(i).message, expected.m_infoList.at(i).message);
+	}
+}
+
+void LatexOutputFilterTest::runLineSeparator()
+{
+	QString log = "(./test.tex\n"
+	              "! Undefined control sequence.\n"
+	              "l.5 \\foo\n"
+	              "\n"
+	              "LaTeX Warning: Reference `sec' on page 1 undefined on input line 7.\n"
+	              "\n"
+	              "Overfull \\hbox (12.0pt too wide) in paragraph at lines 9--10\n"
+	              "[]\\OT1/cmr/m/n/10 aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n"
+	              "\n"
+	              ")\n";
+
+	QTextDocument doc(log);
+	LatexOutputFilter expected;
+	expected.setSource("test.tex");
+	expected.run(&doc);
+
+	// the same log with all line breaks stored as line separators within one block
+	QTextDocument separatedDoc(QString(log).replace('\n', QChar::LineSeparator));
+	QEQUAL(separatedDoc.blockCount(), 1);
+	LatexOutputFilter filter;
+	filter.setSource("test.tex");
+	filter.run(&separatedDoc);
+
+	QVERIFY(expected.m_nErrors > 0);
+	QEQUAL(filter.m_nErrors, expected.m_nErrors);
+	QEQUAL(filter.m_nWarnings, expected.m_nWarnings);
+	QEQUAL(filter.m_nBadBoxes, expected.m_nBadBoxes);
+	QEQUAL(filter.m_infoList.count(), expected.m_infoList.count());
+	for (int i = 0; i < expected.m_infoList.count(); i++) {
+		QEQUAL(filter.m_infoList.at(i).logline, expected.m_infoList.at(i).logline);
+		QEQUAL(filter.m_infoList.at(i).message, expected.m_infoList.at(i).message);
+	}
+}
+
 #endif
@@ -27,6 +27,12 @@ private slots:
 	void detectError_data();
 	void detectError();
 
+	void recorderFile();
+
+	void addChunk_data();
+	void addChunk();
+	void runLineSeparator();
+
 	QString stackTopFilename(const LatexOutputFilter &f);
 	QString currentMessage(const LatexOutputFilter &f);
 };
@@ -394,4 +394,34 @@ void LatexParserTest::test_interpretXArgs()
     QEQUAL(out,result);
 }
 
+void LatexParserTest::test_additionsTo()
+{
+    LatexParser base;
+    base.possibleCommands["user"] << "\\foo";
+    base.possibleCommands["%color"] << "red";
+    base.environmentAliases.insert("align", "math");
+    LatexParser current = base;
+    QEQUAL(current.generation, base.generation);
+    current.possibleCommands["user"] << "\\bar";
+    current.possibleCommands["tabular"] << "\\hline";
+    current.environmentAliases.insert("gather", "math");
+
+    LatexParser delta;
+    QVERIFY(current.additionsTo(base, delta));
+    QEQUAL(delta.possibleCommands.size(), 2);
+    QVERIFY(delta.possibleCommands.value("user") == QSet<QString>{"\\bar"});
+    QVERIFY(delta.possibleCommands.value("tabular") == QSet<QString>{"\\hline"});
+    QVERIFY(!delta.possibleCommands.contains("%color"));
+    QEQUAL(delta.environmentAliases.size(), 1);
+    QVERIFY(delta.environmentAliases.contains("gather", "math"));
+
+    LatexParser appended = base;
+    appended.append(delta);
+    QVERIFY(appended.generation != base.generation);
+    QVERIFY(appended.possibleCommands.value("user") == current.possibleCommands.value("user"));
+
+    current.possibleCommands["%color"].remove("red");
+    QVERIFY(!current.additionsTo(base, delta));
+}
+
 #endif // QT_NO_DEBUG
@@ -79,6 +79,7 @@ private slots:
 	void test_findClosingBracket();
     void test_interpretXArgs_data();
     void test_interpretXArgs();
+    void test_additionsTo();
 }; // LatexParserTest
 
 
@@ -1,5 +1,6 @@
 #ifndef QT_NO_DEBUG
 #include "latexparser/latexparsing.h"
+#include "latexparser/latextokencache.h"
 #include "latexparsing_t.h"
 
 #include "qdocument.h"
@@ -10,7 +11,9 @@
 #include "latexpackage.h"
 #include "testutil.h"
 #include "configmanager.h"
+#include "latexcompleter_config.h"
 #include <QtTest/QtTest>
+#include <QTemporaryDir>
 
 // shortcuts and semantic types
 typedef Token T;
@@ -1189,6 +1192,158 @@ void LatexParsingTest::test_getCompleterContext() {
     delete doc;
 }
 
-#endif
+void LatexParsingTest::test_tokenCache() {
+    QSharedPointer<LatexParser> lp = QSharedPointer<LatexParser>::create();
+    *lp=LatexParser::getInstance();
+    LatexPackage pkg_tex = loadCwlFile("tex.cwl");
+    lp->commandDefs.unite(pkg_tex.commandDescriptions);
+    const QString text = "\\section{abc\ndef} text % comment\n\\label{x}\n\n\\textbf{a\n\nb}\n\\section{abc\ndef} text % comment";
+
+    QDocument *doc = new QDocument();
+    doc->setText(text, false);
+    QList<QDocumentLineHandle *> lines;
+    TokenStack stack;
+    CommandStack commandStack;
+    for(int i=0; i<doc->lines(); i++){
+        QDocumentLineHandle *dlh = doc->line(i).handle();
+        Parsing::simpleLexLatexLine(dlh);
+        dlh->setFlag(QDocumentLine::lexedPass1, true);
+        Parsing::latexDetermineContexts2(dlh, stack, commandStack, lp);
+        lines << dlh;
+    }
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + "/test.tokens";
+    QVERIFY(LatexTokenCache::save(fileName, lines, *lp));
+
+    LatexTokenCache cache;
+    QVERIFY(cache.open(fileName));
+    QVERIFY(cache.matches(*lp));
+
+    QDocument *doc2 = new QDocument();
+    doc2->setText(text, false);
+    stack.clear();
+    commandStack.clear();
+    for(int i=0; i<doc2->lines(); i++){
+        QDocumentLineHandle *dlh = doc2->line(i).handle();
+        QVERIFY(cache.restoreRawTokens(dlh));
+        bool remainderChanged;
+        QVERIFY2(cache.restoreLine(dlh, i, stack, commandStack, remainderChanged), QString("line %1 not restored").arg(i).toLatin1());
+        TokenList expected = doc->line(i).handle()->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList restored = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        QCOMPARE(restored.length(), expected.length());
+        for(int k=0; k<restored.length(); k++){
+            QCOMPARE(restored[k].type, expected[k].type);
+            QCOMPARE(restored[k].subtype, expected[k].subtype);
+            QCOMPARE(restored[k].start, expected[k].start);
+            QCOMPARE(restored[k].length, expected[k].length);
+            QCOMPARE(restored[k].level, expected[k].level);
+            QCOMPARE(restored[k].argLevel, expected[k].argLevel);
+            QCOMPARE(doc2->indexOf(restored[k].dlh), doc->indexOf(expected[k].dlh));
+        }
+        TokenStack expectedStack = doc->line(i).handle()->getCookieLocked(QDocumentLine::LEXER_REMAINDER_COOKIE).value<TokenStack>();
+        QCOMPARE(stack.size(), expectedStack.size());
+        QVERIFY(dlh->hasFlag(QDocumentLine::lexedPass2Complete));
+    }
+    // changed line is not found
+    QDocumentLineHandle *dlh = doc2->line(1).handle();
+    dlh->lockForWriteText();
+    dlh->textBuffer() = "\\label{y}";
+    dlh->unlock();
+    QVERIFY(!cache.restoreRawTokens(dlh));
+    // cache is invalid for different command set
+    lp->possibleCommands["user"].insert("\\mycommand");
+    QVERIFY(!cache.matches(*lp));
+    delete doc2;
+    delete doc;
+}
 
+void LatexParsingTest::test_tokenCommandName() {
+    Token tk;
+    QVERIFY(!tk.hasOptionalCommandName());
+    QVERIFY(tk.optionalCommandName().isEmpty());
+    tk.setOptionalCommandName("\\begin{lstlisting}");
+    QVERIFY(tk.hasOptionalCommandName());
+    QCOMPARE(tk.optionalCommandName(), QString("\\begin{lstlisting}"));
+    Token tk2;
+    tk2.setOptionalCommandName(tk);
+    QCOMPARE(tk2.optionalCommandName(), tk.optionalCommandName());
+    Token tk3;
+    tk3.setOptionalCommandName("\\begin{lstlisting}");
+    QCOMPARE(tk3.optionalCommandName(), tk.optionalCommandName());
+    tk3.setOptionalCommandName("\\includegraphics/width");
+    QCOMPARE(tk3.optionalCommandName(), QString("\\includegraphics/width"));
+    QCOMPARE(tk.optionalCommandName(), QString("\\begin{lstlisting}"));
+    tk3.setOptionalCommandName(QString());
+    QVERIFY(!tk3.hasOptionalCommandName());
+    // more names than fit into a chunk of the name table or into the former 15 bit ids
+    QList<Token> many;
+    for (int i = 0; i < 40000; i++) {
+        Token t;
+        t.setOptionalCommandName(QString("\\test%1/key").arg(i));
+        many << t;
+    }
+    for (int i = 0; i < many.size(); i += 997)
+        QCOMPARE(many[i].optionalCommandName(), QString("\\test%1/key").arg(i));
+    QCOMPARE(many.last().optionalCommandName(), QString("\\test39999/key"));
+    Token runaway;
+    runaway.argLevel = Token::MAX_ARG_LEVEL;
+    QEQUAL(int(runaway.argLevel), Token::MAX_ARG_LEVEL);
+    runaway.argLevel = -Token::MAX_ARG_LEVEL;
+    QEQUAL(int(runaway.argLevel), -Token::MAX_ARG_LEVEL);
+}
 
+void LatexParsingTest::test_cwlCache() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    LatexCompleterConfig config;
+    config.importedCwlBaseDir = dir.path() + "/";
+
+    LatexPackage parsed = loadCwlFile("graphicx.cwl", &config);
+    QVERIFY(!parsed.notFound);
+    QEQUAL(QDir(dir.path() + "/cwlcache").entryList(QDir::Files).size(), 1);
+    LatexPackage cached = loadCwlFile("graphicx.cwl", &config);
+    QVERIFY(!cached.notFound);
+
+    QVERIFY(cached.possibleCommands == parsed.possibleCommands);
+    QVERIFY(cached.requiredPackages == parsed.requiredPackages);
+    QVERIFY(cached.environmentAliases == parsed.environmentAliases);
+    QVERIFY(cached.specialDefCommands == parsed.specialDefCommands);
+    QEQUAL(cached.commandDescriptions.size(), parsed.commandDescriptions.size());
+    foreach (const QString &key, parsed.commandDescriptions.keys())
+        QVERIFY(cached.commandDescriptions.value(key) == parsed.commandDescriptions.value(key));
+    QEQUAL(cached.completionWords.size(), parsed.completionWords.size());
+    for (int i = 0; i < parsed.completionWords.size(); i++) {
+        QEQUAL(cached.completionWords.at(i).word, parsed.completionWords.at(i).word);
+        QEQUAL(cached.completionWords.at(i).lines.join("\n"), parsed.completionWords.at(i).lines.join("\n"));
+        QEQUAL(cached.completionWords.at(i).placeHolders.size(), parsed.completionWords.at(i).placeHolders.size());
+        QEQUAL(cached.completionWords.at(i).index, parsed.completionWords.at(i).index);
+    }
+}
+
+void LatexParsingTest::test_cwlCacheSpecialArgs() {
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    LatexCompleterConfig config;
+    config.importedCwlBaseDir = dir.path() + "/";
+    const QString cwl = dir.path() + "/txstestspecial.cwl";
+    QFile f(cwl);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write("\\txsTestSpecial{txstestkind%special}\n");
+    f.close();
+
+    LatexParser *latexParserInstance = LatexParser::getInstancePtr();
+    QVERIFY(latexParserInstance);
+    LatexPackage parsed = loadCwlFile(cwl, &config);
+    QVERIFY(!parsed.notFound);
+    const int registered = latexParserInstance->mapSpecialArgs.size();
+    QVERIFY(latexParserInstance->mapSpecialArgs.values().contains("%txstestkind"));
+
+    // the name is registered already, the cache is still valid and the token types are kept
+    LatexPackage cached = loadCwlFile(cwl, &config);
+    QVERIFY(!cached.notFound);
+    QEQUAL(latexParserInstance->mapSpecialArgs.size(), registered);
+    QVERIFY(cached.commandDescriptions.value("\\txsTestSpecial") == parsed.commandDescriptions.value("\\txsTestSpecial"));
+}
+
+#endif
@@ -33,6 +33,10 @@ private slots:
 	void test_getContext();
 	void test_getCompleterContext_data();
 	void test_getCompleterContext();
+	void test_tokenCache();
+	void test_tokenCommandName();
+	void test_cwlCache();
+	void test_cwlCacheSpecialArgs();
 };
 
 #endif  // QT_NO_DEBUG
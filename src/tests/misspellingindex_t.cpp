@@ -0,0 +1,110 @@
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include "misspellingindex_t.h"
+#include "misspellingindex.h"
+#include "spellerutility.h"
+#include "latexdocument.h"
+#include "qdocumentcursor.h"
+#include "qdocumentline_p.h"
+#include "qeditor.h"
+#include "testutil.h"
+#include <QtTest/QtTest>
+
+MisspellingIndexTest::MisspellingIndexTest(LatexEditorView* ed): edView(ed){}
+
+void MisspellingIndexTest::setText(const QString &text){
+	edView->editor->setText(text, false);
+	edView->document->synChecker.waitForQueueProcess(); // the spell checked tokens are set by the syntax checker
+}
+
+QStringList MisspellingIndexTest::misspelled(int line){
+	QStringList words;
+	foreach (const MisspellingIndex::Misspelling &m, edView->document->misspellingIndex()->lineMisspellings(edView->document->line(line).handle()))
+		words << m.word;
+	return words;
+}
+
+QStringList MisspellingIndexTest::expected(SpellerUtility *speller, const QString &line){
+	QStringList words;
+	foreach (const QString &word, line.split(' ', Qt::SkipEmptyParts))
+		if (!speller->check(word))
+			words << word;
+	return words;
+}
+
+void MisspellingIndexTest::initTestCase(){
+	if (!edView->speller || edView->speller->getCurrentDic().isEmpty())
+		QSKIP("no dictionary loaded");
+}
+
+void MisspellingIndexTest::staleAfterEdit(){
+	setText("Hello xqzwv world\n");
+	QCOMPARE(misspelled(0), expected(edView->speller, "Hello xqzwv world"));
+	QVERIFY(misspelled(0).contains("xqzwv"));
+
+	QDocumentCursor c(edView->document, 0, 6);
+	c.movePosition(5, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
+	c.insertText("vwzqx");
+	edView->document->synChecker.waitForQueueProcess();
+	QCOMPARE(misspelled(0), expected(edView->speller, "Hello vwzqx world"));
+	QVERIFY(!misspelled(0).contains("xqzwv"));
+}
+
+void MisspellingIndexTest::spellerChange(){
+	SpellerUtility *speller = edView->speller;
+	MisspellingIndex *index = edView->document->misspellingIndex();
+	const QString text = "Hello xqzwv world house Haus maison";
+	setText(text + "\n");
+	QCOMPARE(misspelled(0), expected(speller, text));
+
+	//without a speller of its own the document is checked with the default speller
+	MisspellingIndex::setSpellerManager(edView->spellerManager);
+	index->setSpeller(nullptr);
+	SpellerUtility *defaultSpeller = edView->spellerManager->getSpeller("<default>");
+	QVERIFY(defaultSpeller);
+	QCOMPARE(misspelled(0), expected(defaultSpeller, text));
+
+	SpellerUtility *other = nullptr;
+	foreach (const QString &name, edView->spellerManager->availableDicts()) {
+		if (name != speller->name() && name != defaultSpeller->name()) {
+			other = edView->spellerManager->getSpeller(name);
+			if (other) break;
+		}
+	}
+	if (other) {
+		index->setSpeller(other);
+		QCOMPARE(misspelled(0), expected(other, text));
+	}
+	index->setSpeller(speller);
+	QCOMPARE(misspelled(0), expected(speller, text));
+}
+
+void MisspellingIndexTest::ignoreListChange(){
+	SpellerUtility *speller = edView->speller;
+	setText("Hello xqzwv world\n");
+	QVERIFY(misspelled(0).contains("xqzwv"));
+	speller->addToIgnoreList("xqzwv", false);
+	QVERIFY(!misspelled(0).contains("xqzwv"));
+	speller->removeFromIgnoreList("xqzwv");
+	QVERIFY(misspelled(0).contains("xqzwv"));
+}
+
+void MisspellingIndexTest::linesRemovedDuringSweep(){
+	MisspellingIndex *index = edView->document->misspellingIndex();
+	QStringList lines;
+	for (int i = 0; i < 20000; i++) lines << "Hello xqzwv world";
+	setText(lines.join("\n"));
+
+	//remove all lines while the sweep is checking them, it must not add entries for them afterwards
+	index->startSweep();
+	QDocumentCursor c(edView->document, 1, 0);
+	c.movePosition(1, QDocumentCursor::End, QDocumentCursor::KeepAnchor);
+	c.removeSelectedText();
+	index->m_sweepWatcher.waitForFinished();
+	QCoreApplication::processEvents(); // sweepDone()
+
+	QMutexLocker locker(&index->m_lock);
+	foreach (QDocumentLineHandle *dlh, index->m_lines.keys())
+		QVERIFY(edView->document->indexOf(dlh) >= 0);
+}
+#endif
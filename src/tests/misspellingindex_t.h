@@ -0,0 +1,27 @@
+#ifndef Header_MisspellingIndex_T
+#define Header_MisspellingIndex_T
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include "latexeditorview.h"
+
+class SpellerUtility;
+
+class MisspellingIndexTest: public QObject{
+	Q_OBJECT
+	public:
+		MisspellingIndexTest(LatexEditorView* editor);
+	private:
+		LatexEditorView *edView;
+		void setText(const QString &text);
+		QStringList misspelled(int line);
+		static QStringList expected(SpellerUtility *speller, const QString &line);
+	private slots:
+		void initTestCase();
+		void staleAfterEdit();
+		void spellerChange();
+		void ignoreListChange();
+		void linesRemovedDuringSweep();
+};
+
+#endif
+#endif
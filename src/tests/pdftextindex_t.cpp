@@ -0,0 +1,178 @@
+#if !defined(QT_NO_DEBUG) && !defined(NO_POPPLER_PREVIEW)
+#include "mostQtHeaders.h"
+#include "pdftextindex_t.h"
+#include "pdfviewer/pdftextindex.h"
+#include "testutil.h"
+#include <QtTest/QtTest>
+#include <QPdfWriter>
+
+namespace {
+/*!
+ * \brief write a pdf with one line of text per entry of pages, 24pt apart
+ */
+void writePdf(const QString &fileName, const QList<QStringList> &pages)
+{
+	QPdfWriter writer(fileName);
+	writer.setResolution(72);
+	QPainter painter(&writer);
+	painter.setFont(QFont("Helvetica", 12));
+	for (int p = 0; p < pages.size(); p++) {
+		if (p > 0) writer.newPage();
+		for (int l = 0; l < pages.at(p).size(); l++)
+			painter.drawText(72, 72 + 24 * l, pages.at(p).at(l));
+	}
+}
+
+bool sameLine(const QRectF &a, const QRectF &b)
+{
+	return a.top() < b.bottom() && a.bottom() > b.top();
+}
+
+/*!
+ * \brief wait until the count query is counted on all pages
+ * \return number of matches
+ */
+int waitForCount(PDFTextIndex *index)
+{
+	QElapsedTimer timer;
+	timer.start();
+	int countedPages = 0;
+	int matches = index->matchCount(&countedPages);
+	while (countedPages < index->pageCount() && timer.elapsed() < 10000) {
+		QTest::qWait(5);
+		matches = index->matchCount(&countedPages);
+	}
+	return matches;
+}
+}
+
+void PDFTextIndexTest::initTestCase(){
+	QVERIFY(dir.isValid());
+	const QString fileName = dir.filePath("search.pdf");
+	writePdf(fileName, QList<QStringList>()
+	         << (QStringList() << "Alpha beta gamma" << "beta Beta betamax")
+	         << (QStringList() << "gamma beta"));
+#if ((POPPLER_VERSION_MAJOR==21 && POPPLER_VERSION_MINOR>=6)||(POPPLER_VERSION_MAJOR>21)) && QT_VERSION_MAJOR>5
+	QSharedPointer<Poppler::Document> doc(Poppler::Document::load(fileName).release());
+#else
+	QSharedPointer<Poppler::Document> doc(Poppler::Document::load(fileName));
+#endif
+	QVERIFY(!doc.isNull());
+	QEQUAL(doc->numPages(), 2);
+
+	index = new PDFTextIndex();
+	index->setDocument(doc, 2);
+	QEQUAL(index->pageCount(), 2);
+	QElapsedTimer timer;
+	timer.start();
+	while (index->indexedPageCount() < 2 && timer.elapsed() < 10000)
+		QTest::qWait(5);
+	QVERIFY(index->isIndexed(0));
+	QVERIFY(index->isIndexed(1));
+}
+
+void PDFTextIndexTest::search_data(){
+	QTest::addColumn<QString>("text");
+	QTest::addColumn<bool>("caseSensitive");
+	QTest::addColumn<bool>("wholeWords");
+	QTest::addColumn<int>("matches");
+
+	QTest::newRow("ignore case") << "beta" << false << false << 4;
+	QTest::newRow("case sensitive") << "beta" << true << false << 3;
+	QTest::newRow("whole words") << "beta" << false << true << 3;
+	QTest::newRow("case sensitive whole words") << "beta" << true << true << 2;
+	QTest::newRow("upper case") << "Beta" << true << false << 1;
+	QTest::newRow("part of word") << "max" << false << false << 1;
+	QTest::newRow("part of word, whole words") << "max" << false << true << 0;
+	QTest::newRow("missing") << "delta" << false << false << 0;
+	QTest::newRow("empty") << "" << false << false << 0;
+}
+
+void PDFTextIndexTest::search(){
+	QFETCH(QString, text);
+	QFETCH(bool, caseSensitive);
+	QFETCH(bool, wholeWords);
+	QFETCH(int, matches);
+
+	QList<QRectF> result = index->search(0, text, caseSensitive, wholeWords);
+	QEQUAL(result.size(), matches);
+	foreach (const QRectF &r, result)
+		QVERIFY(!r.isEmpty());
+}
+
+void PDFTextIndexTest::matchOrder(){
+	QList<QRectF> matches = index->search(0, "beta", false, false);
+	QEQUAL(matches.size(), 4);
+	// first line, then the second line from left to right
+	QVERIFY(matches.at(0).bottom() <= matches.at(1).top());
+	for (int i = 1; i < 3; i++) {
+		QVERIFY(sameLine(matches.at(i), matches.at(i + 1)));
+		QVERIFY(matches.at(i).right() <= matches.at(i + 1).left());
+	}
+	// the match covers only the word, not the whole line
+	QList<QRectF> alpha = index->search(0, "Alpha", true, true);
+	QEQUAL(alpha.size(), 1);
+	QVERIFY(alpha.first().right() <= matches.at(0).left());
+	QVERIFY(index->search(2, "beta", false, false).isEmpty());
+}
+
+void PDFTextIndexTest::nextMatch(){
+	QList<QRectF> matches = index->search(0, "beta", false, false);
+	QList<QRectF> secondPage = index->search(1, "beta", false, false);
+	QEQUAL(matches.size(), 4);
+	QEQUAL(secondPage.size(), 1);
+
+	// forward from the top of the page through all matches
+	QEQUAL(PDFTextIndex::nextMatch(matches, QRectF(), false), 0);
+	for (int i = 0; i < 3; i++)
+		QEQUAL(PDFTextIndex::nextMatch(matches, matches.at(i), false), i + 1);
+	// after the last match, the search wraps around to the top of the next page and from the last page to the first one
+	QEQUAL(PDFTextIndex::nextMatch(matches, matches.at(3), false), -1);
+	QEQUAL(PDFTextIndex::nextMatch(secondPage, QRectF(), false), 0);
+	QEQUAL(PDFTextIndex::nextMatch(secondPage, secondPage.first(), false), -1);
+
+	// backwards from the bottom of the page
+	const QRectF bottom(0, 100000, 1, 1);
+	QEQUAL(PDFTextIndex::nextMatch(matches, bottom, true), 3);
+	for (int i = 3; i > 0; i--)
+		QEQUAL(PDFTextIndex::nextMatch(matches, matches.at(i), true), i - 1);
+	QEQUAL(PDFTextIndex::nextMatch(matches, matches.at(0), true), -1);
+	QEQUAL(PDFTextIndex::nextMatch(secondPage, bottom, true), 0);
+
+	// incremental search finds the current match again
+	QRectF current = matches.at(2);
+	current.setLeft(current.left() - 0.01);
+	current.setRight(current.left());
+	QEQUAL(PDFTextIndex::nextMatch(matches, current, false), 2);
+
+	QEQUAL(PDFTextIndex::nextMatch(QList<QRectF>(), QRectF(), false), -1);
+	QEQUAL(PDFTextIndex::nextMatch(QList<QRectF>(), bottom, true), -1);
+}
+
+void PDFTextIndexTest::countQuery(){
+	int countedPages = -1;
+	index->setCountQuery("beta", false, true);
+	QEQUAL(waitForCount(index), 4);
+	index->matchCount(&countedPages);
+	QEQUAL(countedPages, 2);
+
+	// the same query keeps its counts
+	index->setCountQuery("beta", false, true);
+	QEQUAL(index->matchCount(), 4);
+
+	index->setCountQuery("beta", true, false);
+	QEQUAL(waitForCount(index), 4);
+	index->setCountQuery("gamma", false, false);
+	QEQUAL(waitForCount(index), 2);
+
+	index->setCountQuery(QString(), false, false);
+	QEQUAL(index->matchCount(&countedPages), 0);
+	QEQUAL(countedPages, 0);
+}
+
+void PDFTextIndexTest::cleanupTestCase(){
+	delete index;
+	index = nullptr;
+}
+
+#endif
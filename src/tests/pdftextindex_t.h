@@ -0,0 +1,27 @@
+#ifndef Header_PDFTextIndex_T
+#define Header_PDFTextIndex_T
+#if !defined(QT_NO_DEBUG) && !defined(NO_POPPLER_PREVIEW)
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+class PDFTextIndex;
+
+class PDFTextIndexTest: public QObject{
+	Q_OBJECT
+	public:
+		PDFTextIndexTest(): index(nullptr) {}
+	private:
+		QTemporaryDir dir;
+		PDFTextIndex *index;
+	private slots:
+		void initTestCase();
+		void search_data();
+		void search();
+		void matchOrder();
+		void nextMatch();
+		void countQuery();
+		void cleanupTestCase();
+};
+
+#endif
+#endif
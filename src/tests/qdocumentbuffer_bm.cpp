@@ -0,0 +1,110 @@
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include "qdocumentbuffer_bm.h"
+#include "qdocumentbuffer.h"
+#include <QtTest/QtTest>
+
+//the containers never dereference the handles, so plain numbers can be stored
+static QDocumentLineHandle* fakeHandle(int i){
+	return reinterpret_cast<QDocumentLineHandle*>(quintptr(i + 1) * 8);
+}
+
+QDocumentBufferBenchmark::QDocumentBufferBenchmark(bool all): all(all){}
+
+void QDocumentBufferBenchmark::bulkEdit_data(){
+	QTest::addColumn<bool>("vector");
+	QTest::addColumn<int>("lines");
+	QTest::addColumn<int>("editSize");
+
+	QTest::newRow("buffer 10k lines, 100 line edits") << false << 10000 << 100;
+	QTest::newRow("vector 10k lines, 100 line edits") << true << 10000 << 100;
+
+	if (!all) {
+		qDebug() << "skipped benchmark data";
+		return;
+	}
+	QTest::newRow("buffer 100k lines, 1 line edits") << false << 100000 << 1;
+	QTest::newRow("vector 100k lines, 1 line edits") << true << 100000 << 1;
+	QTest::newRow("buffer 100k lines, 5000 line edits") << false << 100000 << 5000;
+	QTest::newRow("vector 100k lines, 5000 line edits") << true << 100000 << 5000;
+	QTest::newRow("buffer 1M lines, 5000 line edits") << false << 1000000 << 5000;
+	QTest::newRow("vector 1M lines, 5000 line edits") << true << 1000000 << 5000;
+}
+void QDocumentBufferBenchmark::bulkEdit(){
+	QFETCH(bool, vector);
+	QFETCH(int, lines);
+	QFETCH(int, editSize);
+
+	QVector<QDocumentLineHandle*> block;
+	for (int i = 0; i < editSize; i++)
+		block << fakeHandle(lines + i);
+
+	//paste a block at several positions of the document and delete it again
+	if (vector) {
+		QVector<QDocumentLineHandle*> v;
+		for (int i = 0; i < lines; i++)
+			v << fakeHandle(i);
+		QBENCHMARK {
+			for (int pos = 0; pos < lines; pos += lines / 10) {
+				for (int i = 0; i < editSize; i++)
+					v.insert(pos + i, block.at(i));
+				v.remove(pos, editSize);
+			}
+		}
+		QCOMPARE(v.count(), lines);
+	} else {
+		QDocumentBuffer b;
+		for (int i = 0; i < lines; i++)
+			b << fakeHandle(i);
+		QBENCHMARK {
+			for (int pos = 0; pos < lines; pos += lines / 10) {
+				b.insert(pos, block);
+				b.remove(pos, editSize);
+			}
+		}
+		QCOMPARE(b.count(), lines);
+		QVERIFY(b.at(lines / 2) == fakeHandle(lines / 2));
+	}
+}
+
+void QDocumentBufferBenchmark::lookup_data(){
+	QTest::addColumn<bool>("vector");
+	QTest::addColumn<int>("lines");
+
+	QTest::newRow("buffer 10k lines") << false << 10000;
+	QTest::newRow("vector 10k lines") << true << 10000;
+
+	if (!all) {
+		qDebug() << "skipped benchmark data";
+		return;
+	}
+	QTest::newRow("buffer 1M lines") << false << 1000000;
+	QTest::newRow("vector 1M lines") << true << 1000000;
+}
+void QDocumentBufferBenchmark::lookup(){
+	QFETCH(bool, vector);
+	QFETCH(int, lines);
+
+	//random access by line number, as done when painting or searching
+	quintptr sum = 0;
+	if (vector) {
+		QVector<QDocumentLineHandle*> v;
+		for (int i = 0; i < lines; i++)
+			v << fakeHandle(i);
+		QBENCHMARK {
+			for (int i = 0; i < lines; i += 7)
+				sum += quintptr(v.at(i));
+		}
+	} else {
+		QDocumentBuffer b;
+		for (int i = 0; i < lines; i++)
+			b << fakeHandle(i);
+		QBENCHMARK {
+			for (int i = 0; i < lines; i += 7)
+				sum += quintptr(b.at(i));
+		}
+	}
+	QVERIFY(sum > 0);
+}
+
+#endif
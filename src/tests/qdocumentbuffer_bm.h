@@ -0,0 +1,22 @@
+#ifndef Header_QDocument_Buffer_Benchmark
+#define Header_QDocument_Buffer_Benchmark
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+//compares the block based line storage of QDocument to a flat vector
+class QDocumentBufferBenchmark: public QObject{
+	Q_OBJECT
+	public:
+		QDocumentBufferBenchmark(bool all);
+	private:
+		bool all;
+	private slots:
+		void bulkEdit_data();
+		void bulkEdit();
+		void lookup_data();
+		void lookup();
+};
+
+#endif
+#endif
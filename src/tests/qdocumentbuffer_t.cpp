@@ -0,0 +1,275 @@
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include "qdocumentbuffer_t.h"
+
+//----
+//access the blocks of the buffer
+#define private public
+#include "qdocumentbuffer.h"
+#undef private
+//----
+
+#include "testutil.h"
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+
+namespace {
+//the buffer never dereferences the handles, so plain numbers can be stored
+QDocumentLineHandle* fakeHandle(int i){
+	return reinterpret_cast<QDocumentLineHandle*>(quintptr(i + 1) * 8);
+}
+
+QVector<QDocumentLineHandle*> fakeHandles(int from, int n){
+	QVector<QDocumentLineHandle*> result;
+	for (int i = 0; i < n; i++)
+		result << fakeHandle(from + i);
+	return result;
+}
+
+void insertLines(QVector<QDocumentLineHandle*> &lines, int position, const QVector<QDocumentLineHandle*> &inserted){
+	lines = lines.mid(0, position) + inserted + lines.mid(position);
+}
+
+QList<int> blockSizes(const QDocumentBuffer &b){
+	QList<int> sizes;
+	for (int i = 0; i < b.m_blocks.count(); i++)
+		sizes << b.m_blocks.at(i)->size();
+	return sizes;
+}
+
+/*!
+ * \brief compare the buffer with a plain vector of the same lines and check the block structure
+ * \return description of the first difference, empty if there is none
+ */
+QString compare(const QDocumentBuffer &b, const QVector<QDocumentLineHandle*> &expected){
+	if (b.count() != expected.count())
+		return QString("count %1 instead of %2").arg(b.count()).arg(expected.count());
+	int start = 0;
+	for (int i = 0; i < b.m_blocks.count(); i++) {
+		const int size = b.m_blocks.at(i)->size();
+		if (b.m_blocks.at(i)->start != start)
+			return QString("block %1 starts at %2 instead of %3").arg(i).arg(b.m_blocks.at(i)->start).arg(start);
+		if (size == 0)
+			return QString("block %1 is empty").arg(i);
+		if (size > b.m_forkThresold)
+			return QString("block %1 has %2 lines, more than the split threshold").arg(i).arg(size);
+		start += size;
+	}
+	if (start != b.count())
+		return QString("blocks contain %1 lines instead of %2").arg(start).arg(b.count());
+	for (int i = 0; i < expected.count(); i++)
+		if (b.at(i) != expected.at(i))
+			return QString("wrong line at %1").arg(i);
+	return QString();
+}
+}
+
+void QDocumentBufferTest::insertRemoveAcrossBlocks_data(){
+	QTest::addColumn<int>("position");
+	QTest::addColumn<int>("inserted");
+	QTest::addColumn<int>("removedFrom");
+	QTest::addColumn<int>("removed");
+
+	QTest::newRow("insert at block start") << 1000 << 10 << 0 << 0;
+	QTest::newRow("insert at block end") << 999 << 10 << 0 << 0;
+	QTest::newRow("insert at document end") << 3500 << 700 << 0 << 0;
+	QTest::newRow("insert at document start") << 0 << 3 << 0 << 0;
+	QTest::newRow("remove across one border") << 0 << 0 << 990 << 20;
+	QTest::newRow("remove across two borders") << 0 << 0 << 990 << 1020;
+	QTest::newRow("remove whole block") << 0 << 0 << 1000 << 1000;
+	QTest::newRow("remove up to the end") << 0 << 0 << 2500 << 1000;
+	QTest::newRow("remove everything") << 0 << 0 << 0 << 3500;
+	QTest::newRow("insert and remove across borders") << 1990 << 1200 << 500 << 2000;
+}
+
+void QDocumentBufferTest::insertRemoveAcrossBlocks(){
+	QFETCH(int, position);
+	QFETCH(int, inserted);
+	QFETCH(int, removedFrom);
+	QFETCH(int, removed);
+
+	QDocumentBuffer b;
+	QVector<QDocumentLineHandle*> expected = fakeHandles(0, 3500);
+	foreach (QDocumentLineHandle *l, expected)
+		b << l;
+	QEQUAL(b.m_blocks.count(), 4);
+	QString error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+
+	const QVector<QDocumentLineHandle*> lines = fakeHandles(10000, inserted);
+	b.insert(position, lines);
+	insertLines(expected, position, lines);
+	error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+
+	b.remove(removedFrom, removed);
+	expected.remove(removedFrom, removed);
+	error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+	QEQUAL(b.isEmpty(), expected.isEmpty());
+	if (!expected.isEmpty()) {
+		QVERIFY(b.first() == expected.first());
+		QVERIFY(b.last() == expected.last());
+	}
+}
+
+void QDocumentBufferTest::splitThreshold(){
+	QDocumentBuffer b;
+	QVector<QDocumentLineHandle*> expected = fakeHandles(0, 1000);
+	b.insert(0, expected);
+	QCOMPARE(blockSizes(b), QList<int>() << 1000);
+
+	// a block may grow up to the split threshold
+	QVector<QDocumentLineHandle*> lines = fakeHandles(1000, b.m_forkThresold - 1000);
+	b.insert(10, lines);
+	insertLines(expected, 10, lines);
+	QCOMPARE(blockSizes(b), QList<int>() << b.m_forkThresold);
+
+	// one more line splits it into blocks of about the optimal size
+	b.insert(20, fakeHandle(5000));
+	expected.insert(20, fakeHandle(5000));
+	QCOMPARE(blockSizes(b), QList<int>() << 750 << 751);
+	QString error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+
+	// a large insertion is split into several blocks at once
+	lines = fakeHandles(10000, 4000);
+	b.insert(750, lines);
+	insertLines(expected, 750, lines);
+	QEQUAL(b.m_blocks.count(), 6);
+	foreach (int size, blockSizes(b))
+		QVERIFY(size <= b.m_optimalSize);
+	error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void QDocumentBufferTest::mergeThreshold(){
+	QDocumentBuffer b;
+	QVector<QDocumentLineHandle*> expected = fakeHandles(0, 2000);
+	foreach (QDocumentLineHandle *l, expected)
+		b << l;
+	QCOMPARE(blockSizes(b), QList<int>() << 1000 << 1000);
+
+	// a block at the merge threshold is kept
+	b.remove(0, 1000 - b.m_mergeThresold);
+	expected.remove(0, 1000 - b.m_mergeThresold);
+	QCOMPARE(blockSizes(b), QList<int>() << b.m_mergeThresold << 1000);
+
+	// a smaller block is merged with its successor
+	b.remove(0, 1);
+	expected.remove(0, 1);
+	QCOMPARE(blockSizes(b), QList<int>() << b.m_mergeThresold - 1 + 1000);
+	QString error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+
+	// unless the merged block would have to be split again
+	b.clear();
+	expected = fakeHandles(0, 2000);
+	foreach (QDocumentLineHandle *l, expected)
+		b << l;
+	QVector<QDocumentLineHandle*> lines = fakeHandles(5000, 500);
+	b.insert(1500, lines);
+	insertLines(expected, 1500, lines);
+	QCOMPARE(blockSizes(b), QList<int>() << 1000 << 1500);
+	b.remove(0, 910);
+	expected.remove(0, 910);
+	QCOMPARE(blockSizes(b), QList<int>() << 90 << 1500);
+	error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+
+	// the block before a removed range is merged as well
+	b.remove(90, 600);
+	expected.remove(90, 600);
+	QCOMPARE(blockSizes(b), QList<int>() << 990);
+	error = compare(b, expected);
+	QVERIFY2(error.isEmpty(), qPrintable(error));
+}
+
+void QDocumentBufferTest::iteratorStepping(){
+	QDocumentBuffer b;
+	QVERIFY(b.begin() == b.end());
+	QVERIFY(b.constBegin() == b.constEnd());
+
+	// a whole block is removed, the remains of two others are merged
+	QVector<QDocumentLineHandle*> expected = fakeHandles(0, 4000);
+	foreach (QDocumentLineHandle *l, expected)
+		b << l;
+	b.remove(1000, 1000);
+	expected.remove(1000, 1000);
+	b.remove(1950, 960);
+	expected.remove(1950, 960);
+	QCOMPARE(blockSizes(b), QList<int>() << 1000 << 1040);
+
+	int line = 0;
+	for (QDocumentBuffer::const_iterator it = b.constBegin(); it != b.constEnd(); ++it, ++line) {
+		QEQUAL(it.lineNumber(), line);
+		QVERIFY(*it == expected.at(line));
+	}
+	QEQUAL(line, expected.count());
+
+	QDocumentBuffer::iterator it = b.end();
+	for (int i = expected.count() - 1; i >= 0; i--) {
+		--it;
+		QEQUAL(it.lineNumber(), i);
+		QVERIFY(*it == expected.at(i));
+	}
+	QVERIFY(it == b.begin());
+
+	// step over the block border in both directions and jump
+	it = b.begin() + 999;
+	QVERIFY(*it == expected.at(999));
+	++it;
+	QVERIFY(*it == expected.at(1000));
+	--it;
+	QVERIFY(*it == expected.at(999));
+	it += 1040;
+	QVERIFY(*it == expected.at(2039));
+	it++;
+	QVERIFY(it == b.end());
+	it -= 2040;
+	QVERIFY(it == b.begin());
+	QEQUAL(b.end() - b.begin(), expected.count());
+	QEQUAL(b.indexOf(expected.at(1500)), 1500);
+	QEQUAL(b.indexOf(expected.at(1500), 1501), -1);
+	QEQUAL(b.indexOf(expected.at(1500), -600), 1500);
+
+	// no empty blocks are left when all lines are removed, the buffer can be filled again
+	b.remove(0, b.count());
+	QVERIFY(b.m_blocks.isEmpty());
+	QVERIFY(b.begin() == b.end());
+	expected = fakeHandles(100, 3);
+	b.insert(0, expected);
+	line = 0;
+	for (QDocumentBuffer::const_iterator refilled = b.constBegin(); refilled != b.constEnd(); ++refilled, ++line)
+		QVERIFY(*refilled == expected.at(line));
+	QEQUAL(line, 3);
+}
+
+void QDocumentBufferTest::lookupAfterManyEdits(){
+	QDocumentBuffer b;
+	QVector<QDocumentLineHandle*> expected;
+	QRandomGenerator random(42);
+	int next = 0;
+	for (int step = 0; step < 500; step++) {
+		const int size = (step % 10 == 0) ? random.bounded(1, 3000) : random.bounded(1, 50);
+		if (expected.isEmpty() || random.bounded(100) < 55) {
+			const int position = random.bounded(expected.count() + 1);
+			const QVector<QDocumentLineHandle*> lines = fakeHandles(next, size);
+			next += size;
+			b.insert(position, lines);
+			insertLines(expected, position, lines);
+		} else {
+			const int position = random.bounded(expected.count());
+			const int n = qMin(size, expected.count() - position);
+			b.remove(position, n);
+			expected.remove(position, n);
+		}
+		const QString error = compare(b, expected);
+		QVERIFY2(error.isEmpty(), qPrintable(QString("step %1: %2").arg(step).arg(error)));
+	}
+	QVERIFY(b.m_blocks.count() > 1);
+	for (int i = 0; i < expected.count(); i += 7)
+		QEQUAL(b.indexOf(expected.at(i)), i);
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef Header_QDocument_Buffer_T
+#define Header_QDocument_Buffer_T
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+class QDocumentBufferTest: public QObject{
+	Q_OBJECT
+	private slots:
+		void insertRemoveAcrossBlocks_data();
+		void insertRemoveAcrossBlocks();
+		void splitThreshold();
+		void mergeThreshold();
+		void iteratorStepping();
+		void lookupAfterManyEdits();
+};
+
+#endif
+#endif
@@ -819,6 +819,69 @@ void QDocumentCursorTest::columnMemory()
 	QEQUAL(cursor.columnNumber(), column);
 }
 
+void QDocumentCursorTest::undoSpill(){
+	QDocument d;
+	d.setText("a\nb\nc\n", false);
+	const QString original = d.text();
+	const qint64 savedLimit = QDocument::undoMemoryLimit();
+	QDocument::setUndoMemoryLimit(1); // spill all commands but the newest
+	for (int i=0;i<300;i++) {
+		QDocumentCursor c = d.cursor(i % 3, 0);
+		if (i % 4 == 3) {
+			c.movePosition(1, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
+			c.removeSelectedText();
+		} else {
+			c.insertText(QString("line %1\nnext ").arg(i));
+		}
+	}
+	const QString edited = d.text();
+	QVERIFY(d.undoSpillSize() > 0);
+	while (d.canUndo()) d.undo();
+	QEQUAL(d.text(), original);
+	while (d.canRedo()) d.redo();
+	QEQUAL(d.text(), edited);
+	QDocument::setUndoMemoryLimit(savedLimit);
+}
+
+void QDocumentCursorTest::undoSpillMerge(){
+	QDocument d;
+	d.setText("a\nb\n", false);
+	const QString original = d.text();
+	const qint64 savedLimit = QDocument::undoMemoryLimit();
+	QDocument::setUndoMemoryLimit(1); // spill all commands but the newest
+	d.cursor(0, 1).insertText("x");
+	const QString typed = d.text();
+	for (int i=0;i<70;i++)
+		d.cursor(1, 0).insertText(QString("%1\n").arg(i));
+	QVERIFY(d.undoSpillSize() > 0);
+
+	//undo back to the spilled insertion and continue typing there, it is merged into the spilled command
+	for (int i=0;i<70;i++) d.undo();
+	QEQUAL(d.text(), typed);
+	d.cursor(0, 2).insertText("y");
+	const QString merged = d.text();
+	QEQUAL(merged, QString("axy\nb\n"));
+
+	d.undo();
+	QEQUAL(d.text(), original);
+	d.redo();
+	QEQUAL(d.text(), merged);
+
+	//text read back by undo/redo is spilled again without appending it to the file again
+	QList<qint64> growth;
+	for (int cycle=0;cycle<3;cycle++) {
+		while (d.canUndo()) d.undo();
+		QEQUAL(d.text(), original);
+		while (d.canRedo()) d.redo();
+		const qint64 before = d.undoSpillSize();
+		for (int i=0;i<64;i++)
+			d.cursor(1, 0).insertText(QString("%1\n").arg(i));
+		growth << d.undoSpillSize() - before;
+	}
+	QCOMPARE(growth[2], growth[1]);
+	QDocument::setUndoMemoryLimit(savedLimit);
+}
+
 void QDocumentCursorTest::cleanupTestCase(){
 	delete doc;
 }
@@ -31,6 +31,8 @@ public:
 		void isForwardSelection();
 		void columnMemory_data();
 		void columnMemory();
+		void undoSpill();
+		void undoSpillMerge();
 		void cleanupTestCase();
 };
 
@@ -123,4 +123,268 @@ void QDocumentLineTest::updateWrap(){
 	
 }
 
+void QDocumentLineTest::lazyWrap(){
+	QStringList lines;
+	for (int i=0;i<3000;i++) lines << "abcd efgh ijkl";
+	doc->setWidthConstraint(100);
+	doc->setText(lines.join("\n"), false);
+	QDocumentPrivate *d = doc->impl();
+	d->m_lastDrawnLines = qMakePair(0, 10);
+	while (d->m_wrapScanPos >= 0) d->processPendingWraps();
+	QVERIFY(d->m_wrapped.isEmpty());
+
+	doc->setWidthConstraint(20);
+	//lines around the view are wrapped immediately, the others are consistent with their old wrap
+	QVERIFY(!doc->line(0).handle()->hasFlag(QDocumentLine::WrapPending));
+	const int wraps = doc->line(0).handle()->m_frontiers.size();
+	QVERIFY(wraps > 0);
+	QDocumentLineHandle *farLine = doc->line(2999).handle();
+	QVERIFY(farLine->hasFlag(QDocumentLine::WrapPending));
+	QEQUAL(d->m_wrapped.value(2999), farLine->m_frontiers.size());
+
+	while (d->m_wrapScanPos >= 0) d->processPendingWraps();
+	QEQUAL(d->m_wrapped.size(), 3000);
+	for (int i=0;i<3000;i++) {
+		QVERIFY(!doc->line(i).handle()->hasFlag(QDocumentLine::WrapPending));
+		QEQUAL(d->m_wrapped.value(i), wraps);
+	}
+	QEQUAL(d->m_height, 1. * 3000 * (wraps + 1) * QDocumentPrivate::m_lineSpacing);
+}
+
+void QDocumentLineTest::visualLines(){
+	//every letter = 5px, i.e. 4 letters per visual line
+	doc->setWidthConstraint(20);
+	doc->setText("abc\nabcd efgh ijkl\nabc\nabcd efgh\nabc\nabcd efgh\nabc\nabc", false);
+	QDocumentPrivate *d = doc->impl();
+	d->setWidth();
+	QVERIFY(!d->m_wrapped.isEmpty());
+
+	int visual = 0;
+	for (int i=0;i<doc->lineCount();i++) {
+		QEQUAL(d->visualLine(i), visual);
+		const int wraps = doc->line(i).handle()->m_frontiers.size();
+		for (int w=0;w<=wraps;w++) {
+			int wrap = -1;
+			QEQUAL(d->textLine(visual + w, &wrap), i);
+			QEQUAL(wrap, w);
+		}
+		visual += wraps + 1;
+	}
+	QEQUAL(d->textLine(visual), doc->lineCount());
+
+	//fold lines 3 to 5 below line 2
+	const int wraps2 = doc->line(2).handle()->m_frontiers.size();
+	const int visual2 = d->visualLine(2), visual6 = d->visualLine(6);
+	for (int i=3;i<=5;i++) doc->line(i).handle()->setFlag(QDocumentLine::Hidden, true);
+	d->hideEvent(2, 3);
+	QEQUAL(d->visualLine(6), visual2 + wraps2 + 1);
+	QEQUAL(d->visualLine(5), visual2 + wraps2);
+	QEQUAL(d->textLine(visual2 + wraps2 + 1), 6);
+
+	for (int i=3;i<=5;i++) doc->line(i).handle()->setFlag(QDocumentLine::Hidden, false);
+	d->showEvent(2, 3);
+	QEQUAL(d->visualLine(6), visual6);
+}
+
+void QDocumentLineTest::visualLineIndex(){
+	//incremental updates of the index must agree with the plain counts
+	QVector<int> counts;
+	QDocumentVisualLineIndex index;
+	index.reset(counts);
+	unsigned int seed = 1;
+	auto rnd = [&seed](int n) { seed = seed * 1103515245u + 12345u; return int((seed >> 16) % unsigned(n)); };
+	for (int step = 0; step < 3000; step++) {
+		const int pos = rnd(counts.size() + 1);
+		switch (counts.isEmpty() ? 0 : rnd(4)) {
+		case 0: {
+			const int n = 1 + rnd(step % 10 ? 20 : 600);
+			counts.insert(pos, n, 1);
+			index.insert(pos, n);
+			break;
+		}
+		case 1: {
+			const int line = qMin(pos, counts.size() - 1), n = 1 + rnd(qMin(300, counts.size() - line));
+			counts.remove(line, n);
+			index.remove(line, n);
+			break;
+		}
+		case 2: {
+			const int line = qMin(pos, counts.size() - 1), c = rnd(4);
+			counts[line] = c;
+			index.set(line, c);
+			break;
+		}
+		default: {
+			const int line = qMin(pos, counts.size() - 1);
+			QVector<int> range(1 + rnd(counts.size() - line), rnd(3));
+			for (int i = 0; i < range.size(); i++) counts[line + i] = range[i];
+			index.set(line, range);
+		}
+		}
+		QEQUAL(index.size(), counts.size());
+		if (step % 100) continue;
+		int visual = 0;
+		for (int i = 0; i < counts.size(); i++) {
+			QEQUAL(index.count(i), counts[i]);
+			QEQUAL(index.prefix(i), visual);
+			for (int w = 0; w < counts[i]; w++)
+				QEQUAL(index.find(visual + w), i);
+			visual += counts[i];
+		}
+		QEQUAL(index.total(), visual);
+		QEQUAL(index.find(visual), counts.size());
+	}
+
+	//editing a document with wraps and folds must give the same visual lines as rebuilding the index
+	QDocumentPrivate *d = doc->impl();
+	auto checkIndex = [&]() {
+		QList<int> incremental;
+		for (int i = 0; i < doc->lineCount(); i++) incremental << d->visualLine(i);
+		d->invalidateVisualLineIndex();
+		for (int i = 0; i < doc->lineCount(); i++) QEQUAL(d->visualLine(i), incremental[i]);
+	};
+	doc->setWidthConstraint(20);
+	QStringList lines;
+	for (int i = 0; i < 30; i++) lines << (i % 3 ? "abc" : "abcd efgh ijkl");
+	doc->setText(lines.join("\n"), false);
+	d->setWidth();
+	d->visualLine(0);
+	QVERIFY(d->m_visualLineIndexValid);
+
+	for (int i = 3; i <= 7; i++) doc->line(i).handle()->setFlag(QDocumentLine::Hidden, true);
+	d->hideEvent(2, 5);
+	QVERIFY(d->m_visualLineIndexValid);
+	checkIndex();
+
+	QDocumentCursor c(doc);
+	c.moveTo(12, 0);
+	c.insertText("abcd efgh\nabc\nabcd efgh ijkl\n");
+	QVERIFY(d->m_visualLineIndexValid);
+	checkIndex();
+
+	c.moveTo(5, 1);
+	c.insertText("\nx\n");
+	checkIndex();
+
+	c.moveTo(14, 0);
+	c.movePosition(6, QDocumentCursor::NextLine, QDocumentCursor::KeepAnchor);
+	c.removeSelectedText();
+	QVERIFY(d->m_visualLineIndexValid);
+	checkIndex();
+
+	c.moveTo(1, 0);
+	c.movePosition(3, QDocumentCursor::NextLine, QDocumentCursor::KeepAnchor);
+	c.removeSelectedText();
+	checkIndex();
+
+	for (int i = 0; i < doc->lineCount(); i++) doc->line(i).handle()->setFlag(QDocumentLine::Hidden, false);
+	d->showEvent(2, -1);
+	d->showEvent(1, -1);
+	checkIndex();
+}
+
+void QDocumentLineTest::lineNumber(){
+	doc->setText("0\n1\n2\n3\n4\n5\n6\n7\n8\n9", false);
+	QDocumentLineHandle *dlh5 = doc->line(5).handle();
+	QDocumentLineHandle *dlh9 = doc->line(9).handle();
+	QEQUAL(doc->indexOf(dlh9), 9);
+	QEQUAL(doc->indexOf(dlh5), 5);
+
+	QDocumentCursor c(doc, 2, 0);
+	c.insertText("a\nb\nc\n");
+	QEQUAL(doc->indexOf(dlh9), 12);
+	QEQUAL(doc->indexOf(dlh5), 8);
+	QEQUAL(doc->indexOf(dlh5, 3), 8);
+	QVERIFY(doc->impl()->next(dlh5) == doc->line(9).handle());
+	QVERIFY(doc->impl()->previous(dlh5) == doc->line(7).handle());
+
+	c.moveTo(1, 0);
+	c.movePosition(5, QDocumentCursor::NextLine, QDocumentCursor::KeepAnchor);
+	c.removeSelectedText();
+	QEQUAL(doc->indexOf(dlh5), 3);
+	QEQUAL(doc->indexOf(dlh9), 7);
+	for (int i = 0; i < doc->lineCount(); i++)
+		QEQUAL(doc->indexOf(doc->line(i).handle()), i);
+
+	QDocument other;
+	other.setText("x", false);
+	QEQUAL(doc->indexOf(other.line(0).handle()), -1);
+	QEQUAL(doc->indexOf(dlh9), 7);
+}
+
+void QDocumentLineTest::chunkLoading_data(){
+	QTest::addColumn<QString>("text");
+	QTest::addColumn<int>("chunkSize");
+
+	QTest::newRow("empty") << "" << 1;
+	QTest::newRow("unix") << "abc\ndef\n\nghi" << 2;
+	QTest::newRow("dos split") << "abc\r\ndef\r\n" << 4;
+	QTest::newRow("dos single chars") << "a\r\n\r\nb\r\n" << 1;
+	QTest::newRow("mac") << "abc\rdef\r" << 3;
+	QTest::newRow("mixed") << "a\rb\nc\r\nd\n\re" << 2;
+}
+
+void QDocumentLineTest::chunkLoading(){
+	QFETCH(QString, text);
+	QFETCH(int, chunkSize);
+
+	QDocument ref;
+	ref.setText(text, false);
+
+	doc->startChunkLoading();
+	for (int i = 0; i < text.length(); i += chunkSize)
+		doc->addChunk(text.mid(i, chunkSize));
+	doc->stopChunkLoading();
+
+	QEQUAL(doc->lineCount(), ref.lineCount());
+	for (int i = 0; i < ref.lineCount(); i++)
+		QEQUAL(doc->line(i).text(), ref.line(i).text());
+	QEQUAL(doc->originalLineEnding(), ref.originalLineEnding());
+}
+
+void QDocumentLineTest::glyphRunCache(){
+	if (QDocumentPrivate::m_fonts.isEmpty())
+		QSKIP("no document fonts");
+	bool savedDisableLineCache = doc->hasWorkAround(QDocument::DisableLineCache);
+	doc->setWorkAround(QDocument::DisableLineCache, false);
+	doc->setText("abc def\nghi", false);
+	QDocumentPrivate *d = doc->impl();
+	QDocumentLineHandle *dlh = doc->line(0).handle();
+
+	QImage img(200, 50, QImage::Format_ARGB32);
+	QPainter p(&img);
+	d->drawShapedText(&p, dlh, 0, 0, 0, dlh->text());
+	QDocumentLineGlyphRuns *cached = d->m_glyphRunCache.object(dlh);
+	QVERIFY(cached);
+	QCOMPARE(cached->ticket, dlh->getCurrentTicket());
+	QVERIFY(cached->texts.contains(qMakePair(0, QString("abc def"))));
+
+	//editing the line must not reuse the runs shaped for the old text
+	QDocumentCursor c(doc);
+	c.moveTo(0, 3);
+	c.insertText("x");
+	d->drawShapedText(&p, dlh, 0, 0, 0, dlh->text());
+	cached = d->m_glyphRunCache.object(dlh);
+	QVERIFY(cached);
+	QCOMPARE(cached->ticket, dlh->getCurrentTicket());
+	QCOMPARE(cached->texts.size(), 1);
+	QVERIFY(cached->texts.contains(qMakePair(0, QString("abcx def"))));
+
+	//reformatting replaces the fonts the runs were shaped with
+	d->updateFormatCache(QApplication::activeWindow());
+	QVERIFY(!d->m_glyphRunCache.contains(dlh));
+
+	//a deleted handle must not leave an entry behind that a new handle at the same address would find
+	QDocumentLineHandle *tmp = new QDocumentLineHandle("tmp", doc);
+	tmp->ref();
+	d->drawShapedText(&p, tmp, 0, 0, 0, tmp->text());
+	QVERIFY(d->m_glyphRunCache.contains(tmp));
+	const QDocumentLineHandle *tmpAddress = tmp;
+	tmp->deref();
+	QVERIFY(!d->m_glyphRunCache.contains(tmpAddress));
+
+	p.end();
+	doc->setWorkAround(QDocument::DisableLineCache, savedDisableLineCache);
+}
+
 #endif
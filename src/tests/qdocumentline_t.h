@@ -25,6 +25,13 @@ private slots:
 
 	void updateWrap_data();
 	void updateWrap();
+	void lazyWrap();
+	void visualLines();
+	void visualLineIndex();
+	void lineNumber();
+	void chunkLoading_data();
+	void chunkLoading();
+	void glyphRunCache();
 };
 #endif
 #endif // QEDITORTEST_H
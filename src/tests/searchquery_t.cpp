@@ -0,0 +1,100 @@
+#ifndef QT_NO_DEBUG
+#include "searchquery_t.h"
+#include "searchquery.h"
+#include "smallUsefulFunctions.h"
+#include "testutil.h"
+
+namespace {
+/// gives access to the file search of SearchQuery
+class FileSearchQuery: public SearchQuery {
+public:
+	FileSearchQuery(): SearchQuery(QString(), QString(), NoFlags) {}
+	using SearchQuery::searchInFile;
+};
+
+/// lines of \a count characters, with \a text starting at byte \a offset
+QByteArray padded(int offset, const QByteArray &text, int count = 100)
+{
+	QByteArray line(count - 1, 'x');
+	line.append('\n');
+	QByteArray result;
+	while (result.size() + line.size() <= offset)
+		result.append(line);
+	result.append(QByteArray(offset - result.size(), 'y'));
+	result.append(text);
+	result.append("\nend\n");
+	return result;
+}
+}
+
+void SearchQueryTest::searchInFile_data(){
+	QTest::addColumn<QByteArray>("content");
+	QTest::addColumn<QString>("codec");
+	QTest::addColumn<QString>("search");
+	QTest::addColumn<bool>("caseSensitive");
+	QTest::addColumn<QStringList>("lines");
+	QTest::addColumn<QList<int> >("lineNumbers");
+
+	QTest::newRow("plain") << QByteArray("foo\nbar baz\r\nbaz\n") << "" << "baz" << true
+	                       << (QStringList() << "bar baz" << "baz") << (QList<int>() << 1 << 2);
+	QTest::newRow("no match") << QByteArray("foo\nbar\n") << "" << "baz" << true
+	                          << QStringList() << QList<int>();
+	QTest::newRow("case insensitive") << QByteArray("foo\nBaZ\n") << "" << "bAz" << false
+	                                  << (QStringList() << "BaZ") << (QList<int>() << 1);
+	QTest::newRow("case sensitive") << QByteArray("foo\nBaZ\n") << "" << "bAz" << true
+	                                << QStringList() << QList<int>();
+	QTest::newRow("binary") << QByteArray("baz\0baz\n", 8) << "" << "baz" << true
+	                        << QStringList() << QList<int>();
+	// the binary check and the prefilter work on blocks of the raw data
+	QTest::newRow("across 8 KB") << padded(8190, "needle") << "" << "needle" << true
+	                             << (QStringList() << QString(8190 % 100, QLatin1Char('y')) + "needle") << (QList<int>() << 81);
+	QTest::newRow("across 1 MB") << padded((1 << 20) - 3, "needle") << "" << "needle" << true
+	                             << (QStringList() << QString(((1 << 20) - 3) % 100, QLatin1Char('y')) + "needle") << (QList<int>() << ((1 << 20) - 3) / 100);
+	QTest::newRow("at end") << QByteArray("foo\nneedle") << "" << "needle" << true
+	                        << (QStringList() << "needle") << (QList<int>() << 1);
+	QTest::newRow("latin1") << QByteArray("foo\nGr\xfc\xdf" "e\n") << "ISO-8859-1" << QString::fromUtf8("Grüße") << true
+	                        << (QStringList() << QString::fromUtf8("Grüße")) << (QList<int>() << 1);
+	QTest::newRow("latin1 ascii search") << QByteArray("foo\nGr\xfc\xdf" "e\n") << "ISO-8859-1" << "gR" << false
+	                                     << (QStringList() << QString::fromUtf8("Grüße")) << (QList<int>() << 1);
+	QTest::newRow("latin1 not utf8") << QByteArray("Gr\xc3\xbc\xc3\x9f" "e\n") << "ISO-8859-1" << QString::fromUtf8("Grüße") << true
+	                                 << QStringList() << QList<int>();
+	QTest::newRow("utf8") << QByteArray("foo\nGr\xc3\xbc\xc3\x9f" "e\n") << "UTF-8" << QString::fromUtf8("Grüße") << true
+	                      << (QStringList() << QString::fromUtf8("Grüße")) << (QList<int>() << 1);
+	QTest::newRow("utf8 bom") << QByteArray("\xef\xbb\xbf" "foo\nGr\xc3\xbc\xc3\x9f" "e\n") << "" << QString::fromUtf8("Grüße") << false
+	                          << (QStringList() << QString::fromUtf8("Grüße")) << (QList<int>() << 1);
+	QByteArray utf16("\xff\xfe");
+	const QString utf16Text = QString::fromUtf8("foo\nGrüße\n");
+	utf16.append(reinterpret_cast<const char *>(utf16Text.utf16()), utf16Text.size() * 2);
+	QTest::newRow("utf16") << utf16 << "" << "gr" << false
+	                       << (QStringList() << QString::fromUtf8("Grüße")) << (QList<int>() << 1);
+}
+
+void SearchQueryTest::searchInFile(){
+	QFETCH(QByteArray, content);
+	QFETCH(QString, codec);
+	QFETCH(QString, search);
+	QFETCH(bool, caseSensitive);
+	QFETCH(QStringList, lines);
+	QFETCH(QList<int>, lineNumbers);
+
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	QString fileName = dir.filePath("search.tex");
+	QFile f(fileName);
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	f.write(content);
+	f.close();
+
+	FileSearchQuery query;
+	QRegularExpression regex = generateRegularExpression(search, caseSensitive, false, false);
+	SearchInfo result = query.searchInFile(fileName, regex, search, codec.isEmpty() ? nullptr : QTextCodec::codecForName(codec.toLatin1()));
+	QCOMPARE(result.textlines, lines);
+	QCOMPARE(result.lineNumberHints, lineNumbers);
+	QEQUAL(result.filename, lines.isEmpty() ? QString() : fileName);
+	// without literal only the regular expression is used
+	result = query.searchInFile(fileName, regex, QString(), codec.isEmpty() ? nullptr : QTextCodec::codecForName(codec.toLatin1()));
+	QCOMPARE(result.textlines, lines);
+	QCOMPARE(result.lineNumberHints, lineNumbers);
+}
+
+#endif
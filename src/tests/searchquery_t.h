@@ -0,0 +1,15 @@
+#ifndef Header_SearchQuery_T
+#define Header_SearchQuery_T
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+class SearchQueryTest: public QObject{
+	Q_OBJECT
+	private slots:
+		void searchInFile_data();
+		void searchInFile();
+};
+
+#endif
+#endif
@@ -8,10 +8,83 @@
 #include "qeditor.h"
 #include "latexdocument.h"
 #include "latexeditorview_config.h"
+#include "spellerutility.h"
 
 //#include "syntaxcheck.h"
 #include "testutil.h"
 #include <QtTest/QtTest>
+
+namespace {
+/*!
+ * \brief everything the syntax check places on a line
+ */
+struct LineSyntaxResult {
+    QList<QFormatRange> overlays;
+    StackEnvironment env;
+    StackEnvironment unclosedEnv;
+    TokenList tokens;
+    QVector<QParenthesis> parens;
+};
+
+/*!
+ * \brief line i of a document with nested environments spanning several hundred lines
+ * itemize spans most of the document, the tabular, equation and center environments cross the borders of the parts
+ * which are checked in parallel (at least SyntaxCheck::MIN_REGION_PART_SIZE lines each). The lines contain syntax errors and highlighted regions.
+ */
+QString regionTestLine(int i)
+{
+    switch (i) {
+    case 0: return "\\documentclass{article}";
+    case 1: return "\\begin{document}";
+    case 2: return "\\begin{itemize}";
+    case 90: return "\\begin{tabular}{ll}";
+    case 130: return "\\end{tabular}";
+    case 190: return "\\begin{equation}";
+    case 260: return "\\end{equation}";
+    case 330: return "\\end{itemize}";
+    case 350: return "\\begin{center}";
+    case 398: return "\\begin{tabular}{lll}";
+    case 403: return "\\end{tabular}";
+    case 450: return "\\end{center}";
+    case 460: return "\\begin{figure}";
+    case 470: return "\\end{quote}";
+    }
+    if ((i > 90 && i < 130) || (i > 398 && i < 403))
+        return (i % 7 == 0) ? "a&b&c&d\\\\" : "a&b\\\\ \\hline";
+    if (i > 190 && i < 260)
+        return QString("x^2+\\alpha_{%1} \\unknownMathCommand \\text{some \\textbf{text}}").arg(i);
+    return QString("\\item some text $x^{%1}$ with \\textbf{bold} and \\unknownCommand, x^2 outside math % comment").arg(i);
+}
+
+QList<LineSyntaxResult> syntaxResults(LatexDocument *doc)
+{
+    QList<LineSyntaxResult> results;
+    for (int i = 0; i < doc->lineCount(); i++) {
+        QDocumentLineHandle *dlh = doc->line(i).handle();
+        LineSyntaxResult result;
+        foreach (const QFormatRange &range, dlh->getOverlays(-1)) {
+            if (range.format != SpellerUtility::spellcheckErrorFormat)
+                result.overlays << range;
+        }
+        result.env = dlh->getCookieLocked(QDocumentLine::STACK_ENVIRONMENT_COOKIE).value<StackEnvironment>();
+        result.unclosedEnv = dlh->getCookieLocked(QDocumentLine::UNCLOSED_ENVIRONMENT_COOKIE).value<StackEnvironment>();
+        result.tokens = dlh->getTokensLocked();
+        result.parens = doc->line(i).parentheses();
+        results << result;
+    }
+    return results;
+}
+
+bool sameParentheses(const QVector<QParenthesis> &a, const QVector<QParenthesis> &b)
+{
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < a.size(); i++)
+        if (a[i].id != b[i].id || a[i].role != b[i].role || a[i].offset != b[i].offset || a[i].length != b[i].length)
+            return false;
+    return true;
+}
+}
+
 SyntaxCheckTest::SyntaxCheckTest(LatexEditorView* ed): edView(ed){}
 
 void SyntaxCheckTest::checktabular_data(){
@@ -527,5 +600,65 @@ void SyntaxCheckTest::checkExplHighlight(){
     edView->getConfig()->realtimeChecking = realtimeChecking;
 }
 
+void SyntaxCheckTest::checkRegionParallel(){
+    bool inlineSyntaxChecking = edView->getConfig()->inlineSyntaxChecking;
+    bool realtimeChecking = edView->getConfig()->realtimeChecking;
+    edView->getConfig()->inlineSyntaxChecking = true;
+    edView->getConfig()->realtimeChecking = true;
+
+    QStringList lines;
+    for (int i = 0; i < 490; i++)
+        lines << regionTestLine(i);
+    edView->editor->setText(lines.join("\n"), false);
+    LatexDocument *doc = edView->getDocument();
+    doc->synChecker.waitForQueueProcess();
+    const int n = doc->lineCount();
+    QVERIFY(n >= 2 * SyntaxCheck::MIN_REGION_PART_SIZE);
+
+    QList<QDocumentLineHandle *> handles;
+    for (int i = 0; i < n; i++)
+        handles << doc->line(i).handle();
+    StackEnvironment start;
+    doc->getEnv(0, start);
+
+    // sequential check, the following lines are queued by checkNextLine as their environment cookies are missing
+    for (int i = 0; i < n; i++)
+        doc->line(i).removeCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
+    doc->synChecker.putLine(handles.first(), start, TokenStack(), true, 0);
+    doc->synChecker.waitForQueueProcess();
+    const QList<LineSyntaxResult> sequential = syntaxResults(doc);
+    QVERIFY(!sequential.at(100).env.isEmpty());
+    QVERIFY(!sequential.at(n - 1).env.isEmpty());
+
+    // parallel check of the whole region with correct, missing and wrong guesses of the context at the part borders
+    QVector<StackEnvironment> correctGuesses, wrongGuesses;
+    for (int i = 0; i < n; i++) {
+        correctGuesses << sequential.at(i).env;
+        wrongGuesses << sequential.at((i + 37) % n).env;
+    }
+    const QList<QVector<StackEnvironment> > guessSets = QList<QVector<StackEnvironment> >() << correctGuesses << QVector<StackEnvironment>() << wrongGuesses;
+    for (int g = 0; g < guessSets.size(); g++) {
+        for (int i = 0; i < n; i++)
+            doc->line(i).removeCookie(QDocumentLine::STACK_ENVIRONMENT_COOKIE);
+        doc->synChecker.putLines(handles, start, TokenStack(), guessSets.at(g), 0);
+        doc->synChecker.waitForQueueProcess();
+        const QList<LineSyntaxResult> parallel = syntaxResults(doc);
+        QEQUAL(parallel.size(), sequential.size());
+        for (int i = 0; i < n; i++) {
+            const QByteArray where = QString("guesses %1, line %2").arg(g).arg(i).toLatin1();
+            QVERIFY2(parallel.at(i).overlays == sequential.at(i).overlays, where.constData());
+            QVERIFY2(SyntaxCheck::identicalEnvStack(parallel.at(i).env, sequential.at(i).env), where.constData());
+            QVERIFY2(SyntaxCheck::identicalEnvStack(parallel.at(i).unclosedEnv, sequential.at(i).unclosedEnv), where.constData());
+            QVERIFY2(parallel.at(i).tokens == sequential.at(i).tokens, where.constData());
+            QVERIFY2(sameParentheses(parallel.at(i).parens, sequential.at(i).parens), where.constData());
+        }
+    }
+
+    edView->editor->setText("", false);
+    doc->synChecker.waitForQueueProcess();
+    edView->getConfig()->inlineSyntaxChecking = inlineSyntaxChecking;
+    edView->getConfig()->realtimeChecking = realtimeChecking;
+}
+
 #endif
 
@@ -23,6 +23,7 @@ class SyntaxCheckTest: public QObject{
         void checkAllowedMath();
         void checkExplHighlight_data();
         void checkExplHighlight();
+        void checkRegionParallel();
         //void checkIncludes_data();
         //void checkIncludes();
 };
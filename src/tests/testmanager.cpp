@@ -6,8 +6,11 @@
 #include "latexparsing_t.h"
 #include "encoding_t.h"
 #include "execprogram_t.h"
+#include "grammarcheck_t.h"
 #include "buildmanager_t.h"
 #include "codesnippet_t.h"
+#include "qdocumentbuffer_bm.h"
+#include "qdocumentbuffer_t.h"
 #include "qdocumentcursor_t.h"
 #include "qdocumentline_t.h"
 #include "qdocumentsearch_t.h"
@@ -17,9 +20,13 @@
 #include "latexeditorview_t.h"
 #include "latexeditorview_bm.h"
 #include "latexstyleparser_t.h"
+#include "misspellingindex_t.h"
+#include "pdftextindex_t.h"
 #include "scriptengine_t.h"
+#include "searchquery_t.h"
 #include "structureview_t.h"
 #include "tablemanipulation_t.h"
+#include "trigramindex_t.h"
 #include "syntaxcheck_t.h"
 #include "updatechecker_t.h"
 #include "utilsui_t.h"
@@ -85,6 +92,8 @@ QString TestManager::execute(TestLevel level, LatexEditorView* edView, QCodeEdit
             << new BuildManagerTest(buildManager)
             << new CodeSnippetTest(editor)
             << new QDocumentLineTest()
+            << new QDocumentBufferTest()
+            << new QDocumentBufferBenchmark(level==TL_ALL)
             << new QDocumentCursorTest(level==TL_AUTO)
             << new QDocumentSearchTest(editor,level==TL_ALL)
             << new QSearchReplacePanelTest(codeedit,level==TL_ALL)
@@ -94,17 +103,24 @@ QString TestManager::execute(TestLevel level, LatexEditorView* edView, QCodeEdit
             << new LatexCompleterTest(edView)
             << new LatexStyleParserTest(level==TL_ALL)
             << new ScriptEngineTest(edView,level==TL_ALL)
+            << new SearchQueryTest()
             << new LatexEditorViewBenchmark(edView,level==TL_ALL)
             << new StructureViewTest(edView,edView->document,level==TL_ALL)
             << new TableManipulationTest(editor)
+            << new TrigramIndexTest()
             << new SyntaxCheckTest(edView)
+            << new MisspellingIndexTest(edView)
             << new UpdateCheckerTest(level==TL_ALL)
             << new UtilsUITest(level==TL_ALL)
             << new VersionTest(level==TL_ALL)
             << new HelpTest(buildManager)
             << new UserMacroTest()
+            << new GrammarCheckTest(level==TL_ALL)
             << new TexStudioTest(level==TL_ALL)
             << new GitTest(buildManager,level!=TL_AUTO);
+#ifndef NO_POPPLER_PREVIEW
+	tests << new PDFTextIndexTest();
+#endif
 	bool allPassed=true;
 	if (level!=TL_ALL)
 		tr="There are skipped tests. Please rerun with --execute-all-tests\n\n";
@@ -8,23 +8,30 @@
 		src/tests/codesnippet_t.cpp \
 		src/tests/encoding_t.cpp \
 		src/tests/execprogram_t.cpp \
+		src/tests/grammarcheck_t.cpp \
 		src/tests/latexcompleter_t.cpp \
 		src/tests/latexeditorview_bm.cpp \
 		src/tests/latexeditorview_t.cpp \
 		src/tests/latexoutputfilter_t.cpp \
 		src/tests/latexparser_t.cpp \
 		src/tests/latexparsing_t.cpp \
+		src/tests/misspellingindex_t.cpp \
+		src/tests/pdftextindex_t.cpp \
 		src/tests/qcetestutil.cpp \
+		src/tests/qdocumentbuffer_bm.cpp \
+		src/tests/qdocumentbuffer_t.cpp \
 		src/tests/qdocumentcursor_t.cpp \
 		src/tests/qdocumentline_t.cpp \
 		src/tests/qdocumentsearch_t.cpp \
 		src/tests/qeditor_t.cpp \
 		src/tests/qsearchreplacepanel_t.cpp \
 		src/tests/scriptengine_t.cpp \
+		src/tests/searchquery_t.cpp \
 		src/tests/smallUsefulFunctions_t.cpp \
 		src/tests/structureview_t.cpp \
 		src/tests/syntaxcheck_t.cpp \
 		src/tests/tablemanipulation_t.cpp \
+		src/tests/trigramindex_t.cpp \
 		src/tests/usermacro_t.cpp \
 		src/tests/testmanager.cpp \
                 src/tests/git_t.cpp \
@@ -32,8 +39,11 @@
                 src/tests/latexdocument_t.cpp
 	HEADERS += \
 		src/tests/execprogram_t.h \
+		src/tests/grammarcheck_t.h \
 		src/tests/qsearchreplacepanel_t.h \
 		src/tests/updatechecker_t.h \
+		src/tests/qdocumentbuffer_bm.h \
+		src/tests/qdocumentbuffer_t.h \
 		src/tests/qdocumentcursor_t.h \
 		src/tests/qdocumentline_t.h \
 		src/tests/qdocumentsearch_t.h \
@@ -44,11 +54,15 @@
 		src/tests/latexoutputfilter_t.h \
 		src/tests/latexparser_t.h \
 		src/tests/latexparsing_t.h \
+		src/tests/misspellingindex_t.h \
+		src/tests/pdftextindex_t.h \
 		src/tests/latexstyleparser_t.h \
 		src/tests/scriptengine_t.h \
+		src/tests/searchquery_t.h \
 		src/tests/qeditor_t.h \
 		src/tests/buildmanager_t.h \
 		src/tests/tablemanipulation_t.h \
+		src/tests/trigramindex_t.h \
 		src/tests/smallUsefulFunctions_t.h \
 		src/tests/utilsui_t.h \
 		src/tests/utilsversion_t.h \
@@ -0,0 +1,108 @@
+#ifndef QT_NO_DEBUG
+#include "trigramindex_t.h"
+#include "trigramindex.h"
+#include "testutil.h"
+#include <QRandomGenerator>
+
+namespace {
+void writeFile(const QString &fileName, const QByteArray &content)
+{
+	QFile f(fileName);
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	f.write(content);
+}
+}
+
+void TrigramIndexTest::addModifyDelete(){
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	const QString first = dir.filePath("first.tex"), second = dir.filePath("sub/second.tex");
+	QVERIFY(QDir(dir.path()).mkpath("sub"));
+	writeFile(first, "\\section{Introduction}\nsome text\n");
+	writeFile(second, "\\chapter{Summary}\n");
+
+	TrigramIndex index;
+	index.setFolder(dir.path(), QString());
+	index.waitForIndexing();
+	QVERIFY(index.isIndexed(first));
+	QVERIFY(index.isIndexed(second));
+	QVERIFY(index.mayContain(QFileInfo(first), "introduction"));
+	QVERIFY(!index.mayContain(QFileInfo(first), "Summary"));
+	QVERIFY(index.mayContain(QFileInfo(second), "Summary"));
+	QEQUAL(index.candidates(QFileInfoList() << QFileInfo(first) << QFileInfo(second), "some text").size(), 1);
+
+	// added file: not indexed yet, so it is a candidate and gets indexed
+	const QString third = dir.filePath("third.tex");
+	writeFile(third, "nothing here\n");
+	QVERIFY(!index.isIndexed(third));
+	QVERIFY(index.mayContain(QFileInfo(third), "Summary"));
+	index.waitForIndexing();
+	QVERIFY(index.isIndexed(third));
+	QVERIFY(!index.mayContain(QFileInfo(third), "Summary"));
+
+	// modified file (size changes, so the change is detected even within the time stamp resolution)
+	writeFile(first, "\\section{Summary and more}\n");
+	QVERIFY(!index.isIndexed(first));
+	QVERIFY(index.mayContain(QFileInfo(first), "Summary"));
+	index.waitForIndexing();
+	QVERIFY(index.isIndexed(first));
+	QVERIFY(index.mayContain(QFileInfo(first), "summary"));
+	QVERIFY(!index.mayContain(QFileInfo(first), "introduction"));
+
+	// deleted file
+	QVERIFY(QFile::remove(second));
+	index.fileChanged(second);
+	index.waitForIndexing();
+	QVERIFY(!index.isIndexed(second));
+
+	index.setFolder(QString(), QString());
+}
+
+void TrigramIndexTest::noFalseNegatives_data(){
+	QTest::addColumn<QByteArray>("prefix");
+	QTest::newRow("utf8") << QByteArray("\xef\xbb\xbf");
+	QTest::newRow("locale") << QByteArray();
+}
+
+void TrigramIndexTest::noFalseNegatives(){
+	QFETCH(QByteArray, prefix);
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	// files from a small alphabet, so that many search texts are contained in some of them but not in others
+	const QString alphabet = prefix.isEmpty() ? QString("abcAB \n\\{}") : QString::fromUtf8("abcAB \n\\{}äÄé");
+	QTextCodec *codec = prefix.isEmpty() ? QTextCodec::codecForLocale() : QTextCodec::codecForName("UTF-8");
+	QRandomGenerator random(42);
+	QStringList contents;
+	QFileInfoList files;
+	for (int i = 0; i < 20; i++) {
+		QString text;
+		for (int j = random.bounded(200); j >= 0; j--)
+			text += alphabet.at(random.bounded(alphabet.length()));
+		contents << text;
+		files << QFileInfo(dir.filePath(QString("file%1.tex").arg(i)));
+		writeFile(files.last().absoluteFilePath(), prefix + codec->fromUnicode(text));
+	}
+
+	TrigramIndex index;
+	index.setFolder(dir.path(), QString());
+	index.waitForIndexing();
+	int filtered = 0;
+	for (int i = 0; i < 500; i++) {
+		QString search;
+		for (int j = 3 + random.bounded(4); j > 0; j--)
+			search += alphabet.at(random.bounded(alphabet.length()));
+		if (search.contains('\n'))
+			continue;
+		const QFileInfoList candidates = index.candidates(files, search);
+		for (int f = 0; f < files.size(); f++) {
+			if (contents.at(f).contains(search, Qt::CaseInsensitive))
+				QVERIFY2(candidates.contains(files.at(f)), qPrintable(QString("%1 not found in %2").arg(search, files.at(f).fileName())));
+		}
+		filtered += files.size() - candidates.size();
+	}
+	QVERIFY(filtered > 0);
+
+	index.setFolder(QString(), QString());
+}
+
+#endif
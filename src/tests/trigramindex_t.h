@@ -0,0 +1,16 @@
+#ifndef Header_TrigramIndex_T
+#define Header_TrigramIndex_T
+#ifndef QT_NO_DEBUG
+#include "mostQtHeaders.h"
+#include <QtTest/QtTest>
+
+class TrigramIndexTest: public QObject{
+	Q_OBJECT
+	private slots:
+		void addModifyDelete();
+		void noFalseNegatives_data();
+		void noFalseNegatives();
+};
+
+#endif
+#endif
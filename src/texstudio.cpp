@@ -56,6 +56,7 @@
 #include "updatechecker.h"
 #include "session.h"
 #include "searchquery.h"
+#include "misspellingindex.h"
 #include "fileselector.h"
 #include "utilsUI.h"
 #include "utilsSystem.h"
@@ -220,6 +221,7 @@ Texstudio::Texstudio(QWidget *parent, Qt::WindowFlags flags, QSplashScreen *spla
 
 	grammarCheck = new GrammarCheck();
 	grammarCheck->moveToThread(&grammarCheckThread);
+	configManager.grammarCheckerConfig->cachingDir = configManager.cacheDocuments ? joinPath(configManager.configBaseDir, "cache") : QString();
 	GrammarCheck::staticMetaObject.invokeMethod(grammarCheck, "init", Qt::QueuedConnection, Q_ARG(LatexParser, latexParser), Q_ARG(GrammarCheckerConfig, *configManager.grammarCheckerConfig));
     //connect(grammarCheck, SIGNAL(checked(LatexDocument*,QDocumentLineHandle*,int,QList<GrammarError>)), &documents, SLOT(lineGrammarChecked(LatexDocument*,QDocumentLineHandle*,int,QList<GrammarError>)));
     connect(grammarCheck, &GrammarCheck::checked, &documents, &LatexDocuments::lineGrammarChecked);
@@ -1262,6 +1264,7 @@ void Texstudio::setupMenus()
 	newManagedAction(menu, "generaterandomtext", tr("Generate &Random Text..."), SLOT(generateRandomText()));
 	menu->addSeparator();
     newManagedAction(menu, "spelling", tr("Check Spelling..."), SLOT(editSpell()), MAC_OR_DEFAULT(Qt::CTRL | Qt::SHIFT | Qt::Key_F7, Qt::CTRL | Qt::Key_Colon));
+    newManagedAction(menu, "spellingreport", tr("Spelling Report"), SLOT(spellingReport()));
     newManagedAction(menu, "thesaurus", tr("Thesaurus..."), SLOT(editThesaurus()), Qt::CTRL | Qt::SHIFT | Qt::Key_F8);
 	newManagedAction(menu, "wordrepetions", tr("Find Word Repetitions..."), SLOT(findWordRepetions()));
 
@@ -2411,6 +2414,7 @@ LatexEditorView *Texstudio::load(const QString &f , bool asProject, bool recheck
         }
     }
     doc->startSyntaxChecker(); // only syntax check visible documents
+    documents.getTrigramIndex(doc); // index the project folder in the background, so it is ready for the first search
 
     delete docToDelete; // remove cached document which was replaced by newly loaded document
 
@@ -4036,7 +4040,7 @@ void Texstudio::editEraseWordCmdEnv()
         }
     }
     if(!handled){
-        TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList tl = dlh->getTokensLocked();
         int tkPos = Parsing::getTokenAtCol(tl, cursor.columnNumber());
         Token tk;
         if (tkPos > -1)
@@ -4527,6 +4531,7 @@ void Texstudio::readSettings(bool reread)
     spellerManager.setIgnoreFilePrefix(configManager.configFileNameBase);
     spellerManager.setDictPaths(configManager.parseDirList(configManager.spellDictDir));
     spellerManager.setDefaultSpeller(configManager.spellLanguage);
+    MisspellingIndex::setSpellerManager(&spellerManager);
 
     ThesaurusDialog::setUserPath(configManager.configFileNameBase);
 
@@ -4998,7 +5003,7 @@ void Texstudio::normalCompletion()
 		int col = c.columnNumber();
         command = Parsing::getCommandFromToken(tk);
         if(command=="\\begin"){ // special treatment for begin as it is only meaningful with the env-name
-            TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            TokenList tl = dlh->getTokensLocked();
             Token tkCmd=Parsing::getCommandTokenFromToken(tl,tk);
             int k = tl.indexOf(tkCmd) + 1;
             Token tk2=tl.value(k);
@@ -5010,7 +5015,7 @@ void Texstudio::normalCompletion()
 		if (!completer->existValues()) {
 			// no keys found for command
 			// command/arg structure ? (yathesis)
-			TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+			TokenList tl = dlh->getTokensLocked();
 			QString subcommand;
             int add = (type == Token::keyVal_val) ? 1 : 0;
 			if (tk.type == Token::braces || tk.type == Token::squareBracket)
@@ -5241,7 +5246,7 @@ void Texstudio::insertCitation(const QString &text)
         Token tk=ts.last();
         if(tk.type == Token::command){
             // for now, simply assume that it should be added to the next argument
-            TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+            TokenList tl = dlh->getTokensLocked();
             int i = tl.indexOf(tk);
             Token tk2=tl.value(i+1);
             if(tk2.type==Token::braces && tk2.subtype == Token::bibItem){
@@ -6435,6 +6440,12 @@ void Texstudio::beginRunningSubCommand(ProcessX *p, const QString &commandMain,
 		clearLogEntriesInEditors();
 	//outputView->resetMessages();
 	connectSubCommand(p, (RCF_SHOW_STDOUT & flags));
+	if (flags & RCF_COMPILES_TEX) {
+		// list errors while the compiler runs; the log file loaded afterwards replaces these entries
+		outputView->getLogWidget()->beginLiveLog(documents.getTemporaryCompileFileName());
+		p->setObserveStdout(true);
+		connect(p, SIGNAL(standardOutputObserved(QString)), outputView->getLogWidget(), SLOT(addLiveLogChunk(QString)));
+	}
 }
 
 void Texstudio::endRunningSubCommand(ProcessX *p, const QString &commandMain, const QString &subCommand, const RunCommandFlags &flags)
@@ -6447,6 +6458,8 @@ void Texstudio::endRunningSubCommand(ProcessX *p, const QString &commandMain, co
 			UtilsUi::txsWarning(tr("Could not start %1.").arg( buildManager.getCommandInfo(commandMain).displayName + ":" + buildManager.getCommandInfo(subCommand).displayName + ":\n" + p->getCommandLine()));
 	}
 #endif
+	if (flags & RCF_COMPILES_TEX)
+		outputView->getLogWidget()->endLiveLog();
 	if ((flags & RCF_CHANGE_PDF)  && !(flags & RCF_WAITFORFINISHED) && (runningPDFAsyncCommands > 0)) {
 		runningPDFAsyncCommands--;
 #ifndef NO_POPPLER_PREVIEW
@@ -6975,6 +6988,7 @@ void Texstudio::generalOptions()
         spellerManager.setDictPaths(configManager.parseDirList(configManager.spellDictDir));
         spellerManager.setDefaultSpeller(configManager.spellLanguage);
 
+        configManager.grammarCheckerConfig->cachingDir = configManager.cacheDocuments ? joinPath(configManager.configBaseDir, "cache") : QString();
         GrammarCheck::staticMetaObject.invokeMethod(grammarCheck, "init", Qt::QueuedConnection, Q_ARG(LatexParser, latexParser), Q_ARG(GrammarCheckerConfig, *configManager.grammarCheckerConfig));
 
         if (configManager.autoDetectEncodingFromLatex || configManager.autoDetectEncodingFromChars) QDocument::setDefaultCodec(nullptr);
@@ -8175,7 +8189,14 @@ void Texstudio::jumpToSearchResult(LatexDocument *doc, int lineNumber, const Sea
         outputView->showPage(outputView->SEARCH_RESULT_PAGE);
     }
     QDocumentCursor highlight = currentEditor()->cursor();
-    highlight.movePosition(query->searchExpression().length(), QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
+    int length = query->searchExpression().length();
+    foreach (const SearchMatch &match, query->model()->getSearchMatches(highlight.line())) {
+        if (match.pos == highlight.columnNumber()) {
+            length = match.length; // differs from the expression for regular expressions
+            break;
+        }
+    }
+    highlight.movePosition(length, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
     currentEditorView()->temporaryHighlight(highlight);
 }
 /*!
@@ -8199,7 +8220,14 @@ void Texstudio::jumpToFileSearchResult(QString fn, int lineNumber, const SearchQ
         outputView->showPage(outputView->SEARCH_RESULT_PAGE);
     }
     QDocumentCursor highlight = currentEditor()->cursor();
-    highlight.movePosition(query->searchExpression().length(), QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
+    int length = query->searchExpression().length();
+    foreach (const SearchMatch &match, query->model()->getSearchMatches(highlight.line())) {
+        if (match.pos == highlight.columnNumber()) {
+            length = match.length; // differs from the expression for regular expressions
+            break;
+        }
+    }
+    highlight.movePosition(length, QDocumentCursor::NextCharacter, QDocumentCursor::KeepAnchor);
     currentEditorView()->temporaryHighlight(highlight);
 }
 
@@ -8705,7 +8733,7 @@ void Texstudio::previewLatex()
             if (tk.type != Token::none)
                 command = tk.getText();
             if (tk.type == Token::env || tk.type == Token::beginEnv ) {
-                TokenList tl = c.line().handle()->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+                TokenList tl = c.line().handle()->getTokensLocked();
                 tk=Parsing::getCommandTokenFromToken(tl,tk);
                 c.setColumnNumber(tk.start);
                 previewc = edView->parenthizedTextSelection(c);
@@ -9205,7 +9233,7 @@ void Texstudio::editInsertRefToNextLabel(const QString &refCmd, bool backward)
 	// TODO: The search of the line should also be switched to the token system
 
 	QDocumentLineHandle *dlh = currentEditor()->document()->line(m).handle();
-    TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    TokenList tl = dlh->getTokensLocked();
 	QString label = Parsing::getArg(tl, Token::label);
 	if (!label.isEmpty()) {
 		currentEditor()->write(refCmd + "{" + label + "}");
@@ -9232,6 +9260,21 @@ void Texstudio::findLabelUsages(LatexDocument *contextDoc, const QString &labelT
     outputView->showPage(outputView->SEARCH_RESULT_PAGE);
 }
 
+/*!
+ * \brief list all lines of the project with misspelled words in the search results
+ */
+void Texstudio::spellingReport()
+{
+	if (!currentEditorView()) {
+		UtilsUi::txsWarning(tr("No document open"));
+		return;
+	}
+	SpellingSearchQuery *query = new SpellingSearchQuery();
+	searchResultWidget()->setQuery(query);
+	query->run(currentEditorView()->document);
+	outputView->showPage(outputView->SEARCH_RESULT_PAGE);
+}
+
 void Texstudio::findLabelUsagesFromAction()
 {
     QAction *action = qobject_cast<QAction *>(sender());
@@ -10837,7 +10880,7 @@ QSet<QString> Texstudio::collectPotentialCompletionWords(const QDocument *doc,co
 
     for(int i=0;i<doc->lineCount();i++){
         QDocumentLineHandle *dlh=doc->line(i).handle();
-        TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+        TokenList tl = dlh->getTokensLocked();
         QString txt;
         for(int k=0;k<tl.size();k++) {
             Token tk=tl.at(k);
@@ -11440,7 +11483,7 @@ void Texstudio::closeEnvironment()
 	// the below method is not exact and will fail on certain edge cases
 	// for the time being this is good enough. An alternative approach may use the token system:
 	//   QDocumentLineHandle *dlh = edView->document->line(cursor.lineNumber()).handle();
-    //   TokenList tl = dlh->getCookieLocked(QDocumentLine::LEXER_COOKIE).value<TokenList>();
+    //   TokenList tl = dlh->getTokensLocked();
 	if (cursor.columnNumber() > 0) {
 		QString text = cursor.line().text();
         QRegularExpression rxBegin = QRegularExpression("\\\\begin\\{([^}]+)\\}");
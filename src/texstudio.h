@@ -392,6 +392,7 @@ protected slots:
 	void editInsertRefToPrevLabel(const QString &refCmd = "\\ref");
 	void runSearch(SearchQuery *query);
 	void findLabelUsages(LatexDocument *doc, const QString &labelText);
+	void spellingReport();
     void findLabelUsagesFromAction();
 	SearchResultWidget *searchResultWidget();
 
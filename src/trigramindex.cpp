@@ -0,0 +1,324 @@
+#include "trigramindex.h"
+#include "qeditor.h"
+#include "qreliablefilewatch.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const quint32 TRIGRAM_INDEX_MAGIC = 0x54585449; ///< "TXTI"
+const qint32 TRIGRAM_INDEX_VERSION = 2;
+const int MAX_INDEXED_FILES = 20000; ///< limit for scanning a folder, e.g. if the root document is directly in the home folder
+const qint64 MAX_INDEXED_FILE_SIZE = 16 * 1024 * 1024; ///< larger files are not indexed but marked as always searched
+const int MAX_WATCHED_FILES = 500; ///< limit file system watches, other files are checked by size/modification time on lookup
+
+/*!
+ * \brief key of a trigram
+ * Trigrams of ASCII characters are encoded exactly, others are hashed. Collisions only add candidates.
+ */
+inline quint32 trigramKey(ushort a, ushort b, ushort c)
+{
+	if (a < 0x80 && b < 0x80 && c < 0x80)
+		return (quint32(a) << 14) | (quint32(b) << 7) | c;
+	quint64 v = (quint64(a) << 32) | (quint64(b) << 16) | c;
+	v *= 0x9E3779B97F4A7C15ull;
+	return quint32(v >> 33) | 0x80000000u;
+}
+
+inline bool isLineBreak(ushort c)
+{
+	return c == '\n' || c == '\r';
+}
+
+/*!
+ * \brief file types which are indexed when scanning a folder
+ * Other files are indexed when they are looked up.
+ */
+QStringList indexedFileFilter()
+{
+	return QStringList() << "*.tex" << "*.bib" << "*.sty" << "*.cls" << "*.ltx" << "*.dtx" << "*.ins" << "*.def" << "*.cfg" << "*.bbx" << "*.cbx" << "*.lbx" << "*.txt" << "*.Rnw" << "*.Rtex" << "*.asy";
+}
+}
+
+TrigramIndex::TrigramIndex(QObject *parent): QObject(parent), m_modified(false)
+{
+	m_pool.setMaxThreadCount(1);
+	connect(&m_scanWatcher, &QFutureWatcher<void>::finished, this, &TrigramIndex::scanFinished);
+}
+
+TrigramIndex::~TrigramIndex()
+{
+	m_stop.storeRelaxed(1);
+	m_pool.waitForDone();
+	save();
+}
+
+/*!
+ * \brief index all files below folder
+ * The previous index is saved and replaced by the cached index of the new folder, which is updated in the background.
+ * \param folder absolute path, usually the folder of the root document. Empty to stop indexing.
+ * \param cachingFolder folder for storing the index, empty to disable storing
+ */
+void TrigramIndex::setFolder(const QString &folder, const QString &cachingFolder)
+{
+	QString cacheFileName;
+	if (!folder.isEmpty() && !cachingFolder.isEmpty())
+		cacheFileName = cachingFolder + "/" + QString::fromLatin1(QCryptographicHash::hash(folder.toUtf8(), QCryptographicHash::Md5).toHex()) + ".trigrams";
+	if (folder == m_folder && cacheFileName == m_cacheFileName)
+		return;
+
+	m_stop.storeRelaxed(1);
+	m_pool.waitForDone();
+	m_stop.storeRelaxed(0);
+	save();
+	QEditor::watcher()->removeWatch(this);
+	m_lock.lock();
+	m_entries.clear();
+	m_modified = false;
+	m_lock.unlock();
+
+	m_folder = folder;
+	m_cacheFileName = cacheFileName;
+	if (m_folder.isEmpty())
+		return;
+	load(m_cacheFileName);
+	m_scanWatcher.setFuture(QtConcurrent::run(&m_pool, [this, folder]() { scan(folder); }));
+}
+
+QString TrigramIndex::folder() const
+{
+	return m_folder;
+}
+/*!
+ * \brief initial scan of the folder is running
+ */
+bool TrigramIndex::isIndexing() const
+{
+	return m_scanWatcher.isRunning();
+}
+/*!
+ * \brief file is in the index and has not been changed since
+ */
+bool TrigramIndex::isIndexed(const QString &fileName) const
+{
+	QFileInfo fi(fileName);
+	QMutexLocker locker(&m_lock);
+	QHash<QString, Entry>::const_iterator it = m_entries.constFind(fi.absoluteFilePath());
+	return it != m_entries.constEnd() && it->size == fi.size() && it->lastModified == fi.lastModified().toMSecsSinceEpoch();
+}
+/*!
+ * \brief block until the initial scan and all queued updates are done
+ */
+void TrigramIndex::waitForIndexing()
+{
+	m_pool.waitForDone();
+}
+/*!
+ * \brief filter files which may contain text
+ * \param files
+ * \param text plain text, no line breaks
+ * \return all files which contain all trigrams of text or are not indexed
+ */
+QFileInfoList TrigramIndex::candidates(const QFileInfoList &files, const QString &text)
+{
+	const QVector<quint32> needle = trigrams(text);
+	if (needle.isEmpty())
+		return files;
+	QFileInfoList result;
+	foreach (const QFileInfo &fi, files) {
+		if (mayContain(fi, needle))
+			result << fi;
+	}
+	return result;
+}
+
+bool TrigramIndex::mayContain(const QFileInfo &file, const QString &text)
+{
+	return mayContain(file, trigrams(text));
+}
+/*!
+ * \brief check if all trigrams of a text are contained in a file
+ * Files which are not indexed or changed since indexing are queued for indexing and reported as candidates.
+ */
+bool TrigramIndex::mayContain(const QFileInfo &file, const QVector<quint32> &needle)
+{
+	const QString fileName = file.absoluteFilePath();
+	QMutexLocker locker(&m_lock);
+	QHash<QString, Entry>::const_iterator it = m_entries.constFind(fileName);
+	if (it == m_entries.constEnd() || it->size != file.size() || it->lastModified != file.lastModified().toMSecsSinceEpoch()) {
+		locker.unlock();
+		fileChanged(fileName);
+		return true;
+	}
+	if (it->scanAlways)
+		return true;
+	const QVector<quint32> &fileTrigrams = it->trigrams;
+	foreach (quint32 key, needle) {
+		if (!std::binary_search(fileTrigrams.constBegin(), fileTrigrams.constEnd(), key))
+			return false;
+	}
+	return true;
+}
+/*!
+ * \brief case folded trigrams of a text, trigrams which contain a line break are omitted
+ * \param text
+ * \return sorted keys without duplicates
+ */
+QVector<quint32> TrigramIndex::trigrams(const QString &text)
+{
+	const QString folded = text.toCaseFolded();
+	const QChar *c = folded.constData();
+	QVector<quint32> result;
+	result.reserve(folded.length());
+	for (int i = 0; i + 2 < folded.length(); i++) {
+		ushort a = c[i].unicode(), b = c[i + 1].unicode(), d = c[i + 2].unicode();
+		if (isLineBreak(a) || isLineBreak(b) || isLineBreak(d))
+			continue;
+		result << trigramKey(a, b, d);
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	result.squeeze();
+	return result;
+}
+/*!
+ * \brief (re-)index file in the background
+ * Called by QReliableFileWatch if a watched file has been changed.
+ * \param fileName
+ */
+void TrigramIndex::fileChanged(const QString &fileName)
+{
+	if (m_folder.isEmpty() || m_stop.loadRelaxed())
+		return;
+	QtConcurrent::run(&m_pool, [this, fileName]() { update(fileName); });
+}
+
+void TrigramIndex::scanFinished()
+{
+	save();
+	QStringList fileNames;
+	m_lock.lock();
+	fileNames = m_entries.keys();
+	m_lock.unlock();
+	QReliableFileWatch *watcher = QEditor::watcher();
+	for (int i = 0; i < fileNames.size() && i < MAX_WATCHED_FILES; i++)
+		watcher->addWatch(fileNames.at(i), this);
+}
+
+void TrigramIndex::scan(const QString &folder)
+{
+	QDirIterator it(folder, indexedFileFilter(), QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+	for (int count = 0; it.hasNext() && count < MAX_INDEXED_FILES && !m_stop.loadRelaxed(); count++)
+		update(it.next());
+}
+/*!
+ * \brief index file if it is not indexed or outdated
+ * Runs in the background thread.
+ */
+void TrigramIndex::update(const QString &fileName)
+{
+	if (m_stop.loadRelaxed())
+		return;
+	QFileInfo fi(fileName);
+	const QString key = fi.absoluteFilePath();
+	if (!fi.exists()) {
+		QMutexLocker locker(&m_lock);
+		if (m_entries.remove(key))
+			m_modified = true;
+		return;
+	}
+	m_lock.lock();
+	QHash<QString, Entry>::const_iterator it = m_entries.constFind(key);
+	bool current = it != m_entries.constEnd() && it->size == fi.size() && it->lastModified == fi.lastModified().toMSecsSinceEpoch();
+	m_lock.unlock();
+	if (current)
+		return;
+
+	Entry entry;
+	bool indexed = indexFile(key, entry);
+	QMutexLocker locker(&m_lock);
+	if (indexed)
+		m_entries.insert(key, entry);
+	else
+		m_entries.remove(key);
+	m_modified = true;
+}
+/*!
+ * \brief read trigrams of a file
+ * The file is decoded like in SearchQuery::searchInFile(), binary files get an empty trigram set.
+ * Large files are only marked as always to be searched, so they are not queued for indexing on every lookup.
+ * \return false if the file could not be indexed
+ */
+bool TrigramIndex::indexFile(const QString &fileName, Entry &entry)
+{
+	QFile f(fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	const qint64 size = f.size();
+	entry.size = size;
+	entry.lastModified = QFileInfo(fileName).lastModified().toMSecsSinceEpoch();
+	entry.scanAlways = size > MAX_INDEXED_FILE_SIZE;
+	if (size == 0 || entry.scanAlways)
+		return true;
+
+	uchar *mapped = f.map(0, size);
+	const QByteArray buffer = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(size)) : f.readAll();
+	const char *data = buffer.constData();
+	const int length = buffer.size();
+	bool utf16 = length >= 2 && ((uchar(data[0]) == 0xFF && uchar(data[1]) == 0xFE) || (uchar(data[0]) == 0xFE && uchar(data[1]) == 0xFF));
+	if (utf16 || !memchr(data, 0, qMin(length, 8192)))
+		entry.trigrams = trigrams(QTextCodec::codecForUtfText(buffer, QTextCodec::codecForLocale())->toUnicode(data, length));
+	if (mapped)
+		f.unmap(mapped);
+	return true;
+}
+
+bool TrigramIndex::load(const QString &fileName)
+{
+	if (fileName.isEmpty())
+		return false;
+	QFile f(fileName);
+	if (!f.open(QIODevice::ReadOnly))
+		return false;
+	QDataStream in(&f);
+	in.setVersion(QDataStream::Qt_5_12);
+	quint32 magic;
+	qint32 version, count;
+	QString folder;
+	in >> magic >> version >> folder >> count;
+	if (magic != TRIGRAM_INDEX_MAGIC || version != TRIGRAM_INDEX_VERSION || folder != m_folder || count < 0)
+		return false;
+	QHash<QString, Entry> entries;
+	entries.reserve(count);
+	for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+		QString name;
+		Entry entry;
+		in >> name >> entry.size >> entry.lastModified >> entry.trigrams >> entry.scanAlways;
+		entries.insert(name, entry);
+	}
+	if (in.status() != QDataStream::Ok)
+		return false;
+	QMutexLocker locker(&m_lock);
+	m_entries.swap(entries);
+	m_modified = false;
+	return true;
+}
+
+void TrigramIndex::save()
+{
+	QMutexLocker locker(&m_lock);
+	if (!m_modified || m_cacheFileName.isEmpty())
+		return;
+	QDir().mkpath(QFileInfo(m_cacheFileName).absolutePath());
+	QFile f(m_cacheFileName);
+	if (!f.open(QIODevice::WriteOnly))
+		return;
+	QDataStream out(&f);
+	out.setVersion(QDataStream::Qt_5_12);
+	out << TRIGRAM_INDEX_MAGIC << TRIGRAM_INDEX_VERSION << m_folder << qint32(m_entries.size());
+	for (QHash<QString, Entry>::const_iterator it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+		out << it.key() << it->size << it->lastModified << it->trigrams << it->scanAlways;
+	m_modified = false;
+}
@@ -0,0 +1,69 @@
+#ifndef Header_TrigramIndex
+#define Header_TrigramIndex
+
+#include "mostQtHeaders.h"
+#include <QFutureWatcher>
+#include <QMutex>
+#include <QThreadPool>
+
+/*!
+ * \brief persistent trigram index of the files in a folder
+ *
+ * For every text file below the folder, the set of case folded trigrams (three consecutive characters within a line) is stored.
+ * A file can only contain a text if it contains all trigrams of the text, so searches can skip all other files without reading them.
+ * Indexing runs in a background thread, files are re-indexed when QReliableFileWatch reports a change or when size/modification time differ on lookup.
+ * Files which are not (yet) indexed are always considered as candidates, i.e. the index never hides a match.
+ * Files which are too large for indexing are remembered as such and always searched.
+ * The index is stored in the caching folder and reloaded when the same folder is indexed again.
+ */
+class TrigramIndex : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit TrigramIndex(QObject *parent = nullptr);
+	~TrigramIndex();
+
+	void setFolder(const QString &folder, const QString &cachingFolder);
+	QString folder() const;
+	bool isIndexing() const;
+	bool isIndexed(const QString &fileName) const;
+	void waitForIndexing();
+
+	QFileInfoList candidates(const QFileInfoList &files, const QString &text);
+	bool mayContain(const QFileInfo &file, const QString &text);
+
+	static QVector<quint32> trigrams(const QString &text);
+
+public slots:
+	void fileChanged(const QString &fileName);
+
+private slots:
+	void scanFinished();
+
+private:
+	struct Entry {
+		qint64 size;
+		qint64 lastModified;
+		QVector<quint32> trigrams; ///< sorted, unique
+		bool scanAlways; ///< file is too large for indexing, trigrams are empty
+	};
+
+	bool mayContain(const QFileInfo &file, const QVector<quint32> &needle);
+	void scan(const QString &folder);
+	void update(const QString &fileName);
+	static bool indexFile(const QString &fileName, Entry &entry);
+	bool load(const QString &fileName);
+	void save();
+
+	mutable QMutex m_lock; ///< protects m_entries and m_modified
+	QHash<QString, Entry> m_entries;
+	bool m_modified;
+	QString m_folder;
+	QString m_cacheFileName;
+	QThreadPool m_pool; ///< single background thread for (re-)indexing
+	QFutureWatcher<void> m_scanWatcher;
+	QAtomicInt m_stop;
+};
+
+#endif // Header_TrigramIndex